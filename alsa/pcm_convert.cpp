@@ -0,0 +1,716 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pcm_convert.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+/* frames converted to the destination format at a time before a layout
+ * change, the stage buffer stays in L1 */
+#define PCM_CONVERT_BLOCK_FRAMES 64
+
+/* Plain C kernels. The SIMD ones finish their tails with these. */
+
+static void s24_to_s16_c(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int16_t *d = (int16_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i] = (int16_t)(s[i] >> 8);
+}
+
+static void s32_to_s16_c(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int16_t *d = (int16_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i] = (int16_t)(s[i] >> 16);
+}
+
+static void s16_to_s24_c(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int32_t *d = (int32_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i] = (int32_t)s[i] * (1 << 8);
+}
+
+static void s16_to_s32_c(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int32_t *d = (int32_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i] = (int32_t)s[i] * (1 << 16);
+}
+
+static void s24_to_s32_c(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i] = (int32_t)((uint32_t)s[i] << 8);
+}
+
+static void s32_to_s24_c(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i] = s[i] >> 8;
+}
+
+static void mono_to_stereo_16_c(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int16_t *d = (int16_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i * 2] = d[i * 2 + 1] = s[i];
+}
+
+static void mono_to_stereo_32_c(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i * 2] = d[i * 2 + 1] = s[i];
+}
+
+static void stereo_to_mono_16_c(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int16_t *d = (int16_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i] = (int16_t)((s[i * 2] >> 1) + (s[i * 2 + 1] >> 1));
+}
+
+static void stereo_to_mono_32_c(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    for (size_t i = 0; i < count; i++) d[i] = (s[i * 2] >> 1) + (s[i * 2 + 1] >> 1);
+}
+
+static void shuffle_c(const void *src, void *dst, size_t count, const uint8_t *table,
+                      unsigned int vectors) {
+    const uint8_t *s = (const uint8_t *)src;
+    uint8_t *d = (uint8_t *)dst;
+    unsigned int bytes = vectors * 16;
+    uint8_t group[PCM_CONVERT_SHUFFLE_MAX_VECTORS * 16];
+    for (size_t i = 0; i < count; i++, s += bytes, d += bytes) {
+        memcpy(group, s, bytes);
+        for (unsigned int b = 0; b < bytes; b++)
+            d[b] = (table[b] & PCM_CONVERT_SHUFFLE_ZERO) ? 0 : group[table[b]];
+    }
+}
+
+static const struct pcm_convert_kernels kernels_c = {
+        "c",
+        {
+                {NULL, s16_to_s24_c, s16_to_s32_c},
+                {s24_to_s16_c, NULL, s24_to_s32_c},
+                {s32_to_s16_c, s32_to_s24_c, NULL},
+        },
+        mono_to_stereo_16_c,
+        mono_to_stereo_32_c,
+        stereo_to_mono_16_c,
+        stereo_to_mono_32_c,
+        shuffle_c,
+};
+
+#if defined(__aarch64__)
+static void s24_to_s16_neon(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int16_t *d = (int16_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // the narrowing shift keeps the low 16 bits, as the cast does
+        int16x4_t lo = vshrn_n_s32(vld1q_s32(s + i), 8);
+        int16x4_t hi = vshrn_n_s32(vld1q_s32(s + i + 4), 8);
+        vst1q_s16(d + i, vcombine_s16(lo, hi));
+    }
+    s24_to_s16_c(s + i, d + i, count - i);
+}
+
+static void s32_to_s16_neon(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int16_t *d = (int16_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x4_t lo = vshrn_n_s32(vld1q_s32(s + i), 16);
+        int16x4_t hi = vshrn_n_s32(vld1q_s32(s + i + 4), 16);
+        vst1q_s16(d + i, vcombine_s16(lo, hi));
+    }
+    s32_to_s16_c(s + i, d + i, count - i);
+}
+
+static void s16_to_s24_neon(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(s + i);
+        vst1q_s32(d + i, vshll_n_s16(vget_low_s16(v), 8));
+        vst1q_s32(d + i + 4, vshll_n_s16(vget_high_s16(v), 8));
+    }
+    s16_to_s24_c(s + i, d + i, count - i);
+}
+
+static void s16_to_s32_neon(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(s + i);
+        vst1q_s32(d + i, vshll_n_s16(vget_low_s16(v), 16));
+        vst1q_s32(d + i + 4, vshll_n_s16(vget_high_s16(v), 16));
+    }
+    s16_to_s32_c(s + i, d + i, count - i);
+}
+
+static void s24_to_s32_neon(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int32x4_t lo = vld1q_s32(s + i);
+        int32x4_t hi = vld1q_s32(s + i + 4);
+        vst1q_s32(d + i, vshlq_n_s32(lo, 8));
+        vst1q_s32(d + i + 4, vshlq_n_s32(hi, 8));
+    }
+    s24_to_s32_c(s + i, d + i, count - i);
+}
+
+static void s32_to_s24_neon(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int32x4_t lo = vld1q_s32(s + i);
+        int32x4_t hi = vld1q_s32(s + i + 4);
+        vst1q_s32(d + i, vshrq_n_s32(lo, 8));
+        vst1q_s32(d + i + 4, vshrq_n_s32(hi, 8));
+    }
+    s32_to_s24_c(s + i, d + i, count - i);
+}
+
+static void mono_to_stereo_16_neon(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int16_t *d = (int16_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8x2_t v;
+        v.val[0] = v.val[1] = vld1q_s16(s + i);
+        vst2q_s16(d + i * 2, v);
+    }
+    mono_to_stereo_16_c(s + i, d + i * 2, count - i);
+}
+
+static void mono_to_stereo_32_neon(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32x4x2_t v;
+        v.val[0] = v.val[1] = vld1q_s32(s + i);
+        vst2q_s32(d + i * 2, v);
+    }
+    mono_to_stereo_32_c(s + i, d + i * 2, count - i);
+}
+
+static void stereo_to_mono_16_neon(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int16_t *d = (int16_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8x2_t v = vld2q_s16(s + i * 2);
+        // not vhaddq, it rounds the sum once instead of each half
+        vst1q_s16(d + i, vaddq_s16(vshrq_n_s16(v.val[0], 1), vshrq_n_s16(v.val[1], 1)));
+    }
+    stereo_to_mono_16_c(s + i * 2, d + i, count - i);
+}
+
+static void stereo_to_mono_32_neon(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32x4x2_t v = vld2q_s32(s + i * 2);
+        vst1q_s32(d + i, vaddq_s32(vshrq_n_s32(v.val[0], 1), vshrq_n_s32(v.val[1], 1)));
+    }
+    stereo_to_mono_32_c(s + i * 2, d + i, count - i);
+}
+
+// TBL gives 0 for the indexes past the table, PCM_CONVERT_SHUFFLE_ZERO is one.
+static void shuffle_neon(const void *src, void *dst, size_t count, const uint8_t *table,
+                         unsigned int vectors) {
+    const uint8_t *s = (const uint8_t *)src;
+    uint8_t *d = (uint8_t *)dst;
+    uint8x16_t t0 = vld1q_u8(table);
+    if (vectors == 1) {
+        for (size_t i = 0; i < count; i++, s += 16, d += 16)
+            vst1q_u8(d, vqtbl1q_u8(vld1q_u8(s), t0));
+    } else if (vectors == 2) {
+        uint8x16_t t1 = vld1q_u8(table + 16);
+        for (size_t i = 0; i < count; i++, s += 32, d += 32) {
+            uint8x16x2_t in = vld1q_u8_x2(s);
+            uint8x16_t o0 = vqtbl2q_u8(in, t0);
+            uint8x16_t o1 = vqtbl2q_u8(in, t1);
+            vst1q_u8(d, o0);
+            vst1q_u8(d + 16, o1);
+        }
+    } else if (vectors == 3) {
+        uint8x16_t t1 = vld1q_u8(table + 16);
+        uint8x16_t t2 = vld1q_u8(table + 32);
+        for (size_t i = 0; i < count; i++, s += 48, d += 48) {
+            uint8x16x3_t in = vld1q_u8_x3(s);
+            uint8x16_t o0 = vqtbl3q_u8(in, t0);
+            uint8x16_t o1 = vqtbl3q_u8(in, t1);
+            uint8x16_t o2 = vqtbl3q_u8(in, t2);
+            vst1q_u8(d, o0);
+            vst1q_u8(d + 16, o1);
+            vst1q_u8(d + 32, o2);
+        }
+    }
+}
+
+static const struct pcm_convert_kernels kernels_neon = {
+        "neon",
+        {
+                {NULL, s16_to_s24_neon, s16_to_s32_neon},
+                {s24_to_s16_neon, NULL, s24_to_s32_neon},
+                {s32_to_s16_neon, s32_to_s24_neon, NULL},
+        },
+        mono_to_stereo_16_neon,
+        mono_to_stereo_32_neon,
+        stereo_to_mono_16_neon,
+        stereo_to_mono_32_neon,
+        shuffle_neon,
+};
+#elif defined(__x86_64__) || defined(__i386__)
+static void s24_to_s16_sse2(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int16_t *d = (int16_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // sign extend bits 8 to 23 so the saturating pack keeps them as they are
+        __m128i lo = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(s + i + 4));
+        lo = _mm_srai_epi32(_mm_slli_epi32(lo, 8), 16);
+        hi = _mm_srai_epi32(_mm_slli_epi32(hi, 8), 16);
+        _mm_storeu_si128((__m128i *)(d + i), _mm_packs_epi32(lo, hi));
+    }
+    s24_to_s16_c(s + i, d + i, count - i);
+}
+
+static void s32_to_s16_sse2(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int16_t *d = (int16_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(s + i)), 16);
+        __m128i hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(s + i + 4)), 16);
+        _mm_storeu_si128((__m128i *)(d + i), _mm_packs_epi32(lo, hi));
+    }
+    s32_to_s16_c(s + i, d + i, count - i);
+}
+
+static void s16_to_s24_sse2(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int32_t *d = (int32_t *)dst;
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // the samples land in the high halves, shift them back down signed
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_srai_epi32(_mm_unpacklo_epi16(zero, v), 8));
+        _mm_storeu_si128((__m128i *)(d + i + 4), _mm_srai_epi32(_mm_unpackhi_epi16(zero, v), 8));
+    }
+    s16_to_s24_c(s + i, d + i, count - i);
+}
+
+static void s16_to_s32_sse2(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int32_t *d = (int32_t *)dst;
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_unpacklo_epi16(zero, v));
+        _mm_storeu_si128((__m128i *)(d + i + 4), _mm_unpackhi_epi16(zero, v));
+    }
+    s16_to_s32_c(s + i, d + i, count - i);
+}
+
+static void s24_to_s32_sse2(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(s + i + 4));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_slli_epi32(lo, 8));
+        _mm_storeu_si128((__m128i *)(d + i + 4), _mm_slli_epi32(hi, 8));
+    }
+    s24_to_s32_c(s + i, d + i, count - i);
+}
+
+static void s32_to_s24_sse2(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(s + i + 4));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_srai_epi32(lo, 8));
+        _mm_storeu_si128((__m128i *)(d + i + 4), _mm_srai_epi32(hi, 8));
+    }
+    s32_to_s24_c(s + i, d + i, count - i);
+}
+
+static void mono_to_stereo_16_sse2(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int16_t *d = (int16_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        _mm_storeu_si128((__m128i *)(d + i * 2), _mm_unpacklo_epi16(v, v));
+        _mm_storeu_si128((__m128i *)(d + i * 2 + 8), _mm_unpackhi_epi16(v, v));
+    }
+    mono_to_stereo_16_c(s + i, d + i * 2, count - i);
+}
+
+static void mono_to_stereo_32_sse2(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        _mm_storeu_si128((__m128i *)(d + i * 2), _mm_unpacklo_epi32(v, v));
+        _mm_storeu_si128((__m128i *)(d + i * 2 + 4), _mm_unpackhi_epi32(v, v));
+    }
+    mono_to_stereo_32_c(s + i, d + i * 2, count - i);
+}
+
+static void stereo_to_mono_16_sse2(const void *src, void *dst, size_t count) {
+    const int16_t *s = (const int16_t *)src;
+    int16_t *d = (int16_t *)dst;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // each 32 bit lane holds a frame, left in the low half
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + i * 2));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i * 2 + 8));
+        __m128i lo = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 17),
+                                   _mm_srai_epi32(a, 17));
+        __m128i hi = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(b, 16), 17),
+                                   _mm_srai_epi32(b, 17));
+        _mm_storeu_si128((__m128i *)(d + i), _mm_packs_epi32(lo, hi));
+    }
+    stereo_to_mono_16_c(s + i * 2, d + i, count - i);
+}
+
+static void stereo_to_mono_32_sse2(const void *src, void *dst, size_t count) {
+    const int32_t *s = (const int32_t *)src;
+    int32_t *d = (int32_t *)dst;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(s + i * 2)));
+        __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(s + i * 2 + 4)));
+        __m128i left = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i right = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128((__m128i *)(d + i),
+                         _mm_add_epi32(_mm_srai_epi32(left, 1), _mm_srai_epi32(right, 1)));
+    }
+    stereo_to_mono_32_c(s + i * 2, d + i, count - i);
+}
+
+// PSHUFB only looks into one vector, so output vector o is the OR of a
+// shuffle of each input vector, with the bytes of the other vectors zeroed.
+// V is a constant so the masks and the vectors of a group stay in registers.
+template <unsigned int V>
+__attribute__((target("ssse3"))) static void shuffle_groups_ssse3(const uint8_t *s, uint8_t *d,
+                                                                   size_t count,
+                                                                   const __m128i (*masks)[V]) {
+    __m128i m[V][V];
+    for (unsigned int o = 0; o < V; o++)
+        for (unsigned int v = 0; v < V; v++) m[o][v] = masks[o][v];
+
+    for (size_t i = 0; i < count; i++, s += V * 16, d += V * 16) {
+        __m128i in[V];
+        __m128i out[V];
+        for (unsigned int v = 0; v < V; v++) in[v] = _mm_loadu_si128((const __m128i *)(s + v * 16));
+        for (unsigned int o = 0; o < V; o++) {
+            out[o] = _mm_shuffle_epi8(in[0], m[o][0]);
+            for (unsigned int v = 1; v < V; v++)
+                out[o] = _mm_or_si128(out[o], _mm_shuffle_epi8(in[v], m[o][v]));
+        }
+        for (unsigned int o = 0; o < V; o++) _mm_storeu_si128((__m128i *)(d + o * 16), out[o]);
+    }
+}
+
+template <unsigned int V>
+__attribute__((target("ssse3"))) static void shuffle_ssse3(const uint8_t *s, uint8_t *d,
+                                                            size_t count, const uint8_t *table) {
+    __m128i masks[V][V];
+    for (unsigned int o = 0; o < V; o++) {
+        for (unsigned int v = 0; v < V; v++) {
+            uint8_t mask[16];
+            for (unsigned int b = 0; b < 16; b++) {
+                uint8_t index = table[o * 16 + b];
+                mask[b] = (index & PCM_CONVERT_SHUFFLE_ZERO) || index / 16 != v
+                                  ? PCM_CONVERT_SHUFFLE_ZERO
+                                  : index % 16;
+            }
+            masks[o][v] = _mm_loadu_si128((const __m128i *)mask);
+        }
+    }
+    shuffle_groups_ssse3<V>(s, d, count, masks);
+}
+
+static void shuffle_ssse3(const void *src, void *dst, size_t count, const uint8_t *table,
+                          unsigned int vectors) {
+    const uint8_t *s = (const uint8_t *)src;
+    uint8_t *d = (uint8_t *)dst;
+    if (vectors == 1)
+        shuffle_ssse3<1>(s, d, count, table);
+    else if (vectors == 2)
+        shuffle_ssse3<2>(s, d, count, table);
+    else if (vectors == 3)
+        shuffle_ssse3<3>(s, d, count, table);
+}
+
+// SSE2 has no byte shuffle, the shuffles fall back to C without SSSE3.
+static const struct pcm_convert_kernels kernels_sse2 = {
+        "sse2",
+        {
+                {NULL, s16_to_s24_sse2, s16_to_s32_sse2},
+                {s24_to_s16_sse2, NULL, s24_to_s32_sse2},
+                {s32_to_s16_sse2, s32_to_s24_sse2, NULL},
+        },
+        mono_to_stereo_16_sse2,
+        mono_to_stereo_32_sse2,
+        stereo_to_mono_16_sse2,
+        stereo_to_mono_32_sse2,
+        shuffle_c,
+};
+
+static const struct pcm_convert_kernels kernels_ssse3 = {
+        "ssse3",
+        {
+                {NULL, s16_to_s24_sse2, s16_to_s32_sse2},
+                {s24_to_s16_sse2, NULL, s24_to_s32_sse2},
+                {s32_to_s16_sse2, s32_to_s24_sse2, NULL},
+        },
+        mono_to_stereo_16_sse2,
+        mono_to_stereo_32_sse2,
+        stereo_to_mono_16_sse2,
+        stereo_to_mono_32_sse2,
+        shuffle_ssse3,
+};
+#endif
+
+static const struct pcm_convert_kernels *select_kernels(void) {
+    const struct pcm_convert_kernels *kernels = &kernels_c;
+#if defined(__aarch64__)
+    // NEON is mandatory on arm64.
+    kernels = &kernels_neon;
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+        kernels = &kernels_ssse3;
+    else if (__builtin_cpu_supports("sse2"))
+        kernels = &kernels_sse2;
+#endif
+    return kernels;
+}
+
+const struct pcm_convert_kernels *pcm_convert_get_kernels(void) {
+    static const struct pcm_convert_kernels *kernels = select_kernels();
+    return kernels;
+}
+
+const struct pcm_convert_kernels *pcm_convert_get_kernels_c(void) {
+    return &kernels_c;
+}
+
+size_t pcm_convert_format_bytes(enum pcm_convert_format format) {
+    return format == PCM_CONVERT_S16_LE ? 2 : 4;
+}
+
+// Sets up the byte shuffle of the smallest group of frames that is a whole
+// number of vectors, if it is no larger than PCM_CONVERT_SHUFFLE_MAX_VECTORS.
+static bool init_shuffle(struct pcm_converter *cv) {
+    unsigned int width = pcm_convert_format_bytes(cv->dst_format);
+    unsigned int frame = width * cv->dst_channels;
+    unsigned int frames = 1;
+    while ((frames * frame) % 16)
+        frames++;
+    if (frames * frame > PCM_CONVERT_SHUFFLE_MAX_VECTORS * 16)
+        return false;
+
+    for (unsigned int f = 0; f < frames; f++) {
+        for (unsigned int c = 0; c < cv->dst_channels; c++) {
+            int src = cv->map[c][0];
+            for (unsigned int b = 0; b < width; b++) {
+                cv->shuffle[f * frame + c * width + b] =
+                        src == PCM_CONVERT_SILENT ? PCM_CONVERT_SHUFFLE_ZERO
+                                                  : f * frame + src * width + b;
+            }
+        }
+    }
+    cv->shuffle_frames = frames;
+    cv->shuffle_vectors = frames * frame / 16;
+    return true;
+}
+
+static enum pcm_convert_layout select_layout(struct pcm_converter *cv) {
+    bool same = cv->src_channels == cv->dst_channels;
+    bool mix = false;
+    for (unsigned int c = 0; c < cv->dst_channels; c++) {
+        if (cv->map[c][0] != (int)c || cv->map[c][1] != PCM_CONVERT_SILENT)
+            same = false;
+        if (cv->map[c][1] != PCM_CONVERT_SILENT)
+            mix = true;
+    }
+    if (same)
+        return PCM_CONVERT_SAME_LAYOUT;
+
+    if (cv->src_channels == 1 && cv->dst_channels == 2 && !mix && cv->map[0][0] == 0 &&
+        cv->map[1][0] == 0)
+        return PCM_CONVERT_MONO_TO_STEREO;
+
+    // the mix is symmetric, either order is the same downmix
+    if (cv->src_channels == 2 && cv->dst_channels == 1 && cv->map[0][0] != PCM_CONVERT_SILENT &&
+        cv->map[0][1] != PCM_CONVERT_SILENT && cv->map[0][0] != cv->map[0][1])
+        return PCM_CONVERT_STEREO_TO_MONO;
+
+    if (cv->src_channels == cv->dst_channels && !mix && init_shuffle(cv))
+        return PCM_CONVERT_SHUFFLE;
+
+    return PCM_CONVERT_MAP;
+}
+
+int pcm_converter_init(struct pcm_converter *cv, enum pcm_convert_format src_format,
+                       unsigned int src_channels, enum pcm_convert_format dst_format,
+                       unsigned int dst_channels, const int8_t *map) {
+    if (!cv || (unsigned int)src_format >= PCM_CONVERT_FORMAT_COUNT ||
+        (unsigned int)dst_format >= PCM_CONVERT_FORMAT_COUNT || src_channels == 0 ||
+        src_channels > PCM_CONVERT_MAX_CHANNELS || dst_channels == 0 ||
+        dst_channels > PCM_CONVERT_MAX_CHANNELS)
+        return -EINVAL;
+
+    memset(cv, 0, sizeof(*cv));
+    cv->src_format = src_format;
+    cv->dst_format = dst_format;
+    cv->src_channels = src_channels;
+    cv->dst_channels = dst_channels;
+    for (unsigned int c = 0; c < dst_channels; c++) {
+        cv->map[c][1] = PCM_CONVERT_SILENT;
+        if (map) {
+            if (map[c] < PCM_CONVERT_SILENT || map[c] >= (int)src_channels)
+                return -EINVAL;
+            cv->map[c][0] = map[c];
+        } else if (src_channels == 2 && dst_channels == 1) {
+            cv->map[c][0] = 0;
+            cv->map[c][1] = 1;
+        } else if (src_channels == 1) {
+            cv->map[c][0] = 0;
+        } else {
+            cv->map[c][0] = c < src_channels ? (int8_t)c : PCM_CONVERT_SILENT;
+        }
+    }
+    cv->layout = select_layout(cv);
+    cv->kernels = pcm_convert_get_kernels();
+    return 0;
+}
+
+void pcm_converter_set_kernels(struct pcm_converter *cv,
+                               const struct pcm_convert_kernels *kernels) {
+    cv->kernels = kernels;
+}
+
+template <typename T>
+static void map_frames_t(const struct pcm_converter *cv, const T *src, T *dst, size_t frames) {
+    T in[PCM_CONVERT_MAX_CHANNELS];
+    for (size_t f = 0; f < frames; f++, src += cv->src_channels, dst += cv->dst_channels) {
+        memcpy(in, src, cv->src_channels * sizeof(T));
+        for (unsigned int c = 0; c < cv->dst_channels; c++) {
+            int a = cv->map[c][0];
+            int b = cv->map[c][1];
+            if (a == PCM_CONVERT_SILENT)
+                dst[c] = 0;
+            else if (b == PCM_CONVERT_SILENT)
+                dst[c] = in[a];
+            else
+                dst[c] = (T)((in[a] >> 1) + (in[b] >> 1));
+        }
+    }
+}
+
+static void map_frames(const struct pcm_converter *cv, const void *src, void *dst,
+                       size_t frames) {
+    if (cv->dst_format == PCM_CONVERT_S16_LE)
+        map_frames_t(cv, (const int16_t *)src, (int16_t *)dst, frames);
+    else
+        map_frames_t(cv, (const int32_t *)src, (int32_t *)dst, frames);
+}
+
+// Changes the channel layout of frames already in the destination format.
+static void convert_layout(const struct pcm_converter *cv, const void *src, void *dst,
+                           size_t frames) {
+    const struct pcm_convert_kernels *k = cv->kernels;
+    bool wide = pcm_convert_format_bytes(cv->dst_format) == 4;
+    switch (cv->layout) {
+        case PCM_CONVERT_SAME_LAYOUT:
+            if (src != dst && frames)
+                memmove(dst, src,
+                        frames * cv->dst_channels * pcm_convert_format_bytes(cv->dst_format));
+            break;
+        case PCM_CONVERT_MONO_TO_STEREO:
+            (wide ? k->mono_to_stereo_32 : k->mono_to_stereo_16)(src, dst, frames);
+            break;
+        case PCM_CONVERT_STEREO_TO_MONO:
+            (wide ? k->stereo_to_mono_32 : k->stereo_to_mono_16)(src, dst, frames);
+            break;
+        case PCM_CONVERT_SHUFFLE: {
+            size_t groups = frames / cv->shuffle_frames;
+            size_t done = groups * cv->shuffle_vectors * 16;
+            k->shuffle(src, dst, groups, cv->shuffle, cv->shuffle_vectors);
+            map_frames(cv, (const uint8_t *)src + done, (uint8_t *)dst + done,
+                       frames - groups * cv->shuffle_frames);
+            break;
+        }
+        case PCM_CONVERT_MAP:
+            map_frames(cv, src, dst, frames);
+            break;
+    }
+}
+
+void pcm_convert(const struct pcm_converter *cv, const void *src, void *dst, size_t frames) {
+    pcm_convert_samples_fn samples = cv->kernels->samples[cv->src_format][cv->dst_format];
+    if (!samples) {
+        convert_layout(cv, src, dst, frames);
+        return;
+    }
+    if (cv->layout == PCM_CONVERT_SAME_LAYOUT) {
+        samples(src, dst, frames * cv->src_channels);
+        return;
+    }
+
+    // the format first, into a block small enough to stay in the cache, then
+    // the layout from there
+    int32_t stage[PCM_CONVERT_BLOCK_FRAMES * PCM_CONVERT_MAX_CHANNELS];
+    size_t src_frame = pcm_convert_format_bytes(cv->src_format) * cv->src_channels;
+    size_t dst_frame = pcm_convert_format_bytes(cv->dst_format) * cv->dst_channels;
+    const uint8_t *s = (const uint8_t *)src;
+    uint8_t *d = (uint8_t *)dst;
+    while (frames) {
+        size_t n = frames < PCM_CONVERT_BLOCK_FRAMES ? frames : PCM_CONVERT_BLOCK_FRAMES;
+        samples(s, stage, n * cv->src_channels);
+        convert_layout(cv, stage, d, n);
+        s += n * src_frame;
+        d += n * dst_frame;
+        frames -= n;
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PCM_CONVERT_H
+#define _PCM_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sample format conversion and channel remapping of interleaved PCM periods.
+ *
+ * A converter is set up once from the source and destination formats, the
+ * channel counts and a channel map, and picks the kernels for it: NEON on
+ * arm64, SSE2/SSSE3 on x86, plain C elsewhere. Every implementation gives the
+ * same samples as the C one. It does not depend on any Android library, so it
+ * also builds on a host for pcm_convert_test and pcm_convert_bench.
+ *
+ * Width changes are shifts, like the HAL always did:
+ *   S24_LE -> S16_LE  (int16_t)(s >> 8)
+ *   S32_LE -> S16_LE  (int16_t)(s >> 16)
+ *   S16_LE -> S24_LE  s << 8
+ *   S16_LE -> S32_LE  s << 16
+ *   S24_LE -> S32_LE  s << 8
+ *   S32_LE -> S24_LE  s >> 8
+ * A downmix of two channels adds the halves of the converted samples,
+ * (a >> 1) + (b >> 1), so it can not overflow.
+ */
+
+#define PCM_CONVERT_MAX_CHANNELS 16
+
+/* channel map entry of a destination channel that is written as silence */
+#define PCM_CONVERT_SILENT (-1)
+
+/* shuffle table entry of a byte written as 0 */
+#define PCM_CONVERT_SHUFFLE_ZERO 0x80
+
+/* the largest shuffle group, in 16 byte vectors */
+#define PCM_CONVERT_SHUFFLE_MAX_VECTORS 3
+
+enum pcm_convert_format {
+    PCM_CONVERT_S16_LE, /* int16_t */
+    PCM_CONVERT_S24_LE, /* 24 bits in the low bits of an int32_t */
+    PCM_CONVERT_S32_LE, /* int32_t */
+    PCM_CONVERT_FORMAT_COUNT,
+};
+
+typedef void (*pcm_convert_samples_fn)(const void *src, void *dst, size_t count);
+
+/* Kernels of one instruction set. */
+struct pcm_convert_kernels {
+    const char *name;
+    /* count samples, indexed [src_format][dst_format], NULL on the diagonal */
+    pcm_convert_samples_fn samples[PCM_CONVERT_FORMAT_COUNT][PCM_CONVERT_FORMAT_COUNT];
+    /* count mono frames to stereo */
+    pcm_convert_samples_fn mono_to_stereo_16;
+    pcm_convert_samples_fn mono_to_stereo_32;
+    /* count stereo frames mixed to mono */
+    pcm_convert_samples_fn stereo_to_mono_16;
+    pcm_convert_samples_fn stereo_to_mono_32;
+    /* count groups of vectors * 16 bytes, output byte n is input byte
+     * table[n] of the group, or 0 when table[n] is PCM_CONVERT_SHUFFLE_ZERO.
+     * vectors is 1 to 3 and in place is fine. */
+    void (*shuffle)(const void *src, void *dst, size_t count, const uint8_t *table,
+                    unsigned int vectors);
+};
+
+/* the kernels picked at runtime: NEON on arm64, SSE2/SSSE3 on x86, C elsewhere */
+const struct pcm_convert_kernels *pcm_convert_get_kernels(void);
+
+/* the plain C kernels, reference of the others */
+const struct pcm_convert_kernels *pcm_convert_get_kernels_c(void);
+
+enum pcm_convert_layout {
+    PCM_CONVERT_SAME_LAYOUT,    /* channel n from source channel n */
+    PCM_CONVERT_MONO_TO_STEREO,
+    PCM_CONVERT_STEREO_TO_MONO,
+    PCM_CONVERT_SHUFFLE,        /* byte shuffle of groups of up to 48 bytes */
+    PCM_CONVERT_MAP,            /* anything else, frame by frame through map */
+};
+
+struct pcm_converter {
+    enum pcm_convert_format src_format;
+    enum pcm_convert_format dst_format;
+    unsigned int src_channels;
+    unsigned int dst_channels;
+    /* source channels of each destination channel, the second one is
+     * PCM_CONVERT_SILENT unless the two are mixed */
+    int8_t map[PCM_CONVERT_MAX_CHANNELS][2];
+    enum pcm_convert_layout layout;
+    /* byte shuffle of shuffle_frames frames for PCM_CONVERT_SHUFFLE */
+    uint8_t shuffle[PCM_CONVERT_SHUFFLE_MAX_VECTORS * 16];
+    unsigned int shuffle_frames;
+    unsigned int shuffle_vectors;
+    const struct pcm_convert_kernels *kernels;
+};
+
+/*
+ * Sets up cv. map holds the source channel of each destination channel, or
+ * PCM_CONVERT_SILENT. With a NULL map a stereo source is mixed to mono, a mono
+ * source is copied to every destination channel and otherwise destination
+ * channel n takes source channel n, silent when there is none.
+ * Returns 0, or -EINVAL when the channel counts or the map are out of range.
+ */
+int pcm_converter_init(struct pcm_converter *cv, enum pcm_convert_format src_format,
+                       unsigned int src_channels, enum pcm_convert_format dst_format,
+                       unsigned int dst_channels, const int8_t *map);
+
+/*
+ * Converts frames frames of src into dst. The buffers may be the same when
+ * a destination frame is not larger than a source frame.
+ */
+void pcm_convert(const struct pcm_converter *cv, const void *src, void *dst, size_t frames);
+
+size_t pcm_convert_format_bytes(enum pcm_convert_format format);
+
+/* Makes cv use kernels instead of pcm_convert_get_kernels(), for tests. */
+void pcm_converter_set_kernels(struct pcm_converter *cv,
+                               const struct pcm_convert_kernels *kernels);
+
+#endif /* _PCM_CONVERT_H */
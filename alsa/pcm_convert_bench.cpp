@@ -0,0 +1,183 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of pcm_convert.
+ *
+ * Converts one second of random audio at 192 kHz, one period at a time, for
+ * the conversions the HAL does on its read and write periods. Reports the ms
+ * spent per second of audio by the per sample loops the HAL had before, the C
+ * kernels and the selected kernels, and checks that the selected kernels give
+ * the same samples as the C ones. Exits non-zero if any output differs.
+ *
+ * It only needs the C++ library, so it also builds on a host:
+ *   g++ -O2 pcm_convert_bench.cpp pcm_convert.cpp -o pcm_convert_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <functional>
+#include <vector>
+
+#include "pcm_convert.h"
+
+#define BENCH_RATE 192000
+#define BENCH_PERIOD_FRAMES 1920 // 10 ms
+#define BENCH_LOOPS 5
+
+static const int8_t esai6[] = {0, 4, 2, 1, 5, 3};
+static const int8_t esai8[] = {0, 4, 2, 6, 1, 5, 3, 7};
+
+// The loops the HAL had before, for comparison.
+static void legacy_narrow(const void *src, void *dst, size_t samples, int shift) {
+    const int *s = (const int *)src;
+    short *d = (short *)dst;
+    for (size_t i = 0; i < samples; i++) *d++ = (short)(*s++ >> shift);
+}
+
+static void legacy_mono_to_stereo(const void *src, void *dst, size_t frames) {
+    const short *s = (const short *)src;
+    short *d = (short *)dst;
+    for (size_t i = 0; i < frames; i++) {
+        short data = *s++;
+        *d++ = data;
+        *d++ = data;
+    }
+}
+
+static void legacy_stereo_to_mono(const void *src, void *dst, size_t frames) {
+    const short *s = (const short *)src;
+    short *d = (short *)dst;
+    for (size_t i = 0; i < frames; i++) {
+        short data1 = *s++;
+        short data2 = *s++;
+        *d++ = (data1 >> 1) + (data2 >> 1);
+    }
+}
+
+static void legacy_widen(const void *src, void *dst, size_t samples) {
+    const short *s = (const short *)src;
+    int *d = (int *)dst;
+    for (size_t i = 0; i < samples; i++) *d++ = (int)(*s++ * 256);
+}
+
+static void legacy_esai(const void *src, void *dst, size_t frames, unsigned int channels) {
+    const short *s = (const short *)src;
+    short *d = (short *)dst;
+    const int8_t *map = channels == 6 ? esai6 : esai8;
+    short in[8];
+    for (size_t i = 0; i < frames; i++, s += channels, d += channels) {
+        memcpy(in, s, channels * sizeof(short));
+        for (unsigned int c = 0; c < channels; c++) d[c] = in[map[c]];
+    }
+}
+
+struct bench_case {
+    const char *name;
+    enum pcm_convert_format src_format;
+    unsigned int src_channels;
+    enum pcm_convert_format dst_format;
+    unsigned int dst_channels;
+    const int8_t *map;
+    std::function<void(const void *, void *, size_t)> legacy;
+};
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// ms per second of audio
+static double time_ms(const std::function<void(size_t)> &period) {
+    for (size_t f = 0; f < BENCH_RATE; f += BENCH_PERIOD_FRAMES) period(f); // warm up
+    double start = now_ms();
+    for (int i = 0; i < BENCH_LOOPS; i++)
+        for (size_t f = 0; f < BENCH_RATE; f += BENCH_PERIOD_FRAMES) period(f);
+    return (now_ms() - start) / BENCH_LOOPS;
+}
+
+int main() {
+    const bench_case cases[] = {
+            {"tdm8 s24->s16", PCM_CONVERT_S24_LE, 8, PCM_CONVERT_S16_LE, 8, NULL,
+             [](const void *s, void *d, size_t n) { legacy_narrow(s, d, n * 8, 8); }},
+            {"tdm8 s32->s16", PCM_CONVERT_S32_LE, 8, PCM_CONVERT_S16_LE, 8, NULL,
+             [](const void *s, void *d, size_t n) { legacy_narrow(s, d, n * 8, 16); }},
+            {"s24 2->1", PCM_CONVERT_S24_LE, 2, PCM_CONVERT_S16_LE, 1, NULL, NULL},
+            {"s32 1->2", PCM_CONVERT_S32_LE, 1, PCM_CONVERT_S16_LE, 2, NULL, NULL},
+            {"s16 1->2", PCM_CONVERT_S16_LE, 1, PCM_CONVERT_S16_LE, 2, NULL,
+             legacy_mono_to_stereo},
+            {"s16 2->1", PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S16_LE, 1, NULL,
+             legacy_stereo_to_mono},
+            {"s16->s24 2ch", PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S24_LE, 2, NULL,
+             [](const void *s, void *d, size_t n) { legacy_widen(s, d, n * 2); }},
+            {"esai 6ch", PCM_CONVERT_S16_LE, 6, PCM_CONVERT_S16_LE, 6, esai6,
+             [](const void *s, void *d, size_t n) { legacy_esai(s, d, n, 6); }},
+            {"esai 8ch", PCM_CONVERT_S16_LE, 8, PCM_CONVERT_S16_LE, 8, esai8,
+             [](const void *s, void *d, size_t n) { legacy_esai(s, d, n, 8); }},
+    };
+
+    int errors = 0;
+    printf("kernels %s, %d Hz, %d frame periods, ms per second of audio\n",
+           pcm_convert_get_kernels()->name, BENCH_RATE, BENCH_PERIOD_FRAMES);
+    printf("%-15s %9s %9s %9s %9s\n", "case", "legacy", "c", "simd", "speedup");
+
+    for (auto &t : cases) {
+        struct pcm_converter cv, ref;
+        if (pcm_converter_init(&cv, t.src_format, t.src_channels, t.dst_format, t.dst_channels,
+                               t.map)) {
+            printf("%-15s init failed\n", t.name);
+            errors++;
+            continue;
+        }
+        ref = cv;
+        pcm_converter_set_kernels(&ref, pcm_convert_get_kernels_c());
+
+        size_t src_frame = pcm_convert_format_bytes(t.src_format) * t.src_channels;
+        size_t dst_frame = pcm_convert_format_bytes(t.dst_format) * t.dst_channels;
+        std::vector<uint8_t> src(BENCH_RATE * src_frame);
+        for (auto &b : src) b = rand();
+        std::vector<uint8_t> out(BENCH_RATE * dst_frame);
+        std::vector<uint8_t> expected(BENCH_RATE * dst_frame);
+
+        double legacy_ms = 0;
+        if (t.legacy) {
+            legacy_ms = time_ms([&](size_t f) {
+                t.legacy(&src[f * src_frame], &out[f * dst_frame], BENCH_PERIOD_FRAMES);
+            });
+        }
+        double c_ms = time_ms([&](size_t f) {
+            pcm_convert(&ref, &src[f * src_frame], &expected[f * dst_frame], BENCH_PERIOD_FRAMES);
+        });
+        double simd_ms = time_ms([&](size_t f) {
+            pcm_convert(&cv, &src[f * src_frame], &out[f * dst_frame], BENCH_PERIOD_FRAMES);
+        });
+        bool same = out == expected;
+        if (!same)
+            errors++;
+
+        char legacy[16] = "-";
+        if (t.legacy)
+            snprintf(legacy, sizeof(legacy), "%.3f", legacy_ms);
+        printf("%-15s %9s %9.3f %9.3f %8.1fx%s\n", t.name, legacy, c_ms, simd_ms,
+               (t.legacy ? legacy_ms : c_ms) / simd_ms, same ? "" : "  MISMATCH");
+    }
+
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
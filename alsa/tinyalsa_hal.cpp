@@ -44,6 +44,7 @@
 #include <unistd.h>
 
 #include "audio_hardware.h"
+#include "pcm_convert.h"
 #include "pcm_ext.h"
 
 /*align the definition in kernel for hdmi audio*/
@@ -232,121 +233,27 @@ static enum pcm_format pcm_format_from_audio_format(audio_format_t format) {
 /* Standard passthrough data format is PCM_FORMAT_S16_LE */
 /* Wrap it to PCM_FORMAT_S24_LE for evk_8mp */
 static void convert_passthrough_data_for_s24(void *src, void *dst, unsigned int frames) {
-    unsigned int i;
-    short *src_t = (short *)src; // source is 16 bit
-    int *dst_t = (int *)dst;     // target is 24 bit
-    short left, right;
-
-    for (i = 0; i < frames; i++) {
-        left = *src_t++;
-        right = *src_t++;
-        *dst_t++ = (int)(left << 8);
-        *dst_t++ = (int)(right << 8);
-    }
-}
-
-static int convert_record_data(void *src, void *dst, unsigned int frames, bool bit_24b_2_16b,
-                               bool bit_32b_2_16b, bool mono2stereo, bool stereo2mono) {
-    unsigned int i;
-    short *dst_t = (short *)dst;
-
-    if (bit_24b_2_16b && mono2stereo && !stereo2mono) {
-        int data;
-        int *src_t = (int *)src;
-        for (i = 0; i < frames; i++) {
-            data = *src_t++;
-            *dst_t++ = (short)(data >> 8);
-            *dst_t++ = (short)(data >> 8);
-        }
-
-        return 0;
-    }
-
-    if (bit_24b_2_16b && !mono2stereo && stereo2mono) {
-        int data1 = 0, data2 = 0;
-        int *src_t = (int *)src;
-        for (i = 0; i < frames; i++) {
-            data1 = *src_t++;
-            data2 = *src_t++;
-            *dst_t++ = (short)(((data1 << 8) >> 17) + ((data2 << 8) >> 17));
-        }
+    struct pcm_converter cv;
 
-        return 0;
-    }
-
-    if (bit_24b_2_16b && !mono2stereo && !stereo2mono) {
-        int data1, data2;
-        int *src_t = (int *)src;
-        for (i = 0; i < frames; i++) {
-            data1 = *src_t++;
-            data2 = *src_t++;
-            *dst_t++ = (short)(data1 >> 8);
-            *dst_t++ = (short)(data2 >> 8);
-        }
-
-        return 0;
-    }
-
-    if (bit_32b_2_16b && mono2stereo && !stereo2mono) {
-        int data;
-        int *src_t = (int *)src;
-        for (i = 0; i < frames; i++) {
-            data = *src_t++;
-            *dst_t++ = (short)(data >> 16);
-            *dst_t++ = (short)(data >> 16);
-        }
-
-        return 0;
-    }
-
-    if (bit_32b_2_16b && !mono2stereo && stereo2mono) {
-        int data1 = 0, data2 = 0;
-        int *src_t = (int *)src;
-        for (i = 0; i < frames; i++) {
-            data1 = *src_t++;
-            data2 = *src_t++;
-            *dst_t++ = (short)((data1 >> 17) + (data2 >> 17));
-        }
-
-        return 0;
-    }
-
-    if (bit_32b_2_16b && !mono2stereo && !stereo2mono) {
-        int data1, data2;
-        int *src_t = (int *)src;
-        for (i = 0; i < frames; i++) {
-            data1 = *src_t++;
-            data2 = *src_t++;
-            *dst_t++ = (short)(data1 >> 16);
-            *dst_t++ = (short)(data2 >> 16);
-        }
-
-        return 0;
-    }
-
-    if (mono2stereo && !stereo2mono) {
-        short data;
-        short *src_t = (short *)src;
-        for (i = 0; i < frames; i++) {
-            data = *src_t++;
-            *dst_t++ = data;
-            *dst_t++ = data;
-        }
-
-        return 0;
-    }
+    // source is 16 bit, target is 24 bit
+    pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S24_LE, 2, NULL);
+    pcm_convert(&cv, src, dst, frames);
+}
 
-    if (!mono2stereo && stereo2mono) {
-        short data1, data2;
-        short *src_t = (short *)src;
-        for (i = 0; i < frames; i++) {
-            data1 = *src_t++;
-            data2 = *src_t++;
-            *dst_t++ = (data1 >> 1) + (data2 >> 1);
-        }
+/* Converts to 16 bit, stereo is mixed to mono and mono is copied to stereo */
+static int convert_record_data(void *src, void *dst, unsigned int frames,
+                               enum pcm_convert_format src_format, unsigned int src_channels,
+                               unsigned int dst_channels) {
+    struct pcm_converter cv;
+    int ret;
 
-        return 0;
+    ret = pcm_converter_init(&cv, src_format, src_channels, PCM_CONVERT_S16_LE, dst_channels,
+                             NULL);
+    if (ret) {
+        ALOGE("%s: can not convert %u to %u channels", __func__, src_channels, dst_channels);
+        return ret;
     }
+    pcm_convert(&cv, src, dst, frames);
 
     return 0;
 }
@@ -1433,8 +1340,13 @@ static int pcm_read_convert(struct imx_stream_in *in, struct pcm *pcm, void *dat
             return in->read_status;
         }
 
-        convert_record_data((void *)in->read_tmp_buf, (void *)data, frames_rq, bit_24b_2_16b,
-                            bit_32b_2_16b, mono2stereo, stereo2mono);
+        enum pcm_convert_format src_format = PCM_CONVERT_S16_LE;
+        if (bit_24b_2_16b)
+            src_format = PCM_CONVERT_S24_LE;
+        if (bit_32b_2_16b)
+            src_format = PCM_CONVERT_S32_LE;
+        convert_record_data((void *)in->read_tmp_buf, (void *)data, frames_rq, src_format,
+                            in->config.channels, in->requested_channel);
     } else {
         in->read_status = pcm_read_wrapper(pcm, (void *)data, count, in->dump);
     }
@@ -1578,8 +1490,8 @@ static ssize_t out_write(struct audio_stream_out *stream, const void *buffer, si
     if ((out->device == AUDIO_DEVICE_OUT_BLUETOOTH_SCO_HEADSET) ||
         (out->device == AUDIO_DEVICE_OUT_BLUETOOTH_SCO_CARKIT) ||
         (out->device == AUDIO_DEVICE_OUT_BLUETOOTH_SCO)) {
-        convert_record_data((void *)buffer, (void *)(out->buffer), out_frames, false, false, false,
-                            true);
+        convert_record_data((void *)buffer, (void *)(out->buffer), out_frames, PCM_CONVERT_S16_LE,
+                            2, 1);
         frame_size = frame_size / 2;
     }
 
@@ -1688,46 +1600,20 @@ LFE, BL, BR, SL, SR", output is "FL,BL,C,FR,BR,LFE". when input is "FL, FR, C, L
 output is "FL,BL,C,SL,FR,BR,LFE,SR"
 *********************************************************************************************************/
 static void convert_output_for_esai(const void *buffer, size_t bytes, int channels) {
-    short *data_src = (short *)buffer;
-    short *data_dst = (short *)buffer;
-    short dataFL, dataFR, dataC, dataLFE, dataBL, dataBR, dataSL, dataSR;
-    int i;
+    static const int8_t esai_map_6ch[] = {0, 4, 2, 1, 5, 3};
+    static const int8_t esai_map_8ch[] = {0, 4, 2, 6, 1, 5, 3, 7};
+    struct pcm_converter cv;
+    const int8_t *map;
+
+    if (channels == 6)
+        map = esai_map_6ch;
+    else if (channels == 8)
+        map = esai_map_8ch;
+    else
+        return;
 
-    if (channels == 6) {
-        for (i = 0; i < (int)bytes / (2 * channels); i++) {
-            dataFL = *data_src++;
-            dataFR = *data_src++;
-            dataC = *data_src++;
-            dataLFE = *data_src++;
-            dataBL = *data_src++;
-            dataBR = *data_src++;
-            *data_dst++ = dataFL;
-            *data_dst++ = dataBL;
-            *data_dst++ = dataC;
-            *data_dst++ = dataFR;
-            *data_dst++ = dataBR;
-            *data_dst++ = dataLFE;
-        }
-    } else if (channels == 8) {
-        for (i = 0; i < (int)bytes / (2 * channels); i++) {
-            dataFL = *data_src++;
-            dataFR = *data_src++;
-            dataC = *data_src++;
-            dataLFE = *data_src++;
-            dataBL = *data_src++;
-            dataBR = *data_src++;
-            dataSL = *data_src++;
-            dataSR = *data_src++;
-            *data_dst++ = dataFL;
-            *data_dst++ = dataBL;
-            *data_dst++ = dataC;
-            *data_dst++ = dataSL;
-            *data_dst++ = dataFR;
-            *data_dst++ = dataBR;
-            *data_dst++ = dataLFE;
-            *data_dst++ = dataSR;
-        }
-    }
+    pcm_converter_init(&cv, PCM_CONVERT_S16_LE, channels, PCM_CONVERT_S16_LE, channels, map);
+    pcm_convert(&cv, buffer, (void *)buffer, bytes / (2 * channels));
 }
 
 static int out_get_render_position(const struct audio_stream_out *stream, uint32_t *dsp_frames) {
@@ -3755,8 +3641,8 @@ static void *sco_rx_task(void *arg) {
               pcm_config_sco_in.period_size, frames, stream_out->buffer_frames, out_frames);
 
         // mono to stereo
-        convert_record_data(stream_out->buffer, sco_rx_out_buffer, out_frames, false, false, true,
-                            false);
+        convert_record_data(stream_out->buffer, sco_rx_out_buffer, out_frames, PCM_CONVERT_S16_LE,
+                            1, 2);
         out_size = pcm_frames_to_bytes(out_pcm, out_frames);
 
         pthread_mutex_lock(&stream_out->lock);
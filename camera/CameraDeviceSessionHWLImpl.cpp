@@ -29,6 +29,7 @@
 #include "CameraMetadata.h"
 #include "CameraUtils.h"
 #include "ISPCameraDeviceHWLImpl.h"
+#include "ImageBufferPool.h"
 #include "ImageProcess.h"
 
 // using namespace fsl;
@@ -217,6 +218,13 @@ status_t CameraDeviceSessionHwlImpl::Initialize(uint32_t camera_id,
     mImgProcThread->mLatestFrame = 0;
     mImgProcThread->mProcdFrame = 0;
 
+    // create jpeg thread, still captures are encoded aside the frame streams
+    mJpegThread = new JpegThread(this);
+    if (mJpegThread == NULL) {
+        ALOGI("%s, new JpegThread failed", __func__);
+        return BAD_VALUE;
+    }
+
     // Device may be destroyed after create session, need copy some members from device.
     mCamBlitCopyType = pDev->mCamBlitCopyType;
     mCamBlitCscType = pDev->mCamBlitCscType;
@@ -252,6 +260,7 @@ CameraDeviceSessionHwlImpl::CameraDeviceSessionHwlImpl(PhysicalMetaMapPtr physic
     mPreCapAndFeedTime = 0;
     mPreSubmitRequestTime = 0;
     mImgProcThread = NULL;
+    mJpegThread = NULL;
     mWorkThread = NULL;
     setDstPhyAddr.clear();
 
@@ -266,6 +275,12 @@ CameraDeviceSessionHwlImpl::~CameraDeviceSessionHwlImpl() {
         ALOGI("%s, mImgProcThread exited", __func__);
     }
 
+    if (mJpegThread != NULL) {
+        mJpegThread->requestExitAndWait();
+        ALOGI("%s, mJpegThread exited", __func__);
+        FailJpegJobs();
+    }
+
     if (mWorkThread != NULL) {
         mWorkThread->requestExitAndWait();
         ALOGI("%s, mWorkThread exited", __func__);
@@ -284,6 +299,8 @@ CameraDeviceSessionHwlImpl::~CameraDeviceSessionHwlImpl() {
     if (mJpegBuilder != NULL)
         mJpegBuilder.clear();
 
+    fsl::ImageBufferPool::getInstance()->clear();
+
     if (mSettings != NULL)
         mSettings.reset();
 
@@ -374,8 +391,11 @@ int CameraDeviceSessionHwlImpl::HandleIntent(HwlPipelineRequest *hwReq) {
                       ret);
         }
     } else {
-        pVideoStreams[0]->SetBufferNumber(pipeline_info->hal_streams->at(configIdx).max_buffers +
-                                          1);
+        // one more buffer stays with the jpeg thread while a still capture is encoded
+        uint32_t bufferNum = pipeline_info->hal_streams->at(configIdx).max_buffers + 1;
+        if (stillcapIdx >= 0)
+            bufferNum++;
+        pVideoStreams[0]->SetBufferNumber(bufferNum);
 
         uint32_t format = HAL_PIXEL_FORMAT_YCbCr_422_I;
         if (strcmp(mSensorData.v4l2_format, "nv12") == 0)
@@ -676,6 +696,24 @@ void CameraDeviceSessionHwlImpl::ImgProcThread::releaseImgFeed(ImageFeed *imgFee
     return;
 }
 
+int CameraDeviceSessionHwlImpl::JpegThread::feed(JpegJob *job) {
+    Mutex::Autolock _l(mJobListLock);
+    mJobList.push_back(job);
+    mJobListCond.signal();
+
+    return 0;
+}
+
+void CameraDeviceSessionHwlImpl::FinishImage(ImageFeed *imgFeed) {
+    mImgProcThread->mImageListLock.lock();
+    mImgProcThread->mProcdImageIdx++;
+    mImgProcThread->mProcdFrame = imgFeed->frame;
+    mImgProcThread->mImageListLock.unlock();
+
+    // release imgFeed and it's request
+    mImgProcThread->releaseImgFeed(imgFeed);
+}
+
 void CameraDeviceSessionHwlImpl::ImgProcThread::DumpImage() {
     ALOGI("%s: mImageList size %zu, mLatestImageIdx %lu, mProcdImageIdx %lu, mLatestFrame %u, "
           "mProcdFrame %u",
@@ -732,6 +770,7 @@ int CameraDeviceSessionHwlImpl::HandleImage() {
     uint32_t frame = imgFeed->frame;
     FrameRequest *frameRequest = imgFeed->frameRequest;
     HwlPipelineRequest &hwReq = frameRequest->hwlReq;
+    JpegJob *jpegJob = NULL;
 
     uint32_t pipeline_id = hwReq.pipeline_id;
     PipelineInfo *pInfo = GetPipelineInfo(pipeline_id);
@@ -821,17 +860,19 @@ int CameraDeviceSessionHwlImpl::HandleImage() {
             }
         }
     } else {
+        // The still capture is encoded on the jpeg thread, the other buffers go on here.
+        jpegJob = TakeJpegJob(imgFeed, result->result_metadata.get());
         ProcessCapbuf2MultiOutbuf(imgFeed->v4l2Buffer, hwReq.output_buffers,
                                   frameRequest->outBufferFences, requestMeta);
     }
 
-    // return v4l2 buffer
+    // return v4l2 buffer, the jpeg thread returns it after encoding
     if (is_logical_request_) {
         for (int i = 0; i < (int)imgFeed->v4l2BufferList.size(); i++) {
             VideoStream *pVideoStream = (VideoStream *)imgFeed->v4l2BufferList[i]->mStream;
             pVideoStream->onFrameReturn(*(imgFeed->v4l2BufferList[i]));
         }
-    } else {
+    } else if (jpegJob == NULL) {
         pVideoStreams[0]->onFrameReturn(*(imgFeed->v4l2Buffer));
     }
 
@@ -916,20 +957,146 @@ int CameraDeviceSessionHwlImpl::HandleImage() {
         pInfo->pipeline_callback.process_pipeline_result(std::move(result));
     }
 
-    mImgProcThread->mImageListLock.lock();
-    mImgProcThread->mProcdImageIdx++;
-    mImgProcThread->mProcdFrame = frame;
-    mImgProcThread->mImageListLock.unlock();
-
     if (mDebug)
         ItvlStat(mPreHandleImageTime, (char *)"HandleImage(), process_pipeline_result");
 
-    // release imgFeed and it's request
-    mImgProcThread->releaseImgFeed(imgFeed);
+    if (jpegJob != NULL)
+        mJpegThread->feed(jpegJob);
+    else
+        FinishImage(imgFeed);
+
+    return 0;
+}
+
+// Move the still capture buffer of the request to a job for the jpeg thread.
+// The job owns the image from then on.
+CameraDeviceSessionHwlImpl::JpegJob *CameraDeviceSessionHwlImpl::TakeJpegJob(
+        ImageFeed *imgFeed, HalCameraMetadata *meta) {
+    FrameRequest *frameRequest = imgFeed->frameRequest;
+    HwlPipelineRequest &hwReq = frameRequest->hwlReq;
+
+    // The request vector is freed with its last entry, so entries of a vector
+    // must finish in order. Keep them all on this thread, mJpegLock keeps
+    // their encode from racing the jpeg thread.
+    if ((mJpegThread == NULL) || (frameRequest->num > 1) || (imgFeed->v4l2Buffer == NULL))
+        return NULL;
+
+    if (hwReq.output_buffers.size() != frameRequest->outBufferFences.size())
+        return NULL;
+
+    for (size_t i = 0; i < hwReq.output_buffers.size(); i++) {
+        Stream *pStream = GetStreamFromStreamBuffer(&hwReq.output_buffers[i]);
+        if ((pStream == NULL) || (pStream->format != HAL_PIXEL_FORMAT_BLOB))
+            continue;
+
+        JpegJob *job = new JpegJob();
+        job->imgFeed = imgFeed;
+        job->pipeline_id = hwReq.pipeline_id;
+        job->buffer = hwReq.output_buffers[i];
+        job->fence = frameRequest->outBufferFences[i];
+        job->srcStream = *(imgFeed->v4l2Buffer->mStream);
+        job->srcBuf = *(imgFeed->v4l2Buffer);
+        job->srcBuf.mStream = &job->srcStream;
+        job->meta = HalCameraMetadata::Clone(meta);
+
+        hwReq.output_buffers.erase(hwReq.output_buffers.begin() + i);
+        frameRequest->outBufferFences.erase(frameRequest->outBufferFences.begin() + i);
+        return job;
+    }
+
+    return NULL;
+}
+
+int CameraDeviceSessionHwlImpl::HandleJpeg() {
+    if (mJpegThread == NULL) {
+        ALOGW("%s: wait mJpegThread to be valid", __func__);
+        usleep(WAIT_ITVL_US);
+        return 0;
+    }
+
+    mJpegThread->mJobListLock.lock();
+
+    if (mJpegThread->mJobList.empty()) {
+        ALOGV("mJobList empty, wait");
+        mJpegThread->mJobListCond.waitRelative(mJpegThread->mJobListLock, WAIT_TIME_OUT);
+    }
+
+    if (mJpegThread->mJobList.empty()) {
+        mJpegThread->mJobListLock.unlock();
+        return 0;
+    }
+
+    JpegJob *job = mJpegThread->mJobList.front();
+    mJpegThread->mJobList.pop_front();
+    mJpegThread->mJobListLock.unlock();
+
+    ImageFeed *imgFeed = job->imgFeed;
+    CameraMetadata requestMeta(job->meta.get());
+
+    ProcessCapbuf2Outbuf(&job->srcBuf, job->buffer, job->fence, requestMeta);
+
+    pVideoStreams[0]->onFrameReturn(*(imgFeed->v4l2Buffer));
+
+    // Only the buffer, the metadata is returned with the other buffers of the request.
+    // Jobs run in order, so still capture buffers are returned in frame order.
+    PipelineInfo *pInfo = GetPipelineInfo(job->pipeline_id);
+    if (pInfo && pInfo->pipeline_callback.process_pipeline_result) {
+        auto result = std::make_unique<HwlPipelineResult>();
+        result->camera_id = camera_id_;
+        result->pipeline_id = job->pipeline_id;
+        result->frame_number = imgFeed->frame;
+        result->partial_result = 0;
+        result->output_buffers.push_back(job->buffer);
+        pInfo->pipeline_callback.process_pipeline_result(std::move(result));
+    }
+
+    if (mDebug)
+        ALOGI("%s: frame %u encoded", __func__, imgFeed->frame);
+
+    FinishImage(imgFeed);
+    delete job;
 
     return 0;
 }
 
+// Return the still capture buffers not encoded yet with an error, so that
+// their v4l2 buffers and requests are released before the streams stop.
+void CameraDeviceSessionHwlImpl::FailJpegJobs() {
+    std::list<JpegJob *> jobs;
+    mJpegThread->mJobListLock.lock();
+    jobs.swap(mJpegThread->mJobList);
+    mJpegThread->mJobListLock.unlock();
+
+    for (JpegJob *job : jobs) {
+        ImageFeed *imgFeed = job->imgFeed;
+        pVideoStreams[0]->onFrameReturn(*(imgFeed->v4l2Buffer));
+
+        PipelineInfo *pInfo = GetPipelineInfo(job->pipeline_id);
+        if (pInfo && pInfo->pipeline_callback.notify) {
+            NotifyMessage msg{.type = MessageType::kError,
+                              .message.error = {.frame_number = imgFeed->frame,
+                                                .error_stream_id = job->buffer.stream_id,
+                                                .error_code = ErrorCode::kErrorBuffer}};
+
+            pInfo->pipeline_callback.notify(job->pipeline_id, msg);
+        }
+        if (pInfo && pInfo->pipeline_callback.process_pipeline_result) {
+            auto result = std::make_unique<HwlPipelineResult>();
+            result->camera_id = camera_id_;
+            result->pipeline_id = job->pipeline_id;
+            result->frame_number = imgFeed->frame;
+            result->partial_result = 0;
+            job->buffer.status = BufferStatus::kError;
+            result->output_buffers.push_back(job->buffer);
+            pInfo->pipeline_callback.process_pipeline_result(std::move(result));
+        }
+
+        ALOGW("%s: frame %u still capture dropped", __func__, imgFeed->frame);
+        FinishImage(imgFeed);
+        delete job;
+    }
+}
+
 ImxStreamBuffer *CameraDeviceSessionHwlImpl::CreateImxStreamBufferFromStreamBuffer(
         StreamBuffer *buf, Stream *stream) {
     void *pBuf = NULL;
@@ -1105,32 +1272,37 @@ status_t CameraDeviceSessionHwlImpl::ProcessCapbuf2Outbuf(ImxStreamBuffer *srcBu
     // limit the container size
     ImxStream *src = srcBuf->mStream;
     ImxStream *dst = dstBuf->mStream;
-    if (setDstPhyAddr.size() >= 20) {
-        ALOGW("%s: erase the previous old addr: 0x%lx", __func__, *(setDstPhyAddr.begin()));
-        setDstPhyAddr.erase(setDstPhyAddr.begin());
-    }
-
-    // Adapt for Camra2.apk. The picture resolution may differ from preview resolution.
-    // If resize for preview stream, there will be obvious changes in the preview when taking
-    // picture. And if there is a new dst addr, the process will not be skipped, otherwise it will
-    // flash green.
-    if ((src->width() != dst->width()) ||
-        (src->height() != dst->height()) && dst->isPreview() && src->isPictureIntent()) {
-        if (!setDstPhyAddr.empty() &&
-            (setDstPhyAddr.find(dstBuf->mPhyAddr) != setDstPhyAddr.end())) {
-            isSkipHandle = true;
-            ALOGW("%s: resize from %dx%d to %dx%d, skip preview stream while taking picture",
-                  __func__, src->width(), src->height(), dst->width(), dst->height());
-        } else {
-            ALOGW("%s: Don't skip the preview stream handle, new dst phy addr 0x%lx appear",
-                  __func__, dstBuf->mPhyAddr);
+
+    // Only the image thread tracks the addresses, still captures may be on the jpeg thread.
+    if (dst->format() != HAL_PIXEL_FORMAT_BLOB) {
+        if (setDstPhyAddr.size() >= 20) {
+            ALOGW("%s: erase the previous old addr: 0x%lx", __func__, *(setDstPhyAddr.begin()));
+            setDstPhyAddr.erase(setDstPhyAddr.begin());
         }
+
+        // Adapt for Camra2.apk. The picture resolution may differ from preview resolution.
+        // If resize for preview stream, there will be obvious changes in the preview when taking
+        // picture. And if there is a new dst addr, the process will not be skipped, otherwise it
+        // will flash green.
+        if ((src->width() != dst->width()) ||
+            (src->height() != dst->height()) && dst->isPreview() && src->isPictureIntent()) {
+            if (!setDstPhyAddr.empty() &&
+                (setDstPhyAddr.find(dstBuf->mPhyAddr) != setDstPhyAddr.end())) {
+                isSkipHandle = true;
+                ALOGW("%s: resize from %dx%d to %dx%d, skip preview stream while taking picture",
+                      __func__, src->width(), src->height(), dst->width(), dst->height());
+            } else {
+                ALOGW("%s: Don't skip the preview stream handle, new dst phy addr 0x%lx appear",
+                      __func__, dstBuf->mPhyAddr);
+            }
+        }
+        setDstPhyAddr.insert(dstBuf->mPhyAddr);
     }
-    setDstPhyAddr.insert(dstBuf->mPhyAddr);
 
     uint64_t t1 = systemTime();
 
     if (dstBuf->mStream->format() == HAL_PIXEL_FORMAT_BLOB) {
+        Mutex::Autolock _l(mJpegLock);
         mJpegBuilder->reset();
         mJpegBuilder->setMetadata(&requestMeta);
         processJpegBuffer(srcBuf, dstBuf, &requestMeta);
@@ -1218,6 +1390,8 @@ int32_t CameraDeviceSessionHwlImpl::processJpegBuffer(ImxStreamBuffer *srcBuf,
     int maxJpegSize = mSensorData.maxjpegsize;
     ImxStreamBuffer resizeBuf;
     memset(&resizeBuf, 0, sizeof(resizeBuf));
+    ImxImageBuffer poolBuf;
+    memset(&poolBuf, 0, sizeof(poolBuf));
 
     if ((srcBuf == NULL) || (dstBuf == NULL) || (meta == NULL)) {
         ALOGE("%s srcBuf %p, dstBuf %p, meta %p", __func__, srcBuf, dstBuf, meta);
@@ -1304,14 +1478,22 @@ int32_t CameraDeviceSessionHwlImpl::processJpegBuffer(ImxStreamBuffer *srcBuf,
 
     // Handle zoom in
     if (srcStream->mZoomRatio > 1.0) {
-        resizeBuf.mFormatSize = srcBuf->mFormatSize;
-        resizeBuf.mSize = (resizeBuf.mFormatSize + PAGE_SIZE) & (~(PAGE_SIZE - 1));
-        ret = AllocPhyBuffer(resizeBuf);
+        // Zoomed captures come in bursts of the same size, reuse the buffer.
+        ret = fsl::ImageBufferPool::getInstance()->acquire(poolBuf, srcStream->format(),
+                                                           srcStream->mWidth, srcStream->mHeight,
+                                                           srcBuf->mFormatSize);
         if (ret) {
-            ALOGE("%s:%d AllocPhyBuffer failed", __func__, __LINE__);
+            ALOGE("%s:%d acquire resize buffer failed", __func__, __LINE__);
             return BAD_VALUE;
         }
 
+        resizeBuf.mVirtAddr = poolBuf.mVirtAddr;
+        resizeBuf.mPhyAddr = poolBuf.mPhyAddr;
+        resizeBuf.mSize = poolBuf.mSize;
+        resizeBuf.mFormatSize = poolBuf.mFormatSize;
+        resizeBuf.buffer = poolBuf.buffer;
+        resizeBuf.mFd = poolBuf.mFd;
+
         resizeBuf.mStream = srcBuf->mStream;
         handleFrame(resizeBuf, *srcBuf, mCamBlitCscType);
 
@@ -1367,9 +1549,9 @@ err_out:
     if (thumbJpeg != NULL)
         delete thumbJpeg;
 
-    if (resizeBuf.mPhyAddr > 0) {
+    if (poolBuf.mPhyAddr > 0) {
         SwitchImxBuf(*srcBuf, resizeBuf);
-        FreePhyBuffer(resizeBuf);
+        fsl::ImageBufferPool::getInstance()->release(poolBuf);
     }
 
     return ret;
@@ -2004,6 +2186,10 @@ int CameraDeviceSessionHwlImpl::CleanRequestsLocked() {
 
 status_t CameraDeviceSessionHwlImpl::Flush() {
     // TODO need refine for multi camera??
+    // still captures waiting for the encoder are returned now, not after it.
+    if (mJpegThread != NULL)
+        FailJpegJobs();
+
     return OK;
 }
 
@@ -219,6 +219,7 @@ private:
     int HandleIntent(HwlPipelineRequest *hwReq);
 
     int HandleImage();
+    int HandleJpeg();
     status_t CapAndFeed(uint32_t frame, FrameRequest *frameRequest);
     void DumpRequest();
     void ReleaseFrameRequest(FrameRequest &frameRequest);
@@ -298,6 +299,55 @@ private:
         uint32_t mProcdFrame = 0;
     };
 
+    // Still capture buffer of a request. It is encoded on the jpeg thread, so
+    // the preview and video buffers of the request are returned without
+    // waiting for the encoder. The job keeps the v4l2 buffer till encoded.
+    typedef struct tag_JpegJob {
+        ImageFeed *imgFeed;
+        uint32_t pipeline_id;
+        StreamBuffer buffer;
+        FenceFdInfo fence;
+        // copy of the v4l2 stream state, zoom may change for the next frames
+        ImxStream srcStream;
+        ImxStreamBuffer srcBuf;
+        std::unique_ptr<HalCameraMetadata> meta;
+    } JpegJob;
+
+    class JpegThread : public Thread {
+    public:
+        JpegThread(CameraDeviceSessionHwlImpl *pSession) : Thread(false), mSession(pSession) {}
+
+        virtual void onFirstRef() { run("JpegThread", PRIORITY_URGENT_DISPLAY); }
+
+        virtual status_t readyToRun() {
+            ALOGI("JpegThread, readyToRun");
+            return 0;
+        }
+
+        virtual bool threadLoop() {
+            int ret = mSession->HandleJpeg();
+            if (ret != OK) {
+                ALOGI("%s exit...", __func__);
+                return false;
+            }
+            return true;
+        }
+
+        int feed(JpegJob *job);
+
+    public:
+        CameraDeviceSessionHwlImpl *mSession;
+
+    public:
+        Mutex mJobListLock;
+        Condition mJobListCond;
+        std::list<JpegJob *> mJobList;
+    };
+
+    JpegJob *TakeJpegJob(ImageFeed *imgFeed, HalCameraMetadata *meta);
+    void FailJpegJobs();
+    void FinishImage(ImageFeed *imgFeed);
+
 public:
     CameraSensorMetadata *getSensorData() { return &mSensorData; }
     char *getDevPath(int i) { return (*mDevPath[i]); }
@@ -331,7 +381,10 @@ private:
 
     sp<WorkThread> mWorkThread;
     sp<ImgProcThread> mImgProcThread;
+    sp<JpegThread> mJpegThread;
     sp<JpegBuilder> mJpegBuilder;
+    // held for a whole still capture encode, the image and jpeg threads both encode.
+    Mutex mJpegLock;
 
     PhysicalMetaMapPtr physical_meta_map_;
 
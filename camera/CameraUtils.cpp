@@ -226,7 +226,8 @@ int32_t handleFrame(ImxStreamBuffer &dstBuf, ImxStreamBuffer &srcBuf, ImxEngine
     StreamBufferToImageBuffer(srcBuf, imageBufferSrc);
     StreamBufferToImageBuffer(dstBuf, imageBufferDst);
 
-    return imageProcess->ConvertImage(imageBufferDst, imageBufferSrc, engine);
+    // software fallbacks of 4K streams are split over the cores.
+    return imageProcess->ConvertImage(imageBufferDst, imageBufferSrc, engine, CPU_THREADS_AUTO);
 }
 
 } // namespace android
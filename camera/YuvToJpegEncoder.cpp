@@ -22,6 +22,7 @@
 #include <log/log.h>
 #include <ui/PixelFormat.h>
 
+#include "CpuWorkers.h"
 #include "ImageProcess.h"
 #include "NV12_resize.h"
 
@@ -511,31 +512,205 @@ int YuvToJpegEncoder::encode(void *inYuv, void *inYuvPhy, int inSize, int inFd,
         inYuv = (void *)resizeBuf.mVirtAddr;
     }
 
+    int size = 0;
+    int stripLines = getStripLines(outWidth, outHeight);
+    int strips = (outHeight + stripLines - 1) / stripLines;
+    if ((int)mStrips.size() < strips)
+        mStrips.resize(strips);
+    // the right edge MCUs read past the last row when the width is not aligned.
+    for (int i = 0; i < strips; i++)
+        mStrips[i].rows.resize(getRowsSize((outWidth + 15) & ~15));
+
+    if (strips == 1) {
+        cinfo.err = jpeg_std_error(&sk_err);
+        jpeg_create_compress(&cinfo);
+
+        cinfo.dest = &dest_mgr;
+
+        setJpegCompressStruct(&cinfo, outWidth, outHeight, quality);
+
+        jpeg_start_compress(&cinfo, TRUE);
+
+        /* If APP1 data was passed in, use it */
+        if (app1Buffer && app1Size) {
+            jpeg_write_marker(&cinfo, JPEG_APP0 + 1, static_cast<const JOCTET *>(app1Buffer),
+                              app1Size);
+        }
+
+        compress(&cinfo, (uint8_t *)inYuv, outHeight, 0, mStrips[0].rows.data());
+        jpeg_finish_compress(&cinfo);
+        jpeg_destroy_compress(&cinfo);
+        size = dest_mgr.jpegsize;
+    } else {
+        uint8_t *yuv = (uint8_t *)inYuv;
+        // bands are whole strips, a band gets several when there are fewer threads than strips.
+        cpuRunBands(outHeight, outWidth, stripLines, CPU_THREADS_AUTO, [&](int start, int end) {
+            for (int row = start; row < end; row += stripLines) {
+                int lines = (end - row < stripLines) ? end - row : stripLines;
+                encodeStrip(mStrips[row / stripLines], yuv, outWidth, outHeight, row, lines,
+                            quality, app1Buffer, app1Size);
+            }
+        });
+        size = stitchStrips(stripLines, outWidth, outHeight, (uint8_t *)outBuf, outSize);
+    }
+
+    if (bResize) {
+        FreePhyBuffer(resizeBuf);
+        delete (resizeBuf.mStream);
+        delete (srcBuf.mStream);
+    }
+
+    return size;
+}
+
+// Lines of each strip, a multiple of the MCU height. The whole frame when it
+// is not worth splitting.
+int YuvToJpegEncoder::getStripLines(int width, int height) {
+    int mcuRows = (height + DEINTERLEAVE_LINES_ONE_TIME - 1) / DEINTERLEAVE_LINES_ONE_TIME;
+    int mcuCols = (width + 15) / 16;
+    int64_t strips = sysconf(_SC_NPROCESSORS_ONLN);
+    if (strips > JPEG_MAX_STRIPS)
+        strips = JPEG_MAX_STRIPS;
+    if (strips > (int64_t)width * height / CPU_BAND_MIN_PIXELS)
+        strips = (int64_t)width * height / CPU_BAND_MIN_PIXELS;
+    if (strips <= 1)
+        return mcuRows * DEINTERLEAVE_LINES_ONE_TIME;
+
+    int stripMcuRows = (mcuRows + strips - 1) / strips;
+    // the restart interval is a 16 bit count of MCUs
+    if (stripMcuRows * mcuCols > 0xffff)
+        stripMcuRows = 0xffff / mcuCols;
+
+    return stripMcuRows * DEINTERLEAVE_LINES_ONE_TIME;
+}
+
+// Encode lines [startRow, startRow + lines) as a standalone jpeg. Only the
+// headers of the first strip are kept, so it alone carries APP1.
+void YuvToJpegEncoder::encodeStrip(JpegStrip &strip, uint8_t *yuv, int width, int height,
+                                   int startRow, int lines, int quality, const void *app1Buffer,
+                                   size_t app1Size) {
+    jpeg_compress_struct cinfo;
+    jpegBuilder_error_mgr sk_err;
+    jpegBuilder_strip_destination_mgr dest_mgr(&strip.out);
+    memset(&cinfo, 0, sizeof(cinfo));
+
     cinfo.err = jpeg_std_error(&sk_err);
     jpeg_create_compress(&cinfo);
 
     cinfo.dest = &dest_mgr;
 
-    setJpegCompressStruct(&cinfo, outWidth, outHeight, quality);
+    setJpegCompressStruct(&cinfo, width, lines, quality);
 
     jpeg_start_compress(&cinfo, TRUE);
 
-    /* If APP1 data was passed in, use it */
-    if (app1Buffer && app1Size) {
+    if (startRow == 0 && app1Buffer && app1Size) {
         jpeg_write_marker(&cinfo, JPEG_APP0 + 1, static_cast<const JOCTET *>(app1Buffer), app1Size);
     }
 
-    compress(&cinfo, (uint8_t *)inYuv);
+    compress(&cinfo, yuv, height, startRow, strip.rows.data());
     jpeg_finish_compress(&cinfo);
     jpeg_destroy_compress(&cinfo);
 
-    if (bResize) {
-        FreePhyBuffer(resizeBuf);
-        delete (resizeBuf.mStream);
-        delete (srcBuf.mStream);
+    strip.outSize = dest_mgr.jpegsize;
+}
+
+// Walk the marker segments of a jpeg up to SOS. Return the offset of the
+// entropy coded data and fill the offsets of the SOF and SOS markers, 0 if
+// the stream is not one libjpeg wrote.
+static size_t jpegFindScanData(const uint8_t *buf, size_t size, size_t *sof, size_t *sos) {
+    size_t pos = 2;
+
+    if (size < 4 || buf[0] != 0xff || buf[1] != 0xd8 || buf[size - 2] != 0xff ||
+        buf[size - 1] != 0xd9)
+        return 0;
+
+    *sof = 0;
+    while (pos + 4 <= size) {
+        if (buf[pos] != 0xff)
+            return 0;
+
+        int marker = buf[pos + 1];
+        size_t len = (buf[pos + 2] << 8) | buf[pos + 3];
+        if (marker >= 0xc0 && marker <= 0xc2)
+            *sof = pos;
+        if (marker == 0xda) {
+            *sos = pos;
+            return (*sof && pos + 2 + len <= size - 2) ? pos + 2 + len : 0;
+        }
+        pos += 2 + len;
+    }
+
+    return 0;
+}
+
+// Join the strips into one jpeg. The markers of strip 0 are kept, with the
+// SOF height patched to the frame and a DRI inserted before SOS so that a
+// decoder expects RSTn after each strip. Every strip restarted its DC
+// prediction and padded its last byte, which is what a restart needs.
+int YuvToJpegEncoder::stitchStrips(int stripLines, int width, int height, uint8_t *outBuf,
+                                   int outSize) {
+    int strips = (height + stripLines - 1) / stripLines;
+    int restartInterval = stripLines / DEINTERLEAVE_LINES_ONE_TIME * ((width + 15) / 16);
+    size_t sof = 0, sos = 0;
+    std::vector<size_t> starts(strips);
+    size_t total = 0;
+
+    for (int i = 0; i < strips; i++) {
+        size_t stripSof, stripSos;
+        JpegStrip &strip = mStrips[i];
+        starts[i] = jpegFindScanData(strip.out.data(), strip.outSize, &stripSof, &stripSos);
+        if (starts[i] == 0) {
+            ALOGE("%s: strip %d is not a valid jpeg", __func__, i);
+            return 0;
+        }
+        if (i == 0) {
+            sof = stripSof;
+            sos = stripSos;
+            // markers with the DRI, then SOS
+            total += starts[0] + 6;
+        } else {
+            // RSTn
+            total += 2;
+        }
+        total += strip.outSize - 2 - starts[i];
+    }
+    // EOI
+    total += 2;
+
+    if (total > (size_t)outSize) {
+        ALOGE("%s: jpeg size %zu exceeds the buffer size %d", __func__, total, outSize);
+        return 0;
     }
 
-    return dest_mgr.jpegsize;
+    uint8_t *dst = outBuf;
+    const uint8_t *src = mStrips[0].out.data();
+    memcpy(dst, src, sos);
+    dst[sof + 5] = height >> 8;
+    dst[sof + 6] = height & 0xff;
+    dst += sos;
+
+    *dst++ = 0xff;
+    *dst++ = 0xdd;
+    *dst++ = 0;
+    *dst++ = 4;
+    *dst++ = restartInterval >> 8;
+    *dst++ = restartInterval & 0xff;
+
+    for (int i = 0; i < strips; i++) {
+        JpegStrip &strip = mStrips[i];
+        size_t start = (i == 0) ? sos : starts[i];
+        if (i > 0) {
+            *dst++ = 0xff;
+            *dst++ = 0xd0 + ((i - 1) & 7);
+        }
+        memcpy(dst, strip.out.data() + start, strip.outSize - 2 - start);
+        dst += strip.outSize - 2 - start;
+    }
+
+    *dst++ = 0xff;
+    *dst++ = 0xd9;
+
+    return dst - outBuf;
 }
 
 void YuvToJpegEncoder::setJpegCompressStruct(jpeg_compress_struct *cinfo, int width, int height,
@@ -568,7 +743,13 @@ Yuv420SpToJpegEncoder::Yuv420SpToJpegEncoder(int format) : YuvToJpegEncoder(form
 #endif
 }
 
-void Yuv420SpToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv) {
+int Yuv420SpToJpegEncoder::getRowsSize(int width) {
+    // 8 lines of u and 8 lines of v
+    return DEINTERLEAVE_LINES_ONE_TIME * (width >> 1);
+}
+
+void Yuv420SpToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv, int height,
+                                     int startRow, uint8_t *rows) {
     JSAMPROW y[16];
     JSAMPROW cb[8];
     JSAMPROW cr[8];
@@ -579,36 +760,37 @@ void Yuv420SpToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv)
     planes[2] = cr;
 
     int width = cinfo->image_width;
-    int height = cinfo->image_height;
     uint8_t *yPlanar = yuv;
     uint8_t *vuPlanar = yuv + width * height;
-    uint8_t *uRows = new uint8_t[8 * (width >> 1)];
-    uint8_t *vRows = new uint8_t[8 * (width >> 1)];
+    uint8_t *uRows = rows;
+    uint8_t *vRows = rows + 8 * (width >> 1);
     int processLines = DEINTERLEAVE_LINES_ONE_TIME;
 
     // process 16 lines of Y and 8 lines of U/V each time.
     while (cinfo->next_scanline < cinfo->image_height) {
+        int rowIndex = startRow + cinfo->next_scanline;
         if (cinfo->next_scanline + DEINTERLEAVE_LINES_ONE_TIME > cinfo->image_height)
             processLines = cinfo->image_height - cinfo->next_scanline;
         // deitnerleave u and v
-        deinterleave(vuPlanar, uRows, vRows, cinfo->next_scanline, width, height, processLines);
+        deinterleave(vuPlanar, uRows, vRows, rowIndex, width, height, processLines);
+
+        for (int i = 0; i < DEINTERLEAVE_LINES_ONE_TIME; i++) {
+            // repeat the last line to fill the MCU
+            int line = (i < processLines) ? i : processLines - 1;
 
-        for (int i = 0; i < processLines; i++) {
             // y row
-            y[i] = yPlanar + (cinfo->next_scanline + i) * width;
+            y[i] = yPlanar + (rowIndex + line) * width;
 
             // construct u row and v row
             if ((i & 1) == 0) {
                 // height and width are both halved because of downsampling
-                int offset = (i >> 1) * (width >> 1);
+                int offset = (line >> 1) * (width >> 1);
                 cb[i / 2] = uRows + offset;
                 cr[i / 2] = vRows + offset;
             }
         }
         jpeg_write_raw_data(cinfo, planes, 16);
     }
-    delete[] uRows;
-    delete[] vRows;
 }
 
 void Yuv420SpToJpegEncoder::deinterleave(uint8_t *vuPlanar, uint8_t *uRows, uint8_t *vRows,
@@ -654,7 +836,13 @@ Yuv422IToJpegEncoder::Yuv422IToJpegEncoder(int format) : YuvToJpegEncoder(format
 #endif
 }
 
-void Yuv422IToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv) {
+int Yuv422IToJpegEncoder::getRowsSize(int width) {
+    // 16 lines of y, u and v
+    return DEINTERLEAVE_LINES_ONE_TIME * (width + 2 * (width >> 1));
+}
+
+void Yuv422IToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv, int height,
+                                    int startRow, uint8_t *rows) {
     JSAMPROW y[16];
     JSAMPROW cb[16];
     JSAMPROW cr[16];
@@ -665,10 +853,9 @@ void Yuv422IToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv) {
     planes[2] = cr;
 
     int width = cinfo->image_width;
-    int height = cinfo->image_height;
-    uint8_t *yRows = new uint8_t[16 * width];
-    uint8_t *uRows = new uint8_t[16 * (width >> 1)];
-    uint8_t *vRows = new uint8_t[16 * (width >> 1)];
+    uint8_t *yRows = rows;
+    uint8_t *uRows = yRows + 16 * width;
+    uint8_t *vRows = uRows + 16 * (width >> 1);
     int processLines = DEINTERLEAVE_LINES_ONE_TIME;
 
     uint8_t *yuvOffset = yuv;
@@ -677,25 +864,25 @@ void Yuv422IToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv) {
     while (cinfo->next_scanline < cinfo->image_height) {
         if (cinfo->next_scanline + DEINTERLEAVE_LINES_ONE_TIME > cinfo->image_height)
             processLines = cinfo->image_height - cinfo->next_scanline;
-        deinterleave(yuvOffset, yRows, uRows, vRows, cinfo->next_scanline, width, height,
-                     processLines);
+        deinterleave(yuvOffset, yRows, uRows, vRows, startRow + cinfo->next_scanline, width,
+                     height, processLines);
+
+        for (int i = 0; i < DEINTERLEAVE_LINES_ONE_TIME; i++) {
+            // repeat the last line to fill the MCU
+            int line = (i < processLines) ? i : processLines - 1;
 
-        for (int i = 0; i < processLines; i++) {
             // y row
-            y[i] = yRows + i * width;
+            y[i] = yRows + line * width;
 
             // construct u row and v row
             // width is halved because of downsampling
-            int offset = i * (width >> 1);
+            int offset = line * (width >> 1);
             cb[i] = uRows + offset;
             cr[i] = vRows + offset;
         }
 
         jpeg_write_raw_data(cinfo, planes, 16);
     }
-    delete[] yRows;
-    delete[] uRows;
-    delete[] vRows;
 }
 
 void Yuv422IToJpegEncoder::deinterleave(uint8_t *yuv, uint8_t *yRows, uint8_t *uRows,
@@ -736,7 +923,13 @@ Yuv422SpToJpegEncoder::Yuv422SpToJpegEncoder(int format) : YuvToJpegEncoder(form
 #endif
 }
 
-void Yuv422SpToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv) {
+int Yuv422SpToJpegEncoder::getRowsSize(int width) {
+    // 16 lines of y, u and v
+    return DEINTERLEAVE_LINES_ONE_TIME * (width + 2 * (width >> 1));
+}
+
+void Yuv422SpToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv, int height,
+                                     int startRow, uint8_t *rows) {
     JSAMPROW y[16];
     JSAMPROW cb[16];
     JSAMPROW cr[16];
@@ -747,10 +940,9 @@ void Yuv422SpToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv)
     planes[2] = cr;
 
     int width = cinfo->image_width;
-    int height = cinfo->image_height;
-    uint8_t *yRows = new uint8_t[16 * width];
-    uint8_t *uRows = new uint8_t[16 * (width >> 1)];
-    uint8_t *vRows = new uint8_t[16 * (width >> 1)];
+    uint8_t *yRows = rows;
+    uint8_t *uRows = yRows + 16 * width;
+    uint8_t *vRows = uRows + 16 * (width >> 1);
     uint8_t *yuvOffset = yuv;
     int processLines = DEINTERLEAVE_LINES_ONE_TIME;
 
@@ -758,25 +950,25 @@ void Yuv422SpToJpegEncoder::compress(jpeg_compress_struct *cinfo, uint8_t *yuv)
     while (cinfo->next_scanline < cinfo->image_height) {
         if (cinfo->next_scanline + DEINTERLEAVE_LINES_ONE_TIME > cinfo->image_height)
             processLines = cinfo->image_height - cinfo->next_scanline;
-        deinterleave(yuvOffset, yRows, uRows, vRows, cinfo->next_scanline, width, height,
-                     processLines);
+        deinterleave(yuvOffset, yRows, uRows, vRows, startRow + cinfo->next_scanline, width,
+                     height, processLines);
+
+        for (int i = 0; i < DEINTERLEAVE_LINES_ONE_TIME; i++) {
+            // repeat the last line to fill the MCU
+            int line = (i < processLines) ? i : processLines - 1;
 
-        for (int i = 0; i < processLines; i++) {
             // y row
-            y[i] = yRows + i * width;
+            y[i] = yRows + line * width;
 
             // construct u row and v row
             // width is halved because of downsampling
-            int offset = i * (width >> 1);
+            int offset = line * (width >> 1);
             cb[i] = uRows + offset;
             cr[i] = vRows + offset;
         }
 
         jpeg_write_raw_data(cinfo, planes, 16);
     }
-    delete[] yRows;
-    delete[] uRows;
-    delete[] vRows;
 }
 
 void Yuv422SpToJpegEncoder::deinterleave(uint8_t *yuv, uint8_t *yRows, uint8_t *uRows,
@@ -855,3 +1047,41 @@ jpegBuilder_destination_mgr::jpegBuilder_destination_mgr(uint8_t *input, int siz
 
     jpegsize = 0;
 }
+
+static void jpegBuilder_strip_init_destination(j_compress_ptr cinfo) {
+    jpegBuilder_strip_destination_mgr *dest = (jpegBuilder_strip_destination_mgr *)cinfo->dest;
+
+    // the buffer is kept by the encoder, it only grows from one frame to the next.
+    if (dest->buf->size() < 64 * 1024)
+        dest->buf->resize(64 * 1024);
+
+    dest->next_output_byte = dest->buf->data();
+    dest->free_in_buffer = dest->buf->size();
+    dest->jpegsize = 0;
+}
+
+static boolean jpegBuilder_strip_empty_output_buffer(j_compress_ptr cinfo) {
+    jpegBuilder_strip_destination_mgr *dest = (jpegBuilder_strip_destination_mgr *)cinfo->dest;
+    size_t used = dest->buf->size();
+
+    dest->buf->resize(used * 2);
+    dest->next_output_byte = dest->buf->data() + used;
+    dest->free_in_buffer = used;
+    return TRUE;
+}
+
+static void jpegBuilder_strip_term_destination(j_compress_ptr cinfo) {
+    jpegBuilder_strip_destination_mgr *dest = (jpegBuilder_strip_destination_mgr *)cinfo->dest;
+
+    dest->jpegsize = dest->buf->size() - dest->free_in_buffer;
+}
+
+jpegBuilder_strip_destination_mgr::jpegBuilder_strip_destination_mgr(std::vector<uint8_t> *output) {
+    this->init_destination = jpegBuilder_strip_init_destination;
+    this->empty_output_buffer = jpegBuilder_strip_empty_output_buffer;
+    this->term_destination = jpegBuilder_strip_term_destination;
+
+    this->buf = output;
+
+    jpegsize = 0;
+}
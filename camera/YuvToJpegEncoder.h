@@ -39,8 +39,14 @@ extern "C" {
 }
 #include <setjmp.h>
 
+#include <vector>
+
+// Also the MCU height, all the encoders subsample chroma vertically by 2 at most.
 #define DEINTERLEAVE_LINES_ONE_TIME 16
 
+// Upper limit of the strips a frame is split into for parallel encoding.
+#define JPEG_MAX_STRIPS 8
+
 using namespace android;
 
 class YuvToJpegEncoder {
@@ -61,17 +67,37 @@ public:
     int getColorFormat() { return mColorFormat; }
 
 protected:
+    // Rows of the frame encoded as one restart interval, by one libjpeg
+    // instance. rows holds the deinterleaved lines, out the encoded strip.
+    struct JpegStrip {
+        std::vector<uint8_t> rows;
+        std::vector<uint8_t> out;
+        size_t outSize;
+    };
+
     int fNumPlanes;
     int color;
     int mColorFormat;
     int mPixelFormat;
+    std::vector<JpegStrip> mStrips;
 
     void setJpegCompressStruct(jpeg_compress_struct *cinfo, int width, int height, int quality);
+    int getStripLines(int width, int height);
+    void encodeStrip(JpegStrip &strip, uint8_t *yuv, int width, int height, int startRow,
+                     int lines, int quality, const void *app1Buffer, size_t app1Size);
+    int stitchStrips(int stripLines, int width, int height, uint8_t *outBuf, int outSize);
     virtual void configSamplingFactors(__attribute__((unused)) jpeg_compress_struct *cinfo) {
         return;
     };
+    // Bytes of row buffer compress() needs for one pass of
+    // DEINTERLEAVE_LINES_ONE_TIME lines.
+    virtual int getRowsSize(__attribute__((unused)) int width) { return 0; };
+    // Encode cinfo->image_height lines of the height lines frame, starting at
+    // startRow.
     virtual void compress(__attribute__((unused)) jpeg_compress_struct *cinfo,
-                          __attribute__((unused)) uint8_t *yuv) {
+                          __attribute__((unused)) uint8_t *yuv, __attribute__((unused)) int height,
+                          __attribute__((unused)) int startRow,
+                          __attribute__((unused)) uint8_t *rows) {
         return;
     };
     virtual int yuvResize(__attribute__((unused)) uint8_t *srcBuf,
@@ -94,7 +120,9 @@ private:
                          uint8_t *&vPlanar);
     void deinterleave(uint8_t *vuPlanar, uint8_t *uRows, uint8_t *vRows, int rowIndex, int width,
                       int height, int processLines);
-    void compress(jpeg_compress_struct *cinfo, uint8_t *yuv);
+    int getRowsSize(int width);
+    void compress(jpeg_compress_struct *cinfo, uint8_t *yuv, int height, int startRow,
+                  uint8_t *rows);
     int yuvResize(uint8_t *srcBuf, int srcWidth, int srcHeight, uint8_t *dstBuf, int dstWidth,
                   int dstHeight);
 };
@@ -106,7 +134,9 @@ public:
 
 private:
     void configSamplingFactors(jpeg_compress_struct *cinfo);
-    void compress(jpeg_compress_struct *cinfo, uint8_t *yuv);
+    int getRowsSize(int width);
+    void compress(jpeg_compress_struct *cinfo, uint8_t *yuv, int height, int startRow,
+                  uint8_t *rows);
     void deinterleave(uint8_t *yuv, uint8_t *yRows, uint8_t *uRows, uint8_t *vRows, int rowIndex,
                       int width, int height, int processLines);
 };
@@ -118,7 +148,9 @@ public:
 
 private:
     void configSamplingFactors(jpeg_compress_struct *cinfo);
-    void compress(jpeg_compress_struct *cinfo, uint8_t *yuv);
+    int getRowsSize(int width);
+    void compress(jpeg_compress_struct *cinfo, uint8_t *yuv, int height, int startRow,
+                  uint8_t *rows);
     void deinterleave(uint8_t *yuv, uint8_t *yRows, uint8_t *uRows, uint8_t *vRows, int rowIndex,
                       int width, int height, int processLines);
     int yuvResize(uint8_t *srcBuf, int srcWidth, int srcHeight, uint8_t *dstBuf, int dstWidth,
@@ -133,6 +165,14 @@ struct jpegBuilder_destination_mgr : jpeg_destination_mgr {
     size_t jpegsize;
 };
 
+// Grows the buffer when libjpeg fills it, used for strips of unknown size.
+struct jpegBuilder_strip_destination_mgr : jpeg_destination_mgr {
+    jpegBuilder_strip_destination_mgr(std::vector<uint8_t> *output);
+
+    std::vector<uint8_t> *buf;
+    size_t jpegsize;
+};
+
 struct jpegBuilder_error_mgr : jpeg_error_mgr {
     jmp_buf fJmpBuf;
 };
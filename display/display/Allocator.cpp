@@ -16,6 +16,8 @@
 
 #include "Allocator.h"
 
+#include <errno.h>
+
 #include "IonAllocator.h"
 #ifdef ENABLE_DMABUF_HEAP
 #include "DmaHeapAllocator.h"
@@ -42,4 +44,19 @@ Allocator* Allocator::getInstance() {
     return mInstance;
 }
 
+int Allocator::getPhysBatch(const int* fds, const int* sizes, int count, uint64_t* addrs) {
+    if (fds == NULL || sizes == NULL || addrs == NULL || count < 0) {
+        return -EINVAL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int ret = getPhys(fds[i], sizes[i], addrs[i]);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
 } // namespace fsl
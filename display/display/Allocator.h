@@ -53,6 +53,14 @@ public:
     virtual int getVaddrs(int fd, int size, uint64_t& addr) = 0;
     // get buffer heap type
     virtual int getHeapType(int fd) = 0;
+    // get physical address of each fd, such as the planes of one buffer.
+    virtual int getPhysBatch(const int* fds, const int* sizes, int count, uint64_t* addrs);
+    // drop information cached for the buffer, called before it is freed.
+    virtual void releaseBufferInfo(int /*fd*/) {}
+    // prepare cacheable memory before CPU access, read discards stale cache lines.
+    virtual int beginCpuAccess(int /*fd*/, bool /*read*/, bool /*write*/) { return 0; }
+    // finish CPU access, write cleans dirty cache lines for the device.
+    virtual int endCpuAccess(int fd, bool /*read*/, bool /*write*/) { return flushCache(fd); }
 
 private:
     static Mutex sLock;
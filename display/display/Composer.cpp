@@ -280,7 +280,7 @@ int Composer::clearRect(Memory* target, Rect& rect) {
     return 0;
 }
 
-int Composer::clearWormHole(LayerVector& layers) {
+int Composer::clearWormHole(LayerVector& layers, const Region* repaint) {
     if (mTarget == NULL) {
         ALOGE("clearWormHole: no effective render buffer");
         return -EINVAL;
@@ -307,6 +307,10 @@ int Composer::clearWormHole(LayerVector& layers) {
     // calculate worm hole.
     Region screen(Rect(mTarget->width, mTarget->height));
     screen.subtractSelf(opaque);
+    if (repaint != NULL) {
+        // the rest of worm hole is still clear in target.
+        screen.andSelf(*repaint);
+    }
     const Rect* holes = NULL;
     size_t numRect = 0;
     holes = screen.getArray(&numRect);
@@ -329,7 +333,7 @@ int Composer::clearWormHole(LayerVector& layers) {
     return 0;
 }
 
-int Composer::composeLayer(Layer* layer, bool bypass) {
+int Composer::composeLayer(Layer* layer, bool bypass, const Region* repaint) {
     if (layer == NULL || mTarget == NULL) {
         ALOGE("composeLayer: invalid layer or target");
         return -EINVAL;
@@ -357,7 +361,13 @@ int Composer::composeLayer(Layer* layer, bool bypass) {
     memset(&dSurfaceX, 0, sizeof(dSurfaceX));
     size_t count = 0;
     bool needDither = false;
-    const Rect* visible = layer->visibleRegion.getArray(&count);
+    // only blit the dirty part of visible region.
+    Region dirty;
+    if (repaint != NULL) {
+        dirty = layer->visibleRegion.intersect(*repaint);
+    }
+    const Rect* visible = (repaint != NULL) ? dirty.getArray(&count)
+                                            : layer->visibleRegion.getArray(&count);
     for (size_t i = 0; i < count; i++) {
         Rect srect = layer->sourceCrop;
         Rect clip = visible[i];
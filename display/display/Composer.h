@@ -46,9 +46,10 @@ public:
     // set composite target buffer.
     int setRenderTarget(Memory* memory);
     // clear worm hole introduced by layers not cover whole screen.
-    int clearWormHole(LayerVector& layers);
+    // repaint limits composition to the dirty part of target, NULL to compose all.
+    int clearWormHole(LayerVector& layers, const Region* repaint = NULL);
     // compose display layer.
-    int composeLayer(Layer* layer, bool bypass);
+    int composeLayer(Layer* layer, bool bypass, const Region* repaint = NULL);
     // sync 2D blit engine.
     int finishComposite();
     // lock surface to get GPU specific resource.
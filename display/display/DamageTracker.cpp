@@ -0,0 +1,173 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DamageTracker.h"
+
+#include <cutils/log.h>
+
+namespace fsl {
+
+// display keeps at most this number of render targets in flight.
+#define MAX_DAMAGE_FRAMES 4
+
+DamageTracker::DamageTracker() {
+    mFrameCount = 0;
+    mBottomLayer = NULL;
+    mWidth = 0;
+    mHeight = 0;
+}
+
+void DamageTracker::reset() {
+    mLayerStates.clear();
+    mFrameDamages.clear();
+    mTargetFrames.clear();
+    mBottomLayer = NULL;
+}
+
+// map surface damage of layer buffer into display space.
+Region DamageTracker::getBufferDamage(Layer* layer) {
+    Rect& frame = layer->displayFrame;
+    Rect& crop = layer->sourceCrop;
+    if (!layer->surfaceDamageValid || layer->transform != 0 || crop.isEmpty()) {
+        return Region(frame);
+    }
+
+    int frameW = frame.width();
+    int frameH = frame.height();
+    int cropW = crop.width();
+    int cropH = crop.height();
+    Region region;
+    size_t count = 0;
+    const Rect* rects = layer->surfaceDamage.getArray(&count);
+    for (size_t i = 0; i < count; i++) {
+        Rect rect;
+        if (!crop.intersect(rects[i], &rect)) {
+            continue;
+        }
+        // round to outside to cover filtered pixels.
+        Rect mapped;
+        mapped.left = frame.left + (int64_t)(rect.left - crop.left) * frameW / cropW - 1;
+        mapped.top = frame.top + (int64_t)(rect.top - crop.top) * frameH / cropH - 1;
+        mapped.right =
+                frame.left + ((int64_t)(rect.right - crop.left) * frameW + cropW - 1) / cropW + 1;
+        mapped.bottom =
+                frame.top + ((int64_t)(rect.bottom - crop.top) * frameH + cropH - 1) / cropH + 1;
+        region.orSelf(mapped);
+    }
+
+    return region.intersect(frame);
+}
+
+Region DamageTracker::computeFrameDamage(LayerVector& layers) {
+    Region damage;
+    std::unordered_map<Layer*, LayerState> states;
+
+    size_t count = layers.size();
+    for (size_t i = 0; i < count; i++) {
+        Layer* layer = layers[i];
+        LayerState state;
+        state.handle = layer->handle;
+        state.sourceCrop = layer->sourceCrop;
+        state.displayFrame = layer->displayFrame;
+        state.visibleRegion = layer->visibleRegion;
+        state.transform = layer->transform;
+        state.blendMode = layer->blendMode;
+        state.planeAlpha = layer->planeAlpha;
+        state.color = layer->color;
+        state.zorder = layer->zorder;
+        state.type = layer->type;
+
+        auto it = mLayerStates.find(layer);
+        if (it == mLayerStates.end()) {
+            damage.orSelf(state.displayFrame);
+        } else {
+            LayerState& last = it->second;
+            if (last.sourceCrop != state.sourceCrop || last.displayFrame != state.displayFrame ||
+                last.transform != state.transform || last.blendMode != state.blendMode ||
+                last.planeAlpha != state.planeAlpha || last.zorder != state.zorder ||
+                last.type != state.type) {
+                damage.orSelf(last.displayFrame);
+                damage.orSelf(state.displayFrame);
+            } else {
+                if (layer->isSolidColor()) {
+                    if (last.color != state.color) {
+                        damage.orSelf(state.displayFrame);
+                    }
+                } else if (layer->flags & BUFFER_SLOT) {
+                    // hw layer buffers are queued without surface damage.
+                    damage.orSelf(state.displayFrame);
+                } else if (last.handle != state.handle) {
+                    damage.orSelf(getBufferDamage(layer));
+                }
+                // parts covered or uncovered by layers out of composition.
+                damage.orSelf(last.visibleRegion.mergeExclusive(state.visibleRegion));
+            }
+            mLayerStates.erase(it);
+        }
+        states.emplace(layer, state);
+    }
+
+    // layers gone from composition.
+    for (auto& v : mLayerStates) {
+        damage.orSelf(v.second.displayFrame);
+    }
+    mLayerStates.swap(states);
+
+    return damage;
+}
+
+Region DamageTracker::getRepaintRegion(LayerVector& layers, Memory* target) {
+    Rect screen(target->width, target->height);
+    if (target->width != mWidth || target->height != mHeight) {
+        reset();
+        mWidth = target->width;
+        mHeight = target->height;
+    }
+
+    Region damage = computeFrameDamage(layers).intersect(screen);
+    // the bottom layer is blitted without blending, redraw all when it changes.
+    Layer* bottom = layers.size() > 0 ? layers[0] : NULL;
+    if (bottom != mBottomLayer) {
+        damage.set(screen);
+        mBottomLayer = bottom;
+    }
+
+    mFrameDamages.push_front(damage);
+    if (mFrameDamages.size() > MAX_DAMAGE_FRAMES) {
+        mFrameDamages.pop_back();
+    }
+    mFrameCount++;
+
+    Region repaint(screen);
+    auto it = mTargetFrames.find(target);
+    if (it != mTargetFrames.end()) {
+        uint64_t age = mFrameCount - it->second;
+        if (age <= mFrameDamages.size()) {
+            repaint.clear();
+            for (uint64_t i = 0; i < age; i++) {
+                repaint.orSelf(mFrameDamages[i]);
+            }
+        }
+    }
+    mTargetFrames[target] = mFrameCount;
+
+    Rect bounds = repaint.getBounds();
+    ALOGV("repaint bounds(l:%d,t:%d,r:%d,b:%d)", bounds.left, bounds.top, bounds.right,
+          bounds.bottom);
+    return repaint;
+}
+
+} // namespace fsl
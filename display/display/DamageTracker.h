@@ -0,0 +1,69 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FSL_DAMAGE_TRACKER_H_
+#define _FSL_DAMAGE_TRACKER_H_
+
+#include <deque>
+#include <unordered_map>
+
+#include "Layer.h"
+#include "Memory.h"
+
+namespace fsl {
+
+// Track layer changes between frames of one display, so that 2D composition
+// only redraws the dirty part of a recycled render target. The region to
+// redraw is the union of frame damages since the target was last composed.
+class DamageTracker {
+public:
+    DamageTracker();
+
+    // get the region of target which must be composed again for layers.
+    Region getRepaintRegion(LayerVector& layers, Memory* target);
+    // forget all history, next frame will be fully composed.
+    void reset();
+
+private:
+    struct LayerState {
+        Memory* handle;
+        Rect sourceCrop;
+        Rect displayFrame;
+        Region visibleRegion;
+        int transform;
+        int blendMode;
+        int planeAlpha;
+        int color;
+        int zorder;
+        int type;
+    };
+
+    Region computeFrameDamage(LayerVector& layers);
+    static Region getBufferDamage(Layer* layer);
+
+    std::unordered_map<Layer*, LayerState> mLayerStates;
+    // damage of recent frames, the newest first.
+    std::deque<Region> mFrameDamages;
+    // frame count when the target was last composed.
+    std::unordered_map<Memory*, uint64_t> mTargetFrames;
+    uint64_t mFrameCount;
+    Layer* mBottomLayer;
+    int mWidth;
+    int mHeight;
+};
+
+} // namespace fsl
+#endif
@@ -24,6 +24,8 @@
 #include <sync/sync.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+
 #include "Memory.h"
 #include "MemoryDesc.h"
 
@@ -66,7 +68,9 @@ Display::Display() : mLock(Mutex::PRIVATE), mComposer(*Composer::getInstance())
     mListener = NULL;
     mTotalLayerNum = 0;
     mMaxBrightness = -1;
-    mOverlay = NULL;
+    memset(mOverlays, 0, sizeof(mOverlays));
+    mOverlayNum = 0;
+    mPartialComposition = property_get_bool("vendor.hwc.enable.partial_composition", true);
 
 #ifdef DEBUG_DUMP_REFRESH_RATE
     m_pre_commit_start = 0;
@@ -284,10 +288,54 @@ bool Display::checkOverlay(Layer* /*layer*/) {
     return false;
 }
 
+size_t Display::assignOverlays(Layer** candidates, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+
+    // only one overlay plane by default, keep the most valuable candidate.
+    size_t best = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (overlayPriorityHigher(candidates[i], candidates[best])) {
+            best = i;
+        }
+    }
+    std::swap(candidates[0], candidates[best]);
+    candidates[0]->planeIndex = 0;
+    return 1;
+}
+
 int Display::performOverlay() {
     return 0;
 }
 
+bool Display::overlayPriorityHigher(const Layer* lhs, const Layer* rhs) {
+#ifdef HAVE_UNMAPPED_HEAP
+    // protected content can only be shown by overlay plane.
+    bool lhsProtected = lhs->handle != NULL && (lhs->handle->usage & USAGE_PROTECTED);
+    bool rhsProtected = rhs->handle != NULL && (rhs->handle->usage & USAGE_PROTECTED);
+    if (lhsProtected != rhsProtected) {
+        return lhsProtected;
+    }
+#endif
+    // bigger layer saves more 2D composition bandwidth.
+    const Rect& l = lhs->displayFrame;
+    const Rect& r = rhs->displayFrame;
+    return (int64_t)(l.right - l.left) * (l.bottom - l.top) >
+            (int64_t)(r.right - r.left) * (r.bottom - r.top);
+}
+
+void Display::clearOverlaysLocked() {
+    for (size_t i = 0; i < mOverlayNum; i++) {
+        if (mOverlays[i] != NULL) {
+            mOverlays[i]->isOverlay = false;
+            mOverlays[i]->planeIndex = -1;
+        }
+        mOverlays[i] = NULL;
+    }
+    mOverlayNum = 0;
+}
+
 int Display::updateScreen() {
     return -EINVAL;
 }
@@ -321,6 +369,8 @@ void Display::resetLayerLocked(Layer* layer) {
     layer->sourceCrop.clear();
     layer->displayFrame.clear();
     layer->visibleRegion.clear();
+    layer->surfaceDamage.clear();
+    layer->surfaceDamageValid = false;
     if (layer->acquireFence != -1) {
         close(layer->acquireFence);
     }
@@ -330,6 +380,7 @@ void Display::resetLayerLocked(Layer* layer) {
     layer->priv = NULL;
     layer->lastHandle = NULL;
     layer->isOverlay = false;
+    layer->planeIndex = -1;
     layer->lastSourceCrop.clear();
     layer->lastDisplayFrame.clear();
     memset(&layer->hdrMetadata, 0, sizeof(layer->hdrMetadata));
@@ -640,81 +691,127 @@ bool Display::verifyLayers() {
     }
 
     // set device compose flags.
-    int ovIdx = -1, idx;
+    Layer* candidates[MAX_LAYERS];
+    size_t candidateNum = 0;
     mComposeFlag &= OVERLAY_COMPOSE_MASK;
     mComposeFlag = mComposeFlag << (LAST_OVERLAY_BIT - OVERLAY_COMPOSE_BIT);
-    for (size_t i = 0; i < MAX_LAYERS; i++) {
-        if (!mLayers[i]->busy) {
-            continue;
-        }
-
-        // handle overlay.
-        idx = i;
-        if (checkOverlay(mLayers[i])) {
-            if (ovIdx == -1) {
-                ovIdx = i;
-                continue;
-            }
-#ifdef HAVE_UNMAPPED_HEAP
-            else {
-                Memory* ov_hnd = mLayers[ovIdx]->handle;
-                Memory* hnd = mLayers[i]->handle;
-                if (hnd != NULL && (hnd->usage & USAGE_PROTECTED) && ov_hnd != NULL &&
-                    !(ov_hnd->usage & USAGE_PROTECTED)) {
-                    mLayers[ovIdx]->isOverlay = false;
-                    idx = ovIdx; // previous overlay layer restore to CLIENT type
-                    ovIdx = i;
-                }
-            }
-#endif
-        }
+    clearOverlaysLocked();
 
+    auto addComposeLayer = [&](Layer* layer) {
         if (!deviceCompose) {
-            mLayers[idx]->type = LAYER_TYPE_CLIENT;
+            layer->type = LAYER_TYPE_CLIENT;
             mComposeFlag |= 1 << CLIENT_COMPOSE_BIT;
             mTotalLayerNum++;
-            layerZVector.emplace(mLayers[idx]->zorder, mLayers[idx]->displayFrame);
+            layerZVector.emplace(layer->zorder, layer->displayFrame);
 
             // Here compare current layer info with previous one to determine
             // whether UI has update. IF no update,won't commit to framebuffer
             // to avoid UI re-composition.
-            if (mLayers[idx]->handle != mLayers[idx]->lastHandle ||
-                mLayers[idx]->lastSourceCrop != mLayers[idx]->sourceCrop ||
-                mLayers[idx]->lastDisplayFrame != mLayers[idx]->displayFrame) {
+            if (layer->handle != layer->lastHandle || layer->lastSourceCrop != layer->sourceCrop ||
+                layer->lastDisplayFrame != layer->displayFrame) {
                 mUiUpdate = true;
             }
 
-            mLayers[idx]->lastHandle = mLayers[idx]->handle;
-            mLayers[idx]->lastSourceCrop = mLayers[idx]->sourceCrop;
-            mLayers[idx]->lastDisplayFrame = mLayers[idx]->displayFrame;
-            continue;
+            layer->lastHandle = layer->handle;
+            layer->lastSourceCrop = layer->sourceCrop;
+            layer->lastDisplayFrame = layer->displayFrame;
+            return;
         }
-        mLayerVector.add(mLayers[idx]);
+        mLayerVector.add(layer);
         mTotalLayerNum++;
+    };
+
+    for (size_t i = 0; i < MAX_LAYERS; i++) {
+        if (!mLayers[i]->busy) {
+            continue;
+        }
+
+        // handle overlay.
+        if (checkOverlay(mLayers[i])) {
+            candidates[candidateNum++] = mLayers[i];
+            continue;
+        }
+
+        addComposeLayer(mLayers[i]);
     }
 
-    if (ovIdx >= 0) {
+    // overlay candidates are assigned to planes from bottom to top.
+    std::stable_sort(candidates, candidates + candidateNum,
+                     [](const Layer* lhs, const Layer* rhs) { return lhs->zorder < rhs->zorder; });
+
+    // client layer below overlay covers it, overlay can't be used.
+    size_t validNum = 0;
+    for (size_t i = 0; i < candidateNum; i++) {
         bool shouldOverlay = true;
         for (auto& v : layerZVector) {
-            if (v.first < mLayers[ovIdx]->zorder &&
-                contains(v.second, mLayers[ovIdx]->displayFrame)) {
+            if (v.first < candidates[i]->zorder && contains(v.second, candidates[i]->displayFrame)) {
                 shouldOverlay = false;
                 break;
             }
         }
 
         if (shouldOverlay) {
-            mOverlay = mLayers[ovIdx];
-            mOverlay->isOverlay = true;
-            mOverlay->type = LAYER_TYPE_DEVICE;
-            mComposeFlag |= 1 << OVERLAY_COMPOSE_BIT;
+            candidates[validNum++] = candidates[i];
         } else {
-            mLayers[ovIdx]->type = LAYER_TYPE_CLIENT;
+            candidates[i]->type = LAYER_TYPE_CLIENT;
             mComposeFlag |= 1 << CLIENT_COMPOSE_BIT;
             mTotalLayerNum++;
         }
     }
 
+    size_t assigned = assignOverlays(candidates, validNum);
+    if (assigned > MAX_OVERLAY_PLANES) {
+        assigned = MAX_OVERLAY_PLANES;
+    }
+    // keep plane assignment in zorder for performOverlay.
+    std::stable_sort(candidates, candidates + assigned,
+                     [](const Layer* lhs, const Layer* rhs) { return lhs->zorder < rhs->zorder; });
+
+    // composed layers all end up in one framebuffer, so none of them may sit
+    // in zorder between two overlays. The upper overlay and the ones above it
+    // go back to composition.
+    auto composedBetween = [&](int low, int high) {
+        for (auto& v : layerZVector) {
+            if (v.first > low && v.first < high) {
+                return true;
+            }
+        }
+        for (size_t i = 0; i < mLayerVector.size(); i++) {
+            if (mLayerVector[i]->zorder > low && mLayerVector[i]->zorder < high) {
+                return true;
+            }
+        }
+        for (size_t i = assigned; i < validNum; i++) {
+            if (candidates[i]->zorder > low && candidates[i]->zorder < high) {
+                return true;
+            }
+        }
+        return false;
+    };
+    for (size_t i = 1; i < assigned; i++) {
+        if (composedBetween(candidates[i - 1]->zorder, candidates[i]->zorder)) {
+            ALOGV("composed layer between overlays %d and %d", candidates[i - 1]->zorder,
+                  candidates[i]->zorder);
+            assigned = i;
+            break;
+        }
+    }
+    for (size_t i = 0; i < assigned; i++) {
+        mOverlays[i] = candidates[i];
+        mOverlays[i]->isOverlay = true;
+        mOverlays[i]->type = LAYER_TYPE_DEVICE;
+    }
+    mOverlayNum = assigned;
+    if (mOverlayNum > 0) {
+        mComposeFlag |= 1 << OVERLAY_COMPOSE_BIT;
+    }
+
+    // layers without free plane go back to composition.
+    for (size_t i = assigned; i < validNum; i++) {
+        candidates[i]->planeIndex = -1;
+        addComposeLayer(candidates[i]);
+    }
+
     if (mTotalLayerNum != lastTotalLayerNum) {
         mUiUpdate = true;
     }
@@ -946,6 +1043,8 @@ int Display::composeLayersLocked() {
     performOverlay();
 
     if (mLayerVector.size() <= 0 && !directCompositionLocked()) {
+        // layer changes of this frame are not tracked, compose all next time.
+        mDamageTracker.reset();
         return ret;
     }
 
@@ -979,9 +1078,16 @@ int Display::composeLayersLocked() {
         mLayerVector.add(mHwLayers[i]);
     }
 
+    // only compose the region changed since mRenderTarget was last composed.
+    Region repaint;
+    if (mPartialComposition) {
+        repaint = mDamageTracker.getRepaintRegion(mLayerVector, mRenderTarget);
+    }
+    const Region* dirty = mPartialComposition ? &repaint : NULL;
+
     mComposer.lockSurface(mRenderTarget);
     mComposer.setRenderTarget(mRenderTarget);
-    mComposer.clearWormHole(mLayerVector);
+    mComposer.clearWormHole(mLayerVector, dirty);
 
     // to do composite.
     size_t count = mLayerVector.size();
@@ -1000,7 +1106,7 @@ int Display::composeLayersLocked() {
         if (layer->handle != NULL && !(layer->flags & BUFFER_SLOT))
             mComposer.lockSurface(layer->handle);
 
-        ret = mComposer.composeLayer(layer, i == 0);
+        ret = mComposer.composeLayer(layer, i == 0, dirty);
 
         if (layer->handle != NULL && !(layer->flags & BUFFER_SLOT))
             mComposer.unlockSurface(layer->handle);
@@ -25,6 +25,7 @@
 #include <vector>
 
 #include "Composer.h"
+#include "DamageTracker.h"
 #include "Edid.h"
 #include "Layer.h"
 #include "Memory.h"
@@ -48,6 +49,8 @@ using android::Vector;
 #define CLIENT_COMPOSE_MASK (1 << CLIENT_COMPOSE_BIT)
 #define ONLY_OVERLAY_MASK (1 << ONLY_OVERLAY_BIT)
 
+#define MAX_OVERLAY_PLANES 4
+
 #define DEF_BACKLIGHT_DEV "pwm-backlight"
 #define DEF_BACKLIGHT_PATH "/sys/class/backlight/"
 
@@ -207,6 +210,9 @@ public:
     int index();
 
     virtual bool checkOverlay(Layer* layer);
+    // assign overlay candidates sorted by zorder to hardware planes,
+    // return the number of layers kept in candidates.
+    virtual size_t assignOverlays(Layer** candidates, size_t count);
     virtual int performOverlay();
     // update composite buffer to screen.
     virtual int updateScreen();
@@ -276,6 +282,8 @@ protected:
     int composeLayersLocked();
     void resetLayerLocked(Layer* layer);
     void waitOnFenceLocked();
+    void clearOverlaysLocked();
+    static bool overlayPriorityHigher(const Layer* lhs, const Layer* rhs);
     bool check2DComposition();
     bool directCompositionLocked();
 
@@ -295,8 +303,11 @@ protected:
     LayerVector mLayerVector;
     Layer* mLayers[MAX_LAYERS];
     Layer* mHwLayers[MAX_LAYERS];
-    Layer* mOverlay;
+    Layer* mOverlays[MAX_OVERLAY_PLANES];
+    size_t mOverlayNum;
     Composer& mComposer;
+    DamageTracker mDamageTracker;
+    bool mPartialComposition;
     Memory* mRenderTarget;
     int mAcquireFence;
     int mComposeFlag;
@@ -0,0 +1,305 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DmaBufPool.h"
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace fsl {
+
+// small buffers are cheap to allocate, only pool the large ones.
+#define POOL_MIN_SIZE (512 * 1024)
+// every pooled buffer costs one fd in this process.
+#define POOL_MAX_ENTRIES 64
+// idle buffers not reused within this time are freed.
+#define POOL_MAX_IDLE_TIME ms2ns(10000)
+#define POOL_TRIM_INTERVAL std::chrono::seconds(2)
+// PSI "some" avg10 percent above which all idle buffers are freed.
+#define POOL_PRESSURE_AVG10 5.0
+
+DmaBufPool::DmaBufPool() {
+    mExit = false;
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.gralloc.dmabuf_pool_mb", value, "64");
+    mMaxIdleBytes = (size_t)atoi(value) * 1024 * 1024;
+    mEnabled = mMaxIdleBytes > 0;
+    mPoolCma = property_get_bool("vendor.gralloc.dmabuf_pool_cma", true);
+}
+
+DmaBufPool::~DmaBufPool() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExit = true;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    for (auto& entry : mEntries) {
+        close(entry.fd);
+    }
+}
+
+int DmaBufPool::getFileCount(int fd) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+    int info = open(path, O_RDONLY | O_CLOEXEC);
+    if (info < 0) {
+        return -1;
+    }
+
+    char buf[512];
+    ssize_t len = read(info, buf, sizeof(buf) - 1);
+    close(info);
+    if (len <= 0) {
+        return -1;
+    }
+    buf[len] = '\0';
+
+    // dma-buf fdinfo reports the reference count of the file.
+    const char* count = strstr(buf, "count:");
+    if (count == NULL) {
+        return -1;
+    }
+    return atoi(count + strlen("count:"));
+}
+
+bool DmaBufPool::clearBuffer(int fd, size_t size) {
+    void* vaddr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (vaddr == MAP_FAILED) {
+        ALOGE("%s mmap failed: %s", __func__, strerror(errno));
+        return false;
+    }
+
+    struct dma_buf_sync sync;
+    sync.flags = DMA_BUF_SYNC_START | DMA_BUF_SYNC_WRITE;
+    ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+    memset(vaddr, 0, size);
+    sync.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_WRITE;
+    ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+
+    munmap(vaddr, size);
+    return true;
+}
+
+bool DmaBufPool::underMemoryPressure() {
+    FILE* file = fopen("/proc/pressure/memory", "re");
+    if (file == NULL) {
+        return false;
+    }
+
+    float avg10 = 0;
+    int ret = fscanf(file, "some avg10=%f", &avg10);
+    fclose(file);
+
+    return ret == 1 && avg10 > POOL_PRESSURE_AVG10;
+}
+
+bool DmaBufPool::isPooledHeap(const char* heap) const {
+    // secure buffers can't be mapped to clear them, the next owner would see
+    // the frames of the previous one.
+    if (!strcmp(heap, "secure")) {
+        return false;
+    }
+    if (!strcmp(heap, "reserved") || !strcmp(heap, "reserved-uncached")) {
+        return mPoolCma;
+    }
+    return true;
+}
+
+bool DmaBufPool::isIdleLocked(Entry& entry, nsecs_t now) {
+    // the pool's own fd is the only reference left.
+    if (getFileCount(entry.fd) != 1) {
+        entry.idleSince = 0;
+        return false;
+    }
+
+    if (entry.idleSince == 0) {
+        entry.idleSince = now;
+    }
+    return true;
+}
+
+void DmaBufPool::releaseEntryLocked(size_t index) {
+    close(mEntries[index].fd);
+    mEntries[index] = std::move(mEntries.back());
+    mEntries.pop_back();
+}
+
+int DmaBufPool::acquire(const char* heap, size_t size) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mEnabled || size < POOL_MIN_SIZE || !isPooledHeap(heap)) {
+        return -1;
+    }
+
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    int best = -1;
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        Entry& entry = mEntries[i];
+        // don't waste more than a quarter of the buffer.
+        if (entry.heap != heap || entry.size < size || entry.size > size + size / 4) {
+            continue;
+        }
+        if (best >= 0 && entry.size >= mEntries[best].size) {
+            continue;
+        }
+        if (isIdleLocked(entry, now)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        return -1;
+    }
+
+    // new owner must not see the content of the previous one.
+    Entry& entry = mEntries[best];
+    if (!clearBuffer(entry.fd, entry.size)) {
+        releaseEntryLocked(best);
+        return -1;
+    }
+
+    int fd = fcntl(entry.fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+        ALOGE("%s dup failed: %s", __func__, strerror(errno));
+        return -1;
+    }
+    entry.idleSince = 0;
+
+    return fd;
+}
+
+void DmaBufPool::track(const char* heap, int fd, size_t size) {
+    if (fd < 0 || size < POOL_MIN_SIZE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    if (!mEnabled || !isPooledHeap(heap)) {
+        return;
+    }
+
+    if (getFileCount(fd) < 0) {
+        ALOGI("%s dmabuf reference count is unknown, disable pool", __func__);
+        mEnabled = false;
+        return;
+    }
+
+    if (mEntries.size() >= POOL_MAX_ENTRIES) {
+        trimLocked(systemTime(SYSTEM_TIME_MONOTONIC), false);
+        if (mEntries.size() >= POOL_MAX_ENTRIES) {
+            return;
+        }
+    }
+
+    int poolFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (poolFd < 0) {
+        ALOGE("%s dup failed: %s", __func__, strerror(errno));
+        return;
+    }
+
+    Entry entry;
+    entry.heap = heap;
+    entry.fd = poolFd;
+    entry.size = size;
+    entry.idleSince = 0;
+    mEntries.push_back(std::move(entry));
+
+    if (!mThread.joinable()) {
+        mThread = std::thread([this]() { threadLoop(); });
+        pthread_setname_np(mThread.native_handle(), "dmabuf_pool");
+    }
+    mCondition.notify_one();
+}
+
+bool DmaBufPool::trim(const char* heap, bool pressure) {
+    std::lock_guard<std::mutex> lock(mLock);
+    return trimLocked(systemTime(SYSTEM_TIME_MONOTONIC), pressure, heap) > 0;
+}
+
+size_t DmaBufPool::trimLocked(nsecs_t now, bool pressure, const char* heap) {
+    size_t freed = 0;
+    size_t idleBytes = 0;
+    for (size_t i = mEntries.size(); i-- > 0;) {
+        Entry& entry = mEntries[i];
+        if (heap != NULL && entry.heap != heap) {
+            continue;
+        }
+        if (!isIdleLocked(entry, now)) {
+            continue;
+        }
+        if (pressure || now - entry.idleSince > POOL_MAX_IDLE_TIME) {
+            releaseEntryLocked(i);
+            freed++;
+            continue;
+        }
+        idleBytes += entry.size;
+    }
+
+    // over budget, free the buffers idle for longest first.
+    while (idleBytes > mMaxIdleBytes) {
+        int oldest = -1;
+        for (size_t i = 0; i < mEntries.size(); i++) {
+            if (heap != NULL && mEntries[i].heap != heap) {
+                continue;
+            }
+            nsecs_t idleSince = mEntries[i].idleSince;
+            if (idleSince != 0 && (oldest < 0 || idleSince < mEntries[oldest].idleSince)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            break;
+        }
+        idleBytes -= mEntries[oldest].size;
+        releaseEntryLocked(oldest);
+        freed++;
+    }
+
+    return freed;
+}
+
+void DmaBufPool::threadLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (!mExit) {
+        if (mEntries.empty()) {
+            mCondition.wait(lock, [this]() { return mExit || !mEntries.empty(); });
+            continue;
+        }
+
+        mCondition.wait_for(lock, POOL_TRIM_INTERVAL);
+        if (mExit) {
+            break;
+        }
+
+        lock.unlock();
+        bool pressure = underMemoryPressure();
+        lock.lock();
+        trimLocked(systemTime(SYSTEM_TIME_MONOTONIC), pressure);
+    }
+}
+
+} // namespace fsl
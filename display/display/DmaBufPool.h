@@ -0,0 +1,86 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FSL_DMABUF_POOL_H_
+#define _FSL_DMABUF_POOL_H_
+
+#include <utils/Timers.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fsl {
+
+// Recycle large dmabufs of the same heap and similar size, so that stream
+// reconfiguration doesn't go to the kernel heap for every buffer.
+//
+// Buffers are handed out to other processes, so the pool can't be told when
+// one is freed. It keeps one extra fd of each large buffer it allocated and
+// reads the file reference count from fdinfo: when the pool holds the only
+// reference, all users are gone and the buffer can be reused.
+//
+// Secure buffers can't be cleared, they are never pooled. CMA heaps are
+// pooled unless vendor.gralloc.dmabuf_pool_cma is false: memory pressure
+// doesn't see CMA running out, so the idle byte budget bounds what the pool
+// holds and a failed allocation trims the heap and retries.
+class DmaBufPool {
+public:
+    DmaBufPool();
+    ~DmaBufPool();
+
+    // return a cleared idle buffer of the heap with at least size bytes, -1 if none.
+    int acquire(const char* heap, size_t size);
+    // keep a reference of a newly allocated buffer for later reuse.
+    void track(const char* heap, int fd, size_t size);
+    // free idle buffers of the heap, all of them with pressure. Returns true
+    // if any buffer was freed.
+    bool trim(const char* heap, bool pressure);
+
+private:
+    struct Entry {
+        std::string heap;
+        int fd;
+        size_t size;
+        // time the buffer was found idle, 0 when it is in use.
+        nsecs_t idleSince;
+    };
+
+    static int getFileCount(int fd);
+    static bool clearBuffer(int fd, size_t size);
+    static bool underMemoryPressure();
+    bool isPooledHeap(const char* heap) const;
+
+    bool isIdleLocked(Entry& entry, nsecs_t now);
+    void releaseEntryLocked(size_t index);
+    // heap NULL trims every heap, returns the number of buffers freed.
+    size_t trimLocked(nsecs_t now, bool pressure, const char* heap = NULL);
+    void threadLoop();
+
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::thread mThread;
+    bool mExit;
+    bool mEnabled;
+    bool mPoolCma;
+    size_t mMaxIdleBytes;
+    std::vector<Entry> mEntries;
+};
+
+} // namespace fsl
+#endif
@@ -25,9 +25,13 @@
 #include <linux/version.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace fsl {
 
+// buffers are normally released before this, it only bounds a leak.
+#define MAX_BUFFER_INFOS 512
+
 DmaHeapAllocator* DmaHeapAllocator::sInstance(0);
 Mutex DmaHeapAllocator::sLock(Mutex::PRIVATE);
 
@@ -43,6 +47,7 @@ DmaHeapAllocator* DmaHeapAllocator::getInstance() {
 }
 
 DmaHeapAllocator::DmaHeapAllocator() {
+    mDeviceFd = -1;
     mBufferAllocator = CreateDmabufHeapBufferAllocator();
     if (!mBufferAllocator) {
         ALOGE("create CreateDmabufHeapBufferAllocator failed");
@@ -52,6 +57,68 @@ DmaHeapAllocator::DmaHeapAllocator() {
 DmaHeapAllocator::~DmaHeapAllocator() {
     if (mBufferAllocator)
         FreeDmabufHeapBufferAllocator(mBufferAllocator);
+    if (mDeviceFd >= 0)
+        close(mDeviceFd);
+}
+
+int DmaHeapAllocator::getDeviceLocked() {
+    if (mDeviceFd < 0) {
+        mDeviceFd = open("/dev/dmabuf_imx", O_RDONLY | O_CLOEXEC);
+        if (mDeviceFd < 0) {
+            ALOGE("open /dev/dmabuf_imx failed: %s", strerror(errno));
+        }
+    }
+    return mDeviceFd;
+}
+
+int DmaHeapAllocator::getBufferKey(int fd, BufferKey& key) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        ALOGE("%s fstat failed: %s", __func__, strerror(errno));
+        return -EINVAL;
+    }
+    key.dev = st.st_dev;
+    key.ino = st.st_ino;
+    return 0;
+}
+
+DmaHeapAllocator::BufferInfo& DmaHeapAllocator::getBufferInfoLocked(const BufferKey& key) {
+    auto it = mBufferInfos.find(key);
+    if (it != mBufferInfos.end()) {
+        return it->second;
+    }
+
+    if (mBufferInfos.size() >= MAX_BUFFER_INFOS) {
+        mBufferInfos.erase(mBufferOrder.front());
+        mBufferOrder.pop_front();
+    }
+    mBufferOrder.push_back(key);
+    BufferInfo& info = mBufferInfos[key];
+    info.hasPhys = false;
+    info.phys = 0;
+    info.heapType = -1;
+    return info;
+}
+
+void DmaHeapAllocator::releaseBufferInfo(int fd) {
+    if (fd < 0) {
+        return;
+    }
+
+    BufferKey key;
+    if (getBufferKey(fd, key) != 0) {
+        return;
+    }
+
+    Mutex::Autolock _l(mLock);
+    if (mBufferInfos.erase(key) > 0) {
+        for (auto it = mBufferOrder.begin(); it != mBufferOrder.end(); ++it) {
+            if (*it == key) {
+                mBufferOrder.erase(it);
+                break;
+            }
+        }
+    }
 }
 
 int DmaHeapAllocator::allocSystemMemeory(uint64_t size) {
@@ -70,59 +137,106 @@ int DmaHeapAllocator::allocMemory(int size, int align, int flags) {
     // But align parameter can't take effect to ensure alignment.
     size = (size + (PAGE_SIZE << 3)) & (~((PAGE_SIZE << 3) - 1));
     // contiguous memory includes cacheable/non-cacheable.
+    const char* heap = NULL;
     if (flags & MFLAGS_SECURE) {
-        fd = DmabufHeapAlloc(mBufferAllocator, "secure", size, 0, 0);
-        if (fd < 0)
-            ALOGE("%s DmabufHeapAlloc MFLAGS_SECURE failed ", __func__);
+        heap = "secure";
     } else if (flags & MFLAGS_CONTIGUOUS) {
         if (flags & MFLAGS_CACHEABLE)
-            fd = DmabufHeapAlloc(mBufferAllocator, "reserved", size, 0, 0);
+            heap = "reserved";
         else
-            fd = DmabufHeapAlloc(mBufferAllocator, "reserved-uncached", size, 0, 0);
-
-        if (fd < 0)
-            ALOGE("%s DmabufHeapAlloc MFLAGS_CONTIGUOUS failed ", __func__);
+            heap = "reserved-uncached";
     }
     // cacheable memory includes non-contiguous.
     // it will not go into this logic currently, it always allocate continue memory
     else if (flags & MFLAGS_CACHEABLE) {
-        fd = DmabufHeapAlloc(mBufferAllocator, "system", size, 0, 0);
-        if (fd < 0)
-            ALOGE("%s DmabufHeapAlloc MFLAGS_CACHEABLE failed ", __func__);
+        heap = "system";
     } else {
         ALOGE("%s invalid flags:0x%x", __func__, flags);
         return fd;
     }
 
+    fd = mPool.acquire(heap, size);
+    if (fd >= 0) {
+        return fd;
+    }
+
+    fd = DmabufHeapAlloc(mBufferAllocator, heap, size, 0, 0);
+    // idle pooled buffers may hold the memory, free them and retry once.
+    if (fd < 0 && mPool.trim(heap, true)) {
+        fd = DmabufHeapAlloc(mBufferAllocator, heap, size, 0, 0);
+    }
+    if (fd < 0) {
+        ALOGE("%s DmabufHeapAlloc %s failed ", __func__, heap);
+        return fd;
+    }
+    mPool.track(heap, fd, size);
+
     return fd;
 }
 
 int DmaHeapAllocator::getPhys(int fd, int size, uint64_t& addr) {
-    uint64_t phyAddr = -1;
-
     if (fd < 0) {
         ALOGE("%s invalid parameters", __func__);
         return -EINVAL;
     }
 
-    struct dmabuf_imx_phys_data data;
-    int fd_;
-    fd_ = open("/dev/dmabuf_imx", O_RDONLY | O_CLOEXEC);
-    if (fd_ < 0) {
-        ALOGE("open /dev/dmabuf_imx failed: %s", strerror(errno));
+    Mutex::Autolock _l(mLock);
+    return getPhysLocked(fd, addr);
+}
+
+int DmaHeapAllocator::getPhysBatch(const int* fds, const int* sizes, int count, uint64_t* addrs) {
+    if (fds == NULL || sizes == NULL || addrs == NULL || count < 0) {
+        ALOGE("%s invalid parameters", __func__);
+        return -EINVAL;
+    }
+
+    Mutex::Autolock _l(mLock);
+    for (int i = 0; i < count; i++) {
+        if (fds[i] < 0) {
+            ALOGE("%s invalid fd of buffer %d", __func__, i);
+            return -EINVAL;
+        }
+        // planes often share one dmabuf.
+        if (i > 0 && fds[i] == fds[i - 1]) {
+            addrs[i] = addrs[i - 1];
+            continue;
+        }
+        int ret = getPhysLocked(fds[i], addrs[i]);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+int DmaHeapAllocator::getPhysLocked(int fd, uint64_t& addr) {
+    BufferKey key;
+    if (getBufferKey(fd, key) != 0) {
         return -EINVAL;
     }
+
+    BufferInfo& info = getBufferInfoLocked(key);
+    if (info.hasPhys) {
+        addr = info.phys;
+        return 0;
+    }
+
+    int device = getDeviceLocked();
+    if (device < 0) {
+        return -EINVAL;
+    }
+
+    struct dmabuf_imx_phys_data data;
     data.dmafd = fd;
-    if (ioctl(fd_, DMABUF_GET_PHYS, &data) < 0) {
+    if (ioctl(device, DMABUF_GET_PHYS, &data) < 0) {
         ALOGE("%s DMABUF_GET_PHYS  failed", __func__);
-        close(fd_);
         return -EINVAL;
-    } else
-        phyAddr = data.phys;
-
-    close(fd_);
+    }
 
-    addr = phyAddr;
+    info.hasPhys = true;
+    info.phys = data.phys;
+    addr = data.phys;
     return 0;
 }
 
@@ -157,6 +271,37 @@ int DmaHeapAllocator::flushCache(int fd) {
 
     return 0;
 }
+
+int DmaHeapAllocator::syncCpuAccess(int fd, uint64_t flags, bool read, bool write) {
+    if (fd < 0) {
+        ALOGE("%s invalid parameters", __func__);
+        return -EINVAL;
+    }
+
+    struct dma_buf_sync dma_sync;
+    dma_sync.flags = flags;
+    if (read) {
+        dma_sync.flags |= DMA_BUF_SYNC_READ;
+    }
+    if (write) {
+        dma_sync.flags |= DMA_BUF_SYNC_WRITE;
+    }
+    if (ioctl(fd, DMA_BUF_IOCTL_SYNC, &dma_sync) < 0) {
+        ALOGE("%s DMA_BUF_IOCTL_SYNC failed", __func__);
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+int DmaHeapAllocator::beginCpuAccess(int fd, bool read, bool write) {
+    return syncCpuAccess(fd, DMA_BUF_SYNC_START, read, write);
+}
+
+int DmaHeapAllocator::endCpuAccess(int fd, bool read, bool write) {
+    return syncCpuAccess(fd, DMA_BUF_SYNC_END, read, write);
+}
+
 int DmaHeapAllocator::getHeapType(int fd) {
     int type = 0;
     if (fd < 0) {
@@ -164,17 +309,26 @@ int DmaHeapAllocator::getHeapType(int fd) {
         return -EINVAL;
     }
 
-    struct dmabuf_imx_heap_name data;
-    int fd_;
-    fd_ = open("/dev/dmabuf_imx", O_RDONLY | O_CLOEXEC);
-    if (fd_ < 0) {
-        ALOGE("open /dev/dmabuf_imx failed: %s", strerror(errno));
+    BufferKey key;
+    if (getBufferKey(fd, key) != 0) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock _l(mLock);
+    BufferInfo& info = getBufferInfoLocked(key);
+    if (info.heapType >= 0) {
+        return info.heapType;
+    }
+
+    int device = getDeviceLocked();
+    if (device < 0) {
         return -EINVAL;
     }
+
+    struct dmabuf_imx_heap_name data;
     data.dmafd = fd;
-    if (ioctl(fd_, DMABUF_GET_HEAP_NAME, &data) < 0) {
-        ALOGE("%s DMABUF_GET_PHYS  failed", __func__);
-        close(fd_);
+    if (ioctl(device, DMABUF_GET_HEAP_NAME, &data) < 0) {
+        ALOGE("%s DMABUF_GET_HEAP_NAME failed", __func__);
         return -EINVAL;
     }
 
@@ -189,8 +343,7 @@ int DmaHeapAllocator::getHeapType(int fd) {
     else if (!strcmp((char*)data.name, "secure"))
         type = DMA_HEAP_SECURE;
 
-    close(fd_);
-
+    info.heapType = type;
     return type;
 }
 
@@ -18,9 +18,14 @@
 #define _DMA_HEAP_ALLOCATOR_H_
 
 #include <BufferAllocator/BufferAllocatorWrapper.h>
+#include <sys/types.h>
 #include <utils/Mutex.h>
 
+#include <deque>
+#include <unordered_map>
+
 #include "Allocator.h"
+#include "DmaBufPool.h"
 #include "Memory.h"
 
 namespace fsl {
@@ -43,12 +48,52 @@ public:
     // get memory virtual address.
     int getVaddrs(int fd, int size, uint64_t& addr);
     int getHeapType(int fd);
+    // get physical addresses of several buffers with one lock.
+    int getPhysBatch(const int* fds, const int* sizes, int count, uint64_t* addrs);
+    void releaseBufferInfo(int fd);
+    // DMA_BUF_IOCTL_SYNC start/end with the direction of the CPU access.
+    int beginCpuAccess(int fd, bool read, bool write);
+    int endCpuAccess(int fd, bool read, bool write);
 
 private:
     DmaHeapAllocator();
     static DmaHeapAllocator* sInstance;
     BufferAllocator* mBufferAllocator;
     static Mutex sLock;
+    // recycled large buffers, see DmaBufPool.
+    DmaBufPool mPool;
+
+    // dmabuf inode, unique for the lifetime of the buffer whatever fd refers to it.
+    struct BufferKey {
+        dev_t dev;
+        ino_t ino;
+        bool operator==(const BufferKey& other) const {
+            return dev == other.dev && ino == other.ino;
+        }
+    };
+    struct BufferKeyHash {
+        size_t operator()(const BufferKey& key) const {
+            return std::hash<uint64_t>()(((uint64_t)key.dev << 32) ^ (uint64_t)key.ino);
+        }
+    };
+    struct BufferInfo {
+        bool hasPhys;
+        uint64_t phys;
+        int heapType; // -1 when not queried yet.
+    };
+
+    int getBufferKey(int fd, BufferKey& key);
+    BufferInfo& getBufferInfoLocked(const BufferKey& key);
+    int getPhysLocked(int fd, uint64_t& addr);
+    // persistent handle of /dev/dmabuf_imx, opened on first use.
+    int getDeviceLocked();
+    int syncCpuAccess(int fd, uint64_t flags, bool read, bool write);
+
+    Mutex mLock;
+    int mDeviceFd;
+    std::unordered_map<BufferKey, BufferInfo, BufferKeyHash> mBufferInfos;
+    // insertion order, the oldest is dropped when the cache is full.
+    std::deque<BufferKey> mBufferOrder;
 };
 
 } // namespace fsl
@@ -274,7 +274,7 @@ bool FbDisplay::checkOverlay(Layer* layer) {
 }
 
 int FbDisplay::performOverlay() {
-    Layer* layer = mOverlay;
+    Layer* layer = mOverlayNum > 0 ? mOverlays[0] : NULL;
     if (layer == NULL) {
         if (mOvPowerMode == FB_BLANK_UNBLANK) {
             // mOvPowerMode = FB_BLANK_POWERDOWN;
@@ -319,7 +319,7 @@ int FbDisplay::performOverlay() {
         return false;
     }
     layer->releaseFence = (mOvInfo.reserved[3] == 0) ? -1 : mOvInfo.reserved[3];
-    mOverlay = NULL;
+    clearOverlaysLocked();
 
     return true;
 }
@@ -581,7 +581,7 @@ int FbDisplay::openFb() {
         mOvFd = -1;
     }
     mOvPowerMode = -1;
-    mOverlay = NULL;
+    clearOverlaysLocked();
 
     return 0;
 }
@@ -615,6 +615,8 @@ int FbDisplay::closeFb() {
 }
 
 void FbDisplay::prepareTargetsLocked() {
+    // new targets hold no content of previous frames.
+    mDamageTracker.reset();
     if (!mComposer.isValid()) {
         ALOGI("no need to alloc memory");
         return;
@@ -657,6 +659,7 @@ void FbDisplay::prepareTargetsLocked() {
 }
 
 void FbDisplay::releaseTargetsLocked() {
+    mDamageTracker.reset();
     MemoryManager* pManager = MemoryManager::getInstance();
     for (int i = 0; i < MAX_FRAMEBUFFERS; i++) {
         if (mTargets[i] == NULL) {
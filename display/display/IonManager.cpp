@@ -19,10 +19,35 @@
 
 #include <cutils/log.h>
 
+#include <algorithm>
+
 #define ION_DECODED_BUFFER_VPU_ALIGN 8
 
 namespace fsl {
 
+#if defined(__aarch64__)
+// Linux allows EL0 cache maintenance by VA, which works on any byte range of
+// the mapping. DMA_BUF_IOCTL_SYNC is still issued for every lock, the
+// exporter waits for fences and keeps its bookkeeping there, and the lines of
+// the locked rows are maintained here.
+static void syncCacheRange(uintptr_t start, uint64_t size, bool invalidate) {
+    uint64_t ctr;
+    asm volatile("mrs %0, ctr_el0" : "=r"(ctr));
+    // DminLine is log2 of the smallest data cache line in words.
+    uintptr_t line = 4 << ((ctr >> 16) & 0xf);
+    uintptr_t end = start + size;
+
+    for (uintptr_t addr = start & ~(line - 1); addr < end; addr += line) {
+        if (invalidate) {
+            asm volatile("dc civac, %0" : : "r"(addr) : "memory");
+        } else {
+            asm volatile("dc cvac, %0" : : "r"(addr) : "memory");
+        }
+    }
+    asm volatile("dsb sy" : : : "memory");
+}
+#endif
+
 IonManager::IonManager() : mAllocator(NULL) {
     mAllocator = (Allocator*)Allocator::getInstance();
 }
@@ -128,31 +153,225 @@ int IonManager::flushCache(Memory* memory) {
     return mAllocator->flushCache(memory->fd);
 }
 
-int IonManager::lock(Memory* handle, int /*usage*/, int /*l*/, int /*t*/, int /*w*/, int /*h*/,
-                     void** vaddr) {
-    if (handle->base == 0) {
-        getVaddrs(handle);
+void IonManager::getLockRegion(Memory* handle, int usage, int t, int h, LockRegion& region) {
+    region.read = (usage & USAGE_SW_READ_OFTEN) != 0;
+    region.write = (usage & USAGE_SW_WRITE_OFTEN) != 0;
+    if (!region.read && !region.write) {
+        region.read = true;
+        region.write = true;
     }
-    *vaddr = (void*)handle->base;
+    region.locks = 1;
+    region.partial = false;
+    region.count = 1;
+    region.offsets[0] = 0;
+    region.sizes[0] = handle->size;
+
+#if GRALLOC_VERSION == 4
+    // plane layout is only known for buffers allocated by gralloc.
+    uint32_t planes = handle->num_planes;
+    if (planes == 0 || planes > DRV_MAX_PLANES || handle->height <= 0 || t < 0 || h <= 0 ||
+        (t == 0 && h >= handle->height)) {
+        return;
+    }
+
+    // cache maintenance is done on whole rows, columns of the rectangle are
+    // not tracked. Chroma planes have fewer rows, scale by the plane height.
+    uint64_t height = handle->height;
+    uint64_t top = std::min<uint64_t>(t, height);
+    uint64_t bottom = std::min<uint64_t>((uint64_t)t + h, height);
+    LockRegion partial = region;
+    for (uint32_t p = 0; p < planes; p++) {
+        uint64_t stride = handle->strides[p];
+        if (stride == 0) {
+            return;
+        }
+        uint64_t rows = handle->sizes[p] / stride;
+        uint64_t first = top * rows / height;
+        uint64_t last = (bottom * rows + height - 1) / height;
+        partial.offsets[p] = handle->offsets[p] + first * stride;
+        partial.sizes[p] = (last - first) * stride;
+        if (partial.offsets[p] + partial.sizes[p] > (uint64_t)handle->size) {
+            return;
+        }
+    }
+
+    partial.partial = true;
+    partial.count = planes;
+    region = partial;
+#else
+    (void)t;
+    (void)h;
+#endif
+}
+
+int IonManager::beginCpuAccess(Memory* handle, const LockRegion& region, bool read, bool write) {
+    if (!(handle->flags & FLAGS_CPU)) {
+        return 0;
+    }
+
+    // the exporter is always told, it waits for fences and tracks CPU access.
+    int ret = mAllocator->beginCpuAccess(handle->fd, read, write);
+    if (ret != 0) {
+        return ret;
+    }
+
+#if defined(__aarch64__)
+    if (region.partial && handle->base != 0) {
+        // device writes may be behind stale lines, only reads need them gone.
+        if (read) {
+            for (uint32_t i = 0; i < region.count; i++) {
+                syncCacheRange(handle->base + region.offsets[i], region.sizes[i], true);
+            }
+        }
+    }
+#endif
 
     return 0;
 }
 
-int IonManager::lockYCbCr(Memory* handle, int /*usage*/, int /*l*/, int /*t*/, int /*w*/, int /*h*/,
-                          android_ycbcr* /*ycbcr*/) {
+int IonManager::endCpuAccess(Memory* handle, const LockRegion& region, bool read, bool write) {
+    if (!(handle->flags & FLAGS_CPU)) {
+        return 0;
+    }
+
+#if defined(__aarch64__)
+    if (region.partial && handle->base != 0) {
+        if (write) {
+            for (uint32_t i = 0; i < region.count; i++) {
+                syncCacheRange(handle->base + region.offsets[i], region.sizes[i], false);
+            }
+        }
+    }
+#endif
+
+    return mAllocator->endCpuAccess(handle->fd, read, write);
+}
+
+int IonManager::lockRegion(Memory* handle, int usage, int t, int h) {
     if (handle->base == 0) {
         getVaddrs(handle);
     }
 
+    LockRegion region;
+    getLockRegion(handle, usage, t, h, region);
+    int ret = beginCpuAccess(handle, region, region.read, region.write);
+    if (ret != 0) {
+        return ret;
+    }
+
+    Mutex::Autolock _l(mLock);
+    auto it = mLockRegions.find(handle);
+    if (it == mLockRegions.end()) {
+        mLockRegions[handle] = region;
+    } else {
+        mergeLockRegion(it->second, region);
+    }
     return 0;
 }
 
-int IonManager::unlock(Memory* handle) {
-    if (handle->flags & FLAGS_CPU) {
-        flushCache(handle);
+void IonManager::mergeLockRegion(LockRegion& held, const LockRegion& region) {
+    held.locks++;
+    held.read = held.read || region.read;
+    held.write = held.write || region.write;
+    if (!held.partial) {
+        return;
+    }
+    if (!region.partial || region.count != held.count) {
+        // whole buffer is synced on the last unlock.
+        held.partial = false;
+        return;
+    }
+
+    for (uint32_t i = 0; i < held.count; i++) {
+        uint64_t start = std::min(held.offsets[i], region.offsets[i]);
+        uint64_t end = std::max(held.offsets[i] + held.sizes[i],
+                                region.offsets[i] + region.sizes[i]);
+        held.offsets[i] = start;
+        held.sizes[i] = end - start;
+    }
+}
+
+int IonManager::lock(Memory* handle, int usage, int /*l*/, int t, int /*w*/, int h, void** vaddr) {
+    int ret = lockRegion(handle, usage, t, h);
+    if (ret != 0) {
+        return ret;
     }
+    *vaddr = (void*)handle->base;
 
     return 0;
 }
 
+int IonManager::lockYCbCr(Memory* handle, int usage, int /*l*/, int t, int /*w*/, int h,
+                          android_ycbcr* /*ycbcr*/) {
+    return lockRegion(handle, usage, t, h);
+}
+
+int IonManager::unlock(Memory* handle) {
+    LockRegion region;
+    {
+        Mutex::Autolock _l(mLock);
+        auto it = mLockRegions.find(handle);
+        if (it == mLockRegions.end()) {
+            // not locked through IonManager, flush the whole buffer.
+            if (handle->flags & FLAGS_CPU) {
+                flushCache(handle);
+            }
+            return 0;
+        }
+        // other locks still hold the buffer, sync it with the last one.
+        if (--it->second.locks > 0) {
+            return 0;
+        }
+        region = it->second;
+        mLockRegions.erase(it);
+    }
+
+    return endCpuAccess(handle, region, region.read, region.write);
+}
+
+int IonManager::flush(Memory* handle) {
+    LockRegion region;
+    {
+        Mutex::Autolock _l(mLock);
+        auto it = mLockRegions.find(handle);
+        if (it == mLockRegions.end()) {
+            if (handle->flags & FLAGS_CPU) {
+                flushCache(handle);
+            }
+            return 0;
+        }
+        region = it->second;
+    }
+
+    if (!region.write) {
+        return 0;
+    }
+    return endCpuAccess(handle, region, false, true);
+}
+
+int IonManager::invalidate(Memory* handle) {
+    LockRegion region;
+    {
+        Mutex::Autolock _l(mLock);
+        auto it = mLockRegions.find(handle);
+        if (it == mLockRegions.end()) {
+            if (handle->flags & FLAGS_CPU) {
+                return mAllocator->beginCpuAccess(handle->fd, true, false);
+            }
+            return 0;
+        }
+        region = it->second;
+    }
+
+    if (!region.read) {
+        return 0;
+    }
+    return beginCpuAccess(handle, region, true, false);
+}
+
+void IonManager::releaseLock(Memory* handle) {
+    Mutex::Autolock _l(mLock);
+    mLockRegions.erase(handle);
+}
+
 } // namespace fsl
@@ -19,6 +19,9 @@
 #define _FSL_ION_MANAGER_H_
 
 #include <hardware/gralloc.h>
+#include <utils/Mutex.h>
+
+#include <unordered_map>
 
 #include "Allocator.h"
 #include "Memory.h"
@@ -41,9 +44,37 @@ public:
     int lock(Memory* handle, int usage, int l, int t, int w, int h, void** vaddr);
     int lockYCbCr(Memory* handle, int usage, int l, int t, int w, int h, android_ycbcr* ycbcr);
     int unlock(Memory* handle);
+    // make CPU writes to the locked region visible to devices.
+    int flush(Memory* handle);
+    // discard stale CPU cache lines of the locked region.
+    int invalidate(Memory* handle);
+    // forget the lock state, called before the handle is freed.
+    void releaseLock(Memory* handle);
 
 private:
+    // byte ranges covered by the locked rectangle, one per plane. A buffer
+    // locked again before unlock covers the union of the locks.
+    struct LockRegion {
+        // locks not unlocked yet.
+        uint32_t locks;
+        bool read;
+        bool write;
+        // false when the region covers the whole buffer.
+        bool partial;
+        uint32_t count;
+        uint64_t offsets[DRV_MAX_PLANES];
+        uint64_t sizes[DRV_MAX_PLANES];
+    };
+
+    void getLockRegion(Memory* handle, int usage, int t, int h, LockRegion& region);
+    int beginCpuAccess(Memory* handle, const LockRegion& region, bool read, bool write);
+    int endCpuAccess(Memory* handle, const LockRegion& region, bool read, bool write);
+    int lockRegion(Memory* handle, int usage, int t, int h);
+    static void mergeLockRegion(LockRegion& held, const LockRegion& region);
+
     Allocator* mAllocator;
+    Mutex mLock;
+    std::unordered_map<Memory*, LockRegion> mLockRegions;
 };
 
 } // namespace fsl
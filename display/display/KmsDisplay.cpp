@@ -28,6 +28,8 @@
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 
+#include <algorithm>
+
 #include "Memory.h"
 #include "MemoryManager.h"
 
@@ -111,6 +113,7 @@ KmsDisplay::KmsDisplay() {
     mConnectorID = 0;
     mKmsPlaneNum = 1;
     memset(mKmsPlanes, 0, sizeof(mKmsPlanes));
+    mOverlayPlaneMask = 0;
     memset(&mMode, 0, sizeof(mMode));
     mDrmModes.clear();
     ;
@@ -156,6 +159,11 @@ KmsDisplay::KmsDisplay() {
         mHDCPEnable = false;
     }
     mDummylayer = NULL;
+
+    mLastCommitTime = 0;
+    memset(prop, 0, PROPERTY_VALUE_MAX);
+    property_get("vendor.hwc.present.offset_us", prop, "0");
+    mPresentOffset = us2ns(atoi(prop));
 }
 
 KmsDisplay::~KmsDisplay() {
@@ -316,6 +324,89 @@ void KmsPlane::getPropertyIds() {
                                  mDrmFd);
 }
 
+/*
+ * Read plane zorder and the format/modifier pairs it can scan out.
+ */
+void KmsPlane::getCapabilities() {
+    zpos = 0;
+    formatNum = 0;
+    modifierNum = 0;
+
+    drmModePlanePtr pPlane = drmModeGetPlane(mDrmFd, mPlaneID);
+    if (pPlane == NULL) {
+        ALOGE("drmModeGetPlane failed for plane %u", mPlaneID);
+        return;
+    }
+    for (uint32_t i = 0; i < pPlane->count_formats && formatNum < KMS_PLANE_MAX_FORMATS; i++) {
+        formats[formatNum++] = pPlane->formats[i];
+    }
+    drmModeFreePlane(pPlane);
+
+    KmsDisplay::getPropertyValue(mPlaneID, DRM_MODE_OBJECT_PLANE, "zpos", NULL, &zpos, mDrmFd);
+
+    uint64_t blobId = 0;
+    KmsDisplay::getPropertyValue(mPlaneID, DRM_MODE_OBJECT_PLANE, "IN_FORMATS", NULL, &blobId,
+                                 mDrmFd);
+    if (blobId == 0) {
+        return;
+    }
+
+    drmModePropertyBlobPtr blob = drmModeGetPropertyBlob(mDrmFd, blobId);
+    if (blob == NULL) {
+        return;
+    }
+
+    struct drm_format_modifier_blob *header = (struct drm_format_modifier_blob *)blob->data;
+    uint32_t *blobFormats = (uint32_t *)((char *)header + header->formats_offset);
+    struct drm_format_modifier *blobModifiers =
+            (struct drm_format_modifier *)((char *)header + header->modifiers_offset);
+    // modifier bitmask indexes formats of IN_FORMATS blob.
+    formatNum = 0;
+    for (uint32_t i = 0; i < header->count_formats && formatNum < KMS_PLANE_MAX_FORMATS; i++) {
+        formats[formatNum++] = blobFormats[i];
+    }
+    for (uint32_t i = 0; i < header->count_modifiers && modifierNum < KMS_PLANE_MAX_MODIFIERS;
+         i++) {
+        modifiers[modifierNum].formats = blobModifiers[i].formats;
+        modifiers[modifierNum].offset = blobModifiers[i].offset;
+        modifiers[modifierNum].modifier = blobModifiers[i].modifier;
+        modifierNum++;
+    }
+    drmModeFreePropertyBlob(blob);
+}
+
+bool KmsPlane::supportFormat(uint32_t format, uint64_t modifier) const {
+    // old driver doesn't report format, trust it as before.
+    if (formatNum == 0) {
+        return true;
+    }
+
+    uint32_t index = 0;
+    while (index < formatNum && formats[index] != format) {
+        index++;
+    }
+    if (index >= formatNum) {
+        return false;
+    }
+
+    if (modifierNum == 0 || modifier == DRM_FORMAT_MOD_LINEAR) {
+        // no IN_FORMATS reported, the driver checks modifier on commit.
+        return true;
+    }
+
+    for (uint32_t i = 0; i < modifierNum; i++) {
+        if (modifiers[i].modifier != modifier || index < modifiers[i].offset ||
+            index >= modifiers[i].offset + 64) {
+            continue;
+        }
+        if (modifiers[i].formats & (1ULL << (index - modifiers[i].offset))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 /*
  * Find the property IDs in group with type.
  */
@@ -397,6 +488,11 @@ void KmsPlane::connectCrtc(drmModeAtomicReqPtr pset, uint32_t crtc, uint32_t fb)
     drmModeAtomicAddProperty(pset, mPlaneID, crtc_id, crtc);
 }
 
+void KmsPlane::disconnectCrtc(drmModeAtomicReqPtr pset) {
+    drmModeAtomicAddProperty(pset, mPlaneID, fb_id, 0);
+    drmModeAtomicAddProperty(pset, mPlaneID, crtc_id, 0);
+}
+
 void KmsPlane::setAlpha(drmModeAtomicReqPtr pset, uint32_t alpha) {
     /*
      * Specify the alpha of source surface to display.
@@ -619,75 +715,110 @@ bool KmsDisplay::veritySourceSize(Layer *layer) {
     return srcW >= 16 && srcH >= 8;
 }
 
-int KmsDisplay::performOverlay() {
-    Layer *layer = NULL;
-    uint8_t gloable_stride = 1;
-    int overlay_plane_index = mKmsPlaneNum - 1;
-    if (mUseOverlayAndroidUI && mSecureDisplay) {
-        layer = mDummylayer;
-        gloable_stride = 4;
-        overlay_plane_index = 0;
-    } else {
-        layer = mOverlay;
+bool KmsDisplay::verityScale(Layer *layer) {
+    // the same display frame setOverlayPlane programs.
+    Rect *rect = &layer->displayFrame;
+    int w = rect->right - rect->left;
+    int h = rect->bottom - rect->top;
+    if (!mSecureDisplay && (mCustomizeUI == UI_SCALE_NONE)) {
+        const DisplayConfig &config = mConfigs[mActiveConfig];
+        w = w * mMode.hdisplay / config.mXres;
+        h = h * mMode.vdisplay / config.mYres;
     }
-    if (layer == NULL || layer->handle == NULL) {
-#ifdef HAVE_UNMAPPED_HEAP
-        if (mHDCPMode && mHDCPEnable) {
-            mHDCPDisableCnt++;
-            if (mHDCPDisableCnt > 10) { // no overlay for more than 10 frames, disable HDCP
-                ALOGI("Disable HDCP");
-                int err = drmModeConnectorSetProperty(mDrmFd, mConnectorID,
-                                                      mConnector.protection_id, 0);
-                if (err != 0) {
-                    ALOGE("failed to set HDCP property:0");
-                }
-                mModeset = true;
-                mHDCPMode = false;
-                mHDCPDisableCnt = 0;
-            }
-        }
-#endif
-        return 0;
+    int srcW = layer->sourceCrop.right - layer->sourceCrop.left;
+    int srcH = layer->sourceCrop.bottom - layer->sourceCrop.top;
+    if (w <= 0 || h <= 0 || srcW <= 0 || srcH <= 0) {
+        return false;
     }
 
-    // it is only used for 8mq platform.
-    if (!veritySourceSize(layer)) {
-        Rect *rect = &layer->sourceCrop;
-        int srcW = rect->right - rect->left;
-        int srcH = rect->bottom - rect->top;
-        int format = layer->handle->fslFormat;
-        ALOGW("no support source size: w:%d, h:%d, f:0x%x", srcW, srcH, format);
-        return 0;
-    }
+    return w <= srcW * KMS_PLANE_MAX_UPSCALE && h <= srcH * KMS_PLANE_MAX_UPSCALE &&
+            srcW <= w * KMS_PLANE_MAX_DOWNSCALE && srcH <= h * KMS_PLANE_MAX_DOWNSCALE;
+}
 
-    if (!mPset) {
-        mPset = drmModeAtomicAlloc();
-        if (!mPset) {
-            ALOGE("Failed to allocate property set");
-            return -ENOMEM;
-        }
+static uint64_t getDrmModifier(int fslFormat) {
+    switch (fslFormat) {
+        case FORMAT_NV12_TILED:
+            return DRM_FORMAT_MOD_AMPHION_TILED;
+        case FORMAT_NV12_G1_TILED:
+        case FORMAT_P010_TILED:
+            return DRM_FORMAT_MOD_VSI_G1_TILED;
+        case FORMAT_NV12_G2_TILED:
+            return DRM_FORMAT_MOD_VSI_G2_TILED;
+        case FORMAT_NV12_G2_TILED_COMPRESSED:
+        case FORMAT_P010_TILED_COMPRESSED:
+            return DRM_FORMAT_MOD_VSI_G2_TILED_COMPRESSED;
+        default:
+            return DRM_FORMAT_MOD_LINEAR;
     }
+}
 
-#ifdef HAVE_UNMAPPED_HEAP
-    if (mHDCPEnable) {
-        bool enable = false;
-        Memory *ov_hnd = layer->handle;
-        if ((ov_hnd->usage & USAGE_PROTECTED) && (mConnector.protection_id > 0)) {
-            enable = true;
+static bool hasHdrMetaData(const hdr_output_metadata &metadata) {
+    hdr_output_metadata empty;
+    memset(&empty, 0, sizeof(empty));
+    return memcmp(&empty, &metadata, sizeof(hdr_output_metadata)) != 0;
+}
+
+size_t KmsDisplay::assignOverlays(Layer **candidates, size_t count) {
+    // it is only used for 8mq platform.
+    // drop the layers no overlay plane can show before ranking them, so a
+    // layer that does not fit never takes the place of one that does.
+    Layer **end = std::stable_partition(candidates, candidates + count, [this](Layer *layer) {
+        if (!veritySourceSize(layer))
+            return false;
+        if (!verityScale(layer)) {
+            ALOGV("overlay planes can't scale layer %d", layer->zorder);
+            layer->planeIndex = -1;
+            return false;
         }
-        if (mHDCPMode != enable) {
-            ALOGI("%s HDCP feature", enable ? "Enable" : "Disable");
-            int val = enable ? 1 : 0;
-            int err = drmModeConnectorSetProperty(mDrmFd, mConnectorID, mConnector.protection_id,
-                                                  val);
-            if (err != 0) {
-                ALOGE("failed to set HDCP property:%d", val);
-            }
-            mModeset = true;
-            mHDCPMode = enable;
+        uint32_t format = convertFormatToDrm(layer->handle->fslFormat);
+        uint64_t modifier = getDrmModifier(layer->handle->fslFormat);
+        for (uint32_t plane = 1; plane < mKmsPlaneNum; plane++) {
+            if (mKmsPlanes[plane].supportFormat(format, modifier))
+                return true;
+        }
+        ALOGV("no overlay plane for format 0x%x modifier 0x%" PRIx64, format, modifier);
+        layer->planeIndex = -1;
+        return false;
+    });
+    size_t num = end - candidates;
+    size_t planeNum = mKmsPlaneNum - 1;
+    if (num > planeNum) {
+        // keep the most valuable layers when planes are not enough.
+        std::stable_sort(candidates, end, overlayPriorityHigher);
+        std::stable_sort(candidates, candidates + planeNum,
+                         [](const Layer *lhs, const Layer *rhs) {
+                             return lhs->zorder < rhs->zorder;
+                         });
+        num = planeNum;
+    }
+
+    // overlay planes are sorted by zpos, so assign them to layers
+    // from bottom to top and always take the lowest matched plane.
+    size_t kept = 0;
+    uint32_t next = 1;
+    for (size_t i = 0; i < num; i++) {
+        Layer *layer = candidates[i];
+        uint32_t format = convertFormatToDrm(layer->handle->fslFormat);
+        uint64_t modifier = getDrmModifier(layer->handle->fslFormat);
+        uint32_t plane = next;
+        while (plane < mKmsPlaneNum && !mKmsPlanes[plane].supportFormat(format, modifier)) {
+            plane++;
         }
+        if (plane >= mKmsPlaneNum) {
+            ALOGV("no overlay plane for format 0x%x modifier 0x%" PRIx64, format, modifier);
+            layer->planeIndex = -1;
+            continue;
+        }
+
+        layer->planeIndex = plane;
+        next = plane + 1;
+        std::swap(candidates[kept++], candidates[i]);
     }
-#endif
+
+    return kept;
+}
+
+int KmsDisplay::setOverlayPlane(Layer *layer, KmsPlane &plane, uint8_t gloable_stride) {
     Memory *buffer = layer->handle;
     const DisplayConfig &config = mConfigs[mActiveConfig];
     if (buffer->fbId == 0) {
@@ -698,20 +829,10 @@ int KmsDisplay::performOverlay() {
         uint32_t offsets[4] = {0};
         uint64_t modifiers[4] = {0};
 
-        if (buffer->fslFormat == FORMAT_NV12_TILED) {
-            modifiers[0] = DRM_FORMAT_MOD_AMPHION_TILED;
-            modifiers[1] = DRM_FORMAT_MOD_AMPHION_TILED;
-        } else if (buffer->fslFormat == FORMAT_NV12_G1_TILED ||
-                   buffer->fslFormat == FORMAT_P010_TILED) {
-            modifiers[0] = DRM_FORMAT_MOD_VSI_G1_TILED;
-            modifiers[1] = DRM_FORMAT_MOD_VSI_G1_TILED;
-        } else if (buffer->fslFormat == FORMAT_NV12_G2_TILED) {
-            modifiers[0] = DRM_FORMAT_MOD_VSI_G2_TILED;
-            modifiers[1] = DRM_FORMAT_MOD_VSI_G2_TILED;
-        } else if (buffer->fslFormat == FORMAT_NV12_G2_TILED_COMPRESSED ||
-                   buffer->fslFormat == FORMAT_P010_TILED_COMPRESSED) {
-            modifiers[0] = DRM_FORMAT_MOD_VSI_G2_TILED_COMPRESSED;
-            modifiers[1] = DRM_FORMAT_MOD_VSI_G2_TILED_COMPRESSED;
+        uint64_t modifier = getDrmModifier(buffer->fslFormat);
+        if (modifier != DRM_FORMAT_MOD_LINEAR) {
+            modifiers[0] = modifier;
+            modifiers[1] = modifier;
         }
         drmPrimeFDToHandle(mDrmFd, buffer->fd, (uint32_t *)&buffer->fbHandle);
         if (mSecureDisplay) {
@@ -726,11 +847,7 @@ int KmsDisplay::performOverlay() {
             bo_handles[0] = buffer->fbHandle;
             bo_handles[1] = buffer->fbHandle;
         }
-        if (buffer->fslFormat == FORMAT_NV12_TILED || buffer->fslFormat == FORMAT_NV12_G1_TILED ||
-            buffer->fslFormat == FORMAT_NV12_G2_TILED ||
-            buffer->fslFormat == FORMAT_NV12_G2_TILED_COMPRESSED ||
-            buffer->fslFormat == FORMAT_P010_TILED ||
-            buffer->fslFormat == FORMAT_P010_TILED_COMPRESSED) {
+        if (modifier != DRM_FORMAT_MOD_LINEAR) {
             drmModeAddFB2WithModifiers(mDrmFd, buffer->width, buffer->height, format, bo_handles,
                                        pitches, offsets, modifiers, (uint32_t *)&buffer->fbId,
                                        DRM_MODE_FB_MODIFIERS);
@@ -743,29 +860,16 @@ int KmsDisplay::performOverlay() {
 
     if (buffer->fbId == 0) {
         ALOGE("%s invalid fbid", __func__);
-        mOverlay->isOverlay = false;
-        mOverlay = NULL;
-        return 0;
+        return -EINVAL;
     }
     if (!mSecureDisplay) {
-        bindOutFence(mPset);
-        if (memcmp(&mLastHdrMetaData, &layer->hdrMetadata, sizeof(hdr_output_metadata))) {
-            // Only pass HDR metadata and flag on HDR supported display.
-            if (mEdid != NULL && mEdid->isHdrSupported()) {
-                setHdrMetaData(mPset, layer->hdrMetadata);
-                layer->isHdrMode = true;
-                mLastHdrMetaData = layer->hdrMetadata;
-            }
-        }
         MetaData *meta = MemoryManager::getInstance()->getMetaData(buffer);
         if (meta != NULL && meta->mFlags & FLAGS_COMPRESSED_OFFSET) {
-            mKmsPlanes[overlay_plane_index].setTableOffset(mPset, meta);
+            plane.setTableOffset(mPset, meta);
             meta->mFlags &= ~FLAGS_COMPRESSED_OFFSET;
         }
-    } else {
-        bindOutFence(mPset);
     }
-    mKmsPlanes[overlay_plane_index].connectCrtc(mPset, mCrtcID, buffer->fbId);
+    plane.connectCrtc(mPset, mCrtcID, buffer->fbId);
 
     Rect *rect = &layer->displayFrame;
     int x = rect->left * mMode.hdisplay / config.mXres;
@@ -774,15 +878,13 @@ int KmsDisplay::performOverlay() {
     int h = (rect->bottom - rect->top) * mMode.vdisplay / config.mYres;
     if (!mSecureDisplay && (mCustomizeUI == UI_SCALE_NONE)) {
 #if defined(WORKAROUND_DOWNSCALE_LIMITATION) || defined(WORKAROUND_DOWNSCALE_LIMITATION_DCSS)
-        mKmsPlanes[overlay_plane_index].setDisplayFrame(mPset, x, y, ALIGN_PIXEL_2(w - 1),
-                                                        ALIGN_PIXEL_2(h - 1));
+        plane.setDisplayFrame(mPset, x, y, ALIGN_PIXEL_2(w - 1), ALIGN_PIXEL_2(h - 1));
 #else
-        mKmsPlanes[overlay_plane_index].setDisplayFrame(mPset, x, y, w, h);
+        plane.setDisplayFrame(mPset, x, y, w, h);
 #endif
     } else {
-        mKmsPlanes[overlay_plane_index].setDisplayFrame(mPset, rect->left, rect->top,
-                                                        rect->right - rect->left,
-                                                        rect->bottom - rect->top);
+        plane.setDisplayFrame(mPset, rect->left, rect->top, rect->right - rect->left,
+                              rect->bottom - rect->top);
     }
     rect = &layer->sourceCrop;
     if (!mSecureDisplay) {
@@ -793,24 +895,168 @@ int KmsDisplay::performOverlay() {
             w = srcW;
         if (srcH < h)
             h = srcH;
-        mKmsPlanes[overlay_plane_index].setSourceSurface(mPset, 0, 0, ALIGN_PIXEL_2(w - 1),
-                                                         ALIGN_PIXEL_2(h - 1));
+        plane.setSourceSurface(mPset, 0, 0, ALIGN_PIXEL_2(w - 1), ALIGN_PIXEL_2(h - 1));
 #elif defined(WORKAROUND_DOWNSCALE_LIMITATION_DCSS)
-        mKmsPlanes[overlay_plane_index].setSourceSurface(mPset, rect->left, rect->top,
-                                                         ALIGN_PIXEL_2(rect->right - rect->left -
-                                                                       1),
-                                                         ALIGN_PIXEL_2(rect->bottom - rect->top -
-                                                                       1));
+        plane.setSourceSurface(mPset, rect->left, rect->top,
+                               ALIGN_PIXEL_2(rect->right - rect->left - 1),
+                               ALIGN_PIXEL_2(rect->bottom - rect->top - 1));
 #else
-        mKmsPlanes[overlay_plane_index].setSourceSurface(mPset, rect->left, rect->top,
-                                                         rect->right - rect->left,
-                                                         rect->bottom - rect->top);
+        plane.setSourceSurface(mPset, rect->left, rect->top, rect->right - rect->left,
+                               rect->bottom - rect->top);
 #endif
     } else {
-        mKmsPlanes[overlay_plane_index].setSourceSurface(mPset, rect->left, rect->top,
-                                                         rect->right - rect->left,
-                                                         rect->bottom - rect->top);
+        plane.setSourceSurface(mPset, rect->left, rect->top, rect->right - rect->left,
+                               rect->bottom - rect->top);
     }
+    return 0;
+}
+
+int KmsDisplay::performOverlay() {
+    Layer *layers[MAX_OVERLAY_PLANES];
+    uint32_t planes[MAX_OVERLAY_PLANES];
+    size_t num = 0;
+    uint8_t gloable_stride = 1;
+    bool dummyOverlay = mUseOverlayAndroidUI && mSecureDisplay;
+    if (dummyOverlay) {
+        if (mDummylayer != NULL && mDummylayer->handle != NULL) {
+            layers[num] = mDummylayer;
+            planes[num++] = 0;
+        }
+        gloable_stride = 4;
+    } else {
+        for (size_t i = 0; i < mOverlayNum; i++) {
+            if (mOverlays[i]->handle == NULL || mOverlays[i]->planeIndex <= 0 ||
+                mOverlays[i]->planeIndex >= (int)mKmsPlaneNum) {
+                continue;
+            }
+            layers[num] = mOverlays[i];
+            planes[num++] = mOverlays[i]->planeIndex;
+        }
+    }
+
+    // overlay planes used by last frame but not by this one, in every mode,
+    // so planes left from before a secure display are detached too.
+    uint32_t planeMask = 0;
+    for (size_t i = 0; i < num; i++) {
+        if (planes[i] > 0) {
+            planeMask |= 1 << planes[i];
+        }
+    }
+    uint32_t unusedMask = mOverlayPlaneMask & ~planeMask;
+
+    if (num == 0) {
+#ifdef HAVE_UNMAPPED_HEAP
+        if (mHDCPMode && mHDCPEnable) {
+            mHDCPDisableCnt++;
+            if (mHDCPDisableCnt > 10) { // no overlay for more than 10 frames, disable HDCP
+                ALOGI("Disable HDCP");
+                int err = drmModeConnectorSetProperty(mDrmFd, mConnectorID,
+                                                      mConnector.protection_id, 0);
+                if (err != 0) {
+                    ALOGE("failed to set HDCP property:0");
+                }
+                mModeset = true;
+                mHDCPMode = false;
+                mHDCPDisableCnt = 0;
+            }
+        }
+#endif
+        if (unusedMask == 0) {
+            return 0;
+        }
+    }
+
+    if (!mPset) {
+        mPset = drmModeAtomicAlloc();
+        if (!mPset) {
+            ALOGE("Failed to allocate property set");
+            return -ENOMEM;
+        }
+    }
+
+#ifdef HAVE_UNMAPPED_HEAP
+    if (mHDCPEnable && num > 0) {
+        bool enable = false;
+        for (size_t i = 0; i < num; i++) {
+            Memory *ov_hnd = layers[i]->handle;
+            if ((ov_hnd->usage & USAGE_PROTECTED) && (mConnector.protection_id > 0)) {
+                enable = true;
+            }
+        }
+        if (mHDCPMode != enable) {
+            ALOGI("%s HDCP feature", enable ? "Enable" : "Disable");
+            int val = enable ? 1 : 0;
+            int err = drmModeConnectorSetProperty(mDrmFd, mConnectorID, mConnector.protection_id,
+                                                  val);
+            if (err != 0) {
+                ALOGE("failed to set HDCP property:%d", val);
+            }
+            mModeset = true;
+            mHDCPMode = enable;
+        }
+    }
+#endif
+
+    for (uint32_t i = 1; i < mKmsPlaneNum; i++) {
+        if (unusedMask & (1 << i)) {
+            mKmsPlanes[i].disconnectCrtc(mPset);
+        }
+    }
+
+    // only one HDR metadata per connector, take it from the bottom HDR layer.
+    Layer *hdrLayer = num > 0 ? layers[0] : NULL;
+    for (size_t i = 0; i < num; i++) {
+        if (hasHdrMetaData(layers[i]->hdrMetadata)) {
+            hdrLayer = layers[i];
+            break;
+        }
+    }
+
+    size_t valid = 0;
+    for (size_t i = 0; i < num; i++) {
+        Layer *layer = layers[i];
+        if (setOverlayPlane(layer, mKmsPlanes[planes[i]], gloable_stride) != 0) {
+            // don't leave the plane with last frame.
+            if (planes[i] > 0) {
+                mKmsPlanes[planes[i]].disconnectCrtc(mPset);
+                planeMask &= ~(1 << planes[i]);
+            }
+            layer->isOverlay = false;
+            layer->planeIndex = -1;
+            continue;
+        }
+
+        if (!mSecureDisplay && layer == hdrLayer &&
+            memcmp(&mLastHdrMetaData, &layer->hdrMetadata, sizeof(hdr_output_metadata))) {
+            // Only pass HDR metadata and flag on HDR supported display.
+            if (mEdid != NULL && mEdid->isHdrSupported()) {
+                setHdrMetaData(mPset, layer->hdrMetadata);
+                layer->isHdrMode = true;
+                mLastHdrMetaData = layer->hdrMetadata;
+            }
+        }
+        valid++;
+    }
+    mOverlayPlaneMask = planeMask;
+
+    if (!dummyOverlay) {
+        // drop overlays failed to program, they get no release fence.
+        size_t kept = 0;
+        for (size_t i = 0; i < mOverlayNum; i++) {
+            if (mOverlays[i]->isOverlay) {
+                mOverlays[kept++] = mOverlays[i];
+            }
+        }
+        for (size_t i = kept; i < mOverlayNum; i++) {
+            mOverlays[i] = NULL;
+        }
+        mOverlayNum = kept;
+    }
+
+    if (valid > 0) {
+        bindOutFence(mPset);
+    }
+
     return true;
 }
 
@@ -994,8 +1240,8 @@ int KmsDisplay::updateScreen() {
 #ifdef DEBUG_DUMP_FRAME
 #ifdef DEBUG_DUMP_OVERLAY
     Memory *hnd;
-    if (mOverlay)
-        hnd = mOverlay->handle;
+    if (mOverlayNum > 0)
+        hnd = mOverlays[0]->handle;
     else
         hnd = buffer;
 #else
@@ -1038,6 +1284,24 @@ int KmsDisplay::updateScreen() {
         mKmsPlanes[primary_plane_index].setClientFence(mPset, mAcquireFence);
     }
 
+    if (mPresentOffset > 0 && !mModeset) {
+        // hold the commit until shortly before the vblank it targets, so the
+        // content is as fresh as possible without missing the vblank.
+        nsecs_t now = systemTime(CLOCK_MONOTONIC);
+        if (mVsyncPredictor.isModelValid(now)) {
+            nsecs_t commitTime = mVsyncPredictor.nextVsyncTime(now) - mPresentOffset;
+            if (commitTime > now) {
+                struct timespec spec;
+                spec.tv_sec = commitTime / 1000000000;
+                spec.tv_nsec = commitTime % 1000000000;
+                int err;
+                do {
+                    err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, NULL);
+                } while (err == EINTR);
+            }
+        }
+    }
+
 #ifdef DEBUG_DUMP_REFRESH_RATE
     nsecs_t commit_time;
     nsecs_t commit_start;
@@ -1091,19 +1355,22 @@ int KmsDisplay::updateScreen() {
         break;
     }
 
-    if (mOverlay != NULL) {
-        if (mCrtc.fence_ptr != 0) {
-            mOverlay->releaseFence = mOutFence;
-        } else {
-            mOverlay->releaseFence = dup(mPresentFence);
-        }
-        if (mOverlay->releaseFence == -1) {
+    mLastCommitTime = systemTime(CLOCK_MONOTONIC);
+
+    // all overlay planes are released by the same commit.
+    for (size_t i = 0; i < mOverlayNum; i++) {
+        Layer *overlay = mOverlays[i];
+        int fence = (mCrtc.fence_ptr != 0) ? mOutFence : mPresentFence;
+        overlay->releaseFence = (fence != -1) ? dup(fence) : -1;
+        if (overlay->releaseFence == -1) {
             ALOGV("%s invalid out fence for overlay plane", __func__);
         }
+    }
+    if (mOutFence != -1) {
+        close(mOutFence);
         mOutFence = -1;
-        mOverlay->isOverlay = false;
-        mOverlay = NULL;
     }
+    clearOverlaysLocked();
 
     drmModeAtomicFree(mPset);
     mPset = NULL;
@@ -1529,16 +1796,22 @@ int KmsDisplay::getPrimaryPlane() {
         if (type == DRM_PLANE_TYPE_PRIMARY) {
             mKmsPlanes[0].mPlaneID = pPlaneRes->planes[i];
             mKmsPlanes[0].mDrmFd = mDrmFd;
+            mKmsPlanes[0].getCapabilities();
         }
         if (type == DRM_PLANE_TYPE_OVERLAY && mKmsPlaneNum < KMS_PLANE_NUM) {
             mKmsPlanes[mKmsPlaneNum].mPlaneID = pPlaneRes->planes[i];
             mKmsPlanes[mKmsPlaneNum].mDrmFd = mDrmFd;
+            mKmsPlanes[mKmsPlaneNum].getCapabilities();
             mKmsPlaneNum++;
         }
     }
 
     drmModeFreePlaneResources(pPlaneRes);
 
+    // overlay planes are assigned to layers in zorder.
+    std::stable_sort(mKmsPlanes + 1, mKmsPlanes + mKmsPlaneNum,
+                     [](const KmsPlane &lhs, const KmsPlane &rhs) { return lhs.zpos < rhs.zpos; });
+
     if (mKmsPlanes[0].mPlaneID == 0) {
         ALOGE("can't find primary plane.");
         return -ENODEV;
@@ -1579,6 +1852,7 @@ int KmsDisplay::closeKms() {
     mConfigs.clear();
     mKmsPlaneNum = 1;
     memset(mKmsPlanes, 0, sizeof(mKmsPlanes));
+    mOverlayPlaneMask = 0;
 
     if (mEdid != NULL) {
         delete mEdid;
@@ -1633,6 +1907,8 @@ uint32_t KmsDisplay::convertFormatToDrm(uint32_t format) {
 }
 
 void KmsDisplay::prepareTargetsLocked() {
+    // new targets hold no content of previous frames.
+    mDamageTracker.reset();
     if (!mComposer.isValid()) {
         ALOGI("no need to alloc memory");
         return;
@@ -1674,6 +1950,7 @@ void KmsDisplay::prepareTargetsLocked() {
 }
 
 void KmsDisplay::releaseTargetsLocked() {
+    mDamageTracker.reset();
     for (int i = 0; i < MAX_FRAMEBUFFERS; i++) {
         if (mTargets[i] != NULL) {
             mMemoryManager->releaseMemory(mTargets[i]);
@@ -2023,7 +2300,8 @@ KmsDisplay::VSyncThread::VSyncThread(KmsDisplay *ctx)
         mEnabled(false),
         mSendVsync(true),
         mFakeVSync(false),
-        mNextFakeVSync(0) {
+        mNextFakeVSync(0),
+        mLastVSync(0) {
     mRefreshPeriod = 0;
 }
 
@@ -2057,8 +2335,16 @@ bool KmsDisplay::VSyncThread::threadLoop() {
     if (mCtx->forceVync()) // For EVS case, always send vsync
         mSendVsync = true;
 
+    int id = mCtx->getActiveId();
+    if (id >= 0) {
+        const DisplayConfig &config = mCtx->getActiveConfig();
+        mCtx->mVsyncPredictor.setPeriod(config.mVsyncPeriod);
+    }
+
     if (mFakeVSync || mCtx->mModeset) {
         performFakeVSync();
+    } else if (isIdle(systemTime(CLOCK_MONOTONIC))) {
+        performPredictedVSync();
     } else {
         performVSync();
     }
@@ -2066,6 +2352,14 @@ bool KmsDisplay::VSyncThread::threadLoop() {
     return true;
 }
 
+// No frame is committed lately and the model is fresh, vblank interrupt is
+// not needed to keep vsync in phase. The model ages out after a while, which
+// makes the thread sample one hardware vblank again.
+bool KmsDisplay::VSyncThread::isIdle(nsecs_t now) {
+    return (now - mCtx->mLastCommitTime) > KMS_IDLE_TIME &&
+            mCtx->mVsyncPredictor.isModelValid(now);
+}
+
 void KmsDisplay::VSyncThread::performFakeVSync() {
     int id = mCtx->getActiveId();
     if (id >= 0) {
@@ -2077,6 +2371,10 @@ void KmsDisplay::VSyncThread::performFakeVSync() {
     const nsecs_t period = mRefreshPeriod;
     const nsecs_t now = systemTime(CLOCK_MONOTONIC);
     nsecs_t next_vsync = mNextFakeVSync;
+    if (mCtx->mVsyncPredictor.isModelValid(now)) {
+        // keep in phase with the real vblank which was measured before.
+        next_vsync = mCtx->mVsyncPredictor.nextVsyncTime(now);
+    }
     nsecs_t sleep = next_vsync - now;
     if (sleep < 0) {
         // we missed, find where the next vsync should be
@@ -2084,6 +2382,7 @@ void KmsDisplay::VSyncThread::performFakeVSync() {
         next_vsync = now + sleep;
     }
     mNextFakeVSync = next_vsync + period;
+    mLastVSync = next_vsync;
 
     struct timespec spec;
     spec.tv_sec = next_vsync / 1000000000;
@@ -2099,6 +2398,29 @@ void KmsDisplay::VSyncThread::performFakeVSync() {
     }
 }
 
+void KmsDisplay::VSyncThread::performPredictedVSync() {
+    const nsecs_t now = systemTime(CLOCK_MONOTONIC);
+    nsecs_t next_vsync = mCtx->mVsyncPredictor.nextVsyncTime(now);
+    // don't send the same vblank twice when woken up early.
+    if (next_vsync - mLastVSync < mCtx->mVsyncPredictor.getPeriod() / 2) {
+        next_vsync = mCtx->mVsyncPredictor.nextVsyncTime(mLastVSync);
+    }
+    mLastVSync = next_vsync;
+
+    struct timespec spec;
+    spec.tv_sec = next_vsync / 1000000000;
+    spec.tv_nsec = next_vsync % 1000000000;
+
+    int err;
+    do {
+        err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, NULL);
+    } while (err == EINTR);
+
+    if (err == 0 && mCtx != NULL && mSendVsync) {
+        mCtx->handleVsyncEvent(next_vsync);
+    }
+}
+
 static const int64_t kOneSecondNs = 1 * 1000 * 1000 * 1000;
 void KmsDisplay::VSyncThread::performVSync() {
     uint64_t timestamp = 0;
@@ -2130,10 +2452,13 @@ void KmsDisplay::VSyncThread::performVSync() {
     }
 
     if (lasttime != 0) {
-        ALOGV("vsync period: %" PRIu64, timestamp - lasttime);
+        ALOGV("vsync period: %" PRIu64 ", model error: %" PRId64, timestamp - lasttime,
+              mCtx->mVsyncPredictor.getError());
     }
 
     lasttime = timestamp;
+    mCtx->mVsyncPredictor.addVsyncTimestamp(timestamp);
+    mLastVSync = timestamp;
     if (mCtx != NULL && mSendVsync) {
         mCtx->handleVsyncEvent(timestamp);
     }
@@ -23,12 +23,14 @@
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 
 #include "Display.h"
 #include "MemoryDesc.h"
 #include "MemoryManager.h"
+#include "VsyncPredictor.h"
 
 namespace fsl {
 
@@ -40,15 +42,26 @@ namespace fsl {
 #endif
 
 #define KMS_FORCE_VYNC_WAIT 100000000LL // unit ns, wait 100ms
+#define KMS_IDLE_TIME 100000000LL       // unit ns, no commit in 100ms
 
 using android::Condition;
 
 #define ARRAY_LEN(_arr) (sizeof(_arr) / sizeof(_arr[0]))
-#define KMS_PLANE_NUM 2
+// one primary plane and up to MAX_OVERLAY_PLANES overlay planes.
+#define KMS_PLANE_NUM (MAX_OVERLAY_PLANES + 1)
+#define KMS_PLANE_MAX_FORMATS 64
+#define KMS_PLANE_MAX_MODIFIERS 32
+// scaling range of the overlay planes, a layer out of it is composed.
+#define KMS_PLANE_MAX_UPSCALE 7
+#define KMS_PLANE_MAX_DOWNSCALE 3
 
 struct KmsPlane {
     void getPropertyIds();
+    // read zpos and supported format/modifier pairs of the plane.
+    void getCapabilities();
+    bool supportFormat(uint32_t format, uint64_t modifier) const;
     void connectCrtc(drmModeAtomicReqPtr pset, uint32_t crtc, uint32_t fb);
+    void disconnectCrtc(drmModeAtomicReqPtr pset);
     void setDisplayFrame(drmModeAtomicReqPtr pset, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
     void setSourceSurface(drmModeAtomicReqPtr pset, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
     void setAlpha(drmModeAtomicReqPtr pset, uint32_t alpha);
@@ -71,6 +84,16 @@ struct KmsPlane {
     uint32_t mPlaneID;
     uint32_t fence_id;
     int mDrmFd;
+
+    uint64_t zpos;
+    uint32_t formats[KMS_PLANE_MAX_FORMATS];
+    uint32_t formatNum;
+    struct {
+        uint64_t formats; // bitmask of formats[offset, offset + 63]
+        uint32_t offset;
+        uint64_t modifier;
+    } modifiers[KMS_PLANE_MAX_MODIFIERS];
+    uint32_t modifierNum;
 };
 
 struct TableProperty {
@@ -124,6 +147,7 @@ public:
     int powerMode();
 
     virtual bool checkOverlay(Layer *layer);
+    virtual size_t assignOverlays(Layer **candidates, size_t count);
     virtual int performOverlay();
     static void getTableProperty(uint32_t objectID, uint32_t objectType,
                                  struct TableProperty *table, size_t tableLen, int drmfd);
@@ -148,6 +172,8 @@ private:
     void setHdrMetaData(drmModeAtomicReqPtr pset, hdr_output_metadata hdrMetaData);
     bool getGUIResolution(int &width, int &height);
     bool veritySourceSize(Layer *layer);
+    bool verityScale(Layer *layer);
+    int setOverlayPlane(Layer *layer, KmsPlane &plane, uint8_t gloable_stride);
     void parseDisplayMode(int *width, int *height, int *vrefresh, int *prefermode);
 #ifdef HAVE_UNMAPPED_HEAP
     int checkSecureLayers();
@@ -173,6 +199,12 @@ protected:
     int mHDCPDisableCnt;
     bool mHDCPEnable;
 
+    // vblank timeline learnt from hardware vsync, shared with vsync thread.
+    VsyncPredictor mVsyncPredictor;
+    std::atomic<nsecs_t> mLastCommitTime;
+    // commit this long before predicted vblank, 0 to commit at once.
+    nsecs_t mPresentOffset;
+
     struct {
         uint32_t mode_id;
         uint32_t active;
@@ -201,6 +233,8 @@ protected:
     bool mModeset;
     KmsPlane mKmsPlanes[KMS_PLANE_NUM];
     uint32_t mKmsPlaneNum;
+    // overlay planes connected to crtc by last commit.
+    uint32_t mOverlayPlaneMask;
     drmModeAtomicReqPtr mPset;
     MemoryManager *mMemoryManager;
     bool mNoResolve;
@@ -225,6 +259,9 @@ protected:
         virtual bool threadLoop();
         void performFakeVSync();
         void performVSync();
+        // send vsync at predicted vblank without waking up on hardware vblank.
+        void performPredictedVSync();
+        bool isIdle(nsecs_t now);
 
         KmsDisplay *mCtx;
         mutable Mutex mLock;
@@ -234,6 +271,8 @@ protected:
 
         bool mFakeVSync;
         mutable nsecs_t mNextFakeVSync;
+        // timestamp of last vsync sent, from any source.
+        nsecs_t mLastVSync;
         nsecs_t mRefreshPeriod;
     };
 
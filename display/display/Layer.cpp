@@ -35,11 +35,14 @@ Layer::Layer()
         index(-1),
         isHdrMode(false),
         isOverlay(false),
+        planeIndex(-1),
+        surfaceDamageValid(false),
         priv(NULL),
         dataspace(0) {
     sourceCrop.clear();
     displayFrame.clear();
     visibleRegion.clear();
+    surfaceDamage.clear();
     memset(&hdrMetadata, 0, sizeof(hdrMetadata));
 }
 
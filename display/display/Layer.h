@@ -82,6 +82,8 @@ public:
     Rect sourceCrop;
     Rect displayFrame;
     Region visibleRegion;
+    // damage in buffer space, whole buffer is damaged when it is invalid.
+    Region surfaceDamage;
     Rect lastSourceCrop;
     Rect lastDisplayFrame;
     // fence transfered from surfaceflinger to HWC.
@@ -93,6 +95,9 @@ public:
     int index;
     bool isHdrMode;
     bool isOverlay;
+    // hardware plane assigned to this layer when isOverlay is set.
+    int planeIndex;
+    bool surfaceDamageValid;
     void* priv;
     hdr_output_metadata hdrMetadata;
     uint32_t dataspace;
@@ -216,6 +216,11 @@ int MemoryManager::releaseMemory(Memory* handle) {
         return -EINVAL;
     }
 
+    if (handle->fd > 0) {
+        Allocator::getInstance()->releaseBufferInfo(handle->fd);
+    }
+    mIonManager->releaseLock(handle);
+
     /* kmsFd, fbHandle and fbId are created in KmsDisplay.
      * It is hard to put free memory code to KmsDisplay.
      */
@@ -446,10 +451,21 @@ int MemoryManager::flush(Memory* handle) {
         // TODO: add flush operation for the buffer allocated in DRM
         return 0; // mGPUModule->unlock(mGPUModule, handle);
     } else {
-        if (handle->flags & FLAGS_CPU)
-            mIonManager->flushCache(handle);
+        return mIonManager->flush(handle);
+    }
+}
+
+int MemoryManager::invalidate(Memory* handle) {
+    if (handle == NULL || !handle->isValid()) {
+        ALOGE("%s invalid handle", __func__);
+        return -EINVAL;
+    }
+
+    if (isDrmAlloc(handle->flags, handle->fslFormat, handle->usage)) {
         return 0;
     }
+
+    return mIonManager->invalidate(handle);
 }
 
 } // namespace fsl
@@ -64,6 +64,8 @@ public:
     int validateMemory(MemoryDesc& desc, Memory* handle);
     // flush memory
     int flush(Memory* handle);
+    // invalidate CPU cache of memory
+    int invalidate(Memory* handle);
 
     MetaData* getMetaData(Memory* handle);
     uint64_t getDrmModifier(Memory* buffer);
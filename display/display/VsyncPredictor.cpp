@@ -0,0 +1,243 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "VsyncPredictor.h"
+
+#include <cutils/log.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+namespace fsl {
+
+#define DEFAULT_VSYNC_PERIOD (1000000000 / 60)
+// number of timestamps used by the fit.
+#define HISTORY_SIZE 20
+// fewer timestamps can not give a stable slope.
+#define MIN_SAMPLES 6
+// timestamps further apart may be assigned to a wrong vblank.
+#define MAX_SAMPLE_GAP ms2ns(2000)
+// without a new timestamp for this long the phase may have drifted.
+#define MAX_MODEL_AGE ms2ns(1000)
+// measured period must be within 20% of the nominal one.
+#define MAX_PERIOD_DEVIATION_PERCENT 20
+// this number of outliers in a row means the model is wrong.
+#define MAX_CONSECUTIVE_OUTLIERS 3
+
+VsyncPredictor::VsyncPredictor() : mTimestamps(HISTORY_SIZE, 0) {
+    mIdealPeriod = DEFAULT_VSYNC_PERIOD;
+    mNext = 0;
+    mCount = 0;
+    mLastTimestamp = 0;
+    mModelReady = false;
+    mModelPeriod = mIdealPeriod;
+    mModelBase = 0;
+    mModelError = 0;
+    mConsecutiveOutliers = 0;
+    mPredictionErrorSum = 0;
+    mPredictionErrorMax = 0;
+    mPredictionCount = 0;
+    mRejectedCount = 0;
+}
+
+void VsyncPredictor::setPeriod(nsecs_t period) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (period <= 0 || period == mIdealPeriod) {
+        return;
+    }
+
+    mIdealPeriod = period;
+    clearHistoryLocked();
+    mLastTimestamp = 0;
+}
+
+void VsyncPredictor::reset() {
+    std::lock_guard<std::mutex> lock(mLock);
+    clearHistoryLocked();
+    mLastTimestamp = 0;
+}
+
+void VsyncPredictor::clearHistoryLocked() {
+    mNext = 0;
+    mCount = 0;
+    mModelReady = false;
+    mModelPeriod = mIdealPeriod;
+    mModelBase = 0;
+    mModelError = 0;
+    mConsecutiveOutliers = 0;
+}
+
+void VsyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mLastTimestamp != 0) {
+        nsecs_t delta = timestamp - mLastTimestamp;
+        if (delta < mIdealPeriod / 2) {
+            // duplicated or out of order.
+            mRejectedCount++;
+            return;
+        }
+        if (delta > MAX_SAMPLE_GAP) {
+            clearHistoryLocked();
+        }
+    }
+
+    if (mModelReady) {
+        nsecs_t offset = timestamp - mModelBase;
+        nsecs_t ordinal = (offset + mModelPeriod / 2) / mModelPeriod;
+        nsecs_t error = llabs(offset - ordinal * mModelPeriod);
+        if (error > mModelPeriod / 4) {
+            mRejectedCount++;
+            if (++mConsecutiveOutliers < MAX_CONSECUTIVE_OUTLIERS) {
+                return;
+            }
+            // vblank timeline has moved, e.g. after a mode set, learn it again.
+            ALOGI("%s: vsync model lost, error %" PRId64 "ns", __func__, error);
+            clearHistoryLocked();
+        } else {
+            mConsecutiveOutliers = 0;
+            mPredictionErrorSum += error;
+            mPredictionErrorMax = std::max(mPredictionErrorMax, error);
+            mPredictionCount++;
+        }
+    }
+
+    mTimestamps[mNext] = timestamp;
+    mNext = (mNext + 1) % HISTORY_SIZE;
+    if (mCount < HISTORY_SIZE) {
+        mCount++;
+    }
+    mLastTimestamp = timestamp;
+
+    updateModelLocked();
+}
+
+void VsyncPredictor::updateModelLocked() {
+    if (mCount < MIN_SAMPLES) {
+        mModelReady = false;
+        return;
+    }
+
+    size_t oldest = (mNext + HISTORY_SIZE - mCount) % HISTORY_SIZE;
+    nsecs_t origin = mTimestamps[oldest];
+    // vblank ordinals are assigned with current model period, it is accurate
+    // enough that gaps of skipped vblanks don't make them ambiguous.
+    nsecs_t period = mModelReady ? mModelPeriod : mIdealPeriod;
+
+    double ordinals[HISTORY_SIZE];
+    double offsets[HISTORY_SIZE];
+    double meanX = 0;
+    double meanY = 0;
+    for (size_t i = 0; i < mCount; i++) {
+        nsecs_t offset = mTimestamps[(oldest + i) % HISTORY_SIZE] - origin;
+        ordinals[i] = (double)((offset + period / 2) / period);
+        offsets[i] = (double)offset;
+        meanX += ordinals[i];
+        meanY += offsets[i];
+    }
+    meanX /= mCount;
+    meanY /= mCount;
+
+    double covariance = 0;
+    double variance = 0;
+    for (size_t i = 0; i < mCount; i++) {
+        covariance += (ordinals[i] - meanX) * (offsets[i] - meanY);
+        variance += (ordinals[i] - meanX) * (ordinals[i] - meanX);
+    }
+    if (variance <= 0) {
+        mModelReady = false;
+        return;
+    }
+
+    double slope = covariance / variance;
+    double intercept = meanY - slope * meanX;
+    nsecs_t deviation = llabs((nsecs_t)slope - mIdealPeriod);
+    if (deviation * 100 > mIdealPeriod * MAX_PERIOD_DEVIATION_PERCENT) {
+        ALOGW("%s: measured period %" PRId64 " is far from %" PRId64 ", reset", __func__,
+              (nsecs_t)slope, mIdealPeriod);
+        nsecs_t last = mLastTimestamp;
+        clearHistoryLocked();
+        mTimestamps[0] = last;
+        mNext = 1;
+        mCount = 1;
+        return;
+    }
+
+    double squares = 0;
+    for (size_t i = 0; i < mCount; i++) {
+        double residual = offsets[i] - (intercept + slope * ordinals[i]);
+        squares += residual * residual;
+    }
+
+    mModelReady = true;
+    mModelPeriod = (nsecs_t)llround(slope);
+    mModelBase = origin + (nsecs_t)llround(intercept);
+    mModelError = (nsecs_t)llround(sqrt(squares / mCount));
+}
+
+bool VsyncPredictor::isModelValid(nsecs_t now) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mModelReady && (now - mLastTimestamp) < MAX_MODEL_AGE &&
+            mModelError < mModelPeriod / 20;
+}
+
+nsecs_t VsyncPredictor::nextVsyncTime(nsecs_t now) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    nsecs_t base = mModelReady ? mModelBase : mLastTimestamp;
+    nsecs_t period = mModelReady ? mModelPeriod : mIdealPeriod;
+    if (base == 0) {
+        return now + period;
+    }
+
+    nsecs_t elapsed = now - base;
+    nsecs_t ordinal = elapsed >= 0 ? elapsed / period + 1 : -((-elapsed) / period);
+    nsecs_t next = base + ordinal * period;
+    if (next <= now) {
+        next += period;
+    }
+    return next;
+}
+
+nsecs_t VsyncPredictor::getPeriod() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mModelReady ? mModelPeriod : mIdealPeriod;
+}
+
+nsecs_t VsyncPredictor::getError() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mModelError;
+}
+
+void VsyncPredictor::dump(std::string& output) const {
+    std::lock_guard<std::mutex> lock(mLock);
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "vsync model: %s, period %" PRId64 "ns (nominal %" PRId64 "ns), samples %zu, "
+             "fit error %" PRId64 "ns\n",
+             mModelReady ? "ready" : "training", mModelPeriod, mIdealPeriod, mCount,
+             mModelError);
+    output += buf;
+
+    nsecs_t meanError = mPredictionCount > 0 ? mPredictionErrorSum / mPredictionCount : 0;
+    snprintf(buf, sizeof(buf),
+             "vsync prediction error: mean %" PRId64 "ns, max %" PRId64 "ns, checked %" PRIu64
+             ", rejected %" PRIu64 "\n",
+             meanError, mPredictionErrorMax, mPredictionCount, mRejectedCount);
+    output += buf;
+}
+
+} // namespace fsl
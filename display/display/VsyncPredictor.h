@@ -0,0 +1,80 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FSL_VSYNC_PREDICTOR_H_
+#define _FSL_VSYNC_PREDICTOR_H_
+
+#include <utils/Timers.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fsl {
+
+// Model the hardware vblank timeline from recent vblank timestamps. A line is
+// fitted through the timestamps by least squares, the slope is the measured
+// refresh period and the intercept is the phase. All times are in
+// CLOCK_MONOTONIC nanoseconds.
+class VsyncPredictor {
+public:
+    VsyncPredictor();
+
+    // set the nominal period of the active mode, forget history if it changes.
+    void setPeriod(nsecs_t period);
+    // feed one hardware vblank timestamp.
+    void addVsyncTimestamp(nsecs_t timestamp);
+    // forget all timestamps, prediction falls back to the nominal period.
+    void reset();
+
+    // true when the model is trained and recent enough to replace hardware vblank.
+    bool isModelValid(nsecs_t now) const;
+    // predicted time of the first vblank after now.
+    nsecs_t nextVsyncTime(nsecs_t now) const;
+    nsecs_t getPeriod() const;
+    // rms residual of the fit.
+    nsecs_t getError() const;
+
+    void dump(std::string& output) const;
+
+private:
+    void clearHistoryLocked();
+    void updateModelLocked();
+
+    mutable std::mutex mLock;
+    nsecs_t mIdealPeriod;
+    // ring buffer of recent timestamps, mNext is the slot for the next one.
+    std::vector<nsecs_t> mTimestamps;
+    size_t mNext;
+    size_t mCount;
+    nsecs_t mLastTimestamp;
+
+    bool mModelReady;
+    nsecs_t mModelPeriod;
+    // time of one vblank on the fitted line.
+    nsecs_t mModelBase;
+    nsecs_t mModelError;
+    uint32_t mConsecutiveOutliers;
+
+    // distance of hardware timestamps to their prediction.
+    nsecs_t mPredictionErrorSum;
+    nsecs_t mPredictionErrorMax;
+    uint64_t mPredictionCount;
+    uint64_t mRejectedCount;
+};
+
+} // namespace fsl
+#endif
@@ -56,6 +56,7 @@ func libionallocatorDefaults(ctx android.LoadHookContext) {
 	}
 	if ctx.Config().VendorConfig("IMXPLUGIN").Bool("ENABLE_DMABUF_HEAP") {
 		p.Target.Android.Srcs = append(p.Target.Android.Srcs, "DmaHeapAllocator.cpp")
+		p.Target.Android.Srcs = append(p.Target.Android.Srcs, "DmaBufPool.cpp")
 		p.Target.Android.Static_libs = append(p.Target.Android.Static_libs, "libdmabufheap")
 		p.Target.Android.Cppflags = append(p.Target.Android.Cppflags, "-DENABLE_DMABUF_HEAP")
 		p.Target.Android.Include_dirs = append(p.Target.Android.Include_dirs, "system/memory/libdmabufheap/include")
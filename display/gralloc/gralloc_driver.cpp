@@ -200,9 +200,26 @@ int32_t gralloc_driver::lock(buffer_handle_t handle, int32_t acquire_fence,
         return -EINVAL;
     }
 
+    // only the rows of rect get cache maintenance, in the direction of map_flags.
+    int usage = 0;
+    if (map_flags & BO_MAP_READ) {
+        usage |= USAGE_SW_READ_OFTEN;
+    }
+    if (map_flags & BO_MAP_WRITE) {
+        usage |= USAGE_SW_WRITE_OFTEN;
+    }
+
+    int left = 0, top = 0, width = hnd->width, height = hnd->height;
+    if (rect && rect->width > 0 && rect->height > 0) {
+        left = rect->x;
+        top = rect->y;
+        width = rect->width;
+        height = rect->height;
+    }
+
     void *vaddr = nullptr;
-    ret = pManager->lock(const_cast<gralloc_handle *>(hnd), hnd->usage, 0, 0, hnd->width,
-                         hnd->height, &vaddr);
+    ret = pManager->lock(const_cast<gralloc_handle *>(hnd), usage, left, top, width, height,
+                         &vaddr);
     if (ret != 0) {
         ALOGE("%s lock memory failed", __func__);
         return -EINVAL;
@@ -239,6 +256,12 @@ int32_t gralloc_driver::invalidate(buffer_handle_t handle) {
         return -EINVAL;
     }
 
+    int ret = pManager->invalidate(const_cast<gralloc_handle *>(hnd));
+    if (ret != 0) {
+        ALOGE("%s invalidate memory failed", __func__);
+        return -EINVAL;
+    }
+
     return 0;
 }
 
@@ -88,9 +88,13 @@ HWC3::Error ClientFrameComposer::init() {
 
     mG2dComposer = std::make_shared<DeviceComposer>();
     if (mG2dComposer->isValid()) {
+        mComposeThread.start();
     }
 
     mHdcpEnabled = IsHdcpUserEnabled();
+    mPartialComposition = property_get_bool("vendor.hwc.enable.partial_composition", true);
+    mPresentOffset =
+            std::chrono::microseconds(property_get_int64("vendor.hwc.present.offset_us", 0));
 
     return HWC3::Error::None;
 }
@@ -124,6 +128,8 @@ HWC3::Error ClientFrameComposer::onDisplayCreate(Display* display) {
     // Ensure created.
     mDisplayBuffers.emplace(displayId, DisplayBuffer{});
     mDisplayLayers.emplace(displayId, ValidatedLayers{});
+    // planes may differ after hotplug.
+    mStrategies[displayId].valid = false;
 
     std::vector<DisplayCapability> caps;
     if (client->getDisplayCapability(displayId, caps) == HWC3::Error::None) {
@@ -156,6 +162,8 @@ HWC3::Error ClientFrameComposer::onDisplayDestroy(Display* display) {
     client->resetDisplayConfig(displayId);
 
     mDisplayBuffers.erase(it);
+    mDamageTrackers.erase(displayId);
+    mStrategies.erase(displayId);
 
     return HWC3::Error::None;
 }
@@ -225,10 +233,45 @@ HWC3::Error ClientFrameComposer::onActiveConfigChange(Display* display, int32_t
     }
 
     client->setActiveConfigId(displayId, configId);
+    mStrategies[displayId].valid = false;
 
     return HWC3::Error::None;
 };
 
+bool ClientFrameComposer::LayerSignature::operator==(const LayerSignature& other) const {
+    return id == other.id && composition == other.composition &&
+            displayFrame == other.displayFrame && sourceCrop == other.sourceCrop &&
+            transform == other.transform && blendMode == other.blendMode &&
+            dataspace == other.dataspace && planeAlpha == other.planeAlpha &&
+            colorTransform == other.colorTransform && fslFormat == other.fslFormat &&
+            modifier == other.modifier && usage == other.usage && width == other.width &&
+            height == other.height && stride == other.stride && format == other.format;
+}
+
+ClientFrameComposer::LayerSignature ClientFrameComposer::getLayerSignature(Layer* layer) {
+    LayerSignature signature;
+    signature.id = layer->getId();
+    signature.composition = layer->getCompositionType();
+    signature.displayFrame = layer->getDisplayFrame();
+    signature.sourceCrop = layer->getSourceCropInt();
+    signature.transform = layer->getTransform();
+    signature.blendMode = layer->getBlendMode();
+    signature.dataspace = layer->getDataspace();
+    signature.planeAlpha = layer->getPlaneAlpha();
+    signature.colorTransform = layer->getColorTransform() != std::nullopt;
+
+    gralloc_handle_t buff = (gralloc_handle_t)layer->getBuffer().getBuffer();
+    signature.fslFormat = buff ? buff->fslFormat : -1;
+    signature.modifier = buff ? buff->format_modifier : 0;
+    // the handle keeps the low 32 bits of the usage, don't sign extend them.
+    signature.usage = buff ? (uint32_t)buff->usage : 0;
+    signature.width = buff ? buff->width : 0;
+    signature.height = buff ? buff->height : 0;
+    signature.stride = buff ? buff->stride : 0;
+    signature.format = buff ? buff->format : 0;
+    return signature;
+}
+
 HWC3::Error ClientFrameComposer::validateDisplay(Display* display, DisplayChanges* outChanges) {
     const auto displayId = display->getId();
     DEBUG_LOG("%s display:%" PRIu64, __FUNCTION__, displayId);
@@ -257,7 +300,7 @@ HWC3::Error ClientFrameComposer::validateDisplay(Display* display, DisplayChange
     bool mustDeviceComposition = false;
 
     bool layerSkiped = false; // check if need overlay checking for layer or not
-    int32_t activeConfigId;
+    int32_t activeConfigId = -1;
     int32_t width = INT_MAX, height = INT_MAX;
     if (display->getActiveConfig(&activeConfigId) == HWC3::Error::None) {
         display->getDisplayAttribute(activeConfigId, DisplayAttribute::WIDTH, &width);
@@ -295,13 +338,39 @@ HWC3::Error ClientFrameComposer::validateDisplay(Display* display, DisplayChange
         client->prepareDrmPlanesForValidate(displayId, nullptr);
     }
 
-    common::Rect uiMaskedRect = {width, height, 0, 0};
+    // the checks below are costly, reuse last result if nothing structural changed.
+    CompositionStrategy& strategy = mStrategies[displayId];
+    std::vector<LayerSignature> signatures;
+    signatures.reserve(layers.size());
     for (Layer* layer : layers) {
+        signatures.push_back(getLayerSignature(layer));
+    }
+    const bool reuseStrategy = strategy.valid && strategy.configId == activeConfigId &&
+            strategy.overlaySupported == overlaySupported &&
+            strategy.colorTransform == display->getColorTransformHint() &&
+            strategy.signatures == signatures;
+    std::vector<uint32_t> planeIds(layers.size(), 0);
+
+    common::Rect uiMaskedRect = {width, height, 0, 0};
+    for (size_t i = 0; i < layers.size(); i++) {
+        Layer* layer = layers[i];
         const auto layerId = layer->getId();
         const auto composeType = layer->getCompositionType();
         if ((int)composeType == Composition_NXP_PRIVATE)
             continue;
 
+        if (reuseStrategy) {
+            uint32_t planeId = strategy.planeIds[i];
+            if (planeId > 0) {
+                layersForOverlay.emplace(planeId, layer);
+                if (composeType != Composition::DEVICE)
+                    outChanges->addLayerCompositionChange(displayId, layerId, Composition::DEVICE);
+            } else {
+                layersForComposition.push_back(layer);
+            }
+            continue;
+        }
+
         if (overlaySupported && !layerSkiped) {
             common::Rect rectFrame = layer->getDisplayFrame();
             DEBUG_LOG("UI masked rect:left=%d, top=%d, right=%d, bottom=%d", uiMaskedRect.left,
@@ -315,6 +384,7 @@ HWC3::Error ClientFrameComposer::validateDisplay(Display* display, DisplayChange
                 auto [error, planeId] = client->getPlaneForLayerBuffer(displayId, handle);
                 if (error == HWC3::Error::None) {
                     layersForOverlay.emplace(planeId, layer);
+                    planeIds[i] = planeId;
 
                     if (composeType != Composition::DEVICE)
                         outChanges->addLayerCompositionChange(displayId, layerId,
@@ -338,6 +408,22 @@ HWC3::Error ClientFrameComposer::validateDisplay(Display* display, DisplayChange
         }
     }
 
+    if (reuseStrategy) {
+        deviceComposition = strategy.deviceComposition;
+        mustDeviceComposition = strategy.mustDeviceComposition;
+        DEBUG_LOG("%s: display:%" PRIu64 " reuse last composition strategy", __FUNCTION__,
+                  displayId);
+    } else {
+        strategy.valid = true;
+        strategy.configId = activeConfigId;
+        strategy.overlaySupported = overlaySupported;
+        strategy.colorTransform = display->getColorTransformHint();
+        strategy.signatures = std::move(signatures);
+        strategy.planeIds = std::move(planeIds);
+        strategy.deviceComposition = deviceComposition;
+        strategy.mustDeviceComposition = mustDeviceComposition;
+    }
+
     if (!mG2dComposer->isValid() || (!mustDeviceComposition && !deviceComposition) ||
         (display->getColorTransformHint() != common::ColorTransform::IDENTITY)) {
         /* currently Device Composer(G2D/DPU) cannot process color transform */
@@ -387,13 +473,65 @@ HWC3::Error ClientFrameComposer::presentDisplay(
     }
 
     bool needFence = false; // Check if need pass in_fence of framebuffer to DRM or not
+    ::android::base::unique_fd luckyFence;
     int32_t activeConfigId = -1;
     if (display->getActiveConfig(&activeConfigId) != HWC3::Error::None) {
         DEBUG_LOG("%s: fail to get active config id", __FUNCTION__);
     }
 
+    // start device composition first, it runs while planes are prepared below.
+    std::future<HWC3::Error> composeResult;
+    buffer_handle_t renderTarget = nullptr;
+    if (layersForComposition.size() > 0) {
+        bool secure = false;
+        for (auto& layer : layersForComposition) {
+            auto buff = (gralloc_handle_t)layer->getBuffer().getBuffer();
+            if (buff && (buff->usage & USAGE_PROTECTED))
+                secure = true;
+        }
+
+        auto [error, target] = client->getComposerTarget(mG2dComposer, displayId, secure);
+        if (error != HWC3::Error::None) {
+            ALOGE("%s: display:%" PRIu64 " failed to get composer target", __FUNCTION__, displayId);
+            return error;
+        }
+        renderTarget = target;
+
+        std::optional<::android::Region> repaint;
+        if (mPartialComposition) {
+            // only compose the region changed since renderTarget was last used.
+            repaint = mDamageTrackers[displayId]
+                              .getRepaintRegion(layersForComposition, renderTarget,
+                                                mG2dComposer->getTargetGeneration());
+        }
+
+        // layers are not touched by SurfaceFlinger until presentDisplay returns,
+        // and the result is always collected before that.
+        FrameStats& stats = display->getFrameStats();
+        composeResult = mComposeThread.submit([this, &stats, layers = layersForComposition,
+                                               renderTarget, repaint = std::move(repaint)]() {
+            {
+                ATRACE_NAME("waitLayerFences");
+                FrameStats::ScopedStage stage(stats, FrameStats::kFenceWait);
+                for (auto& layer : layers) {
+                    layer->waitAndGetBuffer(); // wait for all layer buffer ready
+                }
+            }
+            ATRACE_NAME("composeLayers");
+            FrameStats::ScopedStage stage(stats, FrameStats::kCompose);
+            bool composed = mG2dComposer->composeLayers(layers, renderTarget,
+                                                        repaint ? &*repaint : nullptr);
+            return composed ? HWC3::Error::None : HWC3::Error::NoResources;
+        });
+    } else {
+        // layer changes of this frame are not tracked, compose all next time.
+        mDamageTrackers[displayId].reset();
+    }
+
     for (auto& [planeId, layer] : layersForOverlay) {
-        auto handle = layer->waitAndGetBuffer(); // wait for layer buffer ready
+        // KMS waits for the acquire fence, don't block here.
+        auto handle = layer->getBuffer().getBuffer();
+        displayBuffer.planeInFences[planeId] = layer->getBuffer().getFence();
         common::Rect rectFrame = layer->getDisplayFrame();
         common::Rect rectSource = layer->getSourceCropInt();
 
@@ -401,6 +539,9 @@ HWC3::Error ClientFrameComposer::presentDisplay(
         if (createError != HWC3::Error::None) {
             ALOGE("%s: display:%" PRIu64 " failed to create overlay drm buffer", __FUNCTION__,
                   displayId);
+            if (composeResult.valid()) {
+                composeResult.wait();
+            }
             return HWC3::Error::NoResources;
         }
         displayBuffer.planeDrmBuffer[planeId] = std::move(drmBuffer);
@@ -420,22 +561,7 @@ HWC3::Error ClientFrameComposer::presentDisplay(
         }
     }
 
-    if (layersForComposition.size() > 0) {
-        bool secure = false;
-        for (auto& layer : layersForComposition) {
-            auto buff = (gralloc_handle_t)layer->waitAndGetBuffer();
-            // wait for all layer buffer ready, and check if there secure layer
-            if (buff && (buff->usage & USAGE_PROTECTED))
-                secure = true;
-        }
-
-        auto [error, renderTarget] = client->getComposerTarget(mG2dComposer, displayId, secure);
-        if (error != HWC3::Error::None) {
-            ALOGE("%s: display:%" PRIu64 " failed to get composer target", __FUNCTION__, displayId);
-            return error;
-        }
-        mG2dComposer->composeLayers(layersForComposition, renderTarget);
-
+    if (renderTarget != nullptr) {
         int32_t width = INT_MAX, height = INT_MAX;
         if (activeConfigId >= 0) {
             display->getDisplayAttribute(activeConfigId, DisplayAttribute::WIDTH, &width);
@@ -447,12 +573,10 @@ HWC3::Error ClientFrameComposer::presentDisplay(
         if (createError != HWC3::Error::None) {
             ALOGE("%s: display:%" PRIu64 " failed to create composer target drm buffer",
                   __FUNCTION__, displayId);
+            composeResult.wait();
             return HWC3::Error::NoResources;
         }
         displayBuffer.clientTargetDrmBuffer = std::move(drmBuffer);
-#ifdef DEBUG_DUMP_FRAME
-        debug_dump_frame(renderTarget);
-#endif
     } else if (displayBuffer.clientTargetDrmBuffer) {
         needFence = true;
 #ifdef DEBUG_DUMP_FRAME
@@ -461,7 +585,8 @@ HWC3::Error ClientFrameComposer::presentDisplay(
     } else if (luckyLayer != nullptr) {
         common::Rect rectFrame = luckyLayer->getDisplayFrame();
         common::Rect rectSource = luckyLayer->getSourceCropInt();
-        auto buffer = (gralloc_handle_t)luckyLayer->waitAndGetBuffer();
+        auto buffer = (gralloc_handle_t)luckyLayer->getBuffer().getBuffer();
+        luckyFence = luckyLayer->getBuffer().getFence();
         auto [createError, drmBuffer] = client->create(buffer, rectFrame, rectSource);
         if (createError != HWC3::Error::None) {
             ALOGE("%s: display:%" PRIu64 " failed to create client target drm buffer", __FUNCTION__,
@@ -497,6 +622,9 @@ HWC3::Error ClientFrameComposer::presentDisplay(
             if (createError != HWC3::Error::None) {
                 ALOGE("%s: display:%" PRIu64 " failed to create client target drm buffer",
                       __FUNCTION__, displayId);
+                if (composeResult.valid()) {
+                    composeResult.wait();
+                }
                 return HWC3::Error::NoResources;
             }
             displayBuffer.clientTargetDrmBuffer = drmBuffer;
@@ -520,17 +648,47 @@ HWC3::Error ClientFrameComposer::presentDisplay(
         if (activeConfigId >= 0)
             display->getDisplayAttribute(activeConfigId, DisplayAttribute::VSYNC_PERIOD, &period);
 
+        TimePoint commitTime = *presentTime - Nanoseconds(period);
+        if (mPresentOffset.count() > 0) {
+            // commit a fixed time before the modelled vblank nearest to the
+            // expected present time, rather than a whole period ahead.
+            auto vsync = display->predictVsync(*presentTime - Nanoseconds(period / 2));
+            if (vsync.has_value()) {
+                commitTime = *vsync - mPresentOffset;
+            }
+        }
+
         TimePoint now = std::chrono::steady_clock::now();
-        if (now < *presentTime - Nanoseconds(period))
-            std::this_thread::sleep_until(*presentTime - Nanoseconds(period));
+        if (now < commitTime)
+            std::this_thread::sleep_until(commitTime);
     }
 
+    if (composeResult.valid()) {
+        // G2D has no fence output, the composer target must be ready before commit.
+        if (composeResult.get() != HWC3::Error::None) {
+            ALOGE("%s: display:%" PRIu64 " device composition failed", __FUNCTION__, displayId);
+        }
+#ifdef DEBUG_DUMP_FRAME
+        debug_dump_frame(renderTarget);
+#endif
+    }
+
+    ::android::base::unique_fd inSyncFd;
+    if (needFence) {
+        inSyncFd = display->getClientTarget().getFence();
+    } else if (luckyFence.ok()) {
+        inSyncFd = std::move(luckyFence);
+    }
+    TimePoint flushStart = std::chrono::steady_clock::now();
     auto [flushError, flushCompleteFence] =
-            client->flushToDisplay(displayId, displayBuffer,
-                                   needFence ? display->getClientTarget().getFence()
-                                             : ::android::base::unique_fd());
+            client->flushToDisplay(displayId, displayBuffer, inSyncFd);
     if (flushError != HWC3::Error::None) {
         ALOGE("%s: display:%" PRIu64 " failed to flush drm buffer", __FUNCTION__, displayId);
+    } else {
+        FrameStats& stats = display->getFrameStats();
+        TimePoint flushEnd = std::chrono::steady_clock::now();
+        stats.record(FrameStats::kCommit, flushEnd - flushStart);
+        stats.record(FrameStats::kVsyncToPresent, flushEnd - display->getPreviousVsync());
     }
 
     for (auto& [_, layer] : layersForOverlay) {
@@ -541,6 +699,7 @@ HWC3::Error ClientFrameComposer::presentDisplay(
 
     displayBuffer.clientTargetDrmBuffer = nullptr;
     displayBuffer.planeDrmBuffer.clear();
+    displayBuffer.planeInFences.clear();
 
     layersForOverlay.clear();
     layersForComposition.clear();
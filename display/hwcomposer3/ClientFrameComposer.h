@@ -18,9 +18,12 @@
 #ifndef ANDROID_HWC_CLIENTFRAMECOMPOSER_H
 #define ANDROID_HWC_CLIENTFRAMECOMPOSER_H
 
+#include <future>
 #include <map>
 
 #include "Common.h"
+#include "ComposeThread.h"
+#include "DamageTracker.h"
 #include "DeviceClient.h"
 #include "DeviceComposer.h"
 #include "Display.h"
@@ -101,10 +104,55 @@ private:
     std::unordered_map<int64_t, DisplayBuffer> mDisplayBuffers;
     std::unordered_map<int64_t, ValidatedLayers> mDisplayLayers;
 
+    // Layer properties which the validateDisplay decisions depend on.
+    struct LayerSignature {
+        int64_t id;
+        Composition composition;
+        common::Rect displayFrame;
+        common::Rect sourceCrop;
+        common::Transform transform;
+        common::BlendMode blendMode;
+        common::Dataspace dataspace;
+        float planeAlpha;
+        bool colorTransform;
+        int fslFormat; // -1 when there is no buffer
+        uint64_t modifier;
+        uint64_t usage;
+        // geometry of the buffer, a reallocated buffer may keep the crop.
+        int width;
+        int height;
+        int stride;
+        int format;
+
+        bool operator==(const LayerSignature& other) const;
+    };
+    static LayerSignature getLayerSignature(Layer* layer);
+
+    // Plane/G2D/client assignment of last validated frame, reused when the
+    // layer stack is structurally identical.
+    struct CompositionStrategy {
+        bool valid = false;
+        int32_t configId = -1;
+        bool overlaySupported = false;
+        common::ColorTransform colorTransform = common::ColorTransform::IDENTITY;
+        std::vector<LayerSignature> signatures;
+        // overlay plane of each layer in signatures order, 0 for composition.
+        std::vector<uint32_t> planeIds;
+        bool deviceComposition = false;
+        bool mustDeviceComposition = false;
+    };
+    std::unordered_map<int64_t, CompositionStrategy> mStrategies;
+
     std::map<uint32_t, std::unique_ptr<DeviceClient>> mDeviceClients;
     std::shared_ptr<DeviceComposer> mG2dComposer;
+    // G2D is a single engine, one worker serves all displays.
+    ComposeThread mComposeThread;
+    std::unordered_map<int64_t, DamageTracker> mDamageTrackers;
 
     bool mHdcpEnabled = false;
+    bool mPartialComposition = true;
+    // commit this long before predicted vblank, 0 to commit one period ahead.
+    Nanoseconds mPresentOffset{0};
 };
 
 } // namespace aidl::android::hardware::graphics::composer3::impl
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ComposeThread.h"
+
+#include <utils/ThreadDefs.h>
+
+namespace aidl::android::hardware::graphics::composer3::impl {
+
+ComposeThread::~ComposeThread() {
+    stop();
+}
+
+HWC3::Error ComposeThread::start() {
+    DEBUG_LOG("%s", __FUNCTION__);
+
+    mThread = std::thread([this]() { threadLoop(); });
+
+    int ret = pthread_setname_np(mThread.native_handle(), "hwc_compose");
+    if (ret != 0) {
+        ALOGE("%s: failed to set compose thread name: %s", __FUNCTION__, strerror(ret));
+    }
+
+    // same priority as vsync thread, composition is on the present critical path.
+    struct sched_param param = {
+            .sched_priority = 2,
+    };
+    ret = pthread_setschedparam(mThread.native_handle(), SCHED_FIFO, &param);
+    if (ret != 0) {
+        ALOGE("%s: failed to set compose thread priority: %s", __FUNCTION__, strerror(ret));
+    }
+
+    return HWC3::Error::None;
+}
+
+HWC3::Error ComposeThread::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mStateMutex);
+        mShuttingDown = true;
+    }
+    mCondition.notify_all();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    return HWC3::Error::None;
+}
+
+std::future<HWC3::Error> ComposeThread::submit(std::function<HWC3::Error()> job) {
+    std::packaged_task<HWC3::Error()> task(std::move(job));
+    std::future<HWC3::Error> result = task.get_future();
+
+    if (!mThread.joinable()) {
+        // not started, run in caller thread.
+        task();
+        return result;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mStateMutex);
+        mJobs.push_back(std::move(task));
+    }
+    mCondition.notify_one();
+
+    return result;
+}
+
+void ComposeThread::threadLoop() {
+    DEBUG_LOG("%s", __FUNCTION__);
+
+    std::unique_lock<std::mutex> lock(mStateMutex);
+    while (true) {
+        mCondition.wait(lock, [this]() { return mShuttingDown || !mJobs.empty(); });
+        if (mJobs.empty()) {
+            // shutting down with nothing left to run.
+            break;
+        }
+
+        std::packaged_task<HWC3::Error()> task = std::move(mJobs.front());
+        mJobs.pop_front();
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+} // namespace aidl::android::hardware::graphics::composer3::impl
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HWC_COMPOSETHREAD_H
+#define ANDROID_HWC_COMPOSETHREAD_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "Common.h"
+
+namespace aidl::android::hardware::graphics::composer3::impl {
+
+// Runs device composition jobs (fence waiting and G2D blit) in submission
+// order on a dedicated thread, so that the present path can prepare planes
+// and pace the commit while the layers are still being composed.
+class ComposeThread {
+public:
+    ComposeThread() = default;
+    virtual ~ComposeThread();
+
+    ComposeThread(const ComposeThread&) = delete;
+    ComposeThread& operator=(const ComposeThread&) = delete;
+
+    ComposeThread(ComposeThread&&) = delete;
+    ComposeThread& operator=(ComposeThread&&) = delete;
+
+    HWC3::Error start();
+
+    // Queue a job, the returned future is ready when the job is done.
+    std::future<HWC3::Error> submit(std::function<HWC3::Error()> job);
+
+private:
+    HWC3::Error stop();
+
+    void threadLoop();
+
+    std::thread mThread;
+
+    std::mutex mStateMutex;
+    std::condition_variable mCondition;
+
+    bool mShuttingDown = false;
+
+    std::deque<std::packaged_task<HWC3::Error()>> mJobs;
+};
+
+} // namespace aidl::android::hardware::graphics::composer3::impl
+
+#endif
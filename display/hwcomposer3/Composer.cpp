@@ -98,7 +98,19 @@ void Composer::onClientDestroyed() {
 binder_status_t Composer::dump(int fd, const char** /*args*/, uint32_t /*numArgs*/) {
     DEBUG_LOG("%s", __FUNCTION__);
 
-    std::string output("TODO");
+    std::string output;
+    std::shared_ptr<ComposerClient> client;
+    {
+        std::lock_guard<std::mutex> lock(mClientMutex);
+        client = mClient.lock();
+    }
+    // not under mClientMutex, client may be destroyed when released here.
+    if (client) {
+        client->dump(output);
+    }
+    if (output.empty()) {
+        output = "no composer client\n";
+    }
 
     write(fd, output.c_str(), output.size());
     return STATUS_OK;
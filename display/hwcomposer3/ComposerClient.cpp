@@ -124,6 +124,26 @@ ComposerClient::~ComposerClient() {
     }
 }
 
+void ComposerClient::dump(std::string& output) {
+    DEBUG_LOG("%s", __FUNCTION__);
+
+    std::unique_lock<std::mutex> lock(mStateMutex);
+
+    for (auto& [_, display] : mDisplays) {
+        display->dump(output);
+    }
+
+    if (mComposer == nullptr) {
+        return;
+    }
+
+    std::map<uint32_t, DeviceClient*> clients;
+    mComposer->getAllDeviceClients(clients);
+    for (auto& [_, client] : clients) {
+        client->dump(output);
+    }
+}
+
 HWC3::Error ComposerClient::init() {
     DEBUG_LOG("%s", __FUNCTION__);
 
@@ -149,6 +169,15 @@ HWC3::Error ComposerClient::init() {
         return error;
     }
 
+    // drop the framebuffers cached for a buffer before its handle is freed.
+    mResources->setBufferReleaseCallback([this](buffer_handle_t handle) {
+        std::map<uint32_t, DeviceClient*> clients;
+        mComposer->getAllDeviceClients(clients);
+        for (auto& [_, client] : clients) {
+            client->releaseBuffer(handle);
+        }
+    });
+
     const auto HotplugCallback = [this](bool connected,
                                         std::unique_ptr<HalMultiConfigs> halConfigs) {
         handleHotplug(connected, std::move(halConfigs));
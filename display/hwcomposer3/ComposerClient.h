@@ -43,6 +43,9 @@ public:
 
     std::vector<Capability>& getCapabilities() { return mCapabilities; }
 
+    // Collect debug state of device clients for dumpsys.
+    void dump(std::string& output);
+
     // HWC3 interface:
     ndk::ScopedAStatus createLayer(int64_t displayId, int32_t bufferSlotCount,
                                    int64_t* layer) override;
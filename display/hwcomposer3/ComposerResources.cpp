@@ -65,9 +65,60 @@ HWC3::Error ComposerResources::init() {
     return HWC3::Error::None;
 }
 
+void ComposerResources::setBufferReleaseCallback(BufferReleaseCallback callback) {
+    mBufferReleaseCallback = std::move(callback);
+}
+
+void ComposerResources::releaseLayerBuffers(int64_t displayId, int64_t layerId,
+                                            uint32_t bufferCacheSize) {
+    ::android::hardware::graphics::composer::V2_1::Display display = toHwc2Display(displayId);
+    ::android::hardware::graphics::composer::V2_1::Layer layer = toHwc2Layer(layerId);
+    for (uint32_t slot = 0; slot < bufferCacheSize; slot++) {
+        auto releaser = createReleaser(true);
+        buffer_handle_t cached = nullptr;
+        if (mImpl->getLayerBuffer(display, layer, slot, true, nullptr, &cached,
+                                  releaser->getReplacedHandle()) ==
+                    ::android::hardware::graphics::composer::V2_1::Error::NONE &&
+            cached != nullptr) {
+            mBufferReleaseCallback(cached);
+        }
+    }
+}
+
+void ComposerResources::releaseClientTargets(int64_t displayId) {
+    ::android::hardware::graphics::composer::V2_1::Display display = toHwc2Display(displayId);
+    size_t cacheSize = 0;
+    if (mImpl->getDisplayClientTargetCacheSize(display, &cacheSize) !=
+        ::android::hardware::graphics::composer::V2_1::Error::NONE) {
+        return;
+    }
+    for (uint32_t slot = 0; slot < cacheSize; slot++) {
+        auto releaser = createReleaser(true);
+        buffer_handle_t cached = nullptr;
+        if (mImpl->getDisplayClientTarget(display, slot, true, nullptr, &cached,
+                                          releaser->getReplacedHandle()) ==
+                    ::android::hardware::graphics::composer::V2_1::Error::NONE &&
+            cached != nullptr) {
+            mBufferReleaseCallback(cached);
+        }
+    }
+}
+
 void ComposerResources::clear(
         ::android::hardware::graphics::composer::V2_2::hal::ComposerResources::RemoveDisplay
                 removeDisplay) {
+    {
+        std::lock_guard<std::mutex> lock(mLayerCacheSizesMutex);
+        if (mBufferReleaseCallback) {
+            for (const auto& [displayId, layers] : mLayerCacheSizes) {
+                for (const auto& [layerId, bufferCacheSize] : layers) {
+                    releaseLayerBuffers(displayId, layerId, bufferCacheSize);
+                }
+                releaseClientTargets(displayId);
+            }
+        }
+        mLayerCacheSizes.clear();
+    }
     mImpl->clear(std::move(removeDisplay));
 }
 
@@ -90,6 +141,21 @@ HWC3::Error ComposerResources::addVirtualDisplay(int64_t displayId,
 
 HWC3::Error ComposerResources::removeDisplay(int64_t displayId) {
     ::android::hardware::graphics::composer::V2_1::Display display = toHwc2Display(displayId);
+    {
+        std::lock_guard<std::mutex> lock(mLayerCacheSizesMutex);
+        auto it = mLayerCacheSizes.find(displayId);
+        if (it != mLayerCacheSizes.end()) {
+            if (mBufferReleaseCallback) {
+                for (const auto& [layerId, bufferCacheSize] : it->second) {
+                    releaseLayerBuffers(displayId, layerId, bufferCacheSize);
+                }
+            }
+            mLayerCacheSizes.erase(it);
+        }
+    }
+    if (mBufferReleaseCallback) {
+        releaseClientTargets(displayId);
+    }
     return toHwc3Error(mImpl->removeDisplay(display));
 }
 
@@ -117,7 +183,12 @@ HWC3::Error ComposerResources::addLayer(int64_t displayId, int64_t layerId,
 
     ::android::hardware::graphics::composer::V2_1::Display display = toHwc2Display(displayId);
     ::android::hardware::graphics::composer::V2_1::Layer layer = toHwc2Layer(layerId);
-    return toHwc3Error(mImpl->addLayer(display, layer, bufferCacheSize));
+    auto error = mImpl->addLayer(display, layer, bufferCacheSize);
+    if (error == ::android::hardware::graphics::composer::V2_1::Error::NONE) {
+        std::lock_guard<std::mutex> lock(mLayerCacheSizesMutex);
+        mLayerCacheSizes[displayId][layerId] = bufferCacheSize;
+    }
+    return toHwc3Error(error);
 }
 
 HWC3::Error ComposerResources::removeLayer(int64_t displayId, int64_t layerId) {
@@ -126,6 +197,20 @@ HWC3::Error ComposerResources::removeLayer(int64_t displayId, int64_t layerId) {
     ::android::hardware::graphics::composer::V2_1::Display display = toHwc2Display(displayId);
     ::android::hardware::graphics::composer::V2_1::Layer layer = toHwc2Layer(layerId);
 
+    {
+        std::lock_guard<std::mutex> lock(mLayerCacheSizesMutex);
+        auto it = mLayerCacheSizes.find(displayId);
+        if (it != mLayerCacheSizes.end()) {
+            auto layerIt = it->second.find(layerId);
+            if (layerIt != it->second.end()) {
+                if (mBufferReleaseCallback) {
+                    releaseLayerBuffers(displayId, layerId, layerIt->second);
+                }
+                it->second.erase(layerIt);
+            }
+        }
+    }
+
     return toHwc3Error(mImpl->removeLayer(display, layer));
 }
 
@@ -159,6 +244,17 @@ HWC3::Error ComposerResources::getDisplayClientTarget(int64_t displayId, const B
         bufferHandle = ::android::makeFromAidl(*buffer.handle);
     }
 
+    if (!useCache && mBufferReleaseCallback) {
+        auto cacheReleaser = createReleaser(true);
+        buffer_handle_t cached = nullptr;
+        if (mImpl->getDisplayClientTarget(display, buffer.slot, true, nullptr, &cached,
+                                          cacheReleaser->getReplacedHandle()) ==
+                    ::android::hardware::graphics::composer::V2_1::Error::NONE &&
+            cached != nullptr) {
+            mBufferReleaseCallback(cached);
+        }
+    }
+
     return toHwc3Error(mImpl->getDisplayClientTarget(display, buffer.slot, useCache, bufferHandle,
                                                      outHandle, releaser->getReplacedHandle()));
 }
@@ -195,6 +291,16 @@ HWC3::Error ComposerResources::getLayerBuffer(int64_t displayId, int64_t layerId
     }
 
     DEBUG_LOG("%s fromCache:%s", __FUNCTION__, (useCache ? "yes" : "no"));
+    if (!useCache && mBufferReleaseCallback) {
+        auto cacheReleaser = createReleaser(true);
+        buffer_handle_t cached = nullptr;
+        if (mImpl->getLayerBuffer(display, layer, buffer.slot, true, nullptr, &cached,
+                                  cacheReleaser->getReplacedHandle()) ==
+                    ::android::hardware::graphics::composer::V2_1::Error::NONE &&
+            cached != nullptr) {
+            mBufferReleaseCallback(cached);
+        }
+    }
     auto error = mImpl->getLayerBuffer(display, layer, buffer.slot, useCache, bufferHandle,
                                        outHandle, releaser->getReplacedHandle());
     native_handle_delete(const_cast<native_handle_t*>(bufferHandle));
@@ -26,7 +26,10 @@
 #include <composer-resources/2.2/ComposerResources.h>
 // clang-format on
 
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 
 namespace aidl::android::hardware::graphics::composer3::impl {
@@ -52,6 +55,10 @@ public:
 
     HWC3::Error init();
 
+    // Called with a cached buffer handle right before it is replaced or freed.
+    using BufferReleaseCallback = std::function<void(buffer_handle_t)>;
+    void setBufferReleaseCallback(BufferReleaseCallback callback);
+
     std::unique_ptr<ComposerResourceReleaser> createReleaser(bool isBuffer);
 
     void clear(::android::hardware::graphics::composer::V2_2::hal::ComposerResources::RemoveDisplay
@@ -101,7 +108,15 @@ public:
             buffer_handle_t* outStreamHandle, ComposerResourceReleaser* bufReleaser);
 
 private:
+    void releaseLayerBuffers(int64_t displayId, int64_t layerId, uint32_t bufferCacheSize);
+    void releaseClientTargets(int64_t displayId);
+
     std::unique_ptr< ::android::hardware::graphics::composer::V2_2::hal::ComposerResources> mImpl;
+
+    BufferReleaseCallback mBufferReleaseCallback;
+    // buffer cache size of each layer, by display and layer.
+    std::mutex mLayerCacheSizesMutex;
+    std::map<int64_t, std::map<int64_t, uint32_t>> mLayerCacheSizes;
 };
 
 } // namespace aidl::android::hardware::graphics::composer3::impl
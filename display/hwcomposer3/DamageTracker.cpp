@@ -0,0 +1,188 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DamageTracker.h"
+
+#include <gralloc_handle.h>
+
+#include "DeviceClient.h"
+
+namespace aidl::android::hardware::graphics::composer3::impl {
+
+// older frames than the number of composer targets are never needed.
+#define MAX_TRACKED_FRAMES MAX_COMPOSER_TARGETS_PER_DISPLAY
+
+static ::android::Rect toAndroidRect(const common::Rect& rect) {
+    return ::android::Rect(rect.left, rect.top, rect.right, rect.bottom);
+}
+
+static bool sameRect(const common::Rect& lhs, const common::Rect& rhs) {
+    return lhs.left == rhs.left && lhs.top == rhs.top && lhs.right == rhs.right &&
+            lhs.bottom == rhs.bottom;
+}
+
+static bool sameColor(const Color& lhs, const Color& rhs) {
+    return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b && lhs.a == rhs.a;
+}
+
+DamageTracker::LayerState DamageTracker::getLayerState(Layer* layer) {
+    LayerState state;
+    state.buffer = layer->getBuffer().getBuffer();
+    state.sourceCrop = layer->getSourceCropInt();
+    state.displayFrame = layer->getDisplayFrame();
+    state.transform = layer->getTransform();
+    state.blendMode = layer->getBlendMode();
+    state.planeAlpha = layer->getPlaneAlpha();
+    state.color = layer->getColor();
+    state.zOrder = layer->getZOrder();
+    state.composition = layer->getCompositionType();
+    for (auto& rect : layer->getVisibleRegion()) {
+        state.visible.orSelf(toAndroidRect(rect));
+    }
+    return state;
+}
+
+// Map surface damage of layer buffer into display space.
+::android::Region DamageTracker::getBufferDamage(Layer* layer) {
+    common::Rect frame = layer->getDisplayFrame();
+    ::android::Region full(toAndroidRect(frame));
+    const std::vector<common::Rect>& damage = layer->getSurfaceDamage();
+    if (damage.empty()) {
+        return full;
+    }
+
+    // only do the scaling math for the common case, rotated layers
+    // are considered as fully damaged.
+    common::Rect crop = layer->getSourceCropInt();
+    int32_t cropW = crop.right - crop.left;
+    int32_t cropH = crop.bottom - crop.top;
+    if (layer->getTransform() != common::Transform{0} || cropW <= 0 || cropH <= 0) {
+        return full;
+    }
+
+    int32_t frameW = frame.right - frame.left;
+    int32_t frameH = frame.bottom - frame.top;
+    ::android::Region region;
+    for (auto rect : damage) {
+        if (!rectIntersect(crop, rect)) {
+            continue;
+        }
+        // round to outside to cover filtered pixels.
+        ::android::Rect mapped;
+        mapped.left = frame.left + (int64_t)(rect.left - crop.left) * frameW / cropW - 1;
+        mapped.top = frame.top + (int64_t)(rect.top - crop.top) * frameH / cropH - 1;
+        mapped.right = frame.left +
+                ((int64_t)(rect.right - crop.left) * frameW + cropW - 1) / cropW + 1;
+        mapped.bottom = frame.top +
+                ((int64_t)(rect.bottom - crop.top) * frameH + cropH - 1) / cropH + 1;
+        region.orSelf(mapped);
+    }
+    return region.intersect(toAndroidRect(frame));
+}
+
+::android::Region DamageTracker::computeFrameDamage(const std::vector<Layer*>& layers) {
+    ::android::Region damage;
+    std::unordered_map<int64_t, LayerState> states;
+
+    for (auto layer : layers) {
+        LayerState state = getLayerState(layer);
+        auto it = mLayerStates.find(layer->getId());
+        if (it == mLayerStates.end()) {
+            // new layer of this target.
+            damage.orSelf(toAndroidRect(state.displayFrame));
+        } else {
+            const LayerState& last = it->second;
+            if (!sameRect(last.sourceCrop, state.sourceCrop) ||
+                !sameRect(last.displayFrame, state.displayFrame) ||
+                last.transform != state.transform || last.blendMode != state.blendMode ||
+                last.planeAlpha != state.planeAlpha || last.zOrder != state.zOrder ||
+                last.composition != state.composition) {
+                damage.orSelf(toAndroidRect(last.displayFrame));
+                damage.orSelf(toAndroidRect(state.displayFrame));
+            } else {
+                if (state.composition == Composition::SOLID_COLOR) {
+                    if (!sameColor(last.color, state.color)) {
+                        damage.orSelf(toAndroidRect(state.displayFrame));
+                    }
+                } else if (last.buffer != state.buffer) {
+                    damage.orSelf(getBufferDamage(layer));
+                }
+                // parts covered or uncovered by layers out of this target.
+                damage.orSelf(last.visible.mergeExclusive(state.visible));
+            }
+            mLayerStates.erase(it);
+        }
+        states.emplace(layer->getId(), std::move(state));
+    }
+
+    // layers gone from this target.
+    for (auto& [id, last] : mLayerStates) {
+        damage.orSelf(toAndroidRect(last.displayFrame));
+    }
+    mLayerStates = std::move(states);
+
+    return damage;
+}
+
+::android::Region DamageTracker::getRepaintRegion(const std::vector<Layer*>& layers,
+                                                  buffer_handle_t target, uint64_t generation) {
+    gralloc_handle_t handle = (gralloc_handle_t)target;
+    ::android::Rect screen(handle->width, handle->height);
+    if (generation != mGeneration || handle->width != mWidth || handle->height != mHeight) {
+        reset();
+        mGeneration = generation;
+        mWidth = handle->width;
+        mHeight = handle->height;
+    }
+
+    ::android::Region damage = computeFrameDamage(layers).intersect(screen);
+    // the bottom layer is blitted without blending, redraw all when it changes.
+    int64_t bottomLayerId = layers.empty() ? -1 : layers.front()->getId();
+    if (bottomLayerId != mBottomLayerId) {
+        damage.set(screen);
+        mBottomLayerId = bottomLayerId;
+    }
+    mFrameDamages.push_front(damage);
+    if (mFrameDamages.size() > MAX_TRACKED_FRAMES) {
+        mFrameDamages.pop_back();
+    }
+    mFrameCount++;
+
+    ::android::Region repaint(screen);
+    auto it = mTargetFrames.find(target);
+    if (it != mTargetFrames.end()) {
+        uint64_t age = mFrameCount - it->second;
+        if (age <= mFrameDamages.size()) {
+            repaint.clear();
+            for (uint64_t i = 0; i < age; i++) {
+                repaint.orSelf(mFrameDamages[i]);
+            }
+        }
+    }
+    mTargetFrames[target] = mFrameCount;
+
+    DEBUG_LOG("%s: repaint bounds(l:%d,t:%d,r:%d,b:%d)", __FUNCTION__, repaint.getBounds().left,
+              repaint.getBounds().top, repaint.getBounds().right, repaint.getBounds().bottom);
+    return repaint;
+}
+
+void DamageTracker::reset() {
+    mLayerStates.clear();
+    mFrameDamages.clear();
+    mTargetFrames.clear();
+}
+
+} // namespace aidl::android::hardware::graphics::composer3::impl
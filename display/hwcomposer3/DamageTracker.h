@@ -0,0 +1,82 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HWC_DAMAGETRACKER_H
+#define ANDROID_HWC_DAMAGETRACKER_H
+
+#include <ui/Region.h>
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "Common.h"
+#include "Layer.h"
+
+namespace aidl::android::hardware::graphics::composer3::impl {
+
+// Tracks what changed between frames composed into the same display, so that
+// device composition only needs to redraw the dirty part of a render target.
+// Render targets are recycled, so the region to redraw in one target is the
+// union of the frame damages since the target was last composed (buffer age).
+class DamageTracker {
+public:
+    DamageTracker() = default;
+
+    DamageTracker(const DamageTracker&) = delete;
+    DamageTracker& operator=(const DamageTracker&) = delete;
+
+    // Compute the region of target which must be composed again for layers.
+    // generation changes whenever composer target buffers are reallocated.
+    ::android::Region getRepaintRegion(const std::vector<Layer*>& layers, buffer_handle_t target,
+                                       uint64_t generation);
+
+    // Forget all history, the next frame will be fully composed.
+    void reset();
+
+private:
+    struct LayerState {
+        buffer_handle_t buffer;
+        common::Rect sourceCrop;
+        common::Rect displayFrame;
+        common::Transform transform;
+        common::BlendMode blendMode;
+        float planeAlpha;
+        Color color;
+        int32_t zOrder;
+        ::android::Region visible;
+        Composition composition;
+    };
+
+    ::android::Region computeFrameDamage(const std::vector<Layer*>& layers);
+    static LayerState getLayerState(Layer* layer);
+    static ::android::Region getBufferDamage(Layer* layer);
+
+    std::unordered_map<int64_t, LayerState> mLayerStates;
+    // damage of recent frames, the newest first.
+    std::deque<::android::Region> mFrameDamages;
+    // frame count when a target was last composed.
+    std::unordered_map<buffer_handle_t, uint64_t> mTargetFrames;
+    uint64_t mFrameCount = 0;
+    int64_t mBottomLayerId = -1;
+    uint64_t mGeneration = 0;
+    int32_t mWidth = 0;
+    int32_t mHeight = 0;
+};
+
+} // namespace aidl::android::hardware::graphics::composer3::impl
+
+#endif
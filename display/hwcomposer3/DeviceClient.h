@@ -54,6 +54,9 @@ public:
             const native_handle_t* handle, common::Rect displayFrame, common::Rect sourceCrop) = 0;
     virtual HWC3::Error destroyDrmFramebuffer(DrmBuffer* buffer) = 0;
 
+    // handle is about to be freed, drop what is cached for it.
+    virtual void releaseBuffer(const native_handle_t* /*handle*/) {}
+
     virtual std::tuple<HWC3::Error, ::android::base::unique_fd> flushToDisplay(
             int display, const DisplayBuffer& buffer,
             ::android::base::borrowed_fd inWaitSyncFd) = 0;
@@ -103,6 +106,9 @@ public:
     virtual HWC3::Error waitVBlank(int displayId, int64_t* timestamp) {
         return HWC3::Error::Unsupported;
     }
+
+    // append debug state for dumpsys.
+    virtual void dump(std::string& output) {}
 };
 
 } // namespace aidl::android::hardware::graphics::composer3::impl
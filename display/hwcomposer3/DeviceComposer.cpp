@@ -184,6 +184,7 @@ int DeviceComposer::prepareDeviceFrameBuffer(uint32_t width, uint32_t height, ui
 
         buffers[i] = (gralloc_handle_t)bufferHandle;
     }
+    mTargetGeneration++;
 
     return 0;
 }
@@ -192,6 +193,7 @@ int DeviceComposer::freeDeviceFrameBuffer(std::vector<gralloc_handle_t>& buffers
     for (auto buf : buffers) {
         ::android::GraphicBufferAllocator::get().free(buf);
     }
+    mTargetGeneration++;
 
     return 0;
 }
@@ -279,7 +281,7 @@ int DeviceComposer::clearRect(gralloc_handle_t target, common::Rect& rect) {
     return 0;
 }
 
-int DeviceComposer::clearWormHole(std::vector<Layer*>& layers) {
+int DeviceComposer::clearWormHole(std::vector<Layer*>& layers, const ::android::Region* repaint) {
     DEBUG_LOG("%s: clear worm hole", __FUNCTION__);
     if (mTarget == NULL) {
         ALOGE("%s: no effective render buffer", __FUNCTION__);
@@ -307,6 +309,10 @@ int DeviceComposer::clearWormHole(std::vector<Layer*>& layers) {
     // calculate worm hole.
     ::android::Region screen(::android::Rect(mTarget->width, mTarget->height));
     screen.subtractSelf(opaque);
+    if (repaint != nullptr) {
+        // the rest of worm hole is still clear in target.
+        screen.andSelf(*repaint);
+    }
     const ::android::Rect* holes = NULL;
     size_t numRect = 0;
     holes = screen.getArray(&numRect);
@@ -333,7 +339,8 @@ int DeviceComposer::clearWormHole(std::vector<Layer*>& layers) {
     return 0;
 }
 
-int DeviceComposer::composeLayerLocked(Layer* layer, bool bypass) {
+int DeviceComposer::composeLayerLocked(Layer* layer, bool bypass,
+                                       const ::android::Region* repaint) {
     DEBUG_LOG("%s: compose layer %ld", __FUNCTION__, layer->getId());
     if (layer == NULL || mTarget == NULL) {
         ALOGE("%s: invalid layer or target", __FUNCTION__);
@@ -362,8 +369,8 @@ int DeviceComposer::composeLayerLocked(Layer* layer, bool bypass) {
 
     memset(&dSurfaceX, 0, sizeof(dSurfaceX));
     bool needDither = false;
-    std::vector<common::Rect>& visible = layer->getVisibleRegion();
-    for (auto& clip : visible) {
+    std::vector<common::Rect> clips;
+    for (auto clip : layer->getVisibleRegion()) {
         if (isRectEmpty(clip)) {
             ALOGV("%s: invalid clip", __FUNCTION__);
             continue;
@@ -374,6 +381,22 @@ int DeviceComposer::composeLayerLocked(Layer* layer, bool bypass) {
             continue;
         }
 
+        if (repaint == nullptr) {
+            clips.push_back(clip);
+            continue;
+        }
+
+        // only blit the dirty part of the clip.
+        ::android::Region dirty =
+                repaint->intersect(::android::Rect(clip.left, clip.top, clip.right, clip.bottom));
+        for (auto& rect : dirty) {
+            if (!rect.isEmpty()) {
+                clips.push_back(common::Rect{rect.left, rect.top, rect.right, rect.bottom});
+            }
+        }
+    }
+
+    for (auto& clip : clips) {
         setClipping(srect, drect, clip, transform);
         ALOGV("index:%ld, sourceCrop(l:%d,t:%d,r:%d,b:%d), visible(l:%d,t:%d,r:%d,b:%d), "
               "display(l:%d,t:%d,r:%d,b:%d)",
@@ -829,7 +852,8 @@ bool DeviceComposer::checkDeviceComposition(Layer* layer) {
     return true;
 }
 
-bool DeviceComposer::composeLayers(std::vector<Layer*> layers, buffer_handle_t target) {
+bool DeviceComposer::composeLayers(std::vector<Layer*> layers, buffer_handle_t target,
+                                   const ::android::Region* repaint) {
     DEBUG_LOG("%s: %zu layers to target", __FUNCTION__, layers.size());
 
     if (!target) {
@@ -840,7 +864,7 @@ bool DeviceComposer::composeLayers(std::vector<Layer*> layers, buffer_handle_t t
     Mutex::Autolock _l(sLock);
     lockSurface((gralloc_handle_t)target);
     setRenderTarget((gralloc_handle_t)target);
-    clearWormHole(layers);
+    clearWormHole(layers, repaint);
 
     // to do composite.
     int i = 0, ret = 0;
@@ -853,7 +877,7 @@ bool DeviceComposer::composeLayers(std::vector<Layer*> layers, buffer_handle_t t
         if (layerBuffer != NULL)
             lockSurface(layerBuffer);
 
-        ret = composeLayerLocked(layer, i == 0);
+        ret = composeLayerLocked(layer, i == 0, repaint);
 
         if (layerBuffer != NULL)
             unlockSurface(layerBuffer);
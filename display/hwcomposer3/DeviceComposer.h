@@ -18,8 +18,11 @@
 #define _DEVICE_COMPOSER_H_
 
 #include <g2dExt.h>
+#include <ui/Region.h>
 #include <utils/threads.h>
 
+#include <atomic>
+
 #include "Layer.h"
 #include "gralloc_handle.h"
 
@@ -48,7 +51,11 @@ public:
     int freeDeviceFrameBuffer(std::vector<gralloc_handle_t>& buffers);
     int freeSolidColorBuffer();
 
-    bool composeLayers(std::vector<Layer*> layers, buffer_handle_t target);
+    // repaint limits composition to the dirty part of target, null to compose all.
+    bool composeLayers(std::vector<Layer*> layers, buffer_handle_t target,
+                       const ::android::Region* repaint = nullptr);
+    // changed whenever composer target buffers are allocated or freed.
+    uint64_t getTargetGeneration() { return mTargetGeneration; }
 
 private:
     void* getHandle();
@@ -56,9 +63,9 @@ private:
     // set composite target buffer.
     int setRenderTarget(gralloc_handle_t memory);
     // clear worm hole introduced by layers not cover whole screen.
-    int clearWormHole(std::vector<Layer*>& layers);
+    int clearWormHole(std::vector<Layer*>& layers, const ::android::Region* repaint);
     // compose display layer.
-    int composeLayerLocked(Layer* layer, bool bypass);
+    int composeLayerLocked(Layer* layer, bool bypass, const ::android::Region* repaint);
     // sync 2D blit engine.
     int finishComposite();
     // lock surface to get GPU specific resource.
@@ -101,6 +108,7 @@ private:
 
     gralloc_handle_t mTarget = NULL;
     gralloc_handle_t mSolidColorBuffer = NULL;
+    std::atomic<uint64_t> mTargetGeneration{0};
 
     hwc_func3 mGetAlignedSize;
     hwc_func2 mGetFlipOffset;
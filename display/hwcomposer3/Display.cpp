@@ -86,7 +86,7 @@ bool isValidPowerMode(PowerMode mode) {
 } // namespace
 
 Display::Display(FrameComposer* composer, int64_t id)
-      : mComposer(composer), mId(id), mVsyncThread(this) {
+      : mComposer(composer), mId(id), mVsyncThread(this), mFrameStats(id) {
     mVsyncStarted = false;
     setLegacyEdid();
 }
@@ -805,6 +805,7 @@ HWC3::Error Display::setExpectedPresentTime(
 
 HWC3::Error Display::validate(DisplayChanges* outChanges) {
     ATRACE_CALL();
+    FrameStats::ScopedStage stage(mFrameStats, FrameStats::kValidate);
 
     DEBUG_LOG("%s: display:%" PRId64, __FUNCTION__, mId);
 
@@ -922,6 +923,8 @@ HWC3::Error Display::present(
         return HWC3::Error::NoResources;
     }
 
+    mVsyncThread.notifyPresent();
+
     return mComposer->presentDisplay(this, outDisplayFence, outLayerFences);
 }
 
@@ -50,6 +50,7 @@
 #include "Edid.h"
 #include "FencedBuffer.h"
 #include "FrameComposer.h"
+#include "FrameStats.h"
 #include "Layer.h"
 #include "Time.h"
 #include "VsyncThread.h"
@@ -156,6 +157,15 @@ public:
     HWC3::Error takeEffectConfig(int32_t configId);
     std::optional<TimePoint>& getExpectedPresentTime() { return mExpectedPresentTime; }
     HWC3::Error checkAndWaitNextVsync(int64_t* timestamp);
+    std::optional<TimePoint> predictVsync(TimePoint after) {
+        return mVsyncThread.predictVsync(after);
+    }
+    TimePoint getPreviousVsync() { return mVsyncThread.getPreviousVsync(); }
+    FrameStats& getFrameStats() { return mFrameStats; }
+    void dump(std::string& output) {
+        mVsyncThread.dump(output);
+        mFrameStats.dump(output);
+    }
 
 private:
     bool hasConfig(int32_t configId) const;
@@ -179,6 +189,7 @@ private:
     PowerMode mPowerMode = PowerMode::OFF;
     bool mVsyncStarted = false;
     VsyncThread mVsyncThread;
+    FrameStats mFrameStats;
     FencedBuffer mClientTarget;
     FencedBuffer mReadbackBuffer;
     // Will only be non-null after the Display has been validated and
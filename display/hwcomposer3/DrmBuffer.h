@@ -60,6 +60,8 @@ private:
     uint32_t mPlanePitches[4] = {0, 0, 0, 0};
     uint32_t mPlaneOffsets[4] = {0, 0, 0, 0};
     uint64_t mPlaneModifiers[4] = {0, 0, 0, 0};
+    // inode of the dma-buf, checks a cache hit from another buffer handle.
+    uint64_t mInode = 0;
     common::Rect mDisplayFrame;
     common::Rect mSourceCrop;
     // fsl::MetaData *mMeta = NULL;
@@ -22,6 +22,7 @@
 #include <drm_fourcc.h>
 #include <gralloc_handle.h>
 #include <hwsecure_client.h>
+#include <sys/stat.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 
@@ -264,20 +265,50 @@ std::tuple<HWC3::Error, std::shared_ptr<DrmBuffer>> DrmClient::create(const nati
         return std::make_tuple(HWC3::Error::NoResources, nullptr);
     }
 
-    DrmPrimeBufferHandle primeHandle = 0;
-    int ret = drmPrimeFDToHandle(mFd.get(), memHandle->fd, &primeHandle);
-    if (ret) {
-        ALOGE("%s: drmPrimeFDToHandle failed: %s (errno %d)", __FUNCTION__, strerror(errno), errno);
-        return std::make_tuple(HWC3::Error::NoResources, nullptr);
+    // look up by gralloc buffer id first, a hit on the same fd needs no
+    // syscall on the present path.
+    uint64_t inode = 0;
+    DrmBufferKey key = memHandle->id;
+    if (key == 0) {
+        if (getDmaBufInode(memHandle->fd, &inode)) {
+            return std::make_tuple(HWC3::Error::NoResources, nullptr);
+        }
+        key = kInodeKey | inode;
     }
 
-    auto drmBufferPtr = mBufferCache->get(primeHandle);
+    std::lock_guard<std::mutex> lock(mBufferCacheMutex);
+    auto drmBufferPtr = mBufferCache->get(key);
     if (drmBufferPtr != nullptr) {
-        (*drmBufferPtr)->mDisplayFrame = displayFrame;
-        (*drmBufferPtr)->mSourceCrop = sourceCrop;
-        DEBUG_LOG("%s: found framebuffer:%" PRIu32, __FUNCTION__,
-                  *(*drmBufferPtr)->mDrmFramebuffer);
-        return std::make_tuple(HWC3::Error::None, std::shared_ptr<DrmBuffer>(*drmBufferPtr));
+        DrmBuffer* cached = drmBufferPtr->get();
+        // ids restart with the allocator service, a handle other than the
+        // one the framebuffer was made from must name the same dma-buf.
+        bool same = cached->mWidth == (uint32_t)memHandle->width &&
+                cached->mHeight == (uint32_t)memHandle->height &&
+                cached->mPlanePitches[0] == memHandle->strides[0];
+        if (same && cached->mPlaneFds[0] != (uint32_t)memHandle->fd) {
+            if (inode == 0 && getDmaBufInode(memHandle->fd, &inode)) {
+                return std::make_tuple(HWC3::Error::NoResources, nullptr);
+            }
+            same = cached->mInode == inode;
+        }
+        if (same) {
+            cached->mDisplayFrame = displayFrame;
+            cached->mSourceCrop = sourceCrop;
+            DEBUG_LOG("%s: found framebuffer:%" PRIu32, __FUNCTION__, *cached->mDrmFramebuffer);
+            return std::make_tuple(HWC3::Error::None, std::shared_ptr<DrmBuffer>(*drmBufferPtr));
+        }
+        mBufferCache->remove(key);
+    }
+
+    if (inode == 0 && getDmaBufInode(memHandle->fd, &inode)) {
+        return std::make_tuple(HWC3::Error::NoResources, nullptr);
+    }
+
+    DrmPrimeBufferHandle primeHandle = 0;
+    if (importGemHandle(memHandle->fd, &primeHandle)) {
+        ALOGE("%s: drmPrimeFDToHandle failed: %s (errno %d)", __FUNCTION__, strerror(errno),
+              errno);
+        return std::make_tuple(HWC3::Error::NoResources, nullptr);
     }
 
     uint64_t modifier;
@@ -288,6 +319,7 @@ std::tuple<HWC3::Error, std::shared_ptr<DrmBuffer>> DrmClient::create(const nati
     buffer->mSourceCrop = sourceCrop;
     buffer->mDrmFormat = ConvertNxpFormatToDrmFormat(memHandle->fslFormat, &modifier);
     buffer->mPlaneFds[0] = memHandle->fd;
+    buffer->mInode = inode;
     for (uint32_t i = 0; i < memHandle->num_planes; i++) {
         buffer->mPlaneHandles[i] = primeHandle;
         buffer->mPlanePitches[i] = memHandle->strides[i];
@@ -302,6 +334,7 @@ std::tuple<HWC3::Error, std::shared_ptr<DrmBuffer>> DrmClient::create(const nati
     // buffer->mMeta =
     // MemoryManager::getInstance()->getMetaData(const_cast<gralloc_handle_t>(memHandle));
 
+    int ret;
     uint32_t framebuffer = 0;
     uint32_t format = buffer->mDrmFormat;
     uint32_t width = buffer->mWidth;
@@ -325,17 +358,22 @@ std::tuple<HWC3::Error, std::shared_ptr<DrmBuffer>> DrmClient::create(const nati
                             buffer->mPlaneHandles, buffer->mPlanePitches, buffer->mPlaneOffsets,
                             &framebuffer, 0);
     }
+    int addFbErrno = errno;
+    if (ret) {
+        releaseGemHandle(primeHandle);
+        memset(buffer->mPlaneHandles, 0, sizeof(buffer->mPlaneHandles));
+    }
     if (ret) {
         ALOGE("%s: drmModeAddFB2 failed(buffer:size=%d, %d x %d, stride=%d, format=0x%x, modifier=0x%" PRIx64
               "): %s (errno %d)",
               __FUNCTION__, memHandle->size, memHandle->width, memHandle->height, memHandle->stride,
-              memHandle->fslFormat, buffer->mPlaneModifiers[0], strerror(errno), errno);
+              memHandle->fslFormat, buffer->mPlaneModifiers[0], strerror(addFbErrno), addFbErrno);
         return std::make_tuple(HWC3::Error::NoResources, nullptr);
     }
     DEBUG_LOG("%s: created framebuffer:%" PRIu32, __FUNCTION__, framebuffer);
     buffer->mDrmFramebuffer = framebuffer;
 
-    mBufferCache->set(primeHandle, std::shared_ptr<DrmBuffer>(buffer));
+    mBufferCache->set(key, std::shared_ptr<DrmBuffer>(buffer));
 
     return std::make_tuple(HWC3::Error::None, std::move(buffer));
 }
@@ -351,18 +389,74 @@ HWC3::Error DrmClient::destroyDrmFramebuffer(DrmBuffer* buffer) {
         buffer->mDrmFramebuffer.reset();
     }
     if (buffer->mPlaneHandles[0]) {
-        struct drm_gem_close gem_close = {};
-        gem_close.handle = buffer->mPlaneHandles[0];
-        if (drmIoctl(mFd.get(), DRM_IOCTL_GEM_CLOSE, &gem_close)) {
-            ALOGE("%s: DRM_IOCTL_GEM_CLOSE failed: %s (errno %d)", __FUNCTION__, strerror(errno),
-                  errno);
-            return HWC3::Error::NoResources;
+        releaseGemHandle(buffer->mPlaneHandles[0]);
+        memset(buffer->mPlaneHandles, 0, sizeof(buffer->mPlaneHandles));
+    }
+
+    return HWC3::Error::None;
+}
+
+void DrmClient::releaseBuffer(const native_handle_t* handle) {
+    gralloc_handle_t memHandle = (gralloc_handle_t)handle;
+    if (memHandle == nullptr) {
+        return;
+    }
+    DrmBufferKey key = memHandle->id;
+    uint64_t inode = 0;
+    if (key == 0) {
+        if (getDmaBufInode(memHandle->fd, &inode)) {
+            return;
         }
+        key = kInodeKey | inode;
+    }
 
-        mBufferCache->remove(buffer->mPlaneHandles[0]);
+    // framebuffers still on screen hold their own reference. An entry made
+    // from another handle of the buffer stays for that handle.
+    std::lock_guard<std::mutex> lock(mBufferCacheMutex);
+    auto drmBufferPtr = mBufferCache->get(key);
+    if (drmBufferPtr != nullptr && (*drmBufferPtr)->mPlaneFds[0] == (uint32_t)memHandle->fd) {
+        mBufferCache->remove(key);
     }
+}
 
-    return HWC3::Error::None;
+int DrmClient::getDmaBufInode(int fd, uint64_t* inode) {
+    struct stat st;
+    if (fstat(fd, &st)) {
+        ALOGE("%s: fstat failed: %s (errno %d)", __FUNCTION__, strerror(errno), errno);
+        return -errno;
+    }
+    *inode = st.st_ino;
+    return 0;
+}
+
+int DrmClient::importGemHandle(int fd, DrmPrimeBufferHandle* handle) {
+    std::lock_guard<std::mutex> lock(mGemHandlesMutex);
+    int ret = drmPrimeFDToHandle(mFd.get(), fd, handle);
+    if (ret) {
+        return ret;
+    }
+    mGemHandleRefs[*handle]++;
+    return 0;
+}
+
+void DrmClient::releaseGemHandle(DrmPrimeBufferHandle handle) {
+    std::lock_guard<std::mutex> lock(mGemHandlesMutex);
+    auto it = mGemHandleRefs.find(handle);
+    if (it == mGemHandleRefs.end()) {
+        ALOGE("%s: unknown GEM handle %" PRIu32, __FUNCTION__, handle);
+        return;
+    }
+    if (--it->second > 0) {
+        return;
+    }
+    mGemHandleRefs.erase(it);
+
+    struct drm_gem_close gem_close = {};
+    gem_close.handle = handle;
+    if (drmIoctl(mFd.get(), DRM_IOCTL_GEM_CLOSE, &gem_close)) {
+        ALOGE("%s: DRM_IOCTL_GEM_CLOSE failed: %s (errno %d)", __FUNCTION__, strerror(errno),
+              errno);
+    }
 }
 
 bool DrmClient::handleHotplug() {
@@ -441,8 +535,11 @@ std::tuple<HWC3::Error, ::android::base::unique_fd> DrmClient::flushToDisplay(
     ::android::RWLock::AutoRLock lock(mDisplaysMutex);
     std::unique_ptr<DrmAtomicRequest> request;
     for (auto& pair : buffer.planeDrmBuffer) {
-        auto [err, req] =
-                mDisplays[displayId]->flushOverlay(pair.first, std::move(request), pair.second);
+        auto fenceIt = buffer.planeInFences.find(pair.first);
+        ::android::base::borrowed_fd planeSyncFd =
+                (fenceIt != buffer.planeInFences.end()) ? fenceIt->second.get() : -1;
+        auto [err, req] = mDisplays[displayId]->flushOverlay(pair.first, std::move(request),
+                                                             planeSyncFd, pair.second);
         if (err != HWC3::Error::None) {
             ALOGE("%s: failed, flush overlay plane:%d failed.", __FUNCTION__, pair.first);
             return std::make_tuple(HWC3::Error::NoResources, ::android::base::unique_fd());
@@ -881,4 +978,16 @@ HWC3::Error DrmClient::waitVBlank(int displayId, int64_t* timestamp) {
 
     return HWC3::Error::None;
 }
+
+void DrmClient::dump(std::string& output) {
+    char buf[256];
+    std::unique_lock<std::mutex> lock(mBufferCacheMutex);
+    const DrmBufferCache::Stats stats = mBufferCache->getStats();
+    lock.unlock();
+    snprintf(buf, sizeof(buf),
+             "DrmClient(base id %" PRIu32 ") framebuffer cache: capacity=%zu hits=%" PRIu64
+             " misses=%" PRIu64 " evictions=%" PRIu64 "\n",
+             mDisplayBaseId, mBufferCache->capacity(), stats.hits, stats.misses, stats.evictions);
+    output += buf;
+}
 } // namespace aidl::android::hardware::graphics::composer3::impl
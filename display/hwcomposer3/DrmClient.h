@@ -24,7 +24,9 @@
 #include <xf86drmMode.h>
 
 #include <memory>
+#include <mutex>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "Common.h"
@@ -81,6 +83,7 @@ public:
                                                                common::Rect displayFrame,
                                                                common::Rect sourceCrop) override;
     HWC3::Error destroyDrmFramebuffer(DrmBuffer* buffer) override;
+    void releaseBuffer(const native_handle_t* handle) override;
 
     std::tuple<HWC3::Error, ::android::base::unique_fd> flushToDisplay(
             int display, const DisplayBuffer& buffer,
@@ -118,11 +121,27 @@ public:
                                                ClientTargetProperty* outProperty) override;
     HWC3::Error waitVBlank(int displayId, int64_t* timestamp) override;
 
+    void dump(std::string& output) override;
+
 private:
     using DrmPrimeBufferHandle = uint32_t;
-    using DrmBufferCache = LruCache<DrmPrimeBufferHandle, std::shared_ptr<DrmBuffer>>;
+    // gralloc buffer id, or inode | kInodeKey for buffers without id. The id
+    // restarts with the allocator, so a hit is only trusted for the same fd,
+    // any other handle is checked against the inode of the dma-buf.
+    using DrmBufferKey = uint64_t;
+    static constexpr DrmBufferKey kInodeKey = 1ULL << 63;
+    using DrmBufferCache = LruCache<DrmBufferKey, std::shared_ptr<DrmBuffer>>;
+    std::mutex mBufferCacheMutex;
     std::unique_ptr<DrmBufferCache> mBufferCache;
 
+    // PRIME import gives the same GEM handle for the same dma-buf, so one
+    // handle may back several framebuffers. It is closed with the last one.
+    std::mutex mGemHandlesMutex;
+    std::unordered_map<DrmPrimeBufferHandle, uint32_t> mGemHandleRefs;
+    int importGemHandle(int fd, DrmPrimeBufferHandle* handle);
+    void releaseGemHandle(DrmPrimeBufferHandle handle);
+    int getDmaBufInode(int fd, uint64_t* inode);
+
     // Grant visibility for handleHotplug to DrmEventListener.
     bool handleHotplug();
 
@@ -74,7 +74,7 @@ std::unique_ptr<DrmDisplay> DrmDisplay::create(
 
 std::tuple<HWC3::Error, std::unique_ptr<DrmAtomicRequest>> DrmDisplay::flushOverlay(
         uint32_t planeId, std::unique_ptr<DrmAtomicRequest> request,
-        const std::shared_ptr<DrmBuffer>& buffer) {
+        ::android::base::borrowed_fd inSyncFd, const std::shared_ptr<DrmBuffer>& buffer) {
     if (mPlanes.find(planeId) == mPlanes.end()) {
         ALOGE("%s: Not find the plane:%d to flush", __FUNCTION__, planeId);
         return std::make_tuple(HWC3::Error::BadParameter, std::move(request));
@@ -106,6 +106,7 @@ std::tuple<HWC3::Error, std::unique_ptr<DrmAtomicRequest>> DrmDisplay::flushOver
     DrmPlane* plane = mPlanes[planeId].get();
     bool okay = true;
     okay &= request->Set(planeId, plane->getCrtcProperty(), mCrtc->getId());
+    okay &= request->Set(planeId, plane->getInFenceProperty(), inSyncFd.get());
     okay &= request->Set(planeId, plane->getFbProperty(), *buffer->mDrmFramebuffer);
     okay &= request->Set(planeId, plane->getCrtcXProperty(), x0);
     okay &= request->Set(planeId, plane->getCrtcYProperty(), y0);
@@ -50,6 +50,8 @@ struct DisplayBuffer {
     std::shared_ptr<DrmBuffer> clientTargetDrmBuffer;
     std::unordered_map<uint32_t, std::shared_ptr<DrmBuffer>> planeDrmBuffer;
     std::unordered_map<gralloc_handle_t, std::shared_ptr<DrmBuffer>> dummyDrmBuffer;
+    // acquire fences of overlay buffers, waited by KMS instead of HWC.
+    std::unordered_map<uint32_t, ::android::base::unique_fd> planeInFences;
 };
 
 class DrmDisplay {
@@ -78,7 +80,7 @@ public:
 
     std::tuple<HWC3::Error, std::unique_ptr<DrmAtomicRequest>> flushOverlay(
             uint32_t planeId, std::unique_ptr<DrmAtomicRequest> request,
-            const std::shared_ptr<DrmBuffer>& buffer);
+            ::android::base::borrowed_fd inWaitSyncFd, const std::shared_ptr<DrmBuffer>& buffer);
 
     std::tuple<HWC3::Error, std::unique_ptr<DrmAtomicRequest>> flushPrimary(
             uint32_t planeId, std::unique_ptr<DrmAtomicRequest> request,
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameStats.h"
+
+#include <algorithm>
+
+namespace aidl::android::hardware::graphics::composer3::impl {
+namespace {
+
+const char* const kStageNames[FrameStats::kStageCount] = {
+        "validate", "fence_wait", "compose", "commit", "vsync_to_present",
+};
+
+} // namespace
+
+FrameStats::FrameStats(int64_t displayId) : mDisplayId(displayId) {
+    for (int i = 0; i < kStageCount; i++) {
+        mCounterNames[i] = "HWC3 display " + std::to_string(displayId) + " " + kStageNames[i] +
+                " (us)";
+    }
+}
+
+void FrameStats::record(Stage stage, Nanoseconds duration) {
+    const int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    StageRecord& record = mStages[stage];
+
+    // the slot is claimed first, a reader may see the previous sample of it.
+    uint64_t index = record.count.fetch_add(1, std::memory_order_relaxed);
+    record.samples[index & (kRingSize - 1)].store(us, std::memory_order_relaxed);
+
+    size_t bucket = std::upper_bound(kBucketLimitsUs.begin(), kBucketLimitsUs.end(), us - 1) -
+            kBucketLimitsUs.begin();
+    record.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    int64_t max = record.max.load(std::memory_order_relaxed);
+    while (us > max && !record.max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+
+    if (ATRACE_ENABLED()) {
+        ATRACE_INT64(mCounterNames[stage].c_str(), us);
+    }
+}
+
+void FrameStats::dump(std::string& output) const {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "display %" PRId64 " frame stats (us):\n", mDisplayId);
+    output += buf;
+
+    std::array<int64_t, kRingSize> samples;
+    for (int i = 0; i < kStageCount; i++) {
+        const StageRecord& record = mStages[i];
+        uint64_t total = record.count.load(std::memory_order_relaxed);
+        if (total == 0) {
+            continue;
+        }
+
+        size_t n = std::min<uint64_t>(total, kRingSize);
+        for (size_t j = 0; j < n; j++) {
+            samples[j] = record.samples[j].load(std::memory_order_relaxed);
+        }
+        std::sort(samples.begin(), samples.begin() + n);
+        auto percentile = [&](int p) { return samples[(n - 1) * p / 100]; };
+
+        snprintf(buf, sizeof(buf),
+                 "  %-16s frames %" PRIu64 " p50 %" PRId64 " p90 %" PRId64 " p99 %" PRId64
+                 " max %" PRId64 "\n",
+                 kStageNames[i], total, percentile(50), percentile(90), percentile(99),
+                 record.max.load(std::memory_order_relaxed));
+        output += buf;
+
+        output += "    histogram:";
+        for (size_t b = 0; b < kBucketCount; b++) {
+            if (b < kBucketLimitsUs.size()) {
+                snprintf(buf, sizeof(buf), " <=%" PRId64 ":%" PRIu64, kBucketLimitsUs[b],
+                         record.histogram[b].load(std::memory_order_relaxed));
+            } else {
+                snprintf(buf, sizeof(buf), " >%" PRId64 ":%" PRIu64, kBucketLimitsUs.back(),
+                         record.histogram[b].load(std::memory_order_relaxed));
+            }
+            output += buf;
+        }
+        output += "\n";
+    }
+}
+
+} // namespace aidl::android::hardware::graphics::composer3::impl
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HWC_FRAMESTATS_H
+#define ANDROID_HWC_FRAMESTATS_H
+
+#include <array>
+#include <atomic>
+#include <string>
+
+#include "Common.h"
+
+namespace aidl::android::hardware::graphics::composer3::impl {
+
+// Per display timing of the present path stages. Samples are kept in lock
+// free rings, so they can be recorded from the binder and compose threads
+// while dumpsys reads them. Each sample is also emitted as an atrace counter,
+// which shows up as a counter track in Perfetto.
+class FrameStats {
+public:
+    enum Stage {
+        kValidate = 0,
+        kFenceWait,
+        kCompose,
+        kCommit,
+        kVsyncToPresent,
+        kStageCount,
+    };
+
+    explicit FrameStats(int64_t displayId);
+
+    FrameStats(const FrameStats&) = delete;
+    FrameStats& operator=(const FrameStats&) = delete;
+
+    void record(Stage stage, Nanoseconds duration);
+
+    // print percentiles of recent samples and histograms of all samples.
+    void dump(std::string& output) const;
+
+    // Records the lifetime of the object as one sample of the stage.
+    class ScopedStage {
+    public:
+        ScopedStage(FrameStats& stats, Stage stage)
+              : mStats(stats), mStage(stage), mStart(std::chrono::steady_clock::now()) {}
+        ~ScopedStage() { mStats.record(mStage, std::chrono::steady_clock::now() - mStart); }
+
+    private:
+        FrameStats& mStats;
+        const Stage mStage;
+        const TimePoint mStart;
+    };
+
+private:
+    static constexpr size_t kRingSize = 256; // must be power of two
+    static constexpr size_t kBucketCount = 10;
+    // upper bound of each histogram bucket in microseconds, the last is unbounded.
+    static constexpr std::array<int64_t, kBucketCount - 1> kBucketLimitsUs = {
+            250, 500, 1000, 2000, 4000, 8000, 16000, 33000, 66000};
+
+    struct StageRecord {
+        std::array<std::atomic<int64_t>, kRingSize> samples{};
+        std::atomic<uint64_t> count{0};
+        std::array<std::atomic<uint64_t>, kBucketCount> histogram{};
+        std::atomic<int64_t> max{0};
+    };
+
+    const int64_t mDisplayId;
+    std::array<std::string, kStageCount> mCounterNames;
+    std::array<StageRecord, kStageCount> mStages;
+};
+
+} // namespace aidl::android::hardware::graphics::composer3::impl
+
+#endif
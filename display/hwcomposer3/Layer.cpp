@@ -85,9 +85,20 @@ buffer_handle_t Layer::waitAndGetBuffer() {
     return mBuffer.getBuffer();
 }
 
-HWC3::Error Layer::setSurfaceDamage(const std::vector<std::optional<common::Rect>>& /*damage*/) {
+HWC3::Error Layer::setSurfaceDamage(const std::vector<std::optional<common::Rect>>& damage) {
     DEBUG_LOG("%s: layer:%" PRId64, __FUNCTION__, mId);
 
+    mSurfaceDamage.clear();
+    for (const auto& rect : damage) {
+        if (rect) {
+            mSurfaceDamage.push_back(*rect);
+        }
+    }
+    // keep an empty rect to tell no damage from whole buffer damage.
+    if (mSurfaceDamage.empty() && !damage.empty()) {
+        mSurfaceDamage.push_back(common::Rect{0, 0, 0, 0});
+    }
+
     return HWC3::Error::None;
 }
 
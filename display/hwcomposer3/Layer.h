@@ -58,6 +58,8 @@ public:
     buffer_handle_t waitAndGetBuffer();
 
     HWC3::Error setSurfaceDamage(const std::vector<std::optional<common::Rect>>& damage);
+    // damage in buffer space, empty means the whole buffer is damaged.
+    const std::vector<common::Rect>& getSurfaceDamage() const { return mSurfaceDamage; }
 
     HWC3::Error setBlendMode(common::BlendMode mode);
     common::BlendMode getBlendMode() const;
@@ -122,6 +124,7 @@ private:
     common::FRect mSourceCrop = {0.0f, 0.0f, -1.0f, -1.0f};
     common::Transform mTransform = common::Transform{0};
     std::vector<common::Rect> mVisibleRegion;
+    std::vector<common::Rect> mSurfaceDamage;
     int32_t mZOrder = 0;
     std::optional<std::array<float, 16>> mColorTransform;
     float mBrightness = 1.0f;
@@ -14,68 +14,222 @@
 
 #pragma once
 
-#include <list>
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
 
-template <typename Key, typename Value>
+// Fixed capacity LRU cache. All storage is allocated by the constructor: keys
+// are found by linear probing in an open-addressed table, and the recency list
+// is threaded through the entries by index, so get/set/remove never allocate.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
 class LruCache {
 public:
-    LruCache(std::size_t maxSize) : m_maxSize(maxSize) { m_table.reserve(maxSize); }
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    LruCache(std::size_t maxSize)
+          : m_maxSize(maxSize), m_entries(maxSize), m_slots(tableSizeFor(maxSize), kNone) {
+        m_mask = m_slots.size() - 1;
+        resetLists();
+    }
 
     Value* get(const Key& key) {
-        auto tableIt = m_table.find(key);
-        if (tableIt == m_table.end()) {
+        std::size_t slot = find(key);
+        if (slot == kNotFound) {
+            m_stats.misses++;
             return nullptr;
         }
 
-        // Move to front.
-        auto elementsIt = tableIt->second;
-        m_elements.splice(elementsIt, m_elements, m_elements.begin());
-        return &elementsIt->value;
+        m_stats.hits++;
+        int32_t index = m_slots[slot];
+        moveToFront(index);
+        return &m_entries[index].value;
     }
 
     void set(const Key& key, Value&& value) {
-        auto tableIt = m_table.find(key);
-        if (tableIt == m_table.end()) {
-            if (m_table.size() >= m_maxSize) {
-                auto& kv = m_elements.back();
-                m_table.erase(kv.key);
-                m_elements.pop_back();
-            }
+        std::size_t slot = find(key);
+        if (slot != kNotFound) {
+            int32_t index = m_slots[slot];
+            // release the old value after the cache is consistent again.
+            Value old = std::move(m_entries[index].value);
+            m_entries[index].value = std::forward<Value>(value);
+            moveToFront(index);
+            return;
+        }
+        if (m_maxSize == 0) {
+            return;
+        }
+
+        Value evicted;
+        int32_t index = m_free;
+        if (index != kNone) {
+            m_free = m_entries[index].next;
         } else {
-            auto elementsIt = tableIt->second;
-            m_elements.erase(elementsIt);
-        }
-        m_elements.emplace_front(KeyValue{
-                key,
-                std::forward<Value>(value),
-        });
-        m_table[key] = m_elements.begin();
+            index = m_tail;
+            m_stats.evictions++;
+            unlink(index);
+            eraseSlot(m_entries[index].slot);
+            evicted = std::move(m_entries[index].value);
+        }
+
+        Entry& entry = m_entries[index];
+        entry.key = key;
+        entry.value = std::forward<Value>(value);
+        slot = homeSlot(key);
+        while (m_slots[slot] != kNone) {
+            slot = (slot + 1) & m_mask;
+        }
+        m_slots[slot] = index;
+        entry.slot = slot;
+        pushFront(index);
     }
 
     void remove(const Key& key) {
-        auto tableIt = m_table.find(key);
-        if (tableIt == m_table.end()) {
+        std::size_t slot = find(key);
+        if (slot == kNotFound) {
             return;
         }
-        auto elementsIt = tableIt->second;
-        m_elements.erase(elementsIt);
-        m_table.erase(tableIt);
+
+        int32_t index = m_slots[slot];
+        unlink(index);
+        eraseSlot(slot);
+        Value old = std::move(m_entries[index].value);
+        m_entries[index].next = m_free;
+        m_free = index;
     }
 
     void clear() {
-        m_elements.clear();
-        m_table.clear();
+        std::fill(m_slots.begin(), m_slots.end(), kNone);
+        resetLists();
+        // values may call back into the cache when destroyed, drop them last.
+        for (auto& entry : m_entries) {
+            Value old = std::move(entry.value);
+        }
     }
 
+    std::size_t capacity() const { return m_maxSize; }
+    const Stats& getStats() const { return m_stats; }
+
 private:
-    struct KeyValue {
-        Key key;
-        Value value;
+    static constexpr int32_t kNone = -1;
+    static constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+    struct Entry {
+        Key key{};
+        Value value{};
+        int32_t prev = kNone;
+        int32_t next = kNone;
+        std::size_t slot = 0;
     };
 
+    // keep the table at most half full so probe sequences stay short.
+    static std::size_t tableSizeFor(std::size_t maxSize) {
+        std::size_t size = 2;
+        while (size < maxSize * 2) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    std::size_t homeSlot(const Key& key) const {
+        // spread sequential keys such as buffer ids over the table.
+        uint64_t h = static_cast<uint64_t>(m_hash(key));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<std::size_t>(h) & m_mask;
+    }
+
+    std::size_t find(const Key& key) const {
+        std::size_t slot = homeSlot(key);
+        while (m_slots[slot] != kNone) {
+            if (m_entries[m_slots[slot]].key == key) {
+                return slot;
+            }
+            slot = (slot + 1) & m_mask;
+        }
+        return kNotFound;
+    }
+
+    // Backward shift deletion, no tombstone is left in the probe sequences.
+    void eraseSlot(std::size_t hole) {
+        std::size_t next = (hole + 1) & m_mask;
+        while (m_slots[next] != kNone) {
+            int32_t index = m_slots[next];
+            std::size_t home = homeSlot(m_entries[index].key);
+            if (((next - home) & m_mask) >= ((next - hole) & m_mask)) {
+                m_slots[hole] = index;
+                m_entries[index].slot = hole;
+                hole = next;
+            }
+            next = (next + 1) & m_mask;
+        }
+        m_slots[hole] = kNone;
+    }
+
+    void resetLists() {
+        m_head = kNone;
+        m_tail = kNone;
+        m_free = kNone;
+        for (int32_t i = static_cast<int32_t>(m_entries.size()) - 1; i >= 0; i--) {
+            m_entries[i].prev = kNone;
+            m_entries[i].next = m_free;
+            m_free = i;
+        }
+    }
+
+    void unlink(int32_t index) {
+        Entry& entry = m_entries[index];
+        if (entry.prev != kNone) {
+            m_entries[entry.prev].next = entry.next;
+        } else {
+            m_head = entry.next;
+        }
+        if (entry.next != kNone) {
+            m_entries[entry.next].prev = entry.prev;
+        } else {
+            m_tail = entry.prev;
+        }
+        entry.prev = kNone;
+        entry.next = kNone;
+    }
+
+    void pushFront(int32_t index) {
+        Entry& entry = m_entries[index];
+        entry.prev = kNone;
+        entry.next = m_head;
+        if (m_head != kNone) {
+            m_entries[m_head].prev = index;
+        }
+        m_head = index;
+        if (m_tail == kNone) {
+            m_tail = index;
+        }
+    }
+
+    void moveToFront(int32_t index) {
+        if (index == m_head) {
+            return;
+        }
+        unlink(index);
+        pushFront(index);
+    }
+
     const std::size_t m_maxSize;
-    // Front is the most recently used and back is the least recently used.
-    std::list<KeyValue> m_elements;
-    std::unordered_map<Key, typename std::list<KeyValue>::iterator> m_table;
+    Hash m_hash;
+    std::vector<Entry> m_entries;
+    // index into m_entries, or kNone for an empty slot.
+    std::vector<int32_t> m_slots;
+    std::size_t m_mask = 0;
+    // Head is the most recently used and tail is the least recently used.
+    int32_t m_head = kNone;
+    int32_t m_tail = kNone;
+    // unused entries, chained through next.
+    int32_t m_free = kNone;
+    Stats m_stats;
 };
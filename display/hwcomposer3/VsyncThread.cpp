@@ -40,6 +40,9 @@ TimePoint GetNextVsyncInPhase(Nanoseconds vsyncPeriod, TimePoint previousVsync,
     return previousVsync + (nextMultiple * vsyncPeriod);
 }
 
+// no frame presented for this long, predicted vsync replaces the hardware one.
+constexpr Nanoseconds kIdleTime = std::chrono::milliseconds(100);
+
 } // namespace
 
 VsyncThread::VsyncThread(Display* display) : mDisplayId(display->getId()), mDisplay(display) {}
@@ -53,6 +56,7 @@ HWC3::Error VsyncThread::start(int32_t vsyncPeriodNanos) {
 
     mVsyncPeriod = Nanoseconds(vsyncPeriodNanos);
     mPreviousVsync = std::chrono::steady_clock::now() - mVsyncPeriod;
+    mPredictor.setPeriod(vsyncPeriodNanos);
 
     mThread = std::thread([this]() { threadLoop(); });
 
@@ -107,6 +111,7 @@ HWC3::Error VsyncThread::scheduleVsyncUpdate(int32_t configId, int32_t newVsyncP
     std::chrono::time_point<std::chrono::steady_clock> updateTime;
     if (constraints.desiredTimeNanos == 0) { // take effect immediately
         mVsyncPeriod = Nanoseconds(newVsyncPeriod);
+        mPredictor.setPeriod(newVsyncPeriod);
         mDisplay->takeEffectConfig(configId);
         updateTime = mPreviousVsync;
     } else {
@@ -131,6 +136,7 @@ HWC3::Error VsyncThread::scheduleVsyncUpdate(int32_t configId, int32_t newVsyncP
 Nanoseconds VsyncThread::updateVsyncPeriodLocked(TimePoint now) {
     if (mPendingUpdate && now > mPendingUpdate->updateAfter) {
         mVsyncPeriod = mPendingUpdate->period;
+        mPredictor.setPeriod(mVsyncPeriod.count());
         mDisplay->takeEffectConfig(mPendingUpdate->configId);
         mPendingUpdate.reset();
     }
@@ -138,6 +144,28 @@ Nanoseconds VsyncThread::updateVsyncPeriodLocked(TimePoint now) {
     return mVsyncPeriod;
 }
 
+void VsyncThread::notifyPresent() {
+    mLastPresentNanos.store(asNanosTimePoint(std::chrono::steady_clock::now()));
+}
+
+std::optional<TimePoint> VsyncThread::predictVsync(TimePoint after) {
+    const int64_t afterNanos = asNanosTimePoint(after);
+    if (!mPredictor.isModelValid(afterNanos)) {
+        return std::nullopt;
+    }
+    return asTimePoint(mPredictor.nextVsyncTime(afterNanos));
+}
+
+TimePoint VsyncThread::getPreviousVsync() {
+    std::lock_guard<std::mutex> lock(mStateMutex);
+    return mPreviousVsync;
+}
+
+void VsyncThread::dump(std::string& output) {
+    output += "display " + std::to_string(mDisplayId) + " ";
+    mPredictor.dump(output);
+}
+
 void VsyncThread::threadLoop() {
     ALOGI("Vsync thread for display:%" PRId64 " starting", mDisplayId);
 
@@ -151,16 +179,34 @@ void VsyncThread::threadLoop() {
         int64_t timestamp = 0;
         TimePoint vsyncTime;
         TimePoint now = std::chrono::steady_clock::now();
-        if (mVsyncEnabled && (mDisplay->checkAndWaitNextVsync(&timestamp) == HWC3::Error::None)) {
-            if (timestamp == 0)
+        const int64_t nowNanos = asNanosTimePoint(now);
+        const bool modelValid = mPredictor.isModelValid(nowNanos);
+        // idle display doesn't need vblank interrupts while the model is
+        // fresh, the model ages out and forces a hardware vsync once in a while.
+        const bool idle = modelValid && (nowNanos - mLastPresentNanos.load()) > kIdleTime.count();
+        if (mVsyncEnabled && !idle &&
+            (mDisplay->checkAndWaitNextVsync(&timestamp) == HWC3::Error::None)) {
+            if (timestamp == 0) {
                 vsyncTime = now;
-            else
+            } else {
                 vsyncTime = asTimePoint(timestamp);
+                mPredictor.addVsyncTimestamp(timestamp);
+            }
 
             if (lasttime != 0) {
-                DEBUG_LOG("hardware vsync period: %" PRIu64, timestamp - lasttime);
+                DEBUG_LOG("hardware vsync period: %" PRIu64 ", model error: %" PRId64,
+                          timestamp - lasttime, mPredictor.getError());
             }
             lasttime = timestamp;
+        } else if (modelValid) {
+            TimePoint nextVsync = asTimePoint(mPredictor.nextVsyncTime(nowNanos));
+            // don't send the same vsync twice when woken up early.
+            if (nextVsync - mPreviousVsync < vsyncPeriod / 2) {
+                nextVsync = asTimePoint(
+                        mPredictor.nextVsyncTime(asNanosTimePoint(mPreviousVsync)));
+            }
+            std::this_thread::sleep_until(nextVsync);
+            vsyncTime = nextVsync;
         } else {
             TimePoint nextVsync = GetNextVsyncInPhase(vsyncPeriod, mPreviousVsync, now);
             std::this_thread::sleep_until(nextVsync);
@@ -185,8 +231,10 @@ void VsyncThread::threadLoop() {
 
         static constexpr const int kLogIntervalSeconds = 60;
         if (now > (previousLog + std::chrono::seconds(kLogIntervalSeconds))) {
-            DEBUG_LOG("%s: for display:%" PRIu64 " send %" PRIu32 " in last %d seconds",
-                      __FUNCTION__, mDisplayId, vsyncs, kLogIntervalSeconds);
+            DEBUG_LOG("%s: for display:%" PRIu64 " send %" PRIu32 " in last %d seconds, "
+                      "vsync model error %" PRId64 "ns",
+                      __FUNCTION__, mDisplayId, vsyncs, kLogIntervalSeconds,
+                      mPredictor.getError());
             previousLog = now;
             vsyncs = 0;
         }
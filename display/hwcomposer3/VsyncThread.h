@@ -22,12 +22,15 @@
 #include <aidl/android/hardware/graphics/composer3/VsyncPeriodChangeTimeline.h>
 #include <android/hardware/graphics/common/1.0/types.h>
 
+#include <atomic>
 #include <chrono>
 #include <mutex>
 #include <optional>
+#include <string>
 #include <thread>
 
 #include "Common.h"
+#include "VsyncPredictor.h"
 
 namespace aidl::android::hardware::graphics::composer3::impl {
 
@@ -55,6 +58,18 @@ public:
             const VsyncPeriodChangeConstraints& newVsyncPeriodChangeConstraints,
             VsyncPeriodChangeTimeline* timeline);
 
+    // a frame is being presented, hardware vsync is needed again.
+    void notifyPresent();
+
+    // predicted time of first hardware vsync after the given time, no value
+    // when hardware vsync is not modelled yet.
+    std::optional<std::chrono::time_point<std::chrono::steady_clock>> predictVsync(
+            std::chrono::time_point<std::chrono::steady_clock> after);
+
+    std::chrono::time_point<std::chrono::steady_clock> getPreviousVsync();
+
+    void dump(std::string& output);
+
 private:
     HWC3::Error stop();
 
@@ -84,6 +99,11 @@ private:
         int32_t configId;
     };
     std::optional<PendingUpdate> mPendingUpdate;
+
+    // hardware vsync timeline, lets the thread skip waiting for vblank
+    // interrupts while no frame is presented.
+    fsl::VsyncPredictor mPredictor;
+    std::atomic<int64_t> mLastPresentNanos{0};
 };
 
 } // namespace aidl::android::hardware::graphics::composer3::impl
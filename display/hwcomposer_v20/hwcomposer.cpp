@@ -269,8 +269,31 @@ static int hwc2_set_layer_blend_mode(hwc2_device_t* device, hwc2_display_t displ
     return HWC2_ERROR_NONE;
 }
 
-static int hwc2_set_layer_surface_dmage(hwc2_device_t* /*device*/, hwc2_display_t /*display*/,
-                                        hwc2_layer_t /*layer*/, hwc_region_t /*damage*/) {
+static int hwc2_set_layer_surface_dmage(hwc2_device_t* device, hwc2_display_t display,
+                                        hwc2_layer_t layer, hwc_region_t damage) {
+    if (!device) {
+        ALOGE("%s invalid device", __func__);
+        return HWC2_ERROR_BAD_PARAMETER;
+    }
+
+    Layer* pLayer = hwc2_get_layer(display, layer);
+    if (pLayer == NULL) {
+        ALOGE("%s get layer failed", __func__);
+        return HWC2_ERROR_BAD_PARAMETER;
+    }
+
+    // no rect means the whole buffer is damaged.
+    pLayer->surfaceDamage.clear();
+    pLayer->surfaceDamageValid = damage.numRects > 0;
+    for (size_t n = 0; n < damage.numRects; n++) {
+        const hwc_rect_t& hrect = damage.rects[n];
+        Rect rect(hrect.left, hrect.top, hrect.right, hrect.bottom);
+        if (rect.isEmpty()) {
+            continue;
+        }
+        pLayer->surfaceDamage.orSelf(rect);
+    }
+
     return HWC2_ERROR_NONE;
 }
 
@@ -16,6 +16,7 @@ LOCAL_SRC_FILES := \
     VideoTex.cpp \
     StreamHandler.cpp \
     FormatConvert.cpp \
+    YuvConvert.cpp \
     RenderPixelCopy.cpp
 
 LOCAL_SHARED_LIBRARIES := \
@@ -52,6 +53,16 @@ LOCAL_CFLAGS += -Wall -Werror -Wunused -Wunreachable-code
 
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := \
+    yuv_convert_bench.cpp \
+    YuvConvert.cpp
+
+LOCAL_MODULE:= imx_evs_yuv_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += -Wall -Werror -Wunused -Wunreachable-code
+include $(BUILD_EXECUTABLE)
+
 include $(CLEAR_VARS)
 LOCAL_MODULE := ImxConfig.json
 LOCAL_MODULE_CLASS := ETC
@@ -47,7 +47,7 @@ void copyYV12toRGB32(unsigned width, unsigned height, uint8_t* src, uint32_t* ds
 // The NV21 format provides a Y array of 8bit values, followed by a 1/2 x 1/2 interleaved
 // U/V array.  It assumes an even width and height for the overall image, and a horizontal
 // stride that is an even multiple of 16 bytes for both the Y and UV arrays.
-void copyYUYVtoRGB32(unsigned width, unsigned height, uint8_t* src, unsigned srcStrideBytes,
+void copyYUYVtoRGB32(unsigned width, unsigned height, uint8_t* src, unsigned srcStridePixels,
                      uint32_t* dst, unsigned dstStrideBytes);
 
 // Given an simple rectangular image buffer with an integer number of bytes per pixel,
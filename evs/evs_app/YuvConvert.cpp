@@ -0,0 +1,511 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "YuvConvert.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#endif
+
+// yScale = 255 / 219 for the limited range, chroma weights from Kr and Kb of
+// the standard, scaled by 255 / 224 for the limited range:
+//   rv = 2 (1 - Kr), bu = 2 (1 - Kb), gu = 2 Kb (1 - Kb) / Kg, gv = 2 Kr (1 - Kr) / Kg
+static const YuvMatrix sMatrices[YUV_COLOR_SPACE_COUNT] = {
+        {16, 9539, 13075, 3209, 6660, 16525}, // BT.601 limited
+        {0, 8192, 11485, 2819, 5850, 14516},  // BT.601 full
+        {16, 9539, 14686, 1747, 4366, 17305}, // BT.709 limited
+        {0, 8192, 12901, 1535, 3835, 15201},  // BT.709 full
+};
+
+const YuvMatrix& getYuvMatrix(YuvColorSpace colorSpace) {
+    if (colorSpace < 0 || colorSpace >= YUV_COLOR_SPACE_COUNT)
+        colorSpace = YUV_BT601_LIMITED;
+    return sMatrices[colorSpace];
+}
+
+/*======== generic C ======== */
+static inline uint32_t clampChannel(int c) {
+    c >>= YUV_SHIFT;
+    return c < 0 ? 0 : (c > 255 ? 255 : c);
+}
+
+static inline uint32_t yuvToRgbx(int Y, int U, int V, const YuvMatrix& m) {
+    int y = (Y - m.yOffset) * m.yScale + (1 << (YUV_SHIFT - 1));
+    int u = U - 128;
+    int v = V - 128;
+    uint32_t r = clampChannel(y + m.rv * v);
+    uint32_t g = clampChannel(y - m.gu * u - m.gv * v);
+    uint32_t b = clampChannel(y + m.bu * u);
+    return r | (g << 8) | (b << 16) | 0xff000000;
+}
+
+// convert the pixels [begin, end), the SIMD versions finish their tail with it.
+static void planarRangeC(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* dst,
+                         int begin, int end, const YuvMatrix& m) {
+    for (int c = begin; c < end; c++) {
+        dst[c] = yuvToRgbx(y[c], u[c / 2], v[c / 2], m);
+    }
+}
+
+static void semiPlanarRangeC(const uint8_t* y, const uint8_t* uv, uint32_t* dst, int begin,
+                             int end, const YuvMatrix& m) {
+    for (int c = begin; c < end; c++) {
+        dst[c] = yuvToRgbx(y[c], uv[c & ~1], uv[c | 1], m);
+    }
+}
+
+static void packedRangeC(const uint8_t* yuyv, uint32_t* dst, int begin, int end,
+                         const YuvMatrix& m) {
+    for (int c = begin; c + 1 < end; c += 2) {
+        const uint8_t* p = yuyv + c * 2;
+        dst[c] = yuvToRgbx(p[0], p[1], p[3], m);
+        dst[c + 1] = yuvToRgbx(p[2], p[1], p[3], m);
+    }
+}
+
+static void planarC(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* dst,
+                    int width, const YuvMatrix& m) {
+    planarRangeC(y, u, v, dst, 0, width, m);
+}
+
+static void semiPlanarC(const uint8_t* y, const uint8_t* uv, uint32_t* dst, int width,
+                        const YuvMatrix& m) {
+    semiPlanarRangeC(y, uv, dst, 0, width, m);
+}
+
+static void packedC(const uint8_t* yuyv, uint32_t* dst, int width, const YuvMatrix& m) {
+    packedRangeC(yuyv, dst, 0, width, m);
+}
+
+static const YuvKernels sKernelsC = {
+        "c",
+        planarC,
+        semiPlanarC,
+        packedC,
+};
+
+#if defined(__aarch64__)
+/*======== NEON ======== */
+// One channel of 8 pixels, y and c are already centered.
+static inline uint8x8_t channelNeon(int16x8_t y, int16x8_t c, int16_t ys, int16_t k) {
+    int32x4_t lo = vmull_n_s16(vget_low_s16(y), ys);
+    lo = vmlal_n_s16(lo, vget_low_s16(c), k);
+    int32x4_t hi = vmull_n_s16(vget_high_s16(y), ys);
+    hi = vmlal_n_s16(hi, vget_high_s16(c), k);
+    // rounding shift then saturation to 16 and 8 bits: the clamp of the C code
+    return vqmovun_s16(vcombine_s16(vqrshrn_n_s32(lo, YUV_SHIFT), vqrshrn_n_s32(hi, YUV_SHIFT)));
+}
+
+static inline uint8x8_t greenNeon(int16x8_t y, int16x8_t u, int16x8_t v, const YuvMatrix& m) {
+    int32x4_t lo = vmull_n_s16(vget_low_s16(y), m.yScale);
+    lo = vmlsl_n_s16(lo, vget_low_s16(u), m.gu);
+    lo = vmlsl_n_s16(lo, vget_low_s16(v), m.gv);
+    int32x4_t hi = vmull_n_s16(vget_high_s16(y), m.yScale);
+    hi = vmlsl_n_s16(hi, vget_high_s16(u), m.gu);
+    hi = vmlsl_n_s16(hi, vget_high_s16(v), m.gv);
+    return vqmovun_s16(vcombine_s16(vqrshrn_n_s32(lo, YUV_SHIFT), vqrshrn_n_s32(hi, YUV_SHIFT)));
+}
+
+// 8 pixels, u and v hold the chroma of each pixel.
+static inline void rgbNeon(uint8x8_t y8, int16x8_t u, int16x8_t v, const YuvMatrix& m,
+                           uint8x8_t* r, uint8x8_t* g, uint8x8_t* b) {
+    int16x8_t y = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y8)), vdupq_n_s16(m.yOffset));
+    *r = channelNeon(y, v, m.yScale, m.rv);
+    *g = greenNeon(y, u, v, m);
+    *b = channelNeon(y, u, m.yScale, m.bu);
+}
+
+static inline int16x8_t centerNeon(uint8x8_t c) {
+    return vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(c)), vdupq_n_s16(128));
+}
+
+// 16 pixels from 8 chroma samples
+static inline void store16Neon(uint8x16_t y, uint8x8_t u8, uint8x8_t v8, const YuvMatrix& m,
+                               uint32_t* dst) {
+    int16x8_t u = centerNeon(u8);
+    int16x8_t v = centerNeon(v8);
+    int16x8x2_t u2 = vzipq_s16(u, u);
+    int16x8x2_t v2 = vzipq_s16(v, v);
+    uint8x8_t rl, gl, bl, rh, gh, bh;
+    rgbNeon(vget_low_u8(y), u2.val[0], v2.val[0], m, &rl, &gl, &bl);
+    rgbNeon(vget_high_u8(y), u2.val[1], v2.val[1], m, &rh, &gh, &bh);
+    uint8x16x4_t out;
+    out.val[0] = vcombine_u8(rl, rh);
+    out.val[1] = vcombine_u8(gl, gh);
+    out.val[2] = vcombine_u8(bl, bh);
+    out.val[3] = vdupq_n_u8(0xff);
+    vst4q_u8((uint8_t*)dst, out);
+}
+
+static void planarNeon(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* dst,
+                       int width, const YuvMatrix& m) {
+    int c = 0;
+    for (; c + 16 <= width; c += 16) {
+        store16Neon(vld1q_u8(y + c), vld1_u8(u + c / 2), vld1_u8(v + c / 2), m, dst + c);
+    }
+    planarRangeC(y, u, v, dst, c, width, m);
+}
+
+static void semiPlanarNeon(const uint8_t* y, const uint8_t* uv, uint32_t* dst, int width,
+                           const YuvMatrix& m) {
+    int c = 0;
+    for (; c + 16 <= width; c += 16) {
+        uint8x8x2_t chroma = vld2_u8(uv + c);
+        store16Neon(vld1q_u8(y + c), chroma.val[0], chroma.val[1], m, dst + c);
+    }
+    semiPlanarRangeC(y, uv, dst, c, width, m);
+}
+
+// vld4 splits 16 pixels to even Y, U, odd Y and V, the even and odd pixels are
+// converted apart and zipped back.
+static void packedNeon(const uint8_t* yuyv, uint32_t* dst, int width, const YuvMatrix& m) {
+    int c = 0;
+    for (; c + 16 <= width; c += 16) {
+        uint8x8x4_t p = vld4_u8(yuyv + c * 2);
+        int16x8_t u = centerNeon(p.val[1]);
+        int16x8_t v = centerNeon(p.val[3]);
+        uint8x8_t re, ge, be, ro, go, bo;
+        rgbNeon(p.val[0], u, v, m, &re, &ge, &be);
+        rgbNeon(p.val[2], u, v, m, &ro, &go, &bo);
+        uint8x8x2_t r = vzip_u8(re, ro);
+        uint8x8x2_t g = vzip_u8(ge, go);
+        uint8x8x2_t b = vzip_u8(be, bo);
+        uint8x16x4_t out;
+        out.val[0] = vcombine_u8(r.val[0], r.val[1]);
+        out.val[1] = vcombine_u8(g.val[0], g.val[1]);
+        out.val[2] = vcombine_u8(b.val[0], b.val[1]);
+        out.val[3] = vdupq_n_u8(0xff);
+        vst4q_u8((uint8_t*)(dst + c), out);
+    }
+    packedRangeC(yuyv, dst, c, width, m);
+}
+
+static const YuvKernels sKernelsNeon = {
+        "neon",
+        planarNeon,
+        semiPlanarNeon,
+        packedNeon,
+};
+
+#elif defined(__x86_64__) || defined(__i386__)
+/*======== SSE2 ======== */
+// One channel of 8 pixels with madd on (y, c) pairs, y and c are already
+// centered. The packs saturate like the clamp of the C code.
+static inline __m128i channelSse2(__m128i y, __m128i c, int16_t ys, int16_t k) {
+    const __m128i coefs = _mm_set1_epi32(((uint32_t)(uint16_t)k << 16) | (uint16_t)ys);
+    const __m128i round = _mm_set1_epi32(1 << (YUV_SHIFT - 1));
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, c), coefs), round);
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, c), coefs), round);
+    return _mm_packs_epi32(_mm_srai_epi32(lo, YUV_SHIFT), _mm_srai_epi32(hi, YUV_SHIFT));
+}
+
+static inline __m128i greenSse2(__m128i y, __m128i u, __m128i v, const YuvMatrix& m) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i coefs = _mm_set1_epi32(((uint32_t)(uint16_t)-m.gu << 16) | (uint16_t)m.yScale);
+    const __m128i coefv = _mm_set1_epi32((uint16_t)-m.gv);
+    const __m128i round = _mm_set1_epi32(1 << (YUV_SHIFT - 1));
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, u), coefs),
+                               _mm_madd_epi16(_mm_unpacklo_epi16(v, zero), coefv));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, u), coefs),
+                               _mm_madd_epi16(_mm_unpackhi_epi16(v, zero), coefv));
+    lo = _mm_srai_epi32(_mm_add_epi32(lo, round), YUV_SHIFT);
+    hi = _mm_srai_epi32(_mm_add_epi32(hi, round), YUV_SHIFT);
+    return _mm_packs_epi32(lo, hi);
+}
+
+// 16 pixels: y0 and y1 hold the Y of pixels 0-7 and 8-15, u and v the 8
+// chroma samples, all in 16 bit lanes.
+static inline void store16Sse2(__m128i y0, __m128i y1, __m128i u, __m128i v, const YuvMatrix& m,
+                               uint32_t* dst) {
+    const __m128i yOffset = _mm_set1_epi16(m.yOffset);
+    const __m128i center = _mm_set1_epi16(128);
+    y0 = _mm_sub_epi16(y0, yOffset);
+    y1 = _mm_sub_epi16(y1, yOffset);
+    u = _mm_sub_epi16(u, center);
+    v = _mm_sub_epi16(v, center);
+    __m128i u0 = _mm_unpacklo_epi16(u, u);
+    __m128i u1 = _mm_unpackhi_epi16(u, u);
+    __m128i v0 = _mm_unpacklo_epi16(v, v);
+    __m128i v1 = _mm_unpackhi_epi16(v, v);
+
+    __m128i r = _mm_packus_epi16(channelSse2(y0, v0, m.yScale, m.rv),
+                                 channelSse2(y1, v1, m.yScale, m.rv));
+    __m128i g = _mm_packus_epi16(greenSse2(y0, u0, v0, m), greenSse2(y1, u1, v1, m));
+    __m128i b = _mm_packus_epi16(channelSse2(y0, u0, m.yScale, m.bu),
+                                 channelSse2(y1, u1, m.yScale, m.bu));
+
+    const __m128i alpha = _mm_set1_epi8((char)0xff);
+    __m128i rgLo = _mm_unpacklo_epi8(r, g);
+    __m128i rgHi = _mm_unpackhi_epi8(r, g);
+    __m128i baLo = _mm_unpacklo_epi8(b, alpha);
+    __m128i baHi = _mm_unpackhi_epi8(b, alpha);
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i*)(dst + 4), _mm_unpackhi_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i*)(dst + 8), _mm_unpacklo_epi16(rgHi, baHi));
+    _mm_storeu_si128((__m128i*)(dst + 12), _mm_unpackhi_epi16(rgHi, baHi));
+}
+
+static void planarSse2(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* dst,
+                       int width, const YuvMatrix& m) {
+    const __m128i zero = _mm_setzero_si128();
+    int c = 0;
+    for (; c + 16 <= width; c += 16) {
+        __m128i y8 = _mm_loadu_si128((const __m128i*)(y + c));
+        __m128i u8 = _mm_loadl_epi64((const __m128i*)(u + c / 2));
+        __m128i v8 = _mm_loadl_epi64((const __m128i*)(v + c / 2));
+        store16Sse2(_mm_unpacklo_epi8(y8, zero), _mm_unpackhi_epi8(y8, zero),
+                    _mm_unpacklo_epi8(u8, zero), _mm_unpacklo_epi8(v8, zero), m, dst + c);
+    }
+    planarRangeC(y, u, v, dst, c, width, m);
+}
+
+static void semiPlanarSse2(const uint8_t* y, const uint8_t* uv, uint32_t* dst, int width,
+                           const YuvMatrix& m) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowBytes = _mm_set1_epi16(0xff);
+    int c = 0;
+    for (; c + 16 <= width; c += 16) {
+        __m128i y8 = _mm_loadu_si128((const __m128i*)(y + c));
+        __m128i chroma = _mm_loadu_si128((const __m128i*)(uv + c));
+        store16Sse2(_mm_unpacklo_epi8(y8, zero), _mm_unpackhi_epi8(y8, zero),
+                    _mm_and_si128(chroma, lowBytes), _mm_srli_epi16(chroma, 8), m, dst + c);
+    }
+    semiPlanarRangeC(y, uv, dst, c, width, m);
+}
+
+static void packedSse2(const uint8_t* yuyv, uint32_t* dst, int width, const YuvMatrix& m) {
+    const __m128i lowBytes = _mm_set1_epi16(0xff);
+    int c = 0;
+    for (; c + 16 <= width; c += 16) {
+        __m128i p0 = _mm_loadu_si128((const __m128i*)(yuyv + c * 2));
+        __m128i p1 = _mm_loadu_si128((const __m128i*)(yuyv + c * 2 + 16));
+        // U V pairs as in a semi planar row
+        __m128i chroma = _mm_packus_epi16(_mm_srli_epi16(p0, 8), _mm_srli_epi16(p1, 8));
+        store16Sse2(_mm_and_si128(p0, lowBytes), _mm_and_si128(p1, lowBytes),
+                    _mm_and_si128(chroma, lowBytes), _mm_srli_epi16(chroma, 8), m, dst + c);
+    }
+    packedRangeC(yuyv, dst, c, width, m);
+}
+
+static const YuvKernels sKernelsSse2 = {
+        "sse2",
+        planarSse2,
+        semiPlanarSse2,
+        packedSse2,
+};
+#endif
+
+static const YuvKernels* selectYuvKernels() {
+    const YuvKernels* kernels = &sKernelsC;
+#if defined(__aarch64__)
+    // NEON is mandatory on arm64.
+    kernels = &sKernelsNeon;
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        kernels = &sKernelsSse2;
+#endif
+    return kernels;
+}
+
+const YuvKernels& getYuvKernels() {
+    static const YuvKernels* kernels = selectYuvKernels();
+    return *kernels;
+}
+
+const YuvKernels& getYuvKernelsC() {
+    return sKernelsC;
+}
+
+namespace {
+
+struct BandJob {
+    const std::function<void(unsigned, unsigned)>* func;
+    std::vector<unsigned> bounds;
+    unsigned next;
+    unsigned pending;
+};
+
+// Workers are created on first use and live with the process, like the
+// CpuWorkers pool of libimageprocess, which this system binary can not link.
+// Each is bound to its own core so the bands of a frame do not migrate.
+class YuvWorkerPool {
+public:
+    // never freed, workers may still wait on it while the process exits.
+    static YuvWorkerPool& get() {
+        static YuvWorkerPool* sPool = new YuvWorkerPool();
+        return *sPool;
+    }
+
+    // threads that may work on one job, caller included.
+    unsigned capacity() const { return mWorkers + 1; }
+
+    void run(BandJob& job) {
+        unsigned count = job.bounds.size() - 1;
+        std::unique_lock<std::mutex> lock(mLock);
+        job.next = 0;
+        job.pending = count;
+        mJobs.push_back(&job);
+        mWorkCond.notify_all();
+
+        // take bands of our own job, so it finishes even if all workers are busy.
+        while (job.next < count) {
+            unsigned band = takeBandLocked(job);
+            lock.unlock();
+            (*job.func)(job.bounds[band], job.bounds[band + 1]);
+            lock.lock();
+            job.pending--;
+        }
+
+        mDoneCond.wait(lock, [&job] { return job.pending == 0; });
+    }
+
+private:
+    YuvWorkerPool() {
+        unsigned cores = std::thread::hardware_concurrency();
+        if (cores > YUV_MAX_THREADS)
+            cores = YUV_MAX_THREADS;
+        for (unsigned i = 1; i < cores; i++) {
+            std::thread worker(&YuvWorkerPool::loop, this, i);
+            worker.detach();
+            mWorkers++;
+        }
+    }
+
+    unsigned takeBandLocked(BandJob& job) {
+        unsigned band = job.next++;
+        if (job.next == job.bounds.size() - 1) {
+            for (auto it = mJobs.begin(); it != mJobs.end(); ++it) {
+                if (*it == &job) {
+                    mJobs.erase(it);
+                    break;
+                }
+            }
+        }
+        return band;
+    }
+
+    void loop(unsigned core) {
+        char name[16];
+        snprintf(name, sizeof(name), "evs_yuv%u", core);
+        pthread_setname_np(pthread_self(), name);
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+
+        std::unique_lock<std::mutex> lock(mLock);
+        for (;;) {
+            mWorkCond.wait(lock, [this] { return !mJobs.empty(); });
+
+            BandJob& job = *mJobs.front();
+            unsigned band = takeBandLocked(job);
+            lock.unlock();
+            (*job.func)(job.bounds[band], job.bounds[band + 1]);
+            lock.lock();
+            if (--job.pending == 0)
+                mDoneCond.notify_all();
+        }
+    }
+
+    std::mutex mLock;
+    std::condition_variable mWorkCond;
+    std::condition_variable mDoneCond;
+    std::deque<BandJob*> mJobs;
+    unsigned mWorkers = 0;
+};
+
+} // namespace
+
+// Split rows [0, rows) into bands run on the worker pool, the caller runs
+// bands too and returns when all are done.
+static void runRowBands(unsigned rows, unsigned width, int threads,
+                        const std::function<void(unsigned, unsigned)>& job) {
+    unsigned bands = threads;
+    if (threads == YUV_THREADS_AUTO) {
+        bands = YuvWorkerPool::get().capacity();
+        unsigned maxBands = (uint64_t)rows * width / YUV_BAND_MIN_PIXELS;
+        if (bands > maxBands)
+            bands = maxBands;
+    }
+    if (bands > rows)
+        bands = rows;
+    if (bands <= 1) {
+        job(0, rows);
+        return;
+    }
+
+    BandJob bandJob;
+    bandJob.func = &job;
+    bandJob.bounds.resize(bands + 1);
+    for (unsigned i = 0; i <= bands; i++) {
+        bandJob.bounds[i] = (uint64_t)rows * i / bands;
+    }
+    YuvWorkerPool::get().run(bandJob);
+}
+
+void yuvPlanarToRgbx(const uint8_t* y, unsigned yStride, const uint8_t* u, const uint8_t* v,
+                     unsigned uvStride, uint32_t* dst, unsigned dstStridePixels, unsigned width,
+                     unsigned height, YuvColorSpace colorSpace, int threads) {
+    const YuvKernels& kernels = getYuvKernels();
+    const YuvMatrix& m = getYuvMatrix(colorSpace);
+    runRowBands(height, width, threads, [&](unsigned start, unsigned end) {
+        for (unsigned r = start; r < end; r++) {
+            // the same chroma rows are walked twice for even/odd luma rows
+            kernels.planar(y + r * yStride, u + r / 2 * uvStride, v + r / 2 * uvStride,
+                           dst + r * dstStridePixels, width, m);
+        }
+    });
+}
+
+void yuvSemiPlanarToRgbx(const uint8_t* y, unsigned yStride, const uint8_t* uv,
+                         unsigned uvStride, uint32_t* dst, unsigned dstStridePixels,
+                         unsigned width, unsigned height, YuvColorSpace colorSpace, int threads) {
+    const YuvKernels& kernels = getYuvKernels();
+    const YuvMatrix& m = getYuvMatrix(colorSpace);
+    runRowBands(height, width, threads, [&](unsigned start, unsigned end) {
+        for (unsigned r = start; r < end; r++) {
+            kernels.semiPlanar(y + r * yStride, uv + r / 2 * uvStride, dst + r * dstStridePixels,
+                               width, m);
+        }
+    });
+}
+
+void yuvPackedToRgbx(const uint8_t* yuyv, unsigned srcStride, uint32_t* dst,
+                     unsigned dstStridePixels, unsigned width, unsigned height,
+                     YuvColorSpace colorSpace, int threads) {
+    const YuvKernels& kernels = getYuvKernels();
+    const YuvMatrix& m = getYuvMatrix(colorSpace);
+    runRowBands(height, width, threads, [&](unsigned start, unsigned end) {
+        for (unsigned r = start; r < end; r++) {
+            kernels.packed(yuyv + r * srcStride, dst + r * dstStridePixels, width & ~1u, m);
+        }
+    });
+}
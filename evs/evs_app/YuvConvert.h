@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef EVS_APP_YUVCONVERT_H
+#define EVS_APP_YUVCONVERT_H
+
+#include <stdint.h>
+
+// YUV to RGBx conversion of the camera frames, R in the low byte and the alpha
+// byte set to 0xff. The math is fixed point so every implementation gives the
+// same bytes:
+//   c = ((Y - yOffset) * yScale + k1 * (C1 - 128) [+ k2 * (C2 - 128)] + round) >> YUV_SHIFT
+// clamped to [0, 255]. It does not depend on any Android library, so it also
+// builds on a host for yuv_convert_bench.
+
+// Fractional bits of the matrix coefficients.
+#define YUV_SHIFT 13
+
+// Thread count of the conversions. 1 runs on the caller only, auto uses up to
+// YUV_MAX_THREADS threads when the frame is large enough to gain from it.
+#define YUV_THREADS_AUTO 0
+#define YUV_MAX_THREADS 4
+
+// Bands smaller than this many pixels are not worth a thread.
+#define YUV_BAND_MIN_PIXELS (64 * 1024)
+
+enum YuvColorSpace {
+    YUV_BT601_LIMITED, // Y in [16, 235], UV in [16, 240], SD cameras
+    YUV_BT601_FULL,    // JPEG
+    YUV_BT709_LIMITED, // HD cameras
+    YUV_BT709_FULL,
+    YUV_COLOR_SPACE_COUNT,
+};
+
+struct YuvMatrix {
+    int16_t yOffset;
+    int16_t yScale;
+    int16_t rv; // V weight of R
+    int16_t gu; // U weight of G, subtracted
+    int16_t gv; // V weight of G, subtracted
+    int16_t bu; // U weight of B
+};
+
+const YuvMatrix& getYuvMatrix(YuvColorSpace colorSpace);
+
+// Row kernels, width pixels from dst[0]. Chroma is subsampled 2:1
+// horizontally, the pixels 2n and 2n + 1 share the chroma sample n.
+// The implementation is picked once at runtime: NEON on arm64, SSE2 on x86,
+// plain C elsewhere.
+struct YuvKernels {
+    const char* name;
+    // separate U and V rows
+    void (*planar)(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* dst, int width,
+                   const YuvMatrix& m);
+    // interleaved chroma row, U at even and V at odd bytes
+    void (*semiPlanar)(const uint8_t* y, const uint8_t* uv, uint32_t* dst, int width,
+                       const YuvMatrix& m);
+    // Y0 U Y1 V, width must be even
+    void (*packed)(const uint8_t* yuyv, uint32_t* dst, int width, const YuvMatrix& m);
+};
+
+const YuvKernels& getYuvKernels();
+
+// the plain C kernels, reference of the others.
+const YuvKernels& getYuvKernelsC();
+
+// 4:2:0 frames with one chroma row for two luma rows. Strides are in bytes
+// for the sources and in pixels for dst.
+void yuvPlanarToRgbx(const uint8_t* y, unsigned yStride, const uint8_t* u, const uint8_t* v,
+                     unsigned uvStride, uint32_t* dst, unsigned dstStridePixels, unsigned width,
+                     unsigned height, YuvColorSpace colorSpace, int threads = YUV_THREADS_AUTO);
+
+void yuvSemiPlanarToRgbx(const uint8_t* y, unsigned yStride, const uint8_t* uv,
+                         unsigned uvStride, uint32_t* dst, unsigned dstStridePixels,
+                         unsigned width, unsigned height, YuvColorSpace colorSpace,
+                         int threads = YUV_THREADS_AUTO);
+
+// 4:2:2 YUYV frames.
+void yuvPackedToRgbx(const uint8_t* yuyv, unsigned srcStride, uint32_t* dst,
+                     unsigned dstStridePixels, unsigned width, unsigned height,
+                     YuvColorSpace colorSpace, int threads = YUV_THREADS_AUTO);
+
+#endif // EVS_APP_YUVCONVERT_H
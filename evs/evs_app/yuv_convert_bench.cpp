@@ -0,0 +1,263 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Benchmark and conformance test of YuvConvert.
+ *
+ * Converts random frames of every format, color space and resolution with the
+ * selected kernels, on one thread and on the auto thread count, and compares
+ * the output byte by byte with the plain C kernels, including the padding
+ * after each row which must stay untouched. Reports ms per frame and MPix/s,
+ * next to the former per pixel float conversion. Exits non-zero if any output
+ * differs.
+ *
+ * It only needs the C++ library, so it also builds on a host:
+ *   g++ -O2 yuv_convert_bench.cpp YuvConvert.cpp -lpthread -o yuv_convert_bench
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <functional>
+#include <vector>
+
+#include "YuvConvert.h"
+
+#define BENCH_LOOPS 20
+#define BENCH_DST_PADDING 16 // pixels after each output row
+#define BENCH_FILL 0xcdcdcdcd
+
+enum BenchFormat {
+    BENCH_YV12,
+    BENCH_NV21,
+    BENCH_YUYV,
+};
+
+static const char* sFormatNames[] = {"YV12", "NV21", "YUYV"};
+static const char* sColorSpaceNames[] = {"601L", "601F", "709L", "709F"};
+
+struct BenchSize {
+    unsigned width;
+    unsigned height;
+};
+
+static const BenchSize sSizes[] = {
+        {640, 480}, {1000, 562}, {1280, 720}, {1366, 768}, {1920, 1080},
+};
+
+struct BenchFrame {
+    unsigned width;
+    unsigned height;
+    unsigned yStride;
+    unsigned uvStride;
+    std::vector<uint8_t> y;
+    std::vector<uint8_t> u;
+    std::vector<uint8_t> v;
+};
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static double timeMs(const std::function<void()>& run) {
+    run(); // warm up
+    double start = nowMs();
+    for (int i = 0; i < BENCH_LOOPS; i++) run();
+    return (nowMs() - start) / BENCH_LOOPS;
+}
+
+static void fillRandom(std::vector<uint8_t>& buf) {
+    for (auto& b : buf) b = rand();
+}
+
+// u holds the UV plane of NV21 and the whole frame of YUYV.
+static void makeFrame(BenchFormat format, unsigned width, unsigned height, BenchFrame& frame) {
+    frame.width = width;
+    frame.height = height;
+    frame.yStride = (width + 15) & ~15u;
+    frame.uvStride = format == BENCH_YV12 ? ((frame.yStride / 2 + 15) & ~15u) : frame.yStride;
+    if (format == BENCH_YUYV) {
+        frame.yStride = frame.yStride * 2;
+        frame.y.resize(frame.yStride * height);
+    } else {
+        frame.y.resize(frame.yStride * height);
+        frame.u.resize(frame.uvStride * height / 2);
+        if (format == BENCH_YV12)
+            frame.v.resize(frame.uvStride * height / 2);
+    }
+    fillRandom(frame.y);
+    fillRandom(frame.u);
+    fillRandom(frame.v);
+}
+
+static void convert(BenchFormat format, const BenchFrame& f, uint32_t* dst, unsigned dstStride,
+                    YuvColorSpace colorSpace, int threads) {
+    switch (format) {
+        case BENCH_YV12:
+            yuvPlanarToRgbx(f.y.data(), f.yStride, f.u.data(), f.v.data(), f.uvStride, dst,
+                            dstStride, f.width, f.height, colorSpace, threads);
+            break;
+        case BENCH_NV21:
+            yuvSemiPlanarToRgbx(f.y.data(), f.yStride, f.u.data(), f.uvStride, dst, dstStride,
+                                f.width, f.height, colorSpace, threads);
+            break;
+        case BENCH_YUYV:
+            yuvPackedToRgbx(f.y.data(), f.yStride, dst, dstStride, f.width, f.height, colorSpace,
+                            threads);
+            break;
+    }
+}
+
+static void convertC(BenchFormat format, const BenchFrame& f, uint32_t* dst, unsigned dstStride,
+                     YuvColorSpace colorSpace) {
+    const YuvKernels& c = getYuvKernelsC();
+    const YuvMatrix& m = getYuvMatrix(colorSpace);
+    for (unsigned r = 0; r < f.height; r++) {
+        uint32_t* row = dst + r * dstStride;
+        const uint8_t* y = f.y.data() + r * f.yStride;
+        if (format == BENCH_YV12) {
+            c.planar(y, f.u.data() + r / 2 * f.uvStride, f.v.data() + r / 2 * f.uvStride, row,
+                     f.width, m);
+        } else if (format == BENCH_NV21) {
+            c.semiPlanar(y, f.u.data() + r / 2 * f.uvStride, row, f.width, m);
+        } else {
+            c.packed(y, row, f.width, m);
+        }
+    }
+}
+
+// The per pixel float conversion FormatConvert used before, for comparison.
+static inline float clampFloat(float v) {
+    return v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+}
+
+static uint32_t floatYuvToRgbx(unsigned char Y, unsigned char Uin, unsigned char Vin) {
+    float U = Uin - 128.0f;
+    float V = Vin - 128.0f;
+    unsigned char R = (unsigned char)clampFloat(Y + 1.140f * V);
+    unsigned char G = (unsigned char)clampFloat(Y - 0.395f * U - 0.581f * V);
+    unsigned char B = (unsigned char)clampFloat(Y + 2.032f * U);
+    return (R) | (G << 8) | (B << 16) | 0xFF000000;
+}
+
+static void convertFloat(BenchFormat format, const BenchFrame& f, uint32_t* dst,
+                         unsigned dstStride) {
+    for (unsigned r = 0; r < f.height; r++) {
+        uint32_t* row = dst + r * dstStride;
+        const uint8_t* y = f.y.data() + r * f.yStride;
+        const uint8_t* u = f.u.data() + r / 2 * f.uvStride;
+        for (unsigned c = 0; c < f.width; c++) {
+            if (format == BENCH_YV12) {
+                row[c] = floatYuvToRgbx(y[c], u[c / 2], f.v[r / 2 * f.uvStride + c / 2]);
+            } else if (format == BENCH_NV21) {
+                row[c] = floatYuvToRgbx(y[c], u[c & ~1], u[c | 1]);
+            } else {
+                const uint8_t* p = y + (c & ~1) * 2;
+                row[c] = floatYuvToRgbx(p[(c & 1) * 2], p[1], p[3]);
+            }
+        }
+    }
+}
+
+// within 2 per channel, the YUV values of the primaries are rounded.
+static bool closeColor(uint32_t a, uint32_t b) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        int diff = (int)((a >> shift) & 0xff) - (int)((b >> shift) & 0xff);
+        if (diff < -2 || diff > 2)
+            return false;
+    }
+    return true;
+}
+
+// Known colors of each matrix.
+static int checkMatrices() {
+    struct {
+        YuvColorSpace space;
+        uint8_t y, u, v;
+        uint32_t rgbx;
+    } cases[] = {
+            {YUV_BT601_LIMITED, 16, 128, 128, 0xff000000},
+            {YUV_BT601_LIMITED, 235, 128, 128, 0xffffffff},
+            {YUV_BT601_LIMITED, 81, 90, 240, 0xff0000ff},  // red
+            {YUV_BT601_FULL, 0, 128, 128, 0xff000000},
+            {YUV_BT601_FULL, 255, 128, 128, 0xffffffff},
+            {YUV_BT601_FULL, 76, 85, 255, 0xff0000ff},     // red
+            {YUV_BT709_LIMITED, 63, 102, 240, 0xff0000ff}, // red
+            {YUV_BT709_FULL, 54, 99, 255, 0xff0000ff},     // red
+    };
+    int errors = 0;
+    for (auto& t : cases) {
+        uint8_t y[2] = {t.y, t.y};
+        uint8_t u = t.u, v = t.v;
+        uint32_t out[2];
+        getYuvKernelsC().planar(y, &u, &v, out, 2, getYuvMatrix(t.space));
+        if (!closeColor(out[0], t.rgbx)) {
+            printf("%s Y %u U %u V %u: 0x%08x expected 0x%08x\n", sColorSpaceNames[t.space], t.y,
+                   t.u, t.v, out[0], t.rgbx);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main() {
+    int errors = checkMatrices();
+    printf("kernels %s, %d loops\n", getYuvKernels().name, BENCH_LOOPS);
+    printf("%-5s %-10s %-5s %9s %9s %9s %9s %9s\n", "fmt", "size", "space", "float ms", "c ms",
+           "simd ms", "auto ms", "MPix/s");
+
+    for (int format = BENCH_YV12; format <= BENCH_YUYV; format++) {
+        for (auto& size : sSizes) {
+            BenchFrame frame;
+            makeFrame((BenchFormat)format, size.width, size.height, frame);
+            unsigned dstStride = size.width + BENCH_DST_PADDING;
+            std::vector<uint32_t> ref(dstStride * size.height, BENCH_FILL);
+            std::vector<uint32_t> out(dstStride * size.height, BENCH_FILL);
+            double floatMs = timeMs(
+                    [&] { convertFloat((BenchFormat)format, frame, ref.data(), dstStride); });
+
+            for (int space = 0; space < YUV_COLOR_SPACE_COUNT; space++) {
+                YuvColorSpace colorSpace = (YuvColorSpace)space;
+                double cMs = timeMs([&] {
+                    convertC((BenchFormat)format, frame, ref.data(), dstStride, colorSpace);
+                });
+                double simdMs = timeMs([&] {
+                    convert((BenchFormat)format, frame, out.data(), dstStride, colorSpace, 1);
+                });
+                bool same = out == ref;
+                std::fill(out.begin(), out.end(), BENCH_FILL);
+                double autoMs = timeMs([&] {
+                    convert((BenchFormat)format, frame, out.data(), dstStride, colorSpace,
+                            YUV_THREADS_AUTO);
+                });
+                same = same && out == ref;
+                char name[32];
+                snprintf(name, sizeof(name), "%ux%u", size.width, size.height);
+                printf("%-5s %-10s %-5s %9.3f %9.3f %9.3f %9.3f %9.1f%s\n", sFormatNames[format],
+                       name, sColorSpaceNames[space], floatMs, cMs, simdMs, autoMs,
+                       size.width * size.height / autoMs / 1000.0, same ? "" : "  MISMATCH");
+                if (!same)
+                    errors++;
+            }
+        }
+    }
+
+    printf("%s\n", errors ? "FAIL" : "PASS");
+    return errors ? 1 : 0;
+}
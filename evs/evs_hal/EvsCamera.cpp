@@ -463,6 +463,7 @@ void EvsCamera::forwardFrame(std::vector<struct forwardframe> &fwframes) {
             pDesc->usage = fr.buf->usage;
             bufDesc_1_1.deviceId = fr.deviceid;
             bufDesc_1_1.bufferId = fr.index;
+            bufDesc_1_1.timestamp = fr.timestamp;
             bufDesc_1_1.buffer.nativeHandle = fr.buf;
 
             frames[i++] = bufDesc_1_1;
@@ -56,6 +56,7 @@ struct forwardframe {
     fsl::Memory* buf;
     int index;
     std::string deviceid;
+    int64_t timestamp = 0; // capture time in microseconds, 0 if unknown
 };
 
 using ::android::hardware::hidl_death_recipient;
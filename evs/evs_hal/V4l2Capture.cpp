@@ -16,18 +16,22 @@
 #include "V4l2Capture.h"
 
 #include <android-base/file.h>
+#include <cutils/properties.h>
 #include <errno.h>
 #include <error.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <log/log.h>
 #include <memory.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include "assert.h"
 
 // #define DEBUG_V4L2_CAMERA
@@ -41,6 +45,9 @@ V4l2Capture::V4l2Capture(const char* deviceName, const char* videoName, __u32 wi
     mWidth = width;
     mHeight = height;
     mDecreasenum = 0;
+    mSyncTolerance = 0;
+    mFrameInterval = 0;
+    mSyncDrops = 0;
 
     // check whether the camera is logic camera
     mIslogicCamera = isLogicalCamera(metadata);
@@ -202,6 +209,13 @@ int V4l2Capture::onOpenSingleCamera(const char* deviceName) {
         return -EINVAL;
     }
 
+    // S_PARM returns the interval the driver picked
+    int64_t interval = V4L2_DEFAULT_FRAME_INTERVAL_US;
+    if (param.parm.capture.timeperframe.denominator != 0)
+        interval = 1000000LL * param.parm.capture.timeperframe.numerator /
+                param.parm.capture.timeperframe.denominator;
+    mFrameInterval = std::max(mFrameInterval, interval);
+
     // Set our desired output format
     v4l2_format format;
     format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
@@ -345,6 +359,13 @@ bool V4l2Capture::onStart() {
     if (mFramesAllowed == 0)
         setMaxFramesInFlight(3);
 
+    // frames held from the last stream were released by its stream off
+    mPendingFrames.clear();
+    mSyncDrops = 0;
+    int64_t interval = mFrameInterval > 0 ? mFrameInterval : V4L2_DEFAULT_FRAME_INTERVAL_US;
+    mSyncTolerance = property_get_int32(V4L2_SYNC_TOLERANCE_PROP,
+                                        interval / 2 + V4L2_SYNC_MARGIN_US);
+
     int fd = -1;
     for (const auto& physical_cam : mPhysicalCamera) {
         if (mDeviceFd[physical_cam] < 0)
@@ -605,8 +626,6 @@ bool V4l2Capture::onFrameReturn(int index, std::string deviceid) {
         return false;
     }
 
-    int fd = -1;
-
     if (devicename == "" && mPhysicalCamera.size() == 1) {
         devicename = *mPhysicalCamera.begin();
     }
@@ -625,15 +644,21 @@ bool V4l2Capture::onFrameReturn(int index, std::string deviceid) {
         return true;
     }
 
+    return queueFrame(devicename, index);
+}
+
+// Requeue the v4l2 buffer "index" of the physical camera to capture a new frame
+bool V4l2Capture::queueFrame(const std::string& physical_cam, int index) {
+    int fd = -1;
     fsl::Memory* buffer = nullptr;
     {
         std::unique_lock<std::mutex> lock(mLock);
-        fd = mDeviceFd[devicename];
-        // devicename means the pyhsical camera name
-        // mDeviceFd[devicename] means the pyhsical camera fd
-        // mCamBuffers[mDeviceFd[devicename]]: every pyhsical camera fd have
-        // three buffer, onFrameReturn return index buffer
-        buffer = mCamBuffers[mDeviceFd[devicename]].at(mBufferMap[devicename].at(index));
+        fd = mDeviceFd[physical_cam];
+        // physical_cam means the pyhsical camera name
+        // mDeviceFd[physical_cam] means the pyhsical camera fd
+        // mCamBuffers[mDeviceFd[physical_cam]]: every pyhsical camera fd have
+        // three buffer, return the buffer mapped by index
+        buffer = mCamBuffers[mDeviceFd[physical_cam]].at(mBufferMap[physical_cam].at(index));
     }
 
     if (fd < 0 || buffer == nullptr) {
@@ -661,27 +686,51 @@ bool V4l2Capture::onFrameReturn(int index, std::string deviceid) {
     return true;
 }
 
-// This runs on a background thread to receive and dispatch video frames
+// This runs on a background thread to receive and dispatch video frames.
+// All physical cameras are polled together. One frame of each is forwarded
+// once their capture timestamps are within mSyncTolerance, so the frames of
+// a logical camera come from the same instant. A frame older than the newest
+// one of another camera by more than that can never be matched and is
+// requeued, as is a frame replaced by a newer one of the same camera. If
+// V4L2_SYNC_MAX_DROPS frames are dropped in a row, the current set is
+// forwarded anyway rather than starving the client.
 void V4l2Capture::onFrameCollect(std::vector<struct forwardframe>& frames) {
-    int fd = -1;
     fsl::Memory* buffer = nullptr;
     struct forwardframe frame;
+    std::vector<std::string> cameras;
+    std::vector<struct pollfd> fds;
 #ifdef DEBUG_V4L2_CAMERA
     int index = 0;
 #endif
-    for (const auto& physical_cam : mPhysicalCamera) {
-        if (mDeviceFd[physical_cam] < 0)
-            return;
-
-        {
-            std::unique_lock<std::mutex> lock(mLock);
-            fd = mDeviceFd[physical_cam];
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        for (const auto& physical_cam : mPhysicalCamera) {
+            if (mDeviceFd[physical_cam] < 0) {
+                ALOGE("%s invalid fd", __func__);
+                return;
+            }
+            cameras.push_back(physical_cam);
+            fds.push_back({mDeviceFd[physical_cam], POLLIN, 0});
         }
+    }
 
-        if (fd < 0) {
-            ALOGE("%s invalid fd", __func__);
+    // Wait for a buffer to be ready on any camera
+    int ret = poll(fds.data(), fds.size(), V4L2_POLL_TIMEOUT_MS);
+    if (ret < 0) {
+        if (errno != EINTR)
+            ALOGE("%s poll: %s", __func__, strerror(errno));
+        return;
+    }
+    if (ret == 0)
+        return;
+
+    for (size_t i = 0; i < fds.size(); i++) {
+        if (fds[i].revents & (POLLERR | POLLNVAL)) {
+            ALOGE("%s %s poll error 0x%x", __func__, cameras[i].c_str(), fds[i].revents);
             return;
         }
+        if (!(fds[i].revents & POLLIN))
+            continue;
 
         struct v4l2_buffer buf;
         struct v4l2_plane planes;
@@ -693,18 +742,58 @@ void V4l2Capture::onFrameCollect(std::vector<struct forwardframe>& frames) {
         buf.m.planes = &planes;
         buf.length = 1;
 
-        // Wait for a buffer to be ready
-        if (ioctl(fd, VIDIOC_DQBUF, &buf) < 0) {
+        if (ioctl(fds[i].fd, VIDIOC_DQBUF, &buf) < 0) {
             ALOGE("VIDIOC_DQBUF: %s", strerror(errno));
             return;
         }
 
+        auto pending = mPendingFrames.find(cameras[i]);
+        if (pending != mPendingFrames.end())
+            queueFrame(cameras[i], pending->second.index);
+
+        mPendingFrames[cameras[i]] = {static_cast<int>(buf.index),
+                                      buf.timestamp.tv_sec * 1000000LL + buf.timestamp.tv_usec};
+    }
+
+    // drop the oldest frame until the remaining ones are close enough
+    while (mPendingFrames.size() == cameras.size()) {
+        auto oldest = mPendingFrames.begin();
+        auto newest = mPendingFrames.begin();
+        for (auto it = mPendingFrames.begin(); it != mPendingFrames.end(); ++it) {
+            if (it->second.timestamp < oldest->second.timestamp)
+                oldest = it;
+            if (it->second.timestamp > newest->second.timestamp)
+                newest = it;
+        }
+        int64_t spread = newest->second.timestamp - oldest->second.timestamp;
+        if (spread <= mSyncTolerance)
+            break;
+        if (mSyncDrops >= V4L2_SYNC_MAX_DROPS) {
+            ALOGW("%s no frames within %" PRId64 "us after %u drops, forward %" PRId64
+                  "us apart",
+                  __func__, mSyncTolerance, mSyncDrops, spread);
+            break;
+        }
+
+        ALOGV("%s drop frame of %s, %" PRId64 "us older than %s", __func__,
+              oldest->first.c_str(), newest->second.timestamp - oldest->second.timestamp,
+              newest->first.c_str());
+        queueFrame(oldest->first, oldest->second.index);
+        mPendingFrames.erase(oldest);
+        mSyncDrops++;
+    }
+
+    if (mPendingFrames.size() < cameras.size())
+        return;
+
+    for (const auto& physical_cam : cameras) {
+        const PendingFrame& pending = mPendingFrames[physical_cam];
         {
             std::unique_lock<std::mutex> lock(mLock);
-            // buf.index means the index of v4l2 buffer,
-            // mBufferMap[mDeviceFd[physical_cam]][buf.index] means the index of grolloc buffer
-            buffer =
-                    mCamBuffers[mDeviceFd[physical_cam]].at(mBufferMap[physical_cam].at(buf.index));
+            // pending.index means the index of v4l2 buffer,
+            // mBufferMap[physical_cam][pending.index] means the index of grolloc buffer
+            buffer = mCamBuffers[mDeviceFd[physical_cam]].at(
+                    mBufferMap[physical_cam].at(pending.index));
         }
 #ifdef DEBUG_V4L2_CAMERA
         char filename[128];
@@ -725,10 +814,13 @@ void V4l2Capture::onFrameCollect(std::vector<struct forwardframe>& frames) {
         index++;
 #endif
         frame.buf = buffer;
-        frame.index = buf.index;
+        frame.index = pending.index;
         frame.deviceid = physical_cam;
+        frame.timestamp = pending.timestamp;
         frames.push_back(frame);
     }
+    mPendingFrames.clear();
+    mSyncDrops = 0;
 #ifdef DEBUG_V4L2_CAMERA
     nub++;
 #endif
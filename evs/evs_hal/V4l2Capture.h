@@ -30,6 +30,18 @@ using ::android::hardware::automotive::evs::V1_1::implementation::EvsCamera;
 using ::std::condition_variable;
 
 #define V4L2_BUFFER_NUM 10
+// frames of the physical cameras are forwarded together when their capture
+// timestamps are at most this far apart. The default is half of the longest
+// frame interval plus V4L2_SYNC_MARGIN_US, so free running sensors always
+// have a pair within it.
+#define V4L2_SYNC_TOLERANCE_PROP "vendor.evs.sync.tolerance_us"
+#define V4L2_SYNC_MARGIN_US 4000
+// frame interval used when the driver does not report one, 30fps
+#define V4L2_DEFAULT_FRAME_INTERVAL_US 33333
+// after this many frames dropped in a row the closest set is forwarded anyway
+#define V4L2_SYNC_MAX_DROPS 8
+// onFrameCollect returns after this long without a frame, so stop is not blocked
+#define V4L2_POLL_TIMEOUT_MS 100
 class V4l2Capture : public EvsCamera {
 public:
     V4l2Capture(const char* deviceName, const char* videoName, __u32 width, __u32 height,
@@ -56,8 +68,14 @@ public:
     void onDecreaseMemoryBuffer(unsigned index);
 
 private:
+    struct PendingFrame {
+        int index;
+        int64_t timestamp; // capture time in microseconds
+    };
+
     int getCaptureMode(int fd, int width, int height);
     int getV4lFormat(int format);
+    bool queueFrame(const std::string& physical_cam, int index);
     // mPhysicalCamera return the physical camera
     std::unordered_set<std::string> mPhysicalCamera;
 
@@ -69,6 +87,13 @@ private:
     bool mIslogicCamera;
     unsigned mDecreasenum;
     condition_variable mFramesSignal;
+    // dequeued frames waiting for the other physical cameras, only used in onFrameCollect
+    std::unordered_map<std::string, PendingFrame> mPendingFrames;
+    int64_t mSyncTolerance;
+    // longest frame interval of the physical cameras, in microseconds
+    int64_t mFrameInterval;
+    // frames dropped since the last forwarded set
+    unsigned mSyncDrops;
 };
 
 #endif
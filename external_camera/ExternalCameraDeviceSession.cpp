@@ -1501,6 +1501,7 @@ int pixel_format_nv16_to_nv12(uint8_t* nv16_buff, uint8_t* nv12_buff, int w, int
 }
 
 int ExternalCameraDeviceSession::OutputThread::VpuDecAndCsc(uint8_t* inData, size_t inDataSize,
+                                                            int inFd, uint32_t inCapacity,
                                                             YCbCrLayout& cropAndScaled) {
     if ((inData == NULL) || (inDataSize == 0))
         return BAD_VALUE;
@@ -1509,6 +1510,8 @@ int ExternalCameraDeviceSession::OutputThread::VpuDecAndCsc(uint8_t* inData, siz
     inputbuf->pInBuffer = inData;
     inputbuf->id = 0;
     inputbuf->size = inDataSize;
+    inputbuf->fd = inFd;
+    inputbuf->capacity = inCapacity;
 
     int ret = 0;
     ret = mDecoder->queueInputBuffer(std::move(inputbuf));
@@ -1638,7 +1641,9 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
     if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
         ATRACE_BEGIN("MJPGtoI420");
         if (mHardwareDecoder && parent->getHardwareDecFlag()) {
-            res = VpuDecAndCsc(inData, inDataSize, cropAndScaled);
+            V4L2Frame* v4l2Frame = static_cast<V4L2Frame*>(req->frameIn.get());
+            res = VpuDecAndCsc(inData, inDataSize, v4l2Frame->mDmaBufFd, v4l2Frame->mBufferLength,
+                               cropAndScaled);
         } else {
             res = libyuv::MJPGToI420(inData, inDataSize, static_cast<uint8_t*>(mYu12FrameLayout.y),
                                      mYu12FrameLayout.yStride,
@@ -2126,6 +2131,7 @@ int ExternalCameraDeviceSession::v4l2StreamOffLocked() {
         }
     }
     mV4L2BufferCount = 0;
+    mV4l2BufferDmaFds.clear();
 
     // VIDIOC_STREAMOFF
     enum v4l2_buf_type capture_type;
@@ -2309,6 +2315,7 @@ int ExternalCameraDeviceSession::configureV4l2StreamLocked(const SupportedV4L2Fo
     // VIDIOC_QUERYBUF:  get buffer offset in the V4L2 fd
     // VIDIOC_QBUF: send buffer to driver
     mV4L2BufferCount = req_buffers.count;
+    mV4l2BufferDmaFds.clear();
 
     struct v4l2_plane planes;
     memset(&planes, 0, sizeof(struct v4l2_plane));
@@ -2330,6 +2337,25 @@ int ExternalCameraDeviceSession::configureV4l2StreamLocked(const SupportedV4L2Fo
             return -errno;
         }
 
+        // let the hardware decoder read the MJPEG frames in place
+        if (mHardwareDecoder && mSessionNeedHardwareDec && v4l2Fmt.fourcc == V4L2_PIX_FMT_MJPEG) {
+            struct v4l2_exportbuffer expbuf;
+            memset(&expbuf, 0, sizeof(expbuf));
+            expbuf.type = buffer.type;
+            expbuf.index = i;
+            expbuf.flags = O_CLOEXEC | O_RDONLY;
+            if (TEMP_FAILURE_RETRY(ioctl(mV4l2Fd.get(), VIDIOC_EXPBUF, &expbuf)) < 0) {
+                ALOGW("%s: EXPBUF %d failed: %s, decoder copies input", __FUNCTION__, i,
+                      strerror(errno));
+                mV4l2BufferDmaFds.clear();
+            } else if (mV4l2BufferDmaFds.size() == i) {
+                mV4l2BufferDmaFds.emplace_back(expbuf.fd);
+                mV4l2BufferLength = mPlane ? planes.length : buffer.length;
+            } else {
+                close(expbuf.fd);
+            }
+        }
+
         if (TEMP_FAILURE_RETRY(ioctl(mV4l2Fd.get(), VIDIOC_QBUF, &buffer)) < 0) {
             ALOGE("%s: QBUF %d failed: %s", __FUNCTION__, i, strerror(errno));
             return -errno;
@@ -2476,15 +2502,20 @@ sp<V4L2Frame> ExternalCameraDeviceSession::dequeueV4l2FrameLocked(/*out*/ nsecs_
         mNumDequeuedV4l2Buffers++;
     }
 
+    int dmaBufFd = -1;
+    if (buffer.index < mV4l2BufferDmaFds.size())
+        dmaBufFd = mV4l2BufferDmaFds[buffer.index].get();
+
     if (mPlane) {
         size_t mSize = buffer.m.planes->length;
         size_t mOffset = buffer.m.planes->m.mem_offset;
         return new V4L2Frame(mV4l2StreamingFmt.width, mV4l2StreamingFmt.height,
-                             mV4l2StreamingFmt.fourcc, buffer.index, mV4l2Fd.get(), mSize, mOffset);
+                             mV4l2StreamingFmt.fourcc, buffer.index, mV4l2Fd.get(), mSize, mOffset,
+                             dmaBufFd, mV4l2BufferLength);
     } else {
         return new V4L2Frame(mV4l2StreamingFmt.width, mV4l2StreamingFmt.height,
                              mV4l2StreamingFmt.fourcc, buffer.index, mV4l2Fd.get(),
-                             buffer.bytesused, buffer.m.offset);
+                             buffer.bytesused, buffer.m.offset, dmaBufFd, mV4l2BufferLength);
     }
 }
 
@@ -75,8 +75,14 @@ Frame::Frame(uint32_t width, uint32_t height, uint32_t fourcc)
       : mWidth(width), mHeight(height), mFourcc(fourcc) {}
 
 V4L2Frame::V4L2Frame(uint32_t w, uint32_t h, uint32_t fourcc, int bufIdx, int fd, uint32_t dataSize,
-                     uint64_t offset)
-      : Frame(w, h, fourcc), mBufferIndex(bufIdx), mFd(fd), mDataSize(dataSize), mOffset(offset) {}
+                     uint64_t offset, int dmaBufFd, uint32_t bufferLength)
+      : Frame(w, h, fourcc),
+        mBufferIndex(bufIdx),
+        mDmaBufFd(dmaBufFd),
+        mBufferLength(bufferLength),
+        mFd(fd),
+        mDataSize(dataSize),
+        mOffset(offset) {}
 
 int V4L2Frame::map(uint8_t** data, size_t* dataSize) {
     if (data == nullptr || dataSize == nullptr) {
@@ -53,6 +53,7 @@ HwDecoder::HwDecoder(const char *mime)
 
     bInputStreamOn = false;
     bOutputStreamOn = false;
+    bInputDmaBufFailed = false;
 
     mOutputBufferUsed = 0;
 
@@ -82,7 +83,6 @@ HwDecoder::HwDecoder(const char *mime)
     mOutFormat = V4L2_PIX_FMT_NV12;
     mTableSize = 0;
     color_format_table = NULL;
-    mDecReady = false;
 }
 
 HwDecoder::~HwDecoder() {}
@@ -178,13 +178,9 @@ status_t HwDecoder::Start() {
         ALOGV("%s: mInputFormat width%d, height%d", __FUNCTION__, mInputFormat.width,
               mInputFormat.height);
 
-        if (mInputFormat.width >= 3840 && mInputFormat.height >= 2160)
-            mInputFormat.bufferSize = DEFAULT_INPUT_BUFFER_SIZE_4K;
-        else {
-            mInputFormat.bufferSize = Align(mInputFormat.width * mInputFormat.height * 2, 4096);
-            if (mInputFormat.bufferSize < DEFAULT_INPUT_BUFFER_SIZE_1080P)
-                mInputFormat.bufferSize = DEFAULT_INPUT_BUFFER_SIZE_1080P;
-        }
+        // start with copied input, the first frame switches to import if it can.
+        mInMemType = V4L2_MEMORY_MMAP;
+        resetInputBufferSize();
         ALOGV("%s: mInputFormat bufferSize=%d", __FUNCTION__, mInputFormat.bufferSize);
     }
 
@@ -251,12 +247,25 @@ status_t HwDecoder::Start() {
         return ret;
 
     mDecState = RUNNING;
-    mDecReady = false;
+    {
+        std::lock_guard<std::mutex> mlk(mFramesSignalLock);
+        mDecodedFrames.clear();
+    }
 
     ALOGV("%s: ret=%d", __FUNCTION__, ret);
     return ret;
 }
 
+void HwDecoder::resetInputBufferSize() {
+    if (mInputFormat.width >= 3840 && mInputFormat.height >= 2160)
+        mInputFormat.bufferSize = DEFAULT_INPUT_BUFFER_SIZE_4K;
+    else {
+        mInputFormat.bufferSize = Align(mInputFormat.width * mInputFormat.height * 2, 4096);
+        if (mInputFormat.bufferSize < DEFAULT_INPUT_BUFFER_SIZE_1080P)
+            mInputFormat.bufferSize = DEFAULT_INPUT_BUFFER_SIZE_1080P;
+    }
+}
+
 status_t HwDecoder::SetInputFormats() {
     int result = 0;
     Mutex::Autolock autoLock(mLock);
@@ -419,6 +428,7 @@ status_t HwDecoder::allocateInputBuffers() {
     mInputBufferMap.resize(reqbufs.count);
     for (size_t i = 0; i < mInputBufferMap.size(); i++) {
         mInputBufferMap[i].used = false;
+        mInputBufferMap[i].plane.fd = -1;
         mInputBufferMap[i].plane.vaddr = 0;
         mInputBufferMap[i].plane.paddr = 0;
         mInputBufferMap[i].plane.size = mInputFormat.bufferSize;
@@ -432,6 +442,10 @@ status_t HwDecoder::allocateInputBuffers() {
     void *ptr = NULL;
     uint64_t tmp = 0;
 
+    // imported buffers are attached when queued
+    if (mInMemType == V4L2_MEMORY_DMABUF)
+        return OK;
+
     if (mInMemType != V4L2_MEMORY_MMAP)
         return UNKNOWN_ERROR;
 
@@ -509,6 +523,38 @@ status_t HwDecoder::destroyInputBuffers() {
     return OK;
 }
 
+// Reallocate the input buffers with another memory type, queued input is
+// dropped. Imported buffers are used as they are, so sizeimage is lowered to
+// their capacity and import is refused if the driver wants more.
+status_t HwDecoder::setInputMemory(enum v4l2_memory memory, uint32_t capacity) {
+    status_t ret;
+
+    stopInputStream();
+    destroyInputBuffers();
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mInMemType = memory;
+        resetInputBufferSize();
+        if (memory == V4L2_MEMORY_DMABUF && capacity < mInputFormat.bufferSize)
+            mInputFormat.bufferSize = capacity;
+    }
+
+    ret = SetInputFormats();
+    if (ret == OK && memory == V4L2_MEMORY_DMABUF && mInputFormat.bufferSize > capacity) {
+        ALOGW("%s: input buffer size %d exceeds the capacity %d", __FUNCTION__,
+              mInputFormat.bufferSize, capacity);
+        ret = BAD_VALUE;
+    }
+
+    if (ret == OK)
+        ret = allocateInputBuffers();
+
+    ALOGI("%s: %s input, bufferSize=%d, ret=%d", __FUNCTION__,
+          memory == V4L2_MEMORY_DMABUF ? "dmabuf" : "mmap", mInputFormat.bufferSize, ret);
+    return ret;
+}
+
 status_t HwDecoder::destroyOutputBuffers() {
     if (bOutputStreamOn)
         stopOutputStream();
@@ -573,8 +619,10 @@ status_t HwDecoder::HandleFetchThread() {
               __FUNCTION__, mOutputBufferUsed, mOutputFormat.bufferNum);
 
         DecoderBufferInfo *mDBInfo = getFreeDecoderBuffer();
-        if ((bNeedPostProcess && (mDBInfo->mDBInfoId >= mOutputFormat.bufferNum)) || !mDBInfo) {
-            usleep(3000);
+        if (!mDBInfo || (bNeedPostProcess && (mDBInfo->mDBInfoId >= mOutputFormat.bufferNum))) {
+            // all buffers are held by the client, wait for one to be returned
+            std::unique_lock<std::mutex> flk(mFetchSignalLock);
+            mFetchSignal.wait_for(flk, std::chrono::milliseconds(3));
             continue;
         }
 
@@ -661,8 +709,9 @@ status_t HwDecoder::destroyFetchThread() {
 
 status_t HwDecoder::queueInputBuffer(std::unique_ptr<DecoderInputBuffer> input) {
     int result = 0;
-    int32_t index = 0;
+    int32_t index = -1;
     uint32_t buf_length = 0;
+    uint32_t capacity = 0;
 
     if (input == nullptr)
         return BAD_VALUE;
@@ -672,9 +721,23 @@ status_t HwDecoder::queueInputBuffer(std::unique_ptr<DecoderInputBuffer> input)
             return BAD_VALUE;
     }
 
-    if (input->size > mInputFormat.bufferSize) {
-        ALOGE("%s: invalid buffer size=%d,cap=%d", __FUNCTION__, input->size,
-              mInputFormat.bufferSize);
+    // Import the dmabuf of the input instead of copying it, unless the decoder
+    // already failed to use one. Falls back to copy for the rest of the session.
+    bool dmaBuf = input->fd >= 0 && !bInputDmaBufFailed;
+    if (dmaBuf != (mInMemType == V4L2_MEMORY_DMABUF)) {
+        if (setInputMemory(dmaBuf ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_MMAP, input->capacity) !=
+            OK) {
+            if (!dmaBuf)
+                return UNKNOWN_ERROR;
+            ALOGW("%s: input dmabuf not supported, copy input", __FUNCTION__);
+            bInputDmaBufFailed = true;
+            return queueInputBuffer(std::move(input));
+        }
+    }
+
+    capacity = (mInMemType == V4L2_MEMORY_DMABUF) ? input->capacity : mInputFormat.bufferSize;
+    if (input->size > capacity) {
+        ALOGE("%s: invalid buffer size=%d,cap=%d", __FUNCTION__, input->size, capacity);
         return UNKNOWN_ERROR;
     }
 
@@ -682,19 +745,35 @@ status_t HwDecoder::queueInputBuffer(std::unique_ptr<DecoderInputBuffer> input)
     for (int32_t i = 0; i < mInputBufferMap.size(); i++) {
         if (mInputBufferMap[i].input_id == -1 && !mInputBufferMap[i].used) {
             index = i;
-            break;
+            // keep a dmabuf on the index it was attached to, so it is mapped only once
+            if (mInMemType != V4L2_MEMORY_DMABUF || mInputBufferMap[i].plane.fd == input->fd)
+                break;
         }
     }
 
+    if (index < 0) {
+        // every input buffer still holds a frame being decoded
+        mLock.unlock();
+        ALOGW("%s: no free input buffer", __FUNCTION__);
+        return WOULD_BLOCK;
+    }
+
     mInputBufferMap[index].input_id = input->id;
     ALOGV("%s: input->BUF=%p, index=%d, len=%zu", __FUNCTION__, input->pInBuffer, index,
           (size_t)input->size);
 
     uint32_t offset = 0;
-    memcpy((void *)(uintptr_t)(mInputBufferMap[index].plane.vaddr + offset), input->pInBuffer,
-           input->size);
-    buf_length += input->size;
-    dumpStream((void *)(uintptr_t)(mInputBufferMap[index].plane.vaddr + offset), buf_length, 0);
+    if (mInMemType == V4L2_MEMORY_DMABUF) {
+        mInputBufferMap[index].plane.fd = input->fd;
+        buf_length += input->size;
+        dumpStream(input->pInBuffer, buf_length, 0);
+    } else {
+        memcpy((void *)(uintptr_t)(mInputBufferMap[index].plane.vaddr + offset), input->pInBuffer,
+               input->size);
+        buf_length += input->size;
+        dumpStream((void *)(uintptr_t)(mInputBufferMap[index].plane.vaddr + offset), buf_length,
+                   0);
+    }
 
     struct v4l2_buffer stV4lBuf;
     memset(&stV4lBuf, 0, sizeof(stV4lBuf));
@@ -711,14 +790,19 @@ status_t HwDecoder::queueInputBuffer(std::unique_ptr<DecoderInputBuffer> input)
 
     if (V4L2_TYPE_IS_MULTIPLANAR(mOutBufType)) {
         plane.bytesused = buf_length;
-        plane.length = mInputFormat.bufferSize;
+        plane.length = capacity;
         plane.data_offset = 0;
-        plane.m.mem_offset = 0; // mInMemType == V4L2_MEMORY_MMAP
+        if (mInMemType == V4L2_MEMORY_DMABUF)
+            plane.m.fd = input->fd;
+        else
+            plane.m.mem_offset = 0;
         stV4lBuf.m.planes = &plane;
         stV4lBuf.length = DEFAULT_INPUT_BUFFER_PLANE;
     } else {
         stV4lBuf.bytesused = buf_length;
-        stV4lBuf.length = mInputFormat.bufferSize;
+        stV4lBuf.length = capacity;
+        if (mInMemType == V4L2_MEMORY_DMABUF)
+            stV4lBuf.m.fd = input->fd;
     }
 
     ALOGV("%s: VIDIOC_QBUF OUTPUT BEGIN index=%d,len=%d\n", __FUNCTION__, stV4lBuf.index,
@@ -727,7 +811,14 @@ status_t HwDecoder::queueInputBuffer(std::unique_ptr<DecoderInputBuffer> input)
     result = ioctl(mFd, VIDIOC_QBUF, &stV4lBuf);
     if (result < 0) {
         ALOGE("%s: VIDIOC_QBUF OUTPUT failed, index=%d", __FUNCTION__, index);
+        mInputBufferMap[index].input_id = -1;
         mLock.unlock();
+        // the decoder can't reach the memory, e.g. it is not contiguous
+        if (mInMemType == V4L2_MEMORY_DMABUF) {
+            ALOGW("%s: import input dmabuf failed, copy input", __FUNCTION__);
+            bInputDmaBufFailed = true;
+            return queueInputBuffer(std::move(input));
+        }
         return UNKNOWN_ERROR;
     }
 
@@ -1171,7 +1262,6 @@ status_t HwDecoder::handleFormatChanged() {
 
         mOutFormat = v4l2_pixel_format;
         mOutputFormat.pixelFormat = static_cast<int>(pixel_format);
-        mData.format = mOutputFormat.pixelFormat;
 
         mOutputFormat.width = newWidth;
         mOutputFormat.height = newHeight;
@@ -1485,6 +1575,8 @@ void HwDecoder::returnOutputBufferToDecoder(int32_t bufId) {
     if (mDBInfo) {
         ALOGV("%s: bufId %d", __FUNCTION__, bufId);
         mDBInfo->bInUse = false;
+        std::lock_guard<std::mutex> flk(mFetchSignalLock);
+        mFetchSignal.notify_one();
     } else {
         ALOGE("%s: invalid bufId %d", __FUNCTION__, bufId);
     }
@@ -1503,14 +1595,16 @@ void HwDecoder::notifyDecodeReady(int32_t mOutbufId) {
         return;
     }
 
-    std::unique_lock<std::mutex> mlk(mFramesSignalLock);
+    DecodedData data;
+    data.fd = info->mDMABufFd;
+    data.data = (uint8_t *)info->mVirtAddr;
+    data.width = mOutputFormat.width;
+    data.height = mOutputFormat.height;
+    data.format = mOutputFormat.pixelFormat;
+    data.bufId = mOutbufId;
 
-    mData.fd = info->mDMABufFd;
-    mData.data = (uint8_t *)info->mVirtAddr;
-    mData.width = mOutputFormat.width;
-    mData.height = mOutputFormat.height;
-    mData.bufId = mOutbufId;
-    mDecReady = true;
+    std::unique_lock<std::mutex> mlk(mFramesSignalLock);
+    mDecodedFrames.push_back(data);
 
     mFramesSignal.notify_all();
 }
@@ -1519,15 +1613,15 @@ int HwDecoder::exportDecodedBuf(DecodedData &data, int32_t timeoutMs) {
     std::unique_lock<std::mutex> mlk(mFramesSignalLock);
 
     if (timeoutMs == -1) {
-        while (!mDecReady) mFramesSignal.wait(mlk);
+        while (mDecodedFrames.empty()) mFramesSignal.wait(mlk);
 
-        mDecReady = false;
-        data = mData;
+        data = mDecodedFrames.front();
+        mDecodedFrames.pop_front();
         return OK;
     }
 
     std::chrono::milliseconds timeout = std::chrono::milliseconds(timeoutMs);
-    while (!mDecReady) {
+    while (mDecodedFrames.empty()) {
         auto st = mFramesSignal.wait_for(mlk, timeout);
         if (st == std::cv_status::timeout) {
             ALOGW("%s: wait decoder output timeout!", __FUNCTION__);
@@ -1535,8 +1629,8 @@ int HwDecoder::exportDecodedBuf(DecodedData &data, int32_t timeoutMs) {
         }
     }
 
-    mDecReady = false;
-    data = mData;
+    data = mDecodedFrames.front();
+    mDecodedFrames.pop_front();
 
     return OK;
 }
@@ -201,7 +201,8 @@ struct ExternalCameraDeviceSession : public virtual RefBase, public virtual Outp
         bool mHardwareDecoder;
 
     private:
-        int VpuDecAndCsc(uint8_t* inData, size_t inDataSize, YCbCrLayout& cropAndScaled);
+        int VpuDecAndCsc(uint8_t* inData, size_t inDataSize, int inFd, uint32_t inCapacity,
+                         YCbCrLayout& cropAndScaled);
     };
 
 protected:
@@ -356,6 +357,9 @@ protected:
     std::condition_variable mV4L2BufferReturned;
     size_t mNumDequeuedV4l2Buffers = 0;
     uint32_t mMaxV4L2BufferSize = 0;
+    // dmabuf of each V4L2 buffer, imported by the hardware MJPEG decoder
+    std::vector<unique_fd> mV4l2BufferDmaFds;
+    uint32_t mV4l2BufferLength = 0;
 
     // Not protected by mLock (but might be used when mLock is locked)
     sp<OutputThread> mOutputThread;
@@ -153,12 +153,14 @@ public:
 class V4L2Frame : public Frame {
 public:
     V4L2Frame(uint32_t w, uint32_t h, uint32_t fourcc, int bufIdx, int fd, uint32_t dataSize,
-              uint64_t offset);
+              uint64_t offset, int dmaBufFd = -1, uint32_t bufferLength = 0);
     ~V4L2Frame() override;
 
     virtual int getData(uint8_t** outData, size_t* dataSize) override;
 
     const int mBufferIndex; // for later enqueue
+    const int mDmaBufFd;    // exported buffer, -1 if none. doesn't claim ownership
+    const uint32_t mBufferLength;
     int map(uint8_t** data, size_t* dataSize);
     int unmap();
 
@@ -21,6 +21,7 @@
 #include <utils/Mutex.h>
 
 #include <condition_variable>
+#include <deque>
 
 #include "DecoderDev.h"
 #include "ExternalCameraUtils.h"
@@ -104,6 +105,9 @@ struct DecoderInputBuffer {
     void* pInBuffer;
     int id;
     uint32_t size;
+    // dmabuf holding pInBuffer and its size, imported instead of copied if set
+    int fd = -1;
+    uint32_t capacity = 0;
 };
 
 class HwDecoder {
@@ -125,10 +129,10 @@ public:
     int exportDecodedBuf(DecodedData& data, int32_t timeoutMs);
     void returnOutputBufferToDecoder(int32_t bufId);
 
-    DecodedData mData;
+    // decoded frames in decode order, until taken by exportDecodedBuf
+    std::deque<DecodedData> mDecodedFrames;
     mutable std::mutex mFramesSignalLock;
     std::condition_variable mFramesSignal;
-    bool mDecReady;
 
 private:
     // const char* mMime;
@@ -157,12 +161,17 @@ private:
     Mutex mLock;
     Mutex mThreadLock;
 
+    // wakes the fetch thread when a client returns an output buffer
+    std::mutex mFetchSignalLock;
+    std::condition_variable mFetchSignal;
+
     int mDecState;
     int mPollState;
     int mFetchState;
 
     bool bInputStreamOn;
     bool bOutputStreamOn;
+    bool bInputDmaBufFailed;
 
     uint32_t mOutputBufferUsed;
 
@@ -175,9 +184,11 @@ private:
     uint8_t mTableSize;
     COLOR_FORMAT_TABLE* color_format_table;
 
+    void resetInputBufferSize();
     status_t SetInputFormats();
     status_t allocateInputBuffers();
     status_t destroyInputBuffers();
+    status_t setInputMemory(enum v4l2_memory memory, uint32_t capacity);
 
     status_t SetOutputFormats();
     status_t allocateOutputBuffers();
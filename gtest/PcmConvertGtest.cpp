@@ -0,0 +1,284 @@
+/*
+ * Copyright 2023 NXP
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "pcm_convert.h"
+
+// frame counts around the vector widths and the stage block
+static const size_t sFrameCounts[] = {0, 1, 3, 7, 8, 9, 17, 63, 64, 65, 200, 1031};
+
+static const enum pcm_convert_format sFormats[] = {
+        PCM_CONVERT_S16_LE,
+        PCM_CONVERT_S24_LE,
+        PCM_CONVERT_S32_LE,
+};
+
+static std::vector<uint8_t> randomFrames(enum pcm_convert_format format, unsigned int channels,
+                                         size_t frames) {
+    std::vector<uint8_t> buf(frames * channels * pcm_convert_format_bytes(format));
+    for (auto& b : buf) b = rand();
+    if (format == PCM_CONVERT_S24_LE) {
+        // a real S24_LE sample is sign extended
+        int32_t* s = (int32_t*)buf.data();
+        for (size_t i = 0; i < frames * channels; i++) s[i] = (int32_t)((uint32_t)s[i] << 8) >> 8;
+    }
+    return buf;
+}
+
+static std::vector<uint8_t> convert(const struct pcm_converter& cv, const std::vector<uint8_t>& src,
+                                    size_t frames) {
+    // one frame more to catch writes past the end
+    size_t dstFrame = pcm_convert_format_bytes(cv.dst_format) * cv.dst_channels;
+    std::vector<uint8_t> dst((frames + 1) * dstFrame, 0xcd);
+    pcm_convert(&cv, src.data(), dst.data(), frames);
+    for (size_t i = frames * dstFrame; i < dst.size(); i++) EXPECT_EQ(0xcd, dst[i]);
+    dst.resize(frames * dstFrame);
+    return dst;
+}
+
+// The selected kernels against the C ones, every format pair and channel count.
+TEST(PcmConvert, KernelsMatchC) {
+    printf("kernels %s\n", pcm_convert_get_kernels()->name);
+    for (auto srcFormat : sFormats) {
+        for (auto dstFormat : sFormats) {
+            for (unsigned int srcChannels = 1; srcChannels <= 8; srcChannels++) {
+                for (unsigned int dstChannels = 1; dstChannels <= 8; dstChannels++) {
+                    struct pcm_converter cv, ref;
+                    ASSERT_EQ(0, pcm_converter_init(&cv, srcFormat, srcChannels, dstFormat,
+                                                    dstChannels, NULL));
+                    ref = cv;
+                    pcm_converter_set_kernels(&ref, pcm_convert_get_kernels_c());
+                    for (size_t frames : sFrameCounts) {
+                        auto src = randomFrames(srcFormat, srcChannels, frames);
+                        ASSERT_EQ(convert(ref, src, frames), convert(cv, src, frames))
+                                << srcFormat << " " << srcChannels << " -> " << dstFormat << " "
+                                << dstChannels << ", " << frames << " frames";
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Sample by sample definition of every format change.
+static int32_t convertSample(int32_t s, enum pcm_convert_format from, enum pcm_convert_format to) {
+    if (from == to)
+        return s;
+    if (to == PCM_CONVERT_S16_LE)
+        return (int16_t)(s >> (from == PCM_CONVERT_S24_LE ? 8 : 16));
+    if (from == PCM_CONVERT_S16_LE)
+        return (int32_t)((uint32_t)s << (to == PCM_CONVERT_S24_LE ? 8 : 16));
+    return to == PCM_CONVERT_S32_LE ? (int32_t)((uint32_t)s << 8) : s >> 8;
+}
+
+static int32_t sampleAt(const std::vector<uint8_t>& buf, enum pcm_convert_format format,
+                        size_t i) {
+    if (format == PCM_CONVERT_S16_LE)
+        return ((const int16_t*)buf.data())[i];
+    return ((const int32_t*)buf.data())[i];
+}
+
+TEST(PcmConvert, ExplicitMap) {
+    // reversed, duplicated and silent channels
+    const int8_t map[] = {3, PCM_CONVERT_SILENT, 0, 0, 2, 1};
+    for (auto srcFormat : sFormats) {
+        for (auto dstFormat : sFormats) {
+            struct pcm_converter cv;
+            ASSERT_EQ(0, pcm_converter_init(&cv, srcFormat, 4, dstFormat, 6, map));
+            size_t frames = 77;
+            auto src = randomFrames(srcFormat, 4, frames);
+            auto dst = convert(cv, src, frames);
+            for (size_t f = 0; f < frames; f++) {
+                for (unsigned int c = 0; c < 6; c++) {
+                    int32_t expected = map[c] == PCM_CONVERT_SILENT
+                                               ? 0
+                                               : convertSample(sampleAt(src, srcFormat,
+                                                                        f * 4 + map[c]),
+                                                               srcFormat, dstFormat);
+                    ASSERT_EQ(expected, sampleAt(dst, dstFormat, f * 6 + c));
+                }
+            }
+        }
+    }
+}
+
+TEST(PcmConvert, Layouts) {
+    struct pcm_converter cv;
+    const int8_t esai8[] = {0, 4, 2, 6, 1, 5, 3, 7};
+    const int8_t esai6[] = {0, 4, 2, 1, 5, 3};
+    const int8_t swap[] = {1, 0};
+    const int8_t left[] = {0};
+
+    pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S16_LE, 2, NULL);
+    EXPECT_EQ(PCM_CONVERT_SAME_LAYOUT, cv.layout);
+    pcm_converter_init(&cv, PCM_CONVERT_S24_LE, 1, PCM_CONVERT_S16_LE, 2, NULL);
+    EXPECT_EQ(PCM_CONVERT_MONO_TO_STEREO, cv.layout);
+    pcm_converter_init(&cv, PCM_CONVERT_S32_LE, 2, PCM_CONVERT_S16_LE, 1, NULL);
+    EXPECT_EQ(PCM_CONVERT_STEREO_TO_MONO, cv.layout);
+    pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S16_LE, 1, left);
+    EXPECT_EQ(PCM_CONVERT_MAP, cv.layout);
+    pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S16_LE, 2, swap);
+    EXPECT_EQ(PCM_CONVERT_SHUFFLE, cv.layout);
+    EXPECT_EQ(4u, cv.shuffle_frames);
+    pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 8, PCM_CONVERT_S16_LE, 8, esai8);
+    EXPECT_EQ(PCM_CONVERT_SHUFFLE, cv.layout);
+    EXPECT_EQ(1u, cv.shuffle_vectors);
+    pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 6, PCM_CONVERT_S16_LE, 6, esai6);
+    EXPECT_EQ(PCM_CONVERT_SHUFFLE, cv.layout);
+    EXPECT_EQ(3u, cv.shuffle_vectors);
+    // 56 bytes a frame, no group of frames fits in the shuffle
+    int8_t reverse[14];
+    for (int c = 0; c < 14; c++) reverse[c] = 13 - c;
+    pcm_converter_init(&cv, PCM_CONVERT_S32_LE, 14, PCM_CONVERT_S32_LE, 14, reverse);
+    EXPECT_EQ(PCM_CONVERT_MAP, cv.layout);
+}
+
+TEST(PcmConvert, InvalidArguments) {
+    struct pcm_converter cv;
+    const int8_t bad[] = {0, 2};
+    const int8_t negative[] = {0, -2};
+    EXPECT_EQ(-EINVAL, pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 0, PCM_CONVERT_S16_LE, 2, NULL));
+    EXPECT_EQ(-EINVAL, pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S16_LE,
+                                          PCM_CONVERT_MAX_CHANNELS + 1, NULL));
+    EXPECT_EQ(-EINVAL, pcm_converter_init(&cv, PCM_CONVERT_FORMAT_COUNT, 2, PCM_CONVERT_S16_LE,
+                                          2, NULL));
+    EXPECT_EQ(-EINVAL, pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S16_LE, 2, bad));
+    EXPECT_EQ(-EINVAL,
+              pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S16_LE, 2, negative));
+}
+
+// The loops the HAL had before, the library must give the same samples.
+static void legacyRecord(const void* src, void* dst, unsigned int frames, bool bit_24b_2_16b,
+                         bool bit_32b_2_16b, bool mono2stereo, bool stereo2mono) {
+    const int* s32 = (const int*)src;
+    const short* s16 = (const short*)src;
+    short* d = (short*)dst;
+    for (unsigned int i = 0; i < frames; i++) {
+        if (bit_24b_2_16b && mono2stereo) {
+            d[i * 2] = d[i * 2 + 1] = (short)(s32[i] >> 8);
+        } else if (bit_24b_2_16b && stereo2mono) {
+            // (data << 8) >> 17, without the signed overflow
+            d[i] = (short)(((int)((unsigned)s32[i * 2] << 8) >> 17) +
+                           ((int)((unsigned)s32[i * 2 + 1] << 8) >> 17));
+        } else if (bit_24b_2_16b) {
+            d[i * 2] = (short)(s32[i * 2] >> 8);
+            d[i * 2 + 1] = (short)(s32[i * 2 + 1] >> 8);
+        } else if (bit_32b_2_16b && mono2stereo) {
+            d[i * 2] = d[i * 2 + 1] = (short)(s32[i] >> 16);
+        } else if (bit_32b_2_16b && stereo2mono) {
+            d[i] = (short)((s32[i * 2] >> 17) + (s32[i * 2 + 1] >> 17));
+        } else if (bit_32b_2_16b) {
+            d[i * 2] = (short)(s32[i * 2] >> 16);
+            d[i * 2 + 1] = (short)(s32[i * 2 + 1] >> 16);
+        } else if (mono2stereo) {
+            d[i * 2] = d[i * 2 + 1] = s16[i];
+        } else if (stereo2mono) {
+            d[i] = (s16[i * 2] >> 1) + (s16[i * 2 + 1] >> 1);
+        }
+    }
+}
+
+TEST(PcmConvert, MatchesLegacyRecord) {
+    struct Case {
+        enum pcm_convert_format format;
+        unsigned int channels;
+        unsigned int dstChannels;
+    } cases[] = {
+            {PCM_CONVERT_S24_LE, 1, 2}, {PCM_CONVERT_S24_LE, 2, 1}, {PCM_CONVERT_S24_LE, 2, 2},
+            {PCM_CONVERT_S32_LE, 1, 2}, {PCM_CONVERT_S32_LE, 2, 1}, {PCM_CONVERT_S32_LE, 2, 2},
+            {PCM_CONVERT_S16_LE, 1, 2}, {PCM_CONVERT_S16_LE, 2, 1},
+    };
+    for (auto& t : cases) {
+        struct pcm_converter cv;
+        ASSERT_EQ(0, pcm_converter_init(&cv, t.format, t.channels, PCM_CONVERT_S16_LE,
+                                        t.dstChannels, NULL));
+        for (size_t frames : sFrameCounts) {
+            auto src = randomFrames(t.format, t.channels, frames);
+            // the capture samples are not always sign extended
+            if (t.format == PCM_CONVERT_S24_LE)
+                for (size_t i = 0; i < src.size(); i += 4) src[i + 3] = rand();
+            std::vector<uint8_t> expected(frames * t.dstChannels * 2);
+            legacyRecord(src.data(), expected.data(), frames, t.format == PCM_CONVERT_S24_LE,
+                         t.format == PCM_CONVERT_S32_LE, t.channels < t.dstChannels,
+                         t.channels > t.dstChannels);
+            ASSERT_EQ(expected, convert(cv, src, frames))
+                    << t.format << " " << t.channels << " -> " << t.dstChannels << ", " << frames;
+        }
+    }
+}
+
+TEST(PcmConvert, MatchesLegacyPassthroughS24) {
+    struct pcm_converter cv;
+    ASSERT_EQ(0, pcm_converter_init(&cv, PCM_CONVERT_S16_LE, 2, PCM_CONVERT_S24_LE, 2, NULL));
+    for (size_t frames : sFrameCounts) {
+        auto src = randomFrames(PCM_CONVERT_S16_LE, 2, frames);
+        std::vector<uint8_t> expected(frames * 2 * 4);
+        const short* s = (const short*)src.data();
+        int* d = (int*)expected.data();
+        for (size_t i = 0; i < frames * 2; i++) d[i] = (int)(s[i] * 256);
+        ASSERT_EQ(expected, convert(cv, src, frames));
+    }
+}
+
+// ESAI takes the left channels first, in place on the period.
+TEST(PcmConvert, MatchesLegacyEsaiInPlace) {
+    const int8_t esai6[] = {0, 4, 2, 1, 5, 3};
+    const int8_t esai8[] = {0, 4, 2, 6, 1, 5, 3, 7};
+    for (unsigned int channels : {6u, 8u}) {
+        struct pcm_converter cv;
+        ASSERT_EQ(0, pcm_converter_init(&cv, PCM_CONVERT_S16_LE, channels, PCM_CONVERT_S16_LE,
+                                        channels, channels == 6 ? esai6 : esai8));
+        for (size_t frames : sFrameCounts) {
+            auto buf = randomFrames(PCM_CONVERT_S16_LE, channels, frames);
+            std::vector<uint8_t> expected = buf;
+            short* s = (short*)buf.data();
+            short* d = (short*)expected.data();
+            for (size_t f = 0; f < frames; f++, s += channels, d += channels) {
+                // FL FR C LFE BL BR [SL SR] -> FL BL C [SL] FR BR LFE [SR]
+                short fl = s[0], fr = s[1], c = s[2], lfe = s[3], bl = s[4], br = s[5];
+                if (channels == 6) {
+                    short out[] = {fl, bl, c, fr, br, lfe};
+                    memcpy(d, out, sizeof(out));
+                } else {
+                    short out[] = {fl, bl, c, s[6], fr, br, lfe, s[7]};
+                    memcpy(d, out, sizeof(out));
+                }
+            }
+            pcm_convert(&cv, buf.data(), buf.data(), frames);
+            ASSERT_EQ(expected, buf) << channels << " channels, " << frames << " frames";
+        }
+    }
+}
+
+// Narrowing 8 channel TDM capture in place, as a read period is.
+TEST(PcmConvert, NarrowInPlace) {
+    for (auto srcFormat : {PCM_CONVERT_S24_LE, PCM_CONVERT_S32_LE}) {
+        struct pcm_converter cv;
+        ASSERT_EQ(0, pcm_converter_init(&cv, srcFormat, 8, PCM_CONVERT_S16_LE, 8, NULL));
+        size_t frames = 1031;
+        auto buf = randomFrames(srcFormat, 8, frames);
+        auto expected = convert(cv, buf, frames);
+        pcm_convert(&cv, buf.data(), buf.data(), frames);
+        buf.resize(expected.size());
+        ASSERT_EQ(expected, buf);
+    }
+}
@@ -224,6 +224,33 @@ static int getGrids(float **gl_grid, uint32_t w, uint32_t h) {
     return sum_num;
 }
 
+// A grid rebuilt from reused rings must give the same meshes as a new one.
+TEST(ImxSV, 3DSurroundViewIncrementalGrid) {
+    vector<Vector3d> evsRotations;
+    vector<Vector3d> evsTransforms;
+    vector<Matrix<double, 3, 3>> Ks;
+    vector<Matrix<double, 1, 4>> Ds;
+
+    initCameraParameters(evsRotations, evsTransforms, Ks, Ds);
+
+    uint32_t w = 1280, h = 800;
+    auto grid = CurvilinearGrid(SV_ANGLES_IN_PI, SV_Z_NOP, SV_X_STEP, w, h, evsRotations,
+                                evsTransforms, Ks, Ds);
+    float radiuses[] = {SV_RADIUS, SV_RADIUS * 2, SV_RADIUS};
+    for (auto radius : radiuses) {
+        ASSERT_TRUE(grid.createGrid(radius));
+
+        auto fresh = CurvilinearGrid(SV_ANGLES_IN_PI, SV_Z_NOP, SV_X_STEP, w, h, evsRotations,
+                                     evsTransforms, Ks, Ds);
+        ASSERT_TRUE(fresh.createGrid(radius));
+        for (int camera = 0; camera < 4; camera++) {
+            const vector<float> &mesh = grid.getMesh(camera);
+            EXPECT_EQ(mesh.size() % (6 * SV_ATTRIBUTE_NUM), 0u);
+            EXPECT_TRUE(mesh == fresh.getMesh(camera));
+        }
+    }
+}
+
 TEST(ImxSV, 3DSurroundViewGrids) {
     EGLint majorVersion;
     EGLint minorVersion;
@@ -17,6 +17,8 @@
 #define LOG_TAG "image-test"
 
 #include <cutils/log.h>
+#include <dirent.h>
+#include <fcntl.h>
 #include <gtest/gtest.h>
 #include <gui/BufferItem.h>
 #include <gui/BufferItemConsumer.h>
@@ -26,10 +28,13 @@
 #include <gui/Surface.h>
 #include <gui/SurfaceComposerClient.h>
 #include <math.h>
+#include <sys/stat.h>
 #include <ui/GraphicBuffer.h>
+#include <unistd.h>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <Imx2DBlend.hpp>
 #include <Imx2DSurroundView.hpp>
 
 #include "ImageUtils.h"
@@ -803,6 +808,8 @@ TEST_F(ImxSV2DTest, SVLibFlatSurroundW16H12) {
     prepareFisheyeImages(distorts);
 
     Imx2DSV *imx2DSV = new Imx2DSV();
+    // always build the LUT here, the cache has its own test
+    imx2DSV->SetLUTCacheDir("");
     ImxSV2DParams sv2DParams = ImxSV2DParams(Size2dInteger(mWidth, mHeight),
                                              Size2dInteger(flatw, flath), Size2dFloat(pw, ph));
     ASSERT_TRUE(imx2DSV->SetConfigs(sv2DParams, evsRotations, evsTransforms, Ks, Ds));
@@ -1050,6 +1057,151 @@ TEST_F(ImxSV2DTest, RotationVector) {
     }
 }
 
+// The kernels picked for this CPU must match the C ones bit for bit, tails
+// included.
+TEST(ImxSV2DBlendTest, KernelsMatchC) {
+    const SVBlendKernels &kernels = getSVBlendKernels();
+    const SVBlendKernels &ref = getSVBlendKernelsC();
+    cout << "blend kernels: " << kernels.name << endl;
+
+    const int srcSize = 4096;
+    vector<uint32_t> src0(srcSize), src1(srcSize);
+    srand(1);
+    for (int i = 0; i < srcSize; i++) {
+        src0[i] = ((uint32_t)rand() << 16) ^ rand();
+        src1[i] = ((uint32_t)rand() << 16) ^ rand();
+    }
+
+    for (int count = 0; count < 70; count++) {
+        vector<uint32_t> offsets0(count), offsets1(count), out(count), expected(count);
+        vector<uint16_t> alpha(count);
+        for (int i = 0; i < count; i++) {
+            offsets0[i] = rand() % srcSize;
+            offsets1[i] = rand() % srcSize;
+            alpha[i] = rand() % (SV_ALPHA_ONE + 1);
+        }
+        if (count > 1) {
+            alpha[0] = 0;
+            alpha[1] = SV_ALPHA_ONE;
+        }
+
+        kernels.blend(src0.data(), offsets0.data(), src1.data(), offsets1.data(), alpha.data(),
+                      out.data(), count);
+        ref.blend(src0.data(), offsets0.data(), src1.data(), offsets1.data(), alpha.data(),
+                  expected.data(), count);
+        ASSERT_EQ(expected, out) << "blend of " << count << " pixels";
+
+        kernels.copy(src0.data(), offsets0.data(), out.data(), count);
+        ref.copy(src0.data(), offsets0.data(), expected.data(), count);
+        ASSERT_EQ(expected, out) << "copy of " << count << " pixels";
+    }
+}
+
+// Runs one surround view of distorts with the LUT cache in cacheDir.
+static bool runCachedSV(const string &cacheDir, vector<shared_ptr<char>> &distorts,
+                        ImxSV2DParams &params, vector<uint32_t> &out) {
+    vector<Vector3d> evsRotations;
+    vector<Vector3d> evsTransforms;
+    vector<Matrix<double, 3, 3>> Ks;
+    vector<Matrix<double, 1, 4>> Ds;
+    initCameraParameters(evsRotations, evsTransforms, Ks, Ds);
+
+    Imx2DSV sv;
+    sv.SetLUTCacheDir(cacheDir);
+    out.assign(params.resolution.width * params.resolution.height, 0);
+    return sv.SetConfigs(params, evsRotations, evsTransforms, Ks, Ds) && sv.startSV() &&
+            sv.GetSVBuffer(distorts, out.data(), 4) && sv.stopSV();
+}
+
+// The only file in dir, the cache file of the one calibration used.
+static string findLUTCache(const string &dir) {
+    string path;
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr)
+        return path;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != nullptr) {
+        if (entry->d_name[0] != '.')
+            path = dir + "/" + entry->d_name;
+    }
+    closedir(d);
+    return path;
+}
+
+// A saved LUT is mapped back by the next start, a damaged one is dropped and
+// rebuilt. Both give the output of a LUT built from scratch.
+TEST(ImxSV2DLUTCacheTest, SaveLoadReject) {
+    const uint32_t camw = 1280;
+    const uint32_t camh = 800;
+    ImxSV2DParams params = ImxSV2DParams(Size2dInteger(camw, camh), Size2dInteger(256, 192),
+                                         Size2dFloat(3.0, 3.0));
+
+    vector<shared_ptr<char>> distorts;
+    srand(1);
+    for (int i = 0; i < 4; i++) {
+        shared_ptr<char> image(new char[camw * camh * 4], std::default_delete<char[]>());
+        uint32_t *pixels = (uint32_t *)image.get();
+        for (uint32_t p = 0; p < camw * camh; p++)
+            pixels[p] = ((uint32_t)rand() << 16) ^ rand();
+        distorts.push_back(image);
+    }
+
+    vector<uint32_t> expected, out;
+    ASSERT_TRUE(runCachedSV("", distorts, params, expected));
+
+    char tmpl[] = "/data/local/tmp/sv_lut_XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(tmpl));
+    string dir = tmpl;
+
+    // first start builds and saves the LUT
+    ASSERT_TRUE(runCachedSV(dir, distorts, params, out));
+    EXPECT_EQ(expected, out);
+    string path = findLUTCache(dir);
+    ASSERT_FALSE(path.empty());
+    struct stat saved;
+    ASSERT_EQ(0, stat(path.c_str(), &saved));
+
+    // next start maps it, the file is not rewritten
+    ASSERT_TRUE(runCachedSV(dir, distorts, params, out));
+    EXPECT_EQ(expected, out);
+    struct stat loaded;
+    ASSERT_EQ(0, stat(path.c_str(), &loaded));
+    EXPECT_EQ(saved.st_ino, loaded.st_ino);
+
+    // a bad magic and a truncated file are rejected and the LUT rebuilt
+    int fd = open(path.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    uint32_t magic = 0, bad = 0;
+    ASSERT_EQ((ssize_t)sizeof(magic), pread(fd, &magic, sizeof(magic), 0));
+    ASSERT_EQ((ssize_t)sizeof(bad), pwrite(fd, &bad, sizeof(bad), 0));
+    close(fd);
+    ASSERT_TRUE(runCachedSV(dir, distorts, params, out));
+    EXPECT_EQ(expected, out);
+    struct stat rebuilt;
+    ASSERT_EQ(0, stat(path.c_str(), &rebuilt));
+    EXPECT_EQ(saved.st_size, rebuilt.st_size);
+    fd = open(path.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ((ssize_t)sizeof(bad), pread(fd, &bad, sizeof(bad), 0));
+    close(fd);
+    EXPECT_EQ(magic, bad);
+
+    ASSERT_EQ(0, truncate(path.c_str(), rebuilt.st_size / 2));
+    ASSERT_TRUE(runCachedSV(dir, distorts, params, out));
+    EXPECT_EQ(expected, out);
+    ASSERT_EQ(0, stat(path.c_str(), &rebuilt));
+    EXPECT_EQ(saved.st_size, rebuilt.st_size);
+
+    // the rebuilt file loads again
+    ASSERT_TRUE(runCachedSV(dir, distorts, params, out));
+    EXPECT_EQ(expected, out);
+    ASSERT_EQ(0, stat(path.c_str(), &loaded));
+    EXPECT_EQ(rebuilt.st_ino, loaded.st_ino);
+
+    unlink(path.c_str());
+    rmdir(dir.c_str());
+}
+
 class ImxSVCali1Test : public ::testing::Test {
 protected:
     virtual void SetUp() {
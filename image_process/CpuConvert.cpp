@@ -0,0 +1,473 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "CpuConvert"
+
+#include "CpuConvert.h"
+
+#include <errno.h>
+#include <log/log.h>
+#include <math.h>
+#include <string.h>
+#include <system/graphics.h>
+
+#include <functional>
+#include <vector>
+
+#include "CpuKernels.h"
+#include "CpuWorkers.h"
+
+namespace android {
+
+namespace {
+
+enum ChromaOrder {
+    CHROMA_YUYV, // interleaved with luma
+    CHROMA_UV,   // NV12, NV16
+    CHROMA_VU,   // NV21
+    CHROMA_YV12, // V plane then U plane
+};
+
+struct FrameLayout {
+    ChromaOrder order;
+    int width;
+    int height;
+    int chromaHeight;
+    uint8_t *luma;
+    int lumaStride;
+    // UV/VU plane, V plane of YV12, or the YUYV plane.
+    uint8_t *chroma;
+    int chromaStride;
+    // U plane of YV12.
+    uint8_t *chroma2;
+    int chroma2Stride;
+};
+
+bool getFrameLayout(const ImxImageBuffer &buf, FrameLayout &layout) {
+    uint8_t *base = (uint8_t *)buf.mVirtAddr;
+    int width = buf.mWidth;
+    int height = buf.mHeight;
+    if (base == NULL || width < 2 || height < 2 || (width & 1) || (height & 1))
+        return false;
+
+    layout.width = width;
+    layout.height = height;
+    layout.luma = base;
+    layout.lumaStride = width;
+    layout.chroma = base + width * height;
+    layout.chromaStride = width;
+    layout.chromaHeight = height / 2;
+    layout.chroma2 = NULL;
+    layout.chroma2Stride = 0;
+
+    switch (buf.mFormat) {
+        case HAL_PIXEL_FORMAT_YCbCr_422_I:
+            layout.order = CHROMA_YUYV;
+            layout.lumaStride = width * 2;
+            layout.chroma = base;
+            layout.chromaStride = width * 2;
+            layout.chromaHeight = height;
+            break;
+
+        case HAL_PIXEL_FORMAT_YCbCr_422_SP: {
+            int heightSpan = (int)buf.mHeightSpan > height ? buf.mHeightSpan : height;
+            layout.order = CHROMA_UV;
+            layout.chroma = base + width * heightSpan;
+            layout.chromaHeight = height;
+            break;
+        }
+
+        case HAL_PIXEL_FORMAT_YCbCr_420_SP:
+        case HAL_PIXEL_FORMAT_YCbCr_420_888:
+            layout.order = CHROMA_UV;
+            break;
+
+        case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+            layout.order = CHROMA_VU;
+            break;
+
+        case HAL_PIXEL_FORMAT_YV12:
+            layout.order = CHROMA_YV12;
+            layout.chromaStride = width / 2;
+            layout.chroma2 = layout.chroma + (width / 2) * (height / 2);
+            layout.chroma2Stride = width / 2;
+            break;
+
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+// Fixed point weights of the source samples of each output sample.
+struct FilterTable {
+    bool identity;
+    int taps;
+    std::vector<int> starts;
+    std::vector<uint16_t> weights;
+};
+
+void buildFilterTable(FilterTable &table, int srcCount, int dstCount) {
+    table.identity = (srcCount == dstCount);
+    table.starts.resize(dstCount);
+    if (table.identity) {
+        table.taps = 1;
+        table.weights.assign(dstCount, CPU_WEIGHT_ONE);
+        for (int i = 0; i < dstCount; i++)
+            table.starts[i] = i;
+        return;
+    }
+
+    // bilinear when enlarging, each output averages its footprint when reducing.
+    double scale = (double)srcCount / dstCount;
+    std::vector<int> firsts(dstCount);
+    std::vector<std::vector<double>> raws(dstCount);
+    int taps = 1;
+    for (int i = 0; i < dstCount; i++) {
+        std::vector<double> &raw = raws[i];
+        if (scale <= 1.0) {
+            double center = (i + 0.5) * scale - 0.5;
+            int first = (int)floor(center);
+            double frac = center - first;
+            firsts[i] = first;
+            raw.push_back(1.0 - frac);
+            raw.push_back(frac);
+        } else {
+            double x0 = i * scale;
+            double x1 = x0 + scale;
+            int first = (int)floor(x0);
+            firsts[i] = first;
+            for (int j = first; j < x1; j++) {
+                double w = (fmin(x1, j + 1) - fmax(x0, j)) / scale;
+                raw.push_back(w > 0 ? w : 0);
+            }
+        }
+        if ((int)raw.size() > taps)
+            taps = raw.size();
+    }
+    if (taps > srcCount)
+        taps = srcCount;
+
+    // source samples out of range are clamped to the edge.
+    table.taps = taps;
+    table.weights.assign(dstCount * taps, 0);
+    std::vector<double> merged(taps);
+    for (int i = 0; i < dstCount; i++) {
+        int start = firsts[i];
+        if (start > srcCount - taps)
+            start = srcCount - taps;
+        if (start < 0)
+            start = 0;
+        table.starts[i] = start;
+
+        merged.assign(taps, 0);
+        for (size_t j = 0; j < raws[i].size(); j++) {
+            int index = firsts[i] + j;
+            index = index < 0 ? 0 : (index >= srcCount ? srcCount - 1 : index);
+            merged[index - start] += raws[i][j];
+        }
+
+        // keep the sum exact, the rounding error goes to the largest weight.
+        uint16_t *weights = &table.weights[i * taps];
+        int sum = 0;
+        int largest = 0;
+        for (int k = 0; k < taps; k++) {
+            weights[k] = (uint16_t)lround(merged[k] * CPU_WEIGHT_ONE);
+            sum += weights[k];
+            if (weights[k] > weights[largest])
+                largest = k;
+        }
+        weights[largest] += CPU_WEIGHT_ONE - sum;
+    }
+}
+
+// Return source row, the pointer is either into the frame or scratch.
+typedef std::function<const uint8_t *(int row, uint8_t *scratch)> RowFetcher;
+
+// Scale one plane. Rows are scaled horizontally once and kept in a ring for
+// the vertical taps, then blended with the SIMD kernel.
+class PlaneScaler {
+public:
+    // crop is in samples of channels bytes, fetch may write fetchRowBytes to
+    // scratch. The tables are shared by the scalers of all bands.
+    void init(int srcX, int srcY, int fetchRowBytes, const FilterTable *horizontal,
+              const FilterTable *vertical, int channels, const RowFetcher &fetch) {
+        mHorizontal = horizontal;
+        mVertical = vertical;
+        mSrcX = srcX;
+        mSrcY = srcY;
+        mChannels = channels;
+        mDstBytes = horizontal->starts.size() * channels;
+        mFetch = fetch;
+
+        int taps = vertical->taps;
+        mSlotBytes = fetchRowBytes > mDstBytes ? fetchRowBytes : mDstBytes;
+        mRing.resize(taps * mSlotBytes);
+        mRingRows.assign(taps, -1);
+        mRingPtrs.assign(taps, NULL);
+        mRows.resize(taps);
+        if (!horizontal->identity)
+            mFetchScratch.resize(fetchRowBytes);
+    }
+
+    // Return output row, either scratch or a row of the source when no
+    // vertical blending is needed.
+    const uint8_t *getRow(int row, uint8_t *scratch) {
+        int start = mVertical->starts[row];
+        int taps = mVertical->taps;
+        if (taps == 1)
+            return getScaledRow(start);
+
+        for (int k = 0; k < taps; k++)
+            mRows[k] = getScaledRow(start + k);
+        getCpuKernels().blendRows(mRows.data(), &mVertical->weights[row * taps], taps,
+                                  scratch, mDstBytes);
+        return scratch;
+    }
+
+private:
+    const uint8_t *getScaledRow(int row) {
+        // rows of one window are consecutive, so they never share a slot.
+        int slot = row % mVertical->taps;
+        if (mRingRows[slot] == row)
+            return mRingPtrs[slot];
+
+        uint8_t *buf = &mRing[slot * mSlotBytes];
+        const uint8_t *ptr;
+        if (mHorizontal->identity) {
+            ptr = mFetch(mSrcY + row, buf) + mSrcX * mChannels;
+        } else {
+            const uint8_t *src = mFetch(mSrcY + row, mFetchScratch.data()) + mSrcX * mChannels;
+            scaleRow(src, buf);
+            ptr = buf;
+        }
+
+        mRingRows[slot] = row;
+        mRingPtrs[slot] = ptr;
+        return ptr;
+    }
+
+    void scaleRow(const uint8_t *src, uint8_t *dst) {
+        // the common tap counts are unrolled by the compiler.
+        switch (mHorizontal->taps * 2 + mChannels - 1) {
+            case 2 * 2:
+                scaleRow<1, 2>(src, dst);
+                break;
+            case 2 * 2 + 1:
+                scaleRow<2, 2>(src, dst);
+                break;
+            case 3 * 2:
+                scaleRow<1, 3>(src, dst);
+                break;
+            case 3 * 2 + 1:
+                scaleRow<2, 3>(src, dst);
+                break;
+            default:
+                if (mChannels == 2)
+                    scaleRow<2, 0>(src, dst);
+                else
+                    scaleRow<1, 0>(src, dst);
+                break;
+        }
+    }
+
+    // TAPS is 0 when only known at runtime.
+    template <int CHANNELS, int TAPS>
+    void scaleRow(const uint8_t *src, uint8_t *dst) {
+        int taps = TAPS ? TAPS : mHorizontal->taps;
+        int count = mHorizontal->starts.size();
+        const int *starts = mHorizontal->starts.data();
+        const uint16_t *weights = mHorizontal->weights.data();
+        for (int i = 0; i < count; i++, weights += taps) {
+            const uint8_t *s = src + starts[i] * CHANNELS;
+            for (int c = 0; c < CHANNELS; c++) {
+                uint32_t acc = CPU_WEIGHT_ONE / 2;
+                for (int k = 0; k < taps; k++)
+                    acc += s[k * CHANNELS + c] * weights[k];
+                dst[i * CHANNELS + c] = acc >> CPU_WEIGHT_SHIFT;
+            }
+        }
+    }
+
+    const FilterTable *mHorizontal;
+    const FilterTable *mVertical;
+    int mSrcX;
+    int mSrcY;
+    int mChannels;
+    int mDstBytes;
+    RowFetcher mFetch;
+
+    int mSlotBytes;
+    std::vector<uint8_t> mRing;
+    std::vector<int> mRingRows;
+    std::vector<const uint8_t *> mRingPtrs;
+    std::vector<const uint8_t *> mRows;
+    std::vector<uint8_t> mFetchScratch;
+};
+
+} // namespace
+
+bool cpuConvertSupported(uint32_t srcFormat, uint32_t dstFormat) {
+    ImxImageBuffer src, dst;
+    uint8_t dummy;
+    FrameLayout layout;
+
+    memset(&src, 0, sizeof(src));
+    src.mFormat = srcFormat;
+    src.mWidth = src.mHeight = 2;
+    src.mVirtAddr = &dummy;
+    dst = src;
+    dst.mFormat = dstFormat;
+
+    return getFrameLayout(src, layout) && getFrameLayout(dst, layout);
+}
+
+int cpuConvertImage(ImxImageBuffer &dstBuf, const ImxImageBuffer &srcBuf, int threads) {
+    FrameLayout src, dst;
+    if (!getFrameLayout(srcBuf, src) || !getFrameLayout(dstBuf, dst)) {
+        ALOGE("%s: unsupported convert 0x%x %dx%d to 0x%x %dx%d", __func__, srcBuf.mFormat,
+              srcBuf.mWidth, srcBuf.mHeight, dstBuf.mFormat, dstBuf.mWidth, dstBuf.mHeight);
+        return -EINVAL;
+    }
+
+    const CpuKernels &kernels = getCpuKernels();
+    int srcWidth = src.width;
+    int dstWidth = dst.width;
+    int dstHeight = dst.height;
+
+    // keep the aspect ratio of dst, crop evenly on both sides of the source.
+    int cropWidth = src.width;
+    int cropHeight = src.height;
+    if ((int64_t)src.width * dst.height > (int64_t)dst.width * src.height)
+        cropWidth = (int64_t)src.height * dst.width / dst.height;
+    else
+        cropHeight = (int64_t)src.width * dst.height / dst.width;
+    cropWidth = cropWidth < 2 ? 2 : cropWidth & ~1;
+    cropHeight = cropHeight < 2 ? 2 : cropHeight & ~1;
+    int cropX = ((src.width - cropWidth) / 2) & ~1;
+    int cropY = ((src.height - cropHeight) / 2) & ~1;
+
+    RowFetcher fetchLuma;
+    int lumaRowBytes = srcWidth;
+    if (src.order == CHROMA_YUYV) {
+        lumaRowBytes = srcWidth * 2;
+        fetchLuma = [&](int row, uint8_t *scratch) -> const uint8_t * {
+            kernels.deinterleave(src.luma + row * src.lumaStride, scratch, scratch + srcWidth,
+                                 srcWidth);
+            return scratch;
+        };
+    } else {
+        fetchLuma = [&](int row, uint8_t *) -> const uint8_t * {
+            return src.luma + row * src.lumaStride;
+        };
+    }
+
+    // chroma is handled as UV pairs of half the width.
+    RowFetcher fetchChroma;
+    int chromaRowBytes = srcWidth;
+    switch (src.order) {
+        case CHROMA_YUYV:
+            chromaRowBytes = srcWidth * 2;
+            fetchChroma = [&](int row, uint8_t *scratch) -> const uint8_t * {
+                kernels.deinterleave(src.chroma + row * src.chromaStride, scratch + srcWidth,
+                                     scratch, srcWidth);
+                return scratch;
+            };
+            break;
+        case CHROMA_UV:
+            fetchChroma = [&](int row, uint8_t *) -> const uint8_t * {
+                return src.chroma + row * src.chromaStride;
+            };
+            break;
+        case CHROMA_VU:
+            fetchChroma = [&](int row, uint8_t *scratch) -> const uint8_t * {
+                kernels.swapPairs(src.chroma + row * src.chromaStride, scratch, srcWidth / 2);
+                return scratch;
+            };
+            break;
+        case CHROMA_YV12:
+            fetchChroma = [&](int row, uint8_t *scratch) -> const uint8_t * {
+                kernels.interleave(src.chroma2 + row * src.chroma2Stride,
+                                   src.chroma + row * src.chromaStride, scratch, srcWidth / 2);
+                return scratch;
+            };
+            break;
+    }
+
+    int srcChromaSub = src.height / src.chromaHeight;
+    FilterTable lumaH, lumaV, chromaH, chromaV;
+    buildFilterTable(lumaH, cropWidth, dstWidth);
+    buildFilterTable(lumaV, cropHeight, dstHeight);
+    buildFilterTable(chromaH, cropWidth / 2, dstWidth / 2);
+    buildFilterTable(chromaV, cropHeight / srcChromaSub, dst.chromaHeight);
+
+    // bands of even rows, so 4:2:0 chroma rows split at the same place.
+    int dstChromaSub = dst.height / dst.chromaHeight;
+    cpuRunBands(dstHeight, dstWidth, 2, threads, [&](int start, int end) {
+        PlaneScaler luma, chroma;
+        luma.init(cropX, cropY, lumaRowBytes, &lumaH, &lumaV, 1, fetchLuma);
+        chroma.init(cropX / 2, cropY / srcChromaSub, chromaRowBytes, &chromaH, &chromaV, 2,
+                    fetchChroma);
+
+        std::vector<uint8_t> scratch(dstWidth * 2);
+        uint8_t *lumaScratch = scratch.data();
+        uint8_t *chromaScratch = scratch.data() + dstWidth;
+
+        if (dst.order == CHROMA_YUYV) {
+            for (int i = start; i < end; i++) {
+                const uint8_t *y = luma.getRow(i, lumaScratch);
+                const uint8_t *uv = chroma.getRow(i, chromaScratch);
+                kernels.interleave(y, uv, dst.luma + i * dst.lumaStride, dstWidth);
+            }
+            return;
+        }
+
+        for (int i = start; i < end; i++) {
+            uint8_t *out = dst.luma + i * dst.lumaStride;
+            const uint8_t *y = luma.getRow(i, out);
+            if (y != out)
+                memcpy(out, y, dstWidth);
+        }
+
+        for (int i = start / dstChromaSub; i < end / dstChromaSub; i++) {
+            uint8_t *out = dst.chroma + i * dst.chromaStride;
+            const uint8_t *uv;
+            switch (dst.order) {
+                case CHROMA_UV:
+                    uv = chroma.getRow(i, out);
+                    if (uv != out)
+                        memcpy(out, uv, dstWidth);
+                    break;
+                case CHROMA_VU:
+                    uv = chroma.getRow(i, chromaScratch);
+                    kernels.swapPairs(uv, out, dstWidth / 2);
+                    break;
+                case CHROMA_YV12:
+                    uv = chroma.getRow(i, chromaScratch);
+                    kernels.deinterleave(uv, dst.chroma2 + i * dst.chroma2Stride, out,
+                                         dstWidth / 2);
+                    break;
+                default:
+                    break;
+            }
+        }
+    });
+
+    return 0;
+}
+
+} // namespace android
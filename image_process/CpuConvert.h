@@ -0,0 +1,38 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CPU_CONVERT_H
+#define CPU_CONVERT_H
+
+#include "CpuWorkers.h"
+#include "ImageUtils.h"
+
+namespace android {
+
+// Whether cpuConvertImage() handles the format pair. Supported are YUYV,
+// NV16, NV12, NV21 and YV12 in any combination.
+bool cpuConvertSupported(uint32_t srcFormat, uint32_t dstFormat);
+
+// Scale and convert src to dst in one pass on the CPU. The source is center
+// cropped to the aspect ratio of dst, then scaled at any ratio: bilinear when
+// enlarging, area average when reducing. Planes are packed by width, like the
+// other CPU paths of ImageProcess. The frame is split to bands of rows run
+// by threads, see cpuRunBands().
+int cpuConvertImage(ImxImageBuffer &dst, const ImxImageBuffer &src, int threads = 1);
+
+} // namespace android
+
+#endif // CPU_CONVERT_H
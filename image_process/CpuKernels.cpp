@@ -0,0 +1,277 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "CpuKernels.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace android {
+
+/*======== generic C ======== */
+static void deinterleaveC(const uint8_t *src, uint8_t *even, uint8_t *odd, int count) {
+    for (int i = 0; i < count; i++) {
+        even[i] = src[2 * i];
+        odd[i] = src[2 * i + 1];
+    }
+}
+
+static void interleaveC(const uint8_t *even, const uint8_t *odd, uint8_t *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        dst[2 * i] = even[i];
+        dst[2 * i + 1] = odd[i];
+    }
+}
+
+static void swapPairsC(const uint8_t *src, uint8_t *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        uint8_t first = src[2 * i];
+        dst[2 * i] = src[2 * i + 1];
+        dst[2 * i + 1] = first;
+    }
+}
+
+// blend the pixels [begin, end), the SIMD versions finish their tail with it.
+static void blendRangeC(const uint8_t *const *rows, const uint16_t *weights, int taps, uint8_t *dst,
+                        int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        uint32_t acc = CPU_WEIGHT_ONE / 2;
+        for (int k = 0; k < taps; k++) {
+            acc += rows[k][i] * weights[k];
+        }
+        dst[i] = acc >> CPU_WEIGHT_SHIFT;
+    }
+}
+
+static void blendRowsC(const uint8_t *const *rows, const uint16_t *weights, int taps, uint8_t *dst,
+                       int len) {
+    blendRangeC(rows, weights, taps, dst, 0, len);
+}
+
+static const CpuKernels sKernelsC = {
+        "c", deinterleaveC, interleaveC, swapPairsC, blendRowsC,
+};
+
+// With weights summing to 256 the accumulator of 8 bit pixels fits 16 bit
+// lanes: 255 * 256 + 128 < 65536.
+
+#if defined(__aarch64__)
+/*======== NEON ======== */
+static void deinterleaveNeon(const uint8_t *src, uint8_t *even, uint8_t *odd, int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t v = vld2q_u8(src + 2 * i);
+        vst1q_u8(even + i, v.val[0]);
+        vst1q_u8(odd + i, v.val[1]);
+    }
+    deinterleaveC(src + 2 * i, even + i, odd + i, count - i);
+}
+
+static void interleaveNeon(const uint8_t *even, const uint8_t *odd, uint8_t *dst, int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t v;
+        v.val[0] = vld1q_u8(even + i);
+        v.val[1] = vld1q_u8(odd + i);
+        vst2q_u8(dst + 2 * i, v);
+    }
+    interleaveC(even + i, odd + i, dst + 2 * i, count - i);
+}
+
+static void swapPairsNeon(const uint8_t *src, uint8_t *dst, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u8(dst + 2 * i, vrev16q_u8(vld1q_u8(src + 2 * i)));
+    }
+    swapPairsC(src + 2 * i, dst + 2 * i, count - i);
+}
+
+static void blendRowsNeon(const uint8_t *const *rows, const uint16_t *weights, int taps,
+                          uint8_t *dst, int len) {
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint16x8_t lo = vdupq_n_u16(CPU_WEIGHT_ONE / 2);
+        uint16x8_t hi = lo;
+        for (int k = 0; k < taps; k++) {
+            uint8x16_t s = vld1q_u8(rows[k] + i);
+            uint16x8_t w = vdupq_n_u16(weights[k]);
+            lo = vmlaq_u16(lo, vmovl_u8(vget_low_u8(s)), w);
+            hi = vmlaq_u16(hi, vmovl_high_u8(s), w);
+        }
+        vst1q_u8(dst + i,
+                 vcombine_u8(vshrn_n_u16(lo, CPU_WEIGHT_SHIFT), vshrn_n_u16(hi, CPU_WEIGHT_SHIFT)));
+    }
+    blendRangeC(rows, weights, taps, dst, i, len);
+}
+
+static const CpuKernels sKernelsNeon = {
+        "neon", deinterleaveNeon, interleaveNeon, swapPairsNeon, blendRowsNeon,
+};
+
+#elif defined(__x86_64__) || defined(__i386__)
+/*======== SSE2 ======== */
+static void deinterleaveSse2(const uint8_t *src, uint8_t *even, uint8_t *odd, int count) {
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        __m128i e = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+        __m128i o = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i *)(even + i), e);
+        _mm_storeu_si128((__m128i *)(odd + i), o);
+    }
+    deinterleaveC(src + 2 * i, even + i, odd + i, count - i);
+}
+
+static void interleaveSse2(const uint8_t *even, const uint8_t *odd, uint8_t *dst, int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i e = _mm_loadu_si128((const __m128i *)(even + i));
+        __m128i o = _mm_loadu_si128((const __m128i *)(odd + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(e, o));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(e, o));
+    }
+    interleaveC(even + i, odd + i, dst + 2 * i, count - i);
+}
+
+static void swapPairsSse2(const uint8_t *src, uint8_t *dst, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), v);
+    }
+    swapPairsC(src + 2 * i, dst + 2 * i, count - i);
+}
+
+static void blendRowsSse2(const uint8_t *const *rows, const uint16_t *weights, int taps,
+                          uint8_t *dst, int len) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i lo = _mm_set1_epi16(CPU_WEIGHT_ONE / 2);
+        __m128i hi = lo;
+        for (int k = 0; k < taps; k++) {
+            __m128i s = _mm_loadu_si128((const __m128i *)(rows[k] + i));
+            __m128i w = _mm_set1_epi16(weights[k]);
+            lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), w));
+            hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), w));
+        }
+        __m128i v = _mm_packus_epi16(_mm_srli_epi16(lo, CPU_WEIGHT_SHIFT),
+                                     _mm_srli_epi16(hi, CPU_WEIGHT_SHIFT));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+    blendRangeC(rows, weights, taps, dst, i, len);
+}
+
+static const CpuKernels sKernelsSse2 = {
+        "sse2", deinterleaveSse2, interleaveSse2, swapPairsSse2, blendRowsSse2,
+};
+
+/*======== AVX2 ======== */
+// pack and unpack work inside 128 bit lanes, the 64 bit quarters are
+// reordered afterwards.
+__attribute__((target("avx2"))) static void deinterleaveAvx2(const uint8_t *src, uint8_t *even,
+                                                             uint8_t *odd, int count) {
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + 2 * i + 32));
+        __m256i e = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+        __m256i o = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+        _mm256_storeu_si256((__m256i *)(even + i), _mm256_permute4x64_epi64(e, 0xd8));
+        _mm256_storeu_si256((__m256i *)(odd + i), _mm256_permute4x64_epi64(o, 0xd8));
+    }
+    deinterleaveSse2(src + 2 * i, even + i, odd + i, count - i);
+}
+
+__attribute__((target("avx2"))) static void interleaveAvx2(const uint8_t *even, const uint8_t *odd,
+                                                           uint8_t *dst, int count) {
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i e = _mm256_loadu_si256((const __m256i *)(even + i));
+        __m256i o = _mm256_loadu_si256((const __m256i *)(odd + i));
+        __m256i lo = _mm256_unpacklo_epi8(e, o);
+        __m256i hi = _mm256_unpackhi_epi8(e, o);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    interleaveSse2(even + i, odd + i, dst + 2 * i, count - i);
+}
+
+__attribute__((target("avx2"))) static void swapPairsAvx2(const uint8_t *src, uint8_t *dst,
+                                                          int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+        v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), v);
+    }
+    swapPairsSse2(src + 2 * i, dst + 2 * i, count - i);
+}
+
+__attribute__((target("avx2"))) static void blendRowsAvx2(const uint8_t *const *rows,
+                                                          const uint16_t *weights, int taps,
+                                                          uint8_t *dst, int len) {
+    const __m256i zero = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i lo = _mm256_set1_epi16(CPU_WEIGHT_ONE / 2);
+        __m256i hi = lo;
+        for (int k = 0; k < taps; k++) {
+            __m256i s = _mm256_loadu_si256((const __m256i *)(rows[k] + i));
+            __m256i w = _mm256_set1_epi16(weights[k]);
+            lo = _mm256_add_epi16(lo, _mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), w));
+            hi = _mm256_add_epi16(hi, _mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), w));
+        }
+        __m256i v = _mm256_packus_epi16(_mm256_srli_epi16(lo, CPU_WEIGHT_SHIFT),
+                                        _mm256_srli_epi16(hi, CPU_WEIGHT_SHIFT));
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    blendRangeC(rows, weights, taps, dst, i, len);
+}
+
+static const CpuKernels sKernelsAvx2 = {
+        "avx2", deinterleaveAvx2, interleaveAvx2, swapPairsAvx2, blendRowsAvx2,
+};
+#endif
+
+static const CpuKernels *selectCpuKernels() {
+    const CpuKernels *kernels = &sKernelsC;
+#if defined(__aarch64__)
+    // NEON is mandatory on arm64.
+    kernels = &sKernelsNeon;
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        kernels = &sKernelsAvx2;
+    else if (__builtin_cpu_supports("sse2"))
+        kernels = &sKernelsSse2;
+#endif
+    return kernels;
+}
+
+const CpuKernels &getCpuKernels() {
+    static const CpuKernels *kernels = selectCpuKernels();
+    return *kernels;
+}
+
+} // namespace android
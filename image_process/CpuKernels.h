@@ -0,0 +1,49 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CPU_KERNELS_H
+#define CPU_KERNELS_H
+
+#include <stdint.h>
+
+namespace android {
+
+// Weights of blendRows are fixed point, they sum to 1 << CPU_WEIGHT_SHIFT.
+#define CPU_WEIGHT_SHIFT 8
+#define CPU_WEIGHT_ONE (1 << CPU_WEIGHT_SHIFT)
+
+// Row kernels of the CPU conversion engine. The implementation is picked once
+// at runtime: NEON on arm64, AVX2 or SSE2 on x86 so the same code paths can be
+// checked on a host, plain C elsewhere.
+struct CpuKernels {
+    const char *name;
+    // split even bytes to even[] and odd bytes to odd[], count pairs.
+    // YUYV -> Y + UV, UV -> U + V.
+    void (*deinterleave)(const uint8_t *src, uint8_t *even, uint8_t *odd, int count);
+    // reverse of deinterleave, Y + UV -> YUYV.
+    void (*interleave)(const uint8_t *even, const uint8_t *odd, uint8_t *dst, int count);
+    // swap the bytes of count pairs, UV <-> VU.
+    void (*swapPairs)(const uint8_t *src, uint8_t *dst, int count);
+    // dst[i] = sum(rows[k][i] * weights[k]) >> CPU_WEIGHT_SHIFT with rounding.
+    void (*blendRows)(const uint8_t *const *rows, const uint16_t *weights, int taps, uint8_t *dst,
+                      int len);
+};
+
+const CpuKernels &getCpuKernels();
+
+} // namespace android
+
+#endif // CPU_KERNELS_H
@@ -0,0 +1,169 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "CpuWorkers"
+
+#include "CpuWorkers.h"
+
+#include <log/log.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+
+namespace {
+
+// upper limit of threads working on one frame, caller included.
+#define CPU_MAX_THREADS 8
+
+struct BandJob {
+    const std::function<void(int, int)> *func;
+    std::vector<int> bounds;
+    int next;
+    int pending;
+};
+
+// Workers are created on first use and live with the process. Each is bound
+// to its own core so the bands of a frame do not migrate and share caches.
+class WorkerPool {
+public:
+    // never freed, workers may still wait on it while the process exits.
+    static WorkerPool &get() {
+        static WorkerPool *sPool = new WorkerPool();
+        return *sPool;
+    }
+
+    // threads that may work on one job, caller included.
+    int capacity() const { return mWorkers + 1; }
+
+    void run(BandJob &job) {
+        int count = job.bounds.size() - 1;
+        std::unique_lock<std::mutex> lock(mLock);
+        job.next = 0;
+        job.pending = count;
+        mJobs.push_back(&job);
+        mWorkCond.notify_all();
+
+        // take bands of our own job, so it finishes even if all workers are busy.
+        while (job.next < count) {
+            int band = takeBandLocked(job);
+            lock.unlock();
+            (*job.func)(job.bounds[band], job.bounds[band + 1]);
+            lock.lock();
+            job.pending--;
+        }
+
+        mDoneCond.wait(lock, [&job] { return job.pending == 0; });
+    }
+
+private:
+    WorkerPool() {
+        int cores = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cores > CPU_MAX_THREADS)
+            cores = CPU_MAX_THREADS;
+        for (int i = 1; i < cores; i++) {
+            std::thread worker(&WorkerPool::loop, this, i);
+            worker.detach();
+            mWorkers++;
+        }
+        ALOGI("%s: %d workers", __func__, mWorkers);
+    }
+
+    int takeBandLocked(BandJob &job) {
+        int band = job.next++;
+        if (job.next == (int)job.bounds.size() - 1) {
+            for (auto it = mJobs.begin(); it != mJobs.end(); ++it) {
+                if (*it == &job) {
+                    mJobs.erase(it);
+                    break;
+                }
+            }
+        }
+        return band;
+    }
+
+    void loop(int core) {
+        char name[16];
+        snprintf(name, sizeof(name), "imgproc_cpu%d", core);
+        pthread_setname_np(pthread_self(), name);
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+            ALOGW("%s: bind to cpu %d failed", __func__, core);
+
+        std::unique_lock<std::mutex> lock(mLock);
+        for (;;) {
+            mWorkCond.wait(lock, [this] { return !mJobs.empty(); });
+
+            BandJob &job = *mJobs.front();
+            int band = takeBandLocked(job);
+            lock.unlock();
+            (*job.func)(job.bounds[band], job.bounds[band + 1]);
+            lock.lock();
+            if (--job.pending == 0)
+                mDoneCond.notify_all();
+        }
+    }
+
+    std::mutex mLock;
+    std::condition_variable mWorkCond;
+    std::condition_variable mDoneCond;
+    std::deque<BandJob *> mJobs;
+    int mWorkers = 0;
+};
+
+} // namespace
+
+void cpuRunBands(int rows, int rowPixels, int align, int threads,
+                 const std::function<void(int start, int end)> &job) {
+    int units = (rows + align - 1) / align;
+    int bands = threads;
+    if (threads == CPU_THREADS_AUTO) {
+        int64_t pixels = (int64_t)rows * rowPixels;
+        bands = pixels / CPU_BAND_MIN_PIXELS;
+        if (bands > WorkerPool::get().capacity())
+            bands = WorkerPool::get().capacity();
+    }
+    if (bands > units)
+        bands = units;
+
+    if (bands <= 1) {
+        job(0, rows);
+        return;
+    }
+
+    BandJob bandJob;
+    bandJob.func = &job;
+    bandJob.bounds.resize(bands + 1);
+    for (int i = 0; i <= bands; i++) {
+        int end = (int64_t)units * i / bands * align;
+        bandJob.bounds[i] = end < rows ? end : rows;
+    }
+    WorkerPool::get().run(bandJob);
+}
+
+} // namespace android
@@ -0,0 +1,40 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef CPU_WORKERS_H
+#define CPU_WORKERS_H
+
+#include <functional>
+
+namespace android {
+
+// Thread count of the CPU engine. 1 runs on the caller only, auto uses up to
+// one thread per online core when the frame is large enough to gain from it.
+#define CPU_THREADS_AUTO 0
+
+// Bands smaller than this many output pixels are not worth a thread.
+#define CPU_BAND_MIN_PIXELS (64 * 1024)
+
+// Split rows [0, rows) into horizontal bands of multiples of align rows and
+// run job(start, end) for each. Bands run on a small persistent pool of
+// threads bound to the cores, the caller runs bands too and returns when all
+// are done. Concurrent callers share the pool.
+void cpuRunBands(int rows, int rowPixels, int align, int threads,
+                 const std::function<void(int start, int end)> &job);
+
+} // namespace android
+
+#endif // CPU_WORKERS_H
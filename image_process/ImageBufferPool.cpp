@@ -0,0 +1,212 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ImageBufferPool"
+
+#include "ImageBufferPool.h"
+
+#include <cutils/log.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/user.h>
+
+#include <algorithm>
+
+namespace fsl {
+
+// idle buffers not reused within this time are freed.
+#define POOL_IDLE_TIME ms2ns(3000)
+// upper limit of idle buffers, the least recently used is freed first.
+#define POOL_MAX_IDLE_BUFFERS 8
+
+ImageBufferPool* ImageBufferPool::sInstance(0);
+Mutex ImageBufferPool::sLock(Mutex::PRIVATE);
+
+ImageBufferPool* ImageBufferPool::getInstance() {
+    Mutex::Autolock _l(sLock);
+    if (sInstance != NULL) {
+        return sInstance;
+    }
+
+    sInstance = new ImageBufferPool();
+    return sInstance;
+}
+
+ImageBufferPool::ImageBufferPool() : mExit(false) {}
+
+ImageBufferPool::~ImageBufferPool() {
+    {
+        Mutex::Autolock _l(mLock);
+        mExit = true;
+        mCondition.signal();
+    }
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    Mutex::Autolock _l(mLock);
+    while (!mEntries.empty()) {
+        freeEntryLocked(mEntries.size() - 1);
+    }
+}
+
+void ImageBufferPool::freeEntryLocked(size_t index) {
+    FreePhyBuffer(mEntries[index].buf);
+    mEntries[index] = mEntries.back();
+    mEntries.pop_back();
+}
+
+void ImageBufferPool::trimLocked(nsecs_t now, nsecs_t idleTime) {
+    size_t idleCount = 0;
+    for (size_t i = mEntries.size(); i-- > 0;) {
+        if (mEntries[i].inUse) {
+            continue;
+        }
+        if (now - mEntries[i].lastUsed >= idleTime) {
+            freeEntryLocked(i);
+            continue;
+        }
+        idleCount++;
+    }
+
+    while (idleCount > POOL_MAX_IDLE_BUFFERS) {
+        int oldest = -1;
+        for (size_t i = 0; i < mEntries.size(); i++) {
+            if (!mEntries[i].inUse &&
+                (oldest < 0 || mEntries[i].lastUsed < mEntries[oldest].lastUsed)) {
+                oldest = i;
+            }
+        }
+        freeEntryLocked(oldest);
+        idleCount--;
+    }
+}
+
+nsecs_t ImageBufferPool::nextTrimLocked(nsecs_t now) {
+    nsecs_t next = -1;
+    for (const Entry& entry : mEntries) {
+        if (entry.inUse) {
+            continue;
+        }
+        nsecs_t left = std::max<nsecs_t>(entry.lastUsed + POOL_IDLE_TIME - now, 0);
+        if (next < 0 || left < next) {
+            next = left;
+        }
+    }
+    return next;
+}
+
+void ImageBufferPool::threadLoop() {
+    Mutex::Autolock _l(mLock);
+    while (!mExit) {
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        trimLocked(now, POOL_IDLE_TIME);
+
+        nsecs_t next = nextTrimLocked(now);
+        if (next < 0) {
+            mCondition.wait(mLock);
+        } else {
+            mCondition.waitRelative(mLock, next);
+        }
+    }
+}
+
+int ImageBufferPool::acquire(ImxImageBuffer& buf, uint32_t format, uint32_t width,
+                             uint32_t height, size_t formatSize, bool cached) {
+    if (formatSize == 0) {
+        formatSize = getSizeByForamtRes(format, width, height, false);
+    }
+    if (formatSize == 0) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock _l(mLock);
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    trimLocked(now, POOL_IDLE_TIME);
+
+    for (Entry& entry : mEntries) {
+        if (!entry.inUse && entry.format == format && entry.width == width &&
+            entry.height == height && entry.formatSize == formatSize && entry.cached == cached) {
+            entry.inUse = true;
+            entry.lastUsed = now;
+            buf = entry.buf;
+            return 0;
+        }
+    }
+
+    Entry entry;
+    memset(&entry.buf, 0, sizeof(entry.buf));
+    entry.buf.mFormatSize = formatSize;
+    entry.buf.mSize = (formatSize + PAGE_SIZE) & (~(PAGE_SIZE - 1));
+    entry.buf.mUsage = cached ? (USAGE_SW_READ_OFTEN | USAGE_SW_WRITE_OFTEN) : 0;
+    int ret = AllocPhyBuffer(entry.buf);
+    if (ret) {
+        ALOGE("%s: AllocPhyBuffer failed, formatSize %zu, allocSize %zu", __func__,
+              entry.buf.mFormatSize, entry.buf.mSize);
+        return ret;
+    }
+
+    entry.buf.mFormat = format;
+    entry.buf.mWidth = width;
+    entry.buf.mHeight = height;
+    entry.buf.mStride = width;
+    entry.buf.mHeightSpan = height;
+
+    entry.format = format;
+    entry.width = width;
+    entry.height = height;
+    entry.formatSize = formatSize;
+    entry.cached = cached;
+    entry.inUse = true;
+    entry.lastUsed = now;
+    mEntries.push_back(entry);
+
+    ALOGI("%s: new buffer format 0x%x, res %dx%d, size %zu, pool %zu", __func__, format, width,
+          height, entry.buf.mSize, mEntries.size());
+
+    buf = entry.buf;
+    return 0;
+}
+
+void ImageBufferPool::release(ImxImageBuffer& buf) {
+    Mutex::Autolock _l(mLock);
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    for (Entry& entry : mEntries) {
+        if (entry.inUse && entry.buf.mFd == buf.mFd && entry.buf.mVirtAddr == buf.mVirtAddr) {
+            entry.inUse = false;
+            entry.lastUsed = now;
+            trimLocked(now, POOL_IDLE_TIME);
+
+            if (!mThread.joinable()) {
+                mThread = std::thread([this]() { threadLoop(); });
+                pthread_setname_np(mThread.native_handle(), "imgbuf_pool");
+            }
+            mCondition.signal();
+            return;
+        }
+    }
+
+    ALOGE("%s: buffer fd %d not from pool", __func__, buf.mFd);
+}
+
+void ImageBufferPool::clear() {
+    Mutex::Autolock _l(mLock);
+    trimLocked(systemTime(SYSTEM_TIME_MONOTONIC), 0);
+}
+
+} // namespace fsl
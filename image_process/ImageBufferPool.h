@@ -0,0 +1,87 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _FSL_IMAGE_BUFFER_POOL_H
+#define _FSL_IMAGE_BUFFER_POOL_H
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+
+#include <thread>
+#include <vector>
+
+#include "ImageUtils.h"
+
+namespace fsl {
+
+using namespace android;
+
+// Intermediate buffers of multi-stage conversions. Streaming converts the
+// same format and resolution every frame, so the buffers are kept and
+// reused instead of going to the contiguous heap per frame. Buffers idle
+// for a while are freed by a trim thread, so they don't stay allocated after
+// streaming stops.
+//
+// Every user must call clear() when its streams are stopped or reconfigured,
+// the buffers of the old configuration would otherwise be kept until they
+// time out.
+class ImageBufferPool {
+public:
+    static ImageBufferPool* getInstance();
+    ~ImageBufferPool();
+
+    // get an idle buffer of the same format, resolution and cacheability, or
+    // allocate one. formatSize 0 means the size of the format and resolution.
+    int acquire(ImxImageBuffer& buf, uint32_t format, uint32_t width, uint32_t height,
+                size_t formatSize = 0, bool cached = false);
+    // give back a buffer got from acquire().
+    void release(ImxImageBuffer& buf);
+    // free all idle buffers, such as when streams are reconfigured.
+    void clear();
+
+private:
+    ImageBufferPool();
+
+    struct Entry {
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        size_t formatSize;
+        bool cached;
+        bool inUse;
+        nsecs_t lastUsed;
+        ImxImageBuffer buf;
+    };
+
+    void trimLocked(nsecs_t now, nsecs_t idleTime);
+    // time until the next idle buffer times out, -1 if none is idle.
+    nsecs_t nextTrimLocked(nsecs_t now);
+    void freeEntryLocked(size_t index);
+    void threadLoop();
+
+    static Mutex sLock;
+    static ImageBufferPool* sInstance;
+
+    Mutex mLock;
+    Condition mCondition;
+    std::thread mThread;
+    bool mExit;
+    std::vector<Entry> mEntries;
+};
+
+} // namespace fsl
+#endif
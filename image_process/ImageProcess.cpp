@@ -26,6 +26,8 @@
 #include <cutils/properties.h>
 
 #include "Composer.h"
+#include "CpuConvert.h"
+#include "ImageBufferPool.h"
 
 extern "C" {
 #include <linux/pxp_device.h>
@@ -49,26 +51,6 @@ Mutex ImageProcess::sLock(Mutex::PRIVATE);
 
 static void Revert16BitEndian(uint8_t *pSrc, uint8_t *pDst, uint32_t pixels);
 
-static bool IsCscSupportByCPU(int srcFormat, int dstFormat) {
-    // yuyv -> nv12
-    if (((dstFormat == HAL_PIXEL_FORMAT_YCbCr_420_888) ||
-         (dstFormat == HAL_PIXEL_FORMAT_YCbCr_420_SP)) &&
-        (srcFormat == HAL_PIXEL_FORMAT_YCbCr_422_I))
-        return true;
-
-    // nv12 -> nv21
-    if ((srcFormat == HAL_PIXEL_FORMAT_YCbCr_420_SP) &&
-        (dstFormat == HAL_PIXEL_FORMAT_YCrCb_420_SP))
-        return true;
-
-    // nv12 -> yv12
-    if ((srcFormat == HAL_PIXEL_FORMAT_YCbCr_420_SP) ||
-        (srcFormat == HAL_PIXEL_FORMAT_YCbCr_420_888) && (dstFormat == HAL_PIXEL_FORMAT_YV12))
-        return true;
-
-    return false;
-}
-
 static bool IsCscSupportByG3D(int srcFomat, int dstFormat) {
     // yuyv -> nv12, nv16 -> nv12
     if (((dstFormat == HAL_PIXEL_FORMAT_YCbCr_420_888) ||
@@ -249,7 +231,8 @@ void ImageProcess::getModule(char *path, const char *name) {
     return;
 }
 
-int ImageProcess::ConvertImage(ImxImageBuffer &dstBuf, ImxImageBuffer &srcBuf, ImxEngine engine) {
+int ImageProcess::ConvertImage(ImxImageBuffer &dstBuf, ImxImageBuffer &srcBuf, ImxEngine engine,
+                               int cpuThreads) {
     int ret = 0;
 
     if (!((engine == ENG_NOTCARE) || (engine >= ENG_MIN && engine < ENG_NUM))) {
@@ -272,6 +255,10 @@ int ImageProcess::ConvertImage(ImxImageBuffer &dstBuf, ImxImageBuffer &srcBuf, I
         dstBuf.mFormat = HAL_PIXEL_FORMAT_YCBCR_420_888;
     }
 
+    if (engine == ENG_CPU) {
+        return ConvertImageByCPU(dstBuf, srcBuf, cpuThreads);
+    }
+
     if (engine != ENG_NOTCARE) {
         ret = (this->*g_EngFuncList[engine])(dstBuf, srcBuf);
         return ret;
@@ -279,7 +266,10 @@ int ImageProcess::ConvertImage(ImxImageBuffer &dstBuf, ImxImageBuffer &srcBuf, I
 
     // If ENG_NOTCARE, go through all engines until convert ok.
     for (int i = ENG_MIN; i < ENG_NUM; i++) {
-        ret = (this->*g_EngFuncList[i])(dstBuf, srcBuf);
+        if (i == ENG_CPU)
+            ret = ConvertImageByCPU(dstBuf, srcBuf, cpuThreads);
+        else
+            ret = (this->*g_EngFuncList[i])(dstBuf, srcBuf);
         if (ret == 0)
             return 0;
     }
@@ -490,27 +480,6 @@ int ImageProcess::ConvertImageByG2DCopy(ImxImageBuffer &dstBuf, ImxImageBuffer &
     return ret;
 }
 
-static int AllocPhyBufferByFmtRes(ImxImageBuffer &imgBuf, uint32_t format, uint32_t width,
-                                  uint32_t height) {
-    imgBuf.mFormatSize = getSizeByForamtRes(format, width, height, false);
-    imgBuf.mSize = (imgBuf.mFormatSize + PAGE_SIZE) & (~(PAGE_SIZE - 1));
-
-    int ret = AllocPhyBuffer(imgBuf);
-    if (ret) {
-        ALOGE("%s: AllocPhyBuffer failed, formatSize %d, allocSize %d", __func__,
-              imgBuf.mFormatSize, imgBuf.mSize);
-        return ret;
-    }
-
-    imgBuf.mFormat = format;
-    imgBuf.mWidth = width;
-    imgBuf.mHeight = height;
-    imgBuf.mStride = width;
-    imgBuf.mHeightSpan = height;
-
-    return 0;
-}
-
 int ImageProcess::ConvertImageByG2DBlit(ImxImageBuffer &dstBuf, ImxImageBuffer &srcBuf) {
     if (mBlitEngine == NULL) {
         return -EINVAL;
@@ -592,9 +561,10 @@ int ImageProcess::ConvertImageByG2DBlit(ImxImageBuffer &dstBuf, ImxImageBuffer &
     } else {
         struct g2d_surface tmp_surface;
 
-        ret = AllocPhyBufferByFmtRes(resizeBuf, srcBuf.mFormat, dstBuf.mWidth, dstBuf.mHeight);
+        ret = ImageBufferPool::getInstance()->acquire(resizeBuf, srcBuf.mFormat, dstBuf.mWidth,
+                                                      dstBuf.mHeight);
         if (ret) {
-            ALOGE("%s:%d AllocPhyBufferByFmtRes failed", __func__, __LINE__);
+            ALOGE("%s:%d acquire resize buffer failed", __func__, __LINE__);
             return BAD_VALUE;
         }
         ALOGV("%s: resizeBuf.mFormatSize %d, resizeBuf.mSize %d", __func__,
@@ -641,7 +611,8 @@ int ImageProcess::ConvertImageByG2DBlit(ImxImageBuffer &dstBuf, ImxImageBuffer &
     }
 
 finish_blit:
-    FreePhyBuffer(resizeBuf);
+    if (resizeBuf.mVirtAddr != NULL)
+        ImageBufferPool::getInstance()->release(resizeBuf);
     return ret;
 }
 
@@ -710,63 +681,6 @@ int ImageProcess::ConvertImageByGPU_2D(ImxImageBuffer &dstBuf, ImxImageBuffer &s
     return ConvertImageByG2D(dstBuf, srcBuf, ENG_G2D);
 }
 
-int ImageProcess::convertNV12toNV21(ImxImageBuffer &dstBuf, ImxImageBuffer &srcBuf) {
-    int Ysize = 0, UVsize = 0;
-    uint8_t *srcIn, *dstOut;
-    uint32_t *UVout;
-    int size = (srcBuf.mSize > dstBuf.mSize) ? dstBuf.mSize : srcBuf.mSize;
-
-    Ysize = srcBuf.mWidth * srcBuf.mHeight;
-    UVsize = srcBuf.mWidth * srcBuf.mHeight >> 2;
-    srcIn = (uint8_t *)srcBuf.mVirtAddr;
-    dstOut = (uint8_t *)dstBuf.mVirtAddr;
-    UVout = (uint32_t *)(dstOut + Ysize);
-
-    if (mCopyEngine != NULL) {
-        void *g2dHandle = getHandle();
-        struct g2d_buf s_buf, d_buf;
-        s_buf.buf_paddr = srcBuf.mPhyAddr;
-        s_buf.buf_vaddr = srcBuf.mVirtAddr;
-        d_buf.buf_paddr = dstBuf.mPhyAddr;
-        d_buf.buf_vaddr = dstBuf.mVirtAddr;
-        mCopyEngine(g2dHandle, (void *)&d_buf, (void *)&s_buf, (void *)(intptr_t)size);
-        mFinishEngine(g2dHandle);
-    } else {
-        memcpy(dstOut, srcIn, size);
-    }
-
-    for (int k = 0; k < UVsize / 2; k++) {
-        __asm volatile("rev16 %0, %0" : "+r"(*UVout));
-        UVout += 1;
-    }
-
-    return 0;
-}
-
-void ImageProcess::convertNV12toYV12(uint8_t *inputBuffer, uint8_t *outputBuffer, int width,
-                                     int height) {
-    int size = width * height;
-    // Y
-    memcpy(outputBuffer, inputBuffer, size);
-    // V
-    uint8_t *ptrV1 = outputBuffer + size;
-    uint8_t *ptrV2 = inputBuffer + size + 1;
-    // U
-    uint8_t *ptrU1 = outputBuffer + size * 5 / 4;
-    uint8_t *ptrU2 = inputBuffer + size;
-    int n = 0;
-    while (n < size / 4) {
-        *(ptrV1) = *(ptrV2);
-        ptrV1++;
-        ptrV2 = ptrV2 + 2;
-
-        *(ptrU1) = *(ptrU2);
-        ptrU1++;
-        ptrU2 = ptrU2 + 2;
-        n++;
-    }
-}
-
 static void Revert16BitEndian(uint8_t *pSrc, uint8_t *pDst, uint32_t pixels) {
     ALOGI("enter Revert16BitEndian, src %p, dst %p, pixels %d", pSrc, pDst, pixels);
 
@@ -843,9 +757,10 @@ int ImageProcess::ConvertImageByGPU_3D(ImxImageBuffer &dstBuf, ImxImageBuffer &s
     // case 3: diffrent format, different resolution
     // first resize, then go through case 4.
     if ((srcBuf.mWidth != dstBuf.mWidth) || (srcBuf.mHeight != dstBuf.mHeight)) {
-        ret = AllocPhyBufferByFmtRes(resizeBuf, srcBuf.mFormat, dstBuf.mWidth, dstBuf.mHeight);
+        ret = ImageBufferPool::getInstance()->acquire(resizeBuf, srcBuf.mFormat, dstBuf.mWidth,
+                                                      dstBuf.mHeight);
         if (ret) {
-            ALOGE("%s:%d AllocPhyBufferByFmtRes failed", __func__, __LINE__);
+            ALOGE("%s:%d acquire resize buffer failed", __func__, __LINE__);
             return -EINVAL;
         }
 
@@ -868,18 +783,17 @@ int ImageProcess::ConvertImageByGPU_3D(ImxImageBuffer &dstBuf, ImxImageBuffer &s
 
     if (bResize) {
         SwitchImxBuf(srcBuf, resizeBuf);
-        FreePhyBuffer(resizeBuf);
+        ImageBufferPool::getInstance()->release(resizeBuf);
     }
 
     return 0;
 }
 
 int ImageProcess::ConvertImageByCPU(ImxImageBuffer &dstBuf, ImxImageBuffer &srcBuf) {
-    ImxImageBuffer resizeBuf;
-    memset(&resizeBuf, 0, sizeof(resizeBuf));
-    int ret;
-    bool bResize = false;
+    return ConvertImageByCPU(dstBuf, srcBuf, 1);
+}
 
+int ImageProcess::ConvertImageByCPU(ImxImageBuffer &dstBuf, ImxImageBuffer &srcBuf, int threads) {
     // case 1: same format, same resolution, copy
     if ((srcBuf.mFormat == dstBuf.mFormat) && (srcBuf.mWidth == dstBuf.mWidth) &&
         (srcBuf.mHeight == dstBuf.mHeight)) {
@@ -893,57 +807,15 @@ int ImageProcess::ConvertImageByCPU(ImxImageBuffer &dstBuf, ImxImageBuffer &srcB
         return 0;
     }
 
-    // case 2: same format, different resolution, resize
-    if (srcBuf.mFormat == dstBuf.mFormat) {
-        ret = resizeWrapper(srcBuf, dstBuf, ENG_CPU);
-        return ret;
+    // case 2: resize and/or format convert in one pass by the SIMD kernels
+    if (cpuConvertSupported(srcBuf.mFormat, dstBuf.mFormat)) {
+        return cpuConvertImage(dstBuf, srcBuf, threads);
     }
 
-    // filter out unsupported CSC format
-    if (false == IsCscSupportByCPU(srcBuf.mFormat, dstBuf.mFormat)) {
-        ALOGE("%s:%d, Software don't support format convert from 0x%x to 0x%x", __func__, __LINE__,
-              srcBuf.mFormat, dstBuf.mFormat);
-        return -EINVAL;
-    }
-
-    // case 3: diffrent format, different resolution
-    // first resize, then go through case 4.
-    if ((srcBuf.mWidth != dstBuf.mWidth) || (srcBuf.mHeight != dstBuf.mHeight)) {
-        ret = AllocPhyBufferByFmtRes(resizeBuf, srcBuf.mFormat, dstBuf.mWidth, dstBuf.mHeight);
-        if (ret) {
-            ALOGE("%s:%d AllocPhyBufferByFmtRes failed", __func__, __LINE__);
-            return -EINVAL;
-        }
-
-        resizeWrapper(srcBuf, resizeBuf, ENG_CPU);
-        SwitchImxBuf(srcBuf, resizeBuf);
-        bResize = true;
-    }
-
-    // case 4: diffrent format, same resolution
-    if (((dstBuf.mFormat == HAL_PIXEL_FORMAT_YCbCr_420_888) ||
-         (dstBuf.mFormat == HAL_PIXEL_FORMAT_YCbCr_420_SP)) &&
-        (srcBuf.mFormat == HAL_PIXEL_FORMAT_YCbCr_422_I)) {
-        convertYUYVtoNV12SP((uint8_t *)srcBuf.mVirtAddr, (uint8_t *)dstBuf.mVirtAddr, dstBuf.mWidth,
-                            dstBuf.mHeight);
-    } else if ((srcBuf.mFormat == HAL_PIXEL_FORMAT_YCbCr_420_SP) &&
-               (dstBuf.mFormat == HAL_PIXEL_FORMAT_YCrCb_420_SP)) {
-        convertNV12toNV21(dstBuf, srcBuf);
-    } else if ((srcBuf.mFormat == HAL_PIXEL_FORMAT_YCbCr_420_SP ||
-                (srcBuf.mFormat == HAL_PIXEL_FORMAT_YCbCr_420_888)) &&
-               (dstBuf.mFormat == HAL_PIXEL_FORMAT_YV12)) {
-        convertNV12toYV12((uint8_t *)srcBuf.mVirtAddr, (uint8_t *)dstBuf.mVirtAddr, dstBuf.mWidth,
-                          dstBuf.mHeight);
-    } else {
-        ALOGE("%s:%d should not enter here", __func__, __LINE__);
-    }
-
-    if (bResize) {
-        SwitchImxBuf(srcBuf, resizeBuf);
-        FreePhyBuffer(resizeBuf);
-    }
-
-    return 0;
+    ALOGE("%s:%d, Software don't support convert from 0x%x %dx%d to 0x%x %dx%d", __func__,
+          __LINE__, srcBuf.mFormat, srcBuf.mWidth, srcBuf.mHeight, dstBuf.mFormat, dstBuf.mWidth,
+          dstBuf.mHeight);
+    return -EINVAL;
 }
 
 void ImageProcess::cl_Copy(void *g2dHandle, uint8_t *output, uint8_t *input, uint32_t size,
@@ -1000,55 +872,6 @@ void ImageProcess::cl_csc(void *g2dHandle, uint8_t *inputBuffer, uint8_t *output
     (*mCLBlit)(g2dHandle, (void *)&src, (void *)&dst);
 }
 
-void ImageProcess::convertYUYVtoNV12SP(uint8_t *inputBuffer, uint8_t *outputBuffer, int width,
-                                       int height) {
-#define u32 unsigned int
-#define u8 unsigned char
-
-    u32 h, w;
-    u32 nHeight = height;
-    u32 nWidthDiv4 = width / 4;
-
-    u32 *pYSrcOffset = (u32 *)inputBuffer;
-    u32 value = 0;
-    u32 value2 = 0;
-
-    u32 *pYDstOffset = (u32 *)outputBuffer;
-    u32 *pUVDstOffset = (u32 *)(((u8 *)(outputBuffer)) + width * height);
-
-    for (h = 0; h < nHeight; h++) {
-        if (!(h & 0x1)) {
-            for (w = 0; w < nWidthDiv4; w++) {
-                value = (*pYSrcOffset);
-                value2 = (*(pYSrcOffset + 1));
-                // use bitwise operation to get data from src to improve performance.
-                *pYDstOffset = ((value & 0x000000ff) >> 0) | ((value & 0x00ff0000) >> 8) |
-                        ((value2 & 0x000000ff) << 16) | ((value2 & 0x00ff0000) << 8);
-                pYDstOffset += 1;
-
-#ifdef PLATFORM_VERSION_4
-                *pUVDstOffset = ((value & 0xff000000) >> 24) | ((value & 0x0000ff00) >> 0) |
-                        ((value2 & 0xff000000) >> 8) | ((value2 & 0x0000ff00) << 16);
-#else
-                *pUVDstOffset = ((value & 0x0000ff00) >> 8) | ((value & 0xff000000) >> 16) |
-                        ((value2 & 0x0000ff00) << 8) | ((value2 & 0xff000000) << 0);
-#endif
-                pUVDstOffset += 1;
-                pYSrcOffset += 2;
-            }
-        } else {
-            for (w = 0; w < nWidthDiv4; w++) {
-                value = (*pYSrcOffset);
-                value2 = (*(pYSrcOffset + 1));
-                *pYDstOffset = ((value & 0x000000ff) >> 0) | ((value & 0x00ff0000) >> 8) |
-                        ((value2 & 0x000000ff) << 16) | ((value2 & 0x00ff0000) << 8);
-                pYSrcOffset += 2;
-                pYDstOffset += 1;
-            }
-        }
-    }
-}
-
 int ImageProcess::resizeWrapper(ImxImageBuffer &srcBuf, ImxImageBuffer &dstBuf, ImxEngine engine) {
     int ret;
     ALOGV("enter resizeWrapper");
@@ -1076,18 +899,7 @@ int ImageProcess::resizeWrapper(ImxImageBuffer &srcBuf, ImxImageBuffer &dstBuf,
 
 cpu_resize:
     // cpu resize
-    if (srcBuf.mFormat == HAL_PIXEL_FORMAT_YCBCR_422_I)
-        ret = yuv422iResize((uint8_t *)srcBuf.mVirtAddr, srcBuf.mWidth, srcBuf.mHeight,
-                            (uint8_t *)dstBuf.mVirtAddr, dstBuf.mWidth, dstBuf.mHeight);
-    else if (srcBuf.mFormat == HAL_PIXEL_FORMAT_YCBCR_422_SP)
-        ret = yuv422spResize((uint8_t *)srcBuf.mVirtAddr, srcBuf.mWidth, srcBuf.mHeight,
-                             (uint8_t *)dstBuf.mVirtAddr, dstBuf.mWidth, dstBuf.mHeight, srcBuf.mHeightSpan);
-    else if ((srcBuf.mFormat == HAL_PIXEL_FORMAT_YCBCR_420_888) ||
-             (srcBuf.mFormat == HAL_PIXEL_FORMAT_YCbCr_420_SP)) {
-        ret = yuv420spResize((uint8_t *)srcBuf.mVirtAddr, srcBuf.mWidth, srcBuf.mHeight,
-                             (uint8_t *)dstBuf.mVirtAddr, dstBuf.mWidth, dstBuf.mHeight);
-    } else
-        ALOGE("%s: resize by ENG_CPU, unsupported format 0x%x", __func__, srcBuf.mFormat);
+    ret = cpuConvertImage(dstBuf, srcBuf);
 
     ALOGV("%s: resize format 0x%x, res %dx%d to %dx%d by cpu, ret %d", __func__, srcBuf.mFormat,
           srcBuf.mWidth, srcBuf.mHeight, dstBuf.mWidth, dstBuf.mHeight, ret);
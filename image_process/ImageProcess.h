@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <utils/Mutex.h>
 #include <cutils/native_handle.h>
+#include "CpuWorkers.h"
 #include "ImageUtils.h"
 
 namespace fsl {
@@ -48,23 +49,24 @@ public:
     static ImageProcess* getInstance();
     ~ImageProcess();
 
-    int ConvertImage(ImxImageBuffer& dst, ImxImageBuffer& src, ImxEngine engine);
+    // cpuThreads is the thread count of ENG_CPU, CPU_THREADS_AUTO splits
+    // large frames over the cores.
+    int ConvertImage(ImxImageBuffer& dst, ImxImageBuffer& src, ImxEngine engine,
+                     int cpuThreads = 1);
     void SetMiddleBuffers(std::vector<ImxImageBuffer *> &MiddleBuffers);
 
 
 private:
-    int convertNV12toNV21(ImxImageBuffer& dst, ImxImageBuffer& src);
     int ConvertImageByPXP(ImxImageBuffer& dst, ImxImageBuffer& src);
     int ConvertImageByIPU(ImxImageBuffer& dst, ImxImageBuffer& src);
     int ConvertImageByG2DCopy(ImxImageBuffer& dst, ImxImageBuffer& src);
     int ConvertImageByG2DBlit(ImxImageBuffer& dst, ImxImageBuffer& src);
     int ConvertImageByGPU_3D(ImxImageBuffer& dst, ImxImageBuffer& src);
     int ConvertImageByCPU(ImxImageBuffer& dst, ImxImageBuffer& src);
+    int ConvertImageByCPU(ImxImageBuffer& dst, ImxImageBuffer& src, int threads);
     int ConvertImageByDPU(ImxImageBuffer& dstBuf, ImxImageBuffer& srcBuf);
     int ConvertImageByGPU_2D(ImxImageBuffer& dstBuf, ImxImageBuffer& srcBuf);
     int ConvertImageByG2D(ImxImageBuffer& dstBuf, ImxImageBuffer& srcBuf, ImxEngine engine);
-    void convertYUYVtoNV12SP(uint8_t* inputBuffer, uint8_t* outputBuffer, int width, int height);
-    void convertNV12toYV12(uint8_t* inputBuffer, uint8_t* outputBuffer, int width, int height);
     int resizeWrapper(ImxImageBuffer& src, ImxImageBuffer& dst, ImxEngine engine);
 
     void cl_Copy(void* g2dHandle, uint8_t* output, uint8_t* input, uint32_t size, bool bInputCached,
@@ -572,7 +572,11 @@ int AllocPhyBuffer(ImxImageBuffer &imxBuf) {
         return -1;
     }
 
-    sharedFd = allocator->allocMemory(ionSize, MEM_ALIGN, fsl::MFLAGS_CONTIGUOUS);
+    int flags = fsl::MFLAGS_CONTIGUOUS;
+    if (imxBuf.mUsage & (fsl::USAGE_SW_READ_OFTEN | fsl::USAGE_SW_WRITE_OFTEN))
+        flags |= fsl::MFLAGS_CACHEABLE;
+
+    sharedFd = allocator->allocMemory(ionSize, MEM_ALIGN, flags);
     if (sharedFd < 0) {
         ALOGE("%s: allocMemory failed.", __func__);
         return -1;
@@ -41,6 +41,7 @@
 
 #include <deque>
 
+#include "ImageBufferPool.h"
 #include "Memory.h"
 #include "MemoryDesc.h"
 #include "MemoryManager.h"
@@ -1232,6 +1233,7 @@ int ExternalCameraDeviceSession::configureV4l2StreamLocked(const SupportedV4L2Fo
     // VIDIOC_QUERYBUF:  get buffer offset in the V4L2 fd
     // VIDIOC_QBUF: send buffer to driver
     mV4L2BufferCount = req_buffers.count;
+    mV4l2BufferDmaFds.clear();
     struct v4l2_plane planes;
     memset(&planes, 0, sizeof(struct v4l2_plane));
 
@@ -1250,6 +1252,25 @@ int ExternalCameraDeviceSession::configureV4l2StreamLocked(const SupportedV4L2Fo
             return -errno;
         }
 
+        // let the hardware decoder read the MJPEG frames in place
+        if (mHardwareDecoder && mSessionNeedHardwareDec && v4l2Fmt.fourcc == V4L2_PIX_FMT_MJPEG) {
+            struct v4l2_exportbuffer expbuf;
+            memset(&expbuf, 0, sizeof(expbuf));
+            expbuf.type = mCaptureType;
+            expbuf.index = i;
+            expbuf.flags = O_CLOEXEC | O_RDONLY;
+            if (TEMP_FAILURE_RETRY(ioctl(mV4l2Fd.get(), VIDIOC_EXPBUF, &expbuf)) < 0) {
+                ALOGW("%s: EXPBUF %d failed: %s, decoder copies input", __FUNCTION__, i,
+                      strerror(errno));
+                mV4l2BufferDmaFds.clear();
+            } else if (mV4l2BufferDmaFds.size() == i) {
+                mV4l2BufferDmaFds.emplace_back(expbuf.fd);
+                mV4l2BufferLength = mPlane ? planes.length : buffer.length;
+            } else {
+                close(expbuf.fd);
+            }
+        }
+
         if (TEMP_FAILURE_RETRY(ioctl(mV4l2Fd.get(), VIDIOC_QBUF, &buffer)) < 0) {
             ALOGE("%s: QBUF %d failed: %s", __FUNCTION__, i, strerror(errno));
             return -errno;
@@ -1386,14 +1407,20 @@ std::unique_ptr<V4L2Frame> ExternalCameraDeviceSession::dequeueV4l2FrameLocked(n
         mNumDequeuedV4l2Buffers++;
     }
 
+    int dmaBufFd = -1;
+    if (buffer.index < mV4l2BufferDmaFds.size())
+        dmaBufFd = mV4l2BufferDmaFds[buffer.index].get();
+
     if (mPlane) {
         return std::make_unique<V4L2Frame>(mV4l2StreamingFmt.width, mV4l2StreamingFmt.height,
                                            mV4l2StreamingFmt.fourcc, buffer.index, mV4l2Fd.get(),
-                                           buffer.m.planes->length, buffer.m.planes->m.mem_offset);
+                                           buffer.m.planes->length, buffer.m.planes->m.mem_offset,
+                                           dmaBufFd, mV4l2BufferLength);
     } else {
         return std::make_unique<V4L2Frame>(mV4l2StreamingFmt.width, mV4l2StreamingFmt.height,
                                            mV4l2StreamingFmt.fourcc, buffer.index, mV4l2Fd.get(),
-                                           buffer.bytesused, buffer.m.offset);
+                                           buffer.bytesused, buffer.m.offset, dmaBufFd,
+                                           mV4l2BufferLength);
     }
 }
 
@@ -1574,6 +1601,7 @@ void ExternalCameraDeviceSession::close(bool callerIsDtor) {
         v4l2StreamOffLocked();
         ALOGV("%s: closing V4L2 camera FD %d", __FUNCTION__, mV4l2Fd.get());
         mV4l2Fd.reset();
+        fsl::ImageBufferPool::getInstance()->clear();
         mClosed = true;
     }
 }
@@ -1602,6 +1630,7 @@ int ExternalCameraDeviceSession::v4l2StreamOffLocked() {
         }
     }
     mV4L2BufferCount = 0;
+    mV4l2BufferDmaFds.clear();
 
     // VIDIOC_STREAMOFF
     if (TEMP_FAILURE_RETRY(ioctl(mV4l2Fd.get(), VIDIOC_STREAMOFF, &mCaptureType)) < 0) {
@@ -2430,8 +2459,14 @@ void ExternalCameraDeviceSession::OutputThread::flush() {
     }
 
     std::unique_lock<std::mutex> lk(mRequestListLock);
-    std::list<std::shared_ptr<HalRequest>> reqs = std::move(mRequestList);
-    mRequestList.clear();
+    // requests being queued into the decoder are on neither list yet
+    mRequestDoneCond.wait(lk, [this] { return !mQueueingDecodes; });
+    // requests in the decoder go first, their decoded frames are dropped later
+    std::list<std::shared_ptr<HalRequest>> reqs = std::move(mDecodingList);
+    mDecodingList.clear();
+    for (const auto& req : reqs)
+        mStaleDecodeIds.push_back(req->decodeId);
+    reqs.splice(reqs.end(), mRequestList);
     if (mProcessingRequest) {
         auto timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
         auto st = mRequestDoneCond.wait_for(lk, timeout);
@@ -2455,6 +2490,9 @@ void ExternalCameraDeviceSession::OutputThread::dump(int fd) {
         dprintf(fd, "OutputThread not processing any frames\n");
     }
     dprintf(fd, "OutputThread request list contains frame: ");
+    for (const auto& req : mDecodingList) {
+        dprintf(fd, "%d, ", req->frameNumber);
+    }
     for (const auto& req : mRequestList) {
         dprintf(fd, "%d, ", req->frameNumber);
     }
@@ -2497,6 +2535,16 @@ int ExternalCameraDeviceSession::OutputThread::initVpuThread() {
 
     mDecedFrames = 0;
 
+    // Decode depth above 1 lets the decoder work on the next frames while the
+    // current one is converted. Limited by the decoder input buffers.
+    int32_t depth = property_get_int32("vendor.rw.camera.ext.decdepth", 1);
+    if (depth < 1)
+        depth = 1;
+    else if (depth > DEFAULT_INPUT_BUFFER_COUNT)
+        depth = DEFAULT_INPUT_BUFFER_COUNT;
+    mDecodeDepth = depth;
+    ALOGI("%s: decode depth %zu", __FUNCTION__, mDecodeDepth);
+
     if ((strcmp(socType, "imx8qm") == 0) || (strcmp(socType, "imx8qxp") == 0))
         mEngine = ENG_DPU;
     else if (strcmp(socType, "imx8mq") == 0)
@@ -2523,8 +2571,14 @@ ExternalCameraDeviceSession::OutputThread::switchToOffline() {
     }
 
     std::unique_lock<std::mutex> lk(mRequestListLock);
-    std::list<std::shared_ptr<HalRequest>> reqs = std::move(mRequestList);
-    mRequestList.clear();
+    // requests being queued into the decoder are on neither list yet
+    mRequestDoneCond.wait(lk, [this] { return !mQueueingDecodes; });
+    // requests in the decoder go first, their decoded frames are dropped later
+    std::list<std::shared_ptr<HalRequest>> reqs = std::move(mDecodingList);
+    mDecodingList.clear();
+    for (const auto& req : reqs)
+        mStaleDecodeIds.push_back(req->decodeId);
+    reqs.splice(reqs.end(), mRequestList);
     if (mProcessingRequest) {
         auto timeout = std::chrono::seconds(kFlushWaitTimeoutSec);
         auto st = mRequestDoneCond.wait_for(lk, timeout);
@@ -2555,7 +2609,7 @@ int ExternalCameraDeviceSession::OutputThread::waitForBufferRequestDone(
 }
 
 void ExternalCameraDeviceSession::OutputThread::waitForNextRequest(
-        std::shared_ptr<HalRequest>* out) {
+        std::shared_ptr<HalRequest>* out, bool pipelined, bool* decodeQueued) {
     ATRACE_CALL();
     if (out == nullptr) {
         ALOGE("%s: out is null", __FUNCTION__);
@@ -2564,7 +2618,7 @@ void ExternalCameraDeviceSession::OutputThread::waitForNextRequest(
 
     std::unique_lock<std::mutex> lk(mRequestListLock);
     int waitTimes = 0;
-    while (mRequestList.empty()) {
+    while (mRequestList.empty() && mDecodingList.empty()) {
         if (exitPending()) {
             return;
         }
@@ -2578,12 +2632,84 @@ void ExternalCameraDeviceSession::OutputThread::waitForNextRequest(
             }
         }
     }
-    *out = mRequestList.front();
-    mRequestList.pop_front();
+
+    if (pipelined)
+        fillDecodePipeline(lk);
+
+    if (!mDecodingList.empty()) {
+        *out = mDecodingList.front();
+        mDecodingList.pop_front();
+        if (decodeQueued != nullptr)
+            *decodeQueued = true;
+    } else {
+        *out = mRequestList.front();
+        mRequestList.pop_front();
+    }
     mProcessingRequest = true;
     mProcessingFrameNumber = (*out)->frameNumber;
 }
 
+// Queue the MJPEG frames of the next requests into the hardware decoder, up to
+// mDecodeDepth frames in flight. Stops at the first request that can not be
+// queued, so the requests are still processed in order. Called with lk held,
+// the requests are queued with it released.
+void ExternalCameraDeviceSession::OutputThread::fillDecodePipeline(
+        std::unique_lock<std::mutex>& lk) {
+    std::list<std::shared_ptr<HalRequest>> reqs;
+    while (mDecodingList.size() + reqs.size() < mDecodeDepth && !mRequestList.empty() &&
+           mRequestList.front()->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
+        reqs.push_back(mRequestList.front());
+        mRequestList.pop_front();
+    }
+    if (reqs.empty())
+        return;
+
+    mQueueingDecodes = true;
+    lk.unlock();
+
+    auto it = reqs.begin();
+    for (; it != reqs.end(); it++) {
+        const std::shared_ptr<HalRequest>& req = *it;
+        uint8_t* inData;
+        size_t inDataSize;
+        if (req->frameIn->getData(&inData, &inDataSize) != 0)
+            break;
+
+        std::shared_ptr<V4L2Frame> v4l2Frame = std::static_pointer_cast<V4L2Frame>(req->frameIn);
+        int32_t id = nextDecodeId();
+        if (VpuDecQueueInput(inData, inDataSize, v4l2Frame->mDmaBufFd, v4l2Frame->mBufferLength,
+                             id) != 0)
+            break;
+        req->decodeId = id;
+    }
+
+    lk.lock();
+    // the ones not queued go back ahead of the newer requests
+    std::list<std::shared_ptr<HalRequest>> notQueued;
+    notQueued.splice(notQueued.end(), reqs, it, reqs.end());
+    mRequestList.splice(mRequestList.begin(), notQueued);
+    mDecodingList.splice(mDecodingList.end(), reqs);
+    mQueueingDecodes = false;
+    mRequestDoneCond.notify_all();
+}
+
+// Take out the decoded frames of requests flushed while in the decoder.
+void ExternalCameraDeviceSession::OutputThread::dropStaleDecodes() {
+    std::unique_lock<std::mutex> lk(mRequestListLock);
+    std::vector<int32_t> stale = std::move(mStaleDecodeIds);
+    mStaleDecodeIds.clear();
+    lk.unlock();
+
+    for (int32_t id : stale)
+        VpuDecDropBuffer(id);
+}
+
+int32_t ExternalCameraDeviceSession::OutputThread::nextDecodeId() {
+    int32_t id = mNextDecodeId;
+    mNextDecodeId = (mNextDecodeId == INT32_MAX) ? 1 : mNextDecodeId + 1;
+    return id;
+}
+
 void ExternalCameraDeviceSession::OutputThread::signalRequestDone() {
     std::unique_lock<std::mutex> lk(mRequestListLock);
     mProcessingRequest = false;
@@ -3094,28 +3220,73 @@ int pixel_format_nv16_to_nv12(uint8_t* nv16_buff, uint8_t* nv12_buff, int w, int
     return 0;
 }
 
-int ExternalCameraDeviceSession::OutputThread::VpuDecGetBuffer(uint8_t* inData, size_t inDataSize) {
+int ExternalCameraDeviceSession::OutputThread::VpuDecQueueInput(uint8_t* inData, size_t inDataSize,
+                                                                int inFd, uint32_t inCapacity,
+                                                                int32_t id) {
     if ((inData == NULL) || (inDataSize == 0))
         return BAD_VALUE;
 
     std::unique_ptr<DecoderInputBuffer> inputbuf = std::make_unique<DecoderInputBuffer>();
     inputbuf->pInBuffer = inData;
-    inputbuf->id = 0;
+    inputbuf->id = id;
     inputbuf->size = inDataSize;
+    inputbuf->fd = inFd;
+    inputbuf->capacity = inCapacity;
 
-    int ret = 0;
-    ret = mDecoder->queueInputBuffer(std::move(inputbuf));
+    return mDecoder->queueInputBuffer(std::move(inputbuf));
+}
+
+int ExternalCameraDeviceSession::OutputThread::VpuDecGetBuffer(uint8_t* inData, size_t inDataSize,
+                                                               int inFd, uint32_t inCapacity,
+                                                               int32_t id) {
+    int ret = VpuDecQueueInput(inData, inDataSize, inFd, inCapacity, id);
     if (ret) {
         usleep(5000);
         return ret;
     }
 
+    return VpuDecExportBuffer(id);
+}
+
+// Take the decoded frame of input id. Frames of earlier inputs are left from
+// flushed or failed requests and are returned to the decoder. A later frame
+// means the one of id was lost, it is kept for its own request.
+int ExternalCameraDeviceSession::OutputThread::VpuDecTakeFrame(int32_t id, DecodedData* data) {
+    while (true) {
+        if (!mEarlyDecodes.empty()) {
+            *data = mEarlyDecodes.front();
+            mEarlyDecodes.pop_front();
+        } else {
+            int ret = mDecoder->exportDecodedBuf(*data, kDecWaitTimeoutMs);
+            if (ret)
+                return ret;
+        }
+
+        // without ids from the driver, frames come out in queue order
+        if (data->inputId <= 0 || data->inputId == id)
+            return OK;
+
+        if ((int32_t)((uint32_t)data->inputId - (uint32_t)id) < 0) {
+            ALOGW("%s: drop decoded frame of input %d, waiting for %d", __func__, data->inputId,
+                  id);
+            mDecoder->returnOutputBufferToDecoder(data->bufId);
+            continue;
+        }
+
+        ALOGW("%s: decoded frame of input %d lost, got %d", __func__, id, data->inputId);
+        mEarlyDecodes.push_front(*data);
+        return NOT_ENOUGH_DATA;
+    }
+}
+
+int ExternalCameraDeviceSession::OutputThread::VpuDecExportBuffer(int32_t id) {
+    int ret = 0;
     nsecs_t t1, t2;
 
     if (mDebug)
         t1 = systemTime();
     // mjpeg decoded to nv12/nv16/yuyv raw data
-    ret = mDecoder->exportDecodedBuf(mDecodedData, kDecWaitTimeoutMs);
+    ret = VpuDecTakeFrame(id, &mDecodedData);
     if (mDebug) {
         t2 = systemTime();
         ALOGI("exportDecodedBuf use %lld ns, %lld ms, decoded size %dx%d", (long long)t2 - t1,
@@ -3174,6 +3345,12 @@ void ExternalCameraDeviceSession::OutputThread::VpuDecReturnBuffer() {
     return;
 }
 
+void ExternalCameraDeviceSession::OutputThread::VpuDecDropBuffer(int32_t id) {
+    DecodedData data;
+    if (VpuDecTakeFrame(id, &data) == OK)
+        mDecoder->returnOutputBufferToDecoder(data.bufId);
+}
+
 bool ExternalCameraDeviceSession::getHardwareDecFlag() const {
     return mSessionNeedHardwareDec;
 }
@@ -3289,10 +3466,18 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
     if (!strcmp(value, "debug"))
         mDebug = true;
 
+    dropStaleDecodes();
+
+    // With a decode depth above 1, the MJPEG frames of the next requests are
+    // queued into the hardware decoder before this one is converted.
+    bool pipelined = mHardwareDecoder && parent->getHardwareDecFlag() && mDecodeDepth > 1 &&
+            !mCameraMuted;
+    bool decodeQueued = false;
+
     // TODO: maybe we need to setup a sensor thread to dq/enq v4l frames
     //       regularly to prevent v4l buffer queue filled with stale buffers
     //       when app doesn't program a preview request
-    waitForNextRequest(&req);
+    waitForNextRequest(&req, pipelined, &decodeQueued);
     if (req == nullptr) {
         // No new request, wait again
         return true;
@@ -3318,6 +3503,8 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
         res = requestBufferStart(req->buffers);
         if (res != 0) {
             ALOGE("%s: send BufferRequest failed! res %d", __FUNCTION__, res);
+            if (decodeQueued)
+                VpuDecDropBuffer(req->decodeId);
             return onDeviceError("%s: failed to send buffer request!", __FUNCTION__);
         }
     }
@@ -3365,6 +3552,8 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
     if (req->frameIn->mFourcc == V4L2_PIX_FMT_MJPEG) {
         ATRACE_BEGIN("MJPGtoI420");
         if (mCameraMuted) {
+            if (decodeQueued)
+                VpuDecDropBuffer(req->decodeId);
             res = libyuv::ConvertToI420(mMuteTestPatternFrame.data(), mMuteTestPatternFrame.size(),
                                         static_cast<uint8_t*>(mYu12FrameLayout.y),
                                         mYu12FrameLayout.yStride,
@@ -3375,8 +3564,14 @@ bool ExternalCameraDeviceSession::OutputThread::threadLoop() {
                                         mYu12Frame->mHeight, mYu12Frame->mWidth,
                                         mYu12Frame->mHeight, libyuv::kRotate0, libyuv::FOURCC_RAW);
         } else {
-            if (mHardwareDecoder && parent->getHardwareDecFlag()) {
-                res = VpuDecGetBuffer(inData, inDataSize);
+            if (decodeQueued) {
+                res = VpuDecExportBuffer(req->decodeId);
+            } else if (mHardwareDecoder && parent->getHardwareDecFlag()) {
+                std::shared_ptr<V4L2Frame> v4l2Frame =
+                        std::static_pointer_cast<V4L2Frame>(req->frameIn);
+                req->decodeId = nextDecodeId();
+                res = VpuDecGetBuffer(inData, inDataSize, v4l2Frame->mDmaBufFd,
+                                      v4l2Frame->mBufferLength, req->decodeId);
             } else {
                 if (mDebug)
                     t1 = systemTime();
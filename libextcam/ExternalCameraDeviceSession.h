@@ -211,8 +211,12 @@ public:
         int waitForBufferRequestDone(
                 /*out*/ std::vector<HalStreamBuffer>*);
 
-        void waitForNextRequest(std::shared_ptr<HalRequest>* out);
+        void waitForNextRequest(std::shared_ptr<HalRequest>* out, bool pipelined = false,
+                                bool* decodeQueued = nullptr);
         void signalRequestDone();
+        void fillDecodePipeline(std::unique_lock<std::mutex>& lk);
+        void dropStaleDecodes();
+        int32_t nextDecodeId();
 
         int cropAndScaleLocked(std::shared_ptr<AllocatedFrame>& in, const Size& outSize,
                                YCbCrLayout* out, uint64_t *outPhyAddr = NULL);
@@ -230,11 +234,20 @@ public:
         const common::V1_0::helper::CameraMetadata mCameraCharacteristics;
 
         mutable std::mutex mRequestListLock;      // Protect access to mRequestList,
-                                                  // mProcessingRequest and mProcessingFrameNumber
+                                                  // mDecodingList, mStaleDecodeIds,
+                                                  // mQueueingDecodes, mProcessingRequest
+                                                  // and mProcessingFrameNumber
         std::condition_variable mRequestCond;     // signaled when a new request is submitted
         std::condition_variable mRequestDoneCond; // signaled when a request is done processing
 
         std::list<std::shared_ptr<HalRequest>> mRequestList;
+        // MJPEG requests already queued into the hardware decoder, ahead of mRequestList
+        std::list<std::shared_ptr<HalRequest>> mDecodingList;
+        // decode ids of flushed requests, their decoded frames are still to be dropped
+        std::vector<int32_t> mStaleDecodeIds;
+        // requests taken from mRequestList are being queued into the decoder unlocked
+        bool mQueueingDecodes = false;
+        size_t mDecodeDepth = 1; // frames the hardware decoder may work on ahead of conversion
         bool mProcessingRequest = false;
         uint32_t mProcessingFrameNumber = 0;
 
@@ -258,6 +271,9 @@ public:
         uint32_t mBlobBufferSize = 0; // 0 -> HAL derive buffer size, else: use given size
 
         DecodedData mDecodedData;
+        // decoded frames of later inputs than the one waited for, output thread only
+        std::deque<DecodedData> mEarlyDecodes;
+        int32_t mNextDecodeId = 1;
 
         std::string mExifMake;
         std::string mExifModel;
@@ -269,8 +285,14 @@ public:
         const std::shared_ptr<BufferRequestThread> mBufferRequestThread;
 
     private:
-        int VpuDecGetBuffer(uint8_t* inData, size_t inDataSize);
+        int VpuDecQueueInput(uint8_t* inData, size_t inDataSize, int inFd, uint32_t inCapacity,
+                             int32_t id);
+        int VpuDecTakeFrame(int32_t id, DecodedData* data);
+        int VpuDecExportBuffer(int32_t id);
+        int VpuDecGetBuffer(uint8_t* inData, size_t inDataSize, int inFd, uint32_t inCapacity,
+                            int32_t id);
         void VpuDecReturnBuffer();
+        void VpuDecDropBuffer(int32_t id);
         int CopyFromPrcdBuf(HalStreamBuffer &halBuf, std::vector<HalStreamBuffer *> &prcdBufs);
         int handleFrame(uint32_t width, uint32_t height, uint32_t dst_fmt, uint32_t src_fmt,
                         uint64_t dstPhyAddr, uint64_t srcPhyAddr,
@@ -391,6 +413,9 @@ private:
     std::condition_variable mV4L2BufferReturned;
     size_t mNumDequeuedV4l2Buffers = 0;
     uint32_t mMaxV4L2BufferSize = 0;
+    // dmabuf of each V4L2 buffer, imported by the hardware MJPEG decoder
+    std::vector<unique_fd> mV4l2BufferDmaFds;
+    uint32_t mV4l2BufferLength = 0;
 
     // Not protected by mLock (but might be used when mLock is locked)
     std::shared_ptr<OutputThread> mOutputThread;
@@ -326,8 +326,14 @@ uint32_t Frame::getFormatSize() {
 }
 
 V4L2Frame::V4L2Frame(uint32_t w, uint32_t h, uint32_t fourcc, int bufIdx, int fd, uint32_t dataSize,
-                     uint64_t offset)
-      : Frame(w, h, fourcc), mBufferIndex(bufIdx), mFd(fd), mDataSize(dataSize), mOffset(offset) {}
+                     uint64_t offset, int dmaBufFd, uint32_t bufferLength)
+      : Frame(w, h, fourcc),
+        mBufferIndex(bufIdx),
+        mDmaBufFd(dmaBufFd),
+        mBufferLength(bufferLength),
+        mFd(fd),
+        mDataSize(dataSize),
+        mOffset(offset) {}
 
 V4L2Frame::~V4L2Frame() {
     unmap();
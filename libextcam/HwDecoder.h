@@ -21,6 +21,7 @@
 #include <utils/Mutex.h>
 
 #include <condition_variable>
+#include <deque>
 
 #include "DecoderDev.h"
 #include "ExternalCameraUtils.h"
@@ -98,12 +99,18 @@ typedef struct {
     int height = 0;
     uint32_t format = 0x103; // HAL_PIXEL_FORMAT_YCbCr_420_SP
     int32_t bufId;
+    // DecoderInputBuffer::id of the frame, 0 if the driver doesn't keep it
+    int32_t inputId = 0;
 } DecodedData;
 
 struct DecoderInputBuffer {
     void* pInBuffer;
+    // above 0, handed back in DecodedData::inputId
     int id;
     uint32_t size;
+    // dmabuf holding pInBuffer and its size, imported instead of copied if set
+    int fd = -1;
+    uint32_t capacity = 0;
 };
 
 class HwDecoder {
@@ -121,14 +128,14 @@ public:
 
     status_t freeOutputBuffers();
 
-    void notifyDecodeReady(int32_t mOutbufId);
+    void notifyDecodeReady(int32_t mOutbufId, int32_t inputId = 0);
     int exportDecodedBuf(DecodedData& data, int32_t timeoutMs);
     void returnOutputBufferToDecoder(int32_t bufId);
 
-    DecodedData mData;
+    // decoded frames in decode order, until taken by exportDecodedBuf
+    std::deque<DecodedData> mDecodedFrames;
     mutable std::mutex mFramesSignalLock;
     std::condition_variable mFramesSignal;
-    bool mDecReady;
 
 private:
     // const char* mMime;
@@ -157,12 +164,17 @@ private:
     Mutex mLock;
     Mutex mThreadLock;
 
+    // wakes the fetch thread when a client returns an output buffer
+    std::mutex mFetchSignalLock;
+    std::condition_variable mFetchSignal;
+
     int mDecState;
     int mPollState;
     int mFetchState;
 
     bool bInputStreamOn;
     bool bOutputStreamOn;
+    bool bInputDmaBufFailed;
 
     uint32_t mOutputBufferUsed;
 
@@ -175,9 +187,11 @@ private:
     uint8_t mTableSize;
     COLOR_FORMAT_TABLE* color_format_table;
 
+    void resetInputBufferSize();
     status_t SetInputFormats();
     status_t allocateInputBuffers();
     status_t destroyInputBuffers();
+    status_t setInputMemory(enum v4l2_memory memory, uint32_t capacity);
 
     status_t SetOutputFormats();
     status_t allocateOutputBuffers();
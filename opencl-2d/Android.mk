@@ -58,6 +58,20 @@ LOCAL_SHARED_LIBRARIES := liblog \
                           libyuv
 
 LOCAL_CFLAGS += -DBUILD_FOR_ANDROID
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := cl_g2d_bench
+LOCAL_SRC_FILES := cl_g2d_bench.cpp \
+                   cl_g2d_ref.cpp
+
+LOCAL_VENDOR_MODULE := true
+LOCAL_C_INCLUDES += \
+                    $(FSL_PROPRIETARY_PATH)/fsl-proprietary/include
+
+LOCAL_SHARED_LIBRARIES := libOpenCL
+
 LOCAL_MODULE_TAGS := optional
 include $(BUILD_EXECUTABLE)
 endif
@@ -0,0 +1,595 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark and conformance test of the kernels in cl_g2d.cl.
+ *
+ * Runs every kernel on the first OpenCL device found, which may be a GPU or a
+ * CPU implementation such as PoCL, with the same arguments and NDRange as
+ * opencl-2d.cpp, and compares the output byte by byte with the host reference
+ * in cl_g2d_ref.cpp. Reports device throughput in MPix/s per kernel and
+ * resolution. Exits non-zero if any output differs or a kernel fails.
+ *
+ * It only needs an OpenCL ICD, so it also builds on a host:
+ *   g++ -O2 cl_g2d_bench.cpp cl_g2d_ref.cpp -lOpenCL -o cl_g2d_bench
+ *   ./cl_g2d_bench -f cl_g2d.cl
+ */
+#define CL_TARGET_OPENCL_VERSION 120
+#include <CL/opencl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "cl_g2d_ref.h"
+
+#define BENCH_CL_FILE "/vendor/etc/cl_g2d.cl"
+#define BENCH_LOOPS 20
+#define BENCH_MAX_RES 16
+#define BENCH_MAX_PLANES 3
+/* bytes after each buffer, catches writes past the end of a plane */
+#define BENCH_GUARD_SIZE 4096
+#define BENCH_FILL 0xcd
+
+/* same values as opencl-2d.cpp */
+#define CL_ATOMIC_COPY_SIZE 64
+#define PLAT_VLOAD_BYTES 16
+#define PLAT_LOCAL_SIZE 8
+
+#define ALIGN(x, a) (((x) + (a)-1) / (a) * (a))
+
+struct BenchPass {
+    size_t offset[2];
+    size_t global[2];
+    size_t local[2]; // 0 lets the runtime choose
+    std::vector<int> args; // scalar arguments after the buffers
+};
+
+struct BenchJob {
+    int inCount;
+    int outCount;
+    size_t inSize[BENCH_MAX_PLANES];
+    size_t outSize[BENCH_MAX_PLANES];
+    int dim;
+    std::vector<BenchPass> passes;
+};
+
+struct BenchKernel {
+    const char *name;
+    /* plane sizes and dispatch of a width x height frame, as EnqueueBlit and
+     * EnqueueCopy do it. Keep in sync with opencl-2d.cpp.
+     */
+    void (*setup)(int width, int height, BenchJob &job);
+    void (*ref)(const BenchPass &pass, uint8_t **in, uint8_t **out);
+};
+
+static BenchPass make_pass(size_t global_x, size_t global_y, std::vector<int> args) {
+    BenchPass pass;
+    memset(pass.offset, 0, sizeof(pass.offset));
+    memset(pass.local, 0, sizeof(pass.local));
+    pass.global[0] = global_x;
+    pass.global[1] = global_y;
+    pass.args = args;
+    return pass;
+}
+
+static void set_planes(BenchJob &job, int inCount, size_t in0, size_t in1, int outCount,
+                       size_t out0, size_t out1, size_t out2) {
+    job.inCount = inCount;
+    job.inSize[0] = in0;
+    job.inSize[1] = in1;
+    job.inSize[2] = 0;
+    job.outCount = outCount;
+    job.outSize[0] = out0;
+    job.outSize[1] = out1;
+    job.outSize[2] = out2;
+    job.dim = 2;
+}
+
+static void setup_yuyv_to_nv12(int w, int h, BenchJob &job) {
+    set_planes(job, 1, w * h * 2, 0, 2, w * h, w * h / 2, 0);
+    job.passes.push_back(make_pass(w / 4, h, {w / 4, h, w / 4, h}));
+}
+
+static void ref_yuyv_to_nv12(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_g2d_yuyv_to_nv12(in[0], out[0], out[1], p.args[0], p.args[1], p.args[2], p.args[3],
+                         p.global[0], p.global[1]);
+}
+
+static void setup_yuyv_to_yuyv(int w, int h, BenchJob &job) {
+    // wider destination, the kernel fills the extra columns with black
+    int dst_stride = ALIGN(w + 1, 64);
+    set_planes(job, 1, w * h * 2, 0, 1, dst_stride * h * 2, 0, 0);
+    job.passes.push_back(make_pass(dst_stride / 8, h, {w / 8, h, dst_stride / 8, h}));
+}
+
+static void ref_yuyv_to_yuyv(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_g2d_yuyv_to_yuyv(in[0], out[0], p.args[0], p.args[1], p.args[2], p.args[3], p.global[0],
+                         p.global[1]);
+}
+
+static void setup_mem_copy(int w, int h, BenchJob &job) {
+    int size = w * h * 2;
+    set_planes(job, 1, size, 0, 1, size, 0, 0);
+    job.dim = 1;
+    job.passes.push_back(make_pass(size / CL_ATOMIC_COPY_SIZE, 1, {size}));
+}
+
+static void ref_mem_copy(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_g2d_mem_copy(in[0], out[0], p.args[0], p.global[0]);
+}
+
+static void setup_nv12_to_nv21(int w, int h, BenchJob &job) {
+    set_planes(job, 2, w * h, w * h / 2, 2, w * h, w * h / 2, 0);
+    job.passes.push_back(make_pass((w + 7) / 8, h, {w, h, w, w}));
+}
+
+static void ref_nv12_to_nv21(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_g2d_nv12_to_nv21(in[0], in[1], out[0], out[1], p.args[0], p.args[1], p.args[2],
+                         p.args[3], p.global[0], p.global[1]);
+}
+
+static size_t tiled_size(int stride, int h) {
+    // whole 128 line tiles, and the next tile column read at the right edge
+    return ALIGN(h, 128) * stride + 8 * 128;
+}
+
+static void setup_nv12_tiled(int w, int h, BenchJob &job) {
+    int stride = ALIGN(w, 256);
+    set_planes(job, 2, tiled_size(stride, h), tiled_size(stride, h / 2), 2, w * h, w * h / 2, 0);
+    job.passes.push_back(make_pass(w / 8, h / 2, {stride, w, h}));
+}
+
+static void ref_nv12_tiled(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_nv12_tiled_to_linear(in[0], in[1], out[0], out[1], p.args[0], p.args[1], p.args[2],
+                             p.global[0], p.global[1]);
+}
+
+static void setup_nv12_10bit_tiled(int w, int h, BenchJob &job) {
+    int stride = ALIGN(w * 10 / 8, 256);
+    set_planes(job, 2, tiled_size(stride, h), tiled_size(stride, h / 2), 2, w * h, w * h / 2, 0);
+    job.passes.push_back(make_pass(w / 8, h / 2, {stride, w, h}));
+}
+
+static void ref_nv12_10bit_tiled(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_nv12_10bit_tiled_to_linear(in[0], in[1], out[0], out[1], p.args[0], p.args[1], p.args[2],
+                                   p.global[0], p.global[1]);
+}
+
+static void setup_nv12_to_i420(int w, int h, BenchJob &job) {
+    set_planes(job, 2, w * h, w * h / 2, 3, w * h, w * h / 4, w * h / 4);
+
+    // whole work groups, then the last group again shifted to end at the stride
+    size_t groups = w / PLAT_VLOAD_BYTES / PLAT_LOCAL_SIZE * PLAT_LOCAL_SIZE;
+    BenchPass pass = make_pass(groups, h / 2, {w, w, 0});
+    pass.local[0] = PLAT_LOCAL_SIZE;
+    pass.local[1] = 1;
+    job.passes.push_back(pass);
+
+    int leftover = w - groups * PLAT_VLOAD_BYTES;
+    if (leftover != 0) {
+        pass.offset[0] = groups - PLAT_LOCAL_SIZE;
+        pass.global[0] = PLAT_LOCAL_SIZE;
+        pass.args[2] = leftover;
+        job.passes.push_back(pass);
+    }
+}
+
+static void ref_nv12_to_i420(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_g2d_nv12_to_i420(in[0], in[1], out[0], out[1], out[2], p.args[0], p.args[1], p.args[2],
+                         p.offset[0], p.global[0], p.global[1]);
+}
+
+static void setup_nv16_to_i420(int w, int h, BenchJob &job) {
+    set_planes(job, 2, w * h, w * h, 3, w * h, w * h / 4, w * h / 4);
+    job.passes.push_back(make_pass(w / PLAT_VLOAD_BYTES, h / 2, {w, w, w}));
+}
+
+static void ref_nv16_to_i420(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_g2d_nv16_to_i420(in[0], in[1], out[0], out[1], out[2], p.args[0], p.args[1], p.args[2],
+                         p.global[0], p.global[1]);
+}
+
+static void setup_yuyv_to_i420(int w, int h, BenchJob &job) {
+    set_planes(job, 1, w * h * 2, 0, 3, w * h, w * h / 4, w * h / 4);
+    job.passes.push_back(make_pass(w / 4, h, {w / 4, h, w / 4, h}));
+}
+
+static void ref_yuyv_to_i420(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_g2d_yuyv_to_i420(in[0], out[0], out[1], out[2], p.args[0], p.args[1], p.args[2],
+                         p.args[3], p.global[0], p.global[1]);
+}
+
+static void setup_nv16_to_nv12(int w, int h, BenchJob &job) {
+    set_planes(job, 2, w * h, w * h, 2, w * h, w * h / 2, 0);
+    job.passes.push_back(make_pass(w / PLAT_VLOAD_BYTES, h / 2, {w, w, w}));
+}
+
+static void ref_nv16_to_nv12(const BenchPass &p, uint8_t **in, uint8_t **out) {
+    ref_g2d_nv16_to_nv12(in[0], in[1], out[0], out[1], p.args[0], p.args[1], p.args[2],
+                         p.global[0], p.global[1]);
+}
+
+static const BenchKernel bench_kernels[] = {
+        {"g2d_yuyv_to_nv12", setup_yuyv_to_nv12, ref_yuyv_to_nv12},
+        {"g2d_yuyv_to_yuyv", setup_yuyv_to_yuyv, ref_yuyv_to_yuyv},
+        {"g2d_mem_copy", setup_mem_copy, ref_mem_copy},
+        {"g2d_nv12_to_nv21", setup_nv12_to_nv21, ref_nv12_to_nv21},
+        {"nv12_tiled_to_linear", setup_nv12_tiled, ref_nv12_tiled},
+        {"nv12_10bit_tiled_to_linear", setup_nv12_10bit_tiled, ref_nv12_10bit_tiled},
+        {"g2d_nv12_to_i420", setup_nv12_to_i420, ref_nv12_to_i420},
+        {"g2d_nv16_to_i420", setup_nv16_to_i420, ref_nv16_to_i420},
+        {"g2d_yuyv_to_i420", setup_yuyv_to_i420, ref_yuyv_to_i420},
+        {"g2d_nv16_to_nv12", setup_nv16_to_nv12, ref_nv16_to_nv12},
+};
+
+struct BenchRes {
+    int width;
+    int height;
+};
+
+/* 1366 is not a multiple of 128 bytes, it runs the leftover pass of nv12_to_i420 */
+static const BenchRes default_res[] = {
+        {640, 480}, {1280, 720}, {1366, 768}, {1920, 1080}, {3840, 2160},
+};
+
+struct BenchEnv {
+    cl_context context;
+    cl_device_id device;
+    cl_command_queue queue;
+    cl_program program;
+};
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static char *read_file(const char *fileName, size_t *length) {
+    FILE *fp = fopen(fileName, "rb");
+    if (fp == NULL) {
+        printf("%s: cannot open %s\n", __func__, fileName);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *source = (char *)malloc(size + 1);
+    if (source == NULL || fread(source, 1, size, fp) != (size_t)size) {
+        printf("%s: cannot read %s\n", __func__, fileName);
+        free(source);
+        fclose(fp);
+        return NULL;
+    }
+    source[size] = '\0';
+    fclose(fp);
+    *length = size;
+    return source;
+}
+
+static int open_env(BenchEnv &env, int platformIndex, const char *fileName) {
+    cl_platform_id platforms[8];
+    cl_uint numPlatforms = 0;
+    cl_int errNum = clGetPlatformIDs(8, platforms, &numPlatforms);
+    if (errNum != CL_SUCCESS || numPlatforms == 0) {
+        printf("%s: no OpenCL platform\n", __func__);
+        return -1;
+    }
+
+    // the given platform, or the first with any device
+    env.device = NULL;
+    for (cl_uint i = 0; i < numPlatforms && i < 8; i++) {
+        if (platformIndex >= 0 && (cl_uint)platformIndex != i)
+            continue;
+        if (clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_ALL, 1, &env.device, NULL) ==
+            CL_SUCCESS) {
+            char platformName[128] = {0};
+            char deviceName[128] = {0};
+            clGetPlatformInfo(platforms[i], CL_PLATFORM_NAME, sizeof(platformName) - 1,
+                              platformName, NULL);
+            clGetDeviceInfo(env.device, CL_DEVICE_NAME, sizeof(deviceName) - 1, deviceName,
+                            NULL);
+            printf("platform %u: %s, device: %s\n", i, platformName, deviceName);
+            break;
+        }
+        env.device = NULL;
+    }
+    if (env.device == NULL) {
+        printf("%s: no OpenCL device\n", __func__);
+        return -1;
+    }
+
+    env.context = clCreateContext(NULL, 1, &env.device, NULL, NULL, &errNum);
+    if (errNum != CL_SUCCESS) {
+        printf("%s: clCreateContext failed %d\n", __func__, errNum);
+        return -1;
+    }
+    env.queue = clCreateCommandQueue(env.context, env.device, CL_QUEUE_PROFILING_ENABLE, &errNum);
+    if (errNum != CL_SUCCESS) {
+        printf("%s: clCreateCommandQueue failed %d\n", __func__, errNum);
+        return -1;
+    }
+
+    size_t length = 0;
+    char *source = read_file(fileName, &length);
+    if (source == NULL)
+        return -1;
+    env.program = clCreateProgramWithSource(env.context, 1, (const char **)&source, &length,
+                                            &errNum);
+    free(source);
+    if (errNum != CL_SUCCESS) {
+        printf("%s: clCreateProgramWithSource failed %d\n", __func__, errNum);
+        return -1;
+    }
+    errNum = clBuildProgram(env.program, 1, &env.device, NULL, NULL, NULL);
+    if (errNum != CL_SUCCESS) {
+        char buildLog[16384] = {0};
+        clGetProgramBuildInfo(env.program, env.device, CL_PROGRAM_BUILD_LOG,
+                              sizeof(buildLog) - 1, buildLog, NULL);
+        printf("%s: build of %s failed:\n%s\n", __func__, fileName, buildLog);
+        return -1;
+    }
+    return 0;
+}
+
+static void close_env(BenchEnv &env) {
+    if (env.program)
+        clReleaseProgram(env.program);
+    if (env.queue)
+        clReleaseCommandQueue(env.queue);
+    if (env.context)
+        clReleaseContext(env.context);
+}
+
+/* enqueue all passes of the job, returns the device time in ns or -1 */
+static double enqueue_job(BenchEnv &env, cl_kernel kernel, const BenchJob &job, cl_mem *mems) {
+    int memCount = job.inCount + job.outCount;
+    double deviceNs = 0;
+
+    for (size_t p = 0; p < job.passes.size(); p++) {
+        const BenchPass &pass = job.passes[p];
+        cl_int errNum = CL_SUCCESS;
+        int arg = 0;
+        for (int i = 0; i < memCount; i++)
+            errNum |= clSetKernelArg(kernel, arg++, sizeof(cl_mem), &mems[i]);
+        for (size_t i = 0; i < pass.args.size(); i++)
+            errNum |= clSetKernelArg(kernel, arg++, sizeof(cl_int), &pass.args[i]);
+        if (errNum != CL_SUCCESS) {
+            printf("%s: Error setting kernel arguments\n", __func__);
+            return -1;
+        }
+
+        cl_event event = NULL;
+        errNum = clEnqueueNDRangeKernel(env.queue, kernel, job.dim,
+                                        pass.offset[0] || pass.offset[1] ? pass.offset : NULL,
+                                        pass.global, pass.local[0] ? pass.local : NULL, 0, NULL,
+                                        &event);
+        if (errNum != CL_SUCCESS) {
+            printf("%s: Error queuing kernel, err = %d\n", __func__, errNum);
+            return -1;
+        }
+        clWaitForEvents(1, &event);
+        cl_ulong start = 0, end = 0;
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+        clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+        clReleaseEvent(event);
+        deviceNs += end - start;
+    }
+    return deviceNs;
+}
+
+static size_t first_mismatch(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b) {
+    for (size_t i = 0; i < a.size(); i++)
+        if (a[i] != b[i])
+            return i;
+    return a.size();
+}
+
+/* returns 0 if the device output matches the reference */
+static int run_case(BenchEnv &env, const BenchKernel &bk, const BenchRes &res, int loops) {
+    BenchJob job;
+    bk.setup(res.width, res.height, job);
+    int memCount = job.inCount + job.outCount;
+
+    std::vector<uint8_t> host[BENCH_MAX_PLANES * 2];
+    std::vector<uint8_t> ref[BENCH_MAX_PLANES];
+    for (int i = 0; i < job.inCount; i++) {
+        host[i].resize(job.inSize[i] + BENCH_GUARD_SIZE);
+        for (size_t j = 0; j < host[i].size(); j++)
+            host[i][j] = rand() & 0xff;
+    }
+    for (int i = 0; i < job.outCount; i++) {
+        host[job.inCount + i].assign(job.outSize[i] + BENCH_GUARD_SIZE, BENCH_FILL);
+        ref[i].assign(job.outSize[i] + BENCH_GUARD_SIZE, BENCH_FILL);
+    }
+
+    cl_kernel kernel = NULL;
+    cl_mem mems[BENCH_MAX_PLANES * 2] = {NULL};
+    cl_int errNum;
+    int ret = -1;
+    double deviceNs = 0;
+    double refMs = 0;
+
+    kernel = clCreateKernel(env.program, bk.name, &errNum);
+    if (errNum != CL_SUCCESS) {
+        printf("%s: cannot create kernel %s\n", __func__, bk.name);
+        goto out;
+    }
+    for (int i = 0; i < memCount; i++) {
+        mems[i] = clCreateBuffer(env.context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                 host[i].size(), host[i].data(), &errNum);
+        if (errNum != CL_SUCCESS) {
+            printf("%s: clCreateBuffer failed %d\n", __func__, errNum);
+            goto out;
+        }
+    }
+
+    // warm up, then time the loops
+    if (enqueue_job(env, kernel, job, mems) < 0)
+        goto out;
+    for (int i = 0; i < loops; i++) {
+        double ns = enqueue_job(env, kernel, job, mems);
+        if (ns < 0)
+            goto out;
+        deviceNs += ns;
+    }
+
+    for (int i = 0; i < job.outCount; i++) {
+        errNum = clEnqueueReadBuffer(env.queue, mems[job.inCount + i], CL_TRUE, 0,
+                                     host[job.inCount + i].size(),
+                                     host[job.inCount + i].data(), 0, NULL, NULL);
+        if (errNum != CL_SUCCESS) {
+            printf("%s: clEnqueueReadBuffer failed %d\n", __func__, errNum);
+            goto out;
+        }
+    }
+
+    {
+        uint8_t *in[BENCH_MAX_PLANES] = {NULL};
+        uint8_t *outRef[BENCH_MAX_PLANES] = {NULL};
+        for (int i = 0; i < job.inCount; i++)
+            in[i] = host[i].data();
+        for (int i = 0; i < job.outCount; i++)
+            outRef[i] = ref[i].data();
+        double start = now_ms();
+        for (size_t p = 0; p < job.passes.size(); p++)
+            bk.ref(job.passes[p], in, outRef);
+        refMs = now_ms() - start;
+    }
+
+    {
+        double pixels = (double)res.width * res.height;
+        double deviceMs = deviceNs / loops / 1000000.0;
+        int mismatch = -1;
+        size_t offset = 0;
+        for (int i = 0; i < job.outCount && mismatch < 0; i++) {
+            offset = first_mismatch(host[job.inCount + i], ref[i]);
+            if (offset != ref[i].size())
+                mismatch = i;
+        }
+
+        printf("%-28s %5dx%-5d %9.3f ms %10.1f MPix/s   ref %9.1f MPix/s   %s", bk.name,
+               res.width, res.height, deviceMs, pixels / deviceMs / 1000.0,
+               refMs > 0 ? pixels / refMs / 1000.0 : 0.0, mismatch < 0 ? "OK" : "MISMATCH");
+        if (mismatch >= 0)
+            printf(" plane %d offset %zu: 0x%02x != 0x%02x%s", mismatch, offset,
+                   host[job.inCount + mismatch][offset], ref[mismatch][offset],
+                   offset >= job.outSize[mismatch] ? " (past the plane)" : "");
+        printf("\n");
+        ret = mismatch < 0 ? 0 : -1;
+    }
+
+out:
+    for (int i = 0; i < memCount; i++)
+        if (mems[i] != NULL)
+            clReleaseMemObject(mems[i]);
+    if (kernel != NULL)
+        clReleaseKernel(kernel);
+    return ret;
+}
+
+static void usage(const char *app) {
+    printf("Usage: %s [-f cl_file] [-k kernel] [-r WxH]... [-l loops] [-p platform]\n", app);
+    printf("  -f  kernel source, default %s\n", BENCH_CL_FILE);
+    printf("  -k  run only this kernel, default all\n");
+    printf("  -r  resolution, may be repeated, default 640x480 to 3840x2160\n");
+    printf("  -l  timed loops per case, default %d\n", BENCH_LOOPS);
+    printf("  -p  platform index, default the first with a device\n");
+    printf("kernels:");
+    for (size_t i = 0; i < sizeof(bench_kernels) / sizeof(bench_kernels[0]); i++)
+        printf(" %s", bench_kernels[i].name);
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    const char *fileName = BENCH_CL_FILE;
+    const char *kernelName = NULL;
+    int loops = BENCH_LOOPS;
+    int platformIndex = -1;
+    BenchRes resList[BENCH_MAX_RES];
+    int resCount = 0;
+    int rt;
+
+    while ((rt = getopt(argc, argv, "hf:k:r:l:p:")) >= 0) {
+        switch (rt) {
+            case 'f':
+                fileName = optarg;
+                break;
+            case 'k':
+                kernelName = optarg;
+                break;
+            case 'r':
+                if (resCount >= BENCH_MAX_RES ||
+                    sscanf(optarg, "%dx%d", &resList[resCount].width,
+                           &resList[resCount].height) != 2 ||
+                    resList[resCount].width < 16 || resList[resCount].height < 2) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                resCount++;
+                break;
+            case 'l':
+                loops = atoi(optarg);
+                if (loops <= 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'p':
+                platformIndex = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return rt == 'h' ? 0 : -1;
+        }
+    }
+    if (resCount == 0) {
+        resCount = sizeof(default_res) / sizeof(default_res[0]);
+        memcpy(resList, default_res, sizeof(default_res));
+    }
+
+    BenchEnv env;
+    memset(&env, 0, sizeof(env));
+    if (open_env(env, platformIndex, fileName) != 0) {
+        close_env(env);
+        return -1;
+    }
+
+    srand(1);
+    int ran = 0, failed = 0;
+    for (size_t k = 0; k < sizeof(bench_kernels) / sizeof(bench_kernels[0]); k++) {
+        if (kernelName != NULL && strcmp(kernelName, bench_kernels[k].name) != 0)
+            continue;
+        for (int r = 0; r < resCount; r++) {
+            ran++;
+            if (run_case(env, bench_kernels[k], resList[r], loops) != 0)
+                failed++;
+        }
+    }
+    close_env(env);
+
+    if (ran == 0) {
+        printf("no kernel named %s\n", kernelName);
+        usage(argv[0]);
+        return -1;
+    }
+    printf("%d cases, %d failed\n", ran, failed);
+    return failed ? 1 : 0;
+}
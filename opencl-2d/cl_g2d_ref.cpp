@@ -0,0 +1,286 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+
+#include "cl_g2d_ref.h"
+
+/*
+ * Pointers of vector types in the kernels index in units of the vector size,
+ * the helpers below keep that arithmetic visible: a uchar8 pointer plus n is
+ * byte 8 * n, a uint4 pointer plus n is byte 16 * n.
+ */
+
+static void copy_vec(uint8_t *dst, const uint8_t *src, int bytes) {
+    memcpy(dst, src, bytes);
+}
+
+void ref_nv12_10bit_tiled_to_linear(const uint8_t *input_y, const uint8_t *input_uv,
+                                    uint8_t *output_y, uint8_t *output_uv, int src_stride,
+                                    int width, int height, size_t global_x, size_t global_y) {
+    for (size_t gy = 0; gy < global_y; gy++) {
+        for (size_t gx = 0; gx < global_x; gx++) {
+            // the kernel keeps coordinates in shorts
+            short x1 = (short)gx;
+            short y = (short)gy;
+            uint8_t ypix[5] = {0}, upix[5] = {0};
+            short x = x1 * 5;
+            y = y << 1;
+            int dst_index = x1 * 8 + y * width;
+            int dst_index2 = x1 * 8 + (y + 1) * width;
+            x = x << 1;
+            int src_index1 = (x / 8) * 8 * 128 + (y & 127) * 8 + (y / 128) * src_stride * 128;
+            uint8_t byte_loc = (x & 7);
+            uint8_t byte_cnt = 8 - byte_loc;
+            bool has_uv = y < (height >> 1);
+            uint8_t i;
+
+            for (i = 0; i < byte_cnt && i < 5; i++) {
+                ypix[i] = input_y[src_index1 + byte_loc + i];
+                if (has_uv)
+                    upix[i] = input_uv[src_index1 + byte_loc + i];
+            }
+            // the 5 bytes of 4 pixels cross into the next tile column
+            if (byte_cnt < 5) {
+                int src_index2 =
+                        (x / 8 + 1) * 8 * 128 + (y & 127) * 8 + (y / 128) * src_stride * 128;
+                for (uint8_t k = 0; i < 5; i++, k++) {
+                    ypix[i] = input_y[src_index2 + k];
+                    if (has_uv)
+                        upix[i] = input_uv[src_index2 + k];
+                }
+            }
+
+            for (i = 0; i < 4; i++) {
+                uint8_t bit_pos = i * 10;
+                byte_loc = bit_pos >> 3;
+                uint8_t bit_loc = bit_pos - (byte_loc << 3);
+                uint16_t pix = (ypix[byte_loc] << 8) | ypix[byte_loc + 1];
+                pix = pix >> (8 - bit_loc);
+                output_y[dst_index + 2 * i] = pix & 0xff;
+                output_y[dst_index + 2 * i + 1] = pix & 0xff;
+                output_y[dst_index2 + 2 * i] = pix & 0xff;
+                output_y[dst_index2 + 2 * i + 1] = pix & 0xff;
+
+                if (has_uv) {
+                    pix = (upix[byte_loc] << 8) | upix[byte_loc + 1];
+                    pix = pix >> (8 - bit_loc);
+                    output_uv[dst_index + i] = pix & 0xff;
+                    output_uv[dst_index + i + 4] = pix & 0xff;
+                    output_uv[dst_index2 + i] = pix & 0xff;
+                    output_uv[dst_index2 + i + 4] = pix & 0xff;
+                }
+            }
+        }
+    }
+}
+
+void ref_nv12_tiled_to_linear(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                              uint8_t *output_uv, int src_stride, int width, int height,
+                              size_t global_x, size_t global_y) {
+    for (size_t gy = 0; gy < global_y; gy++) {
+        for (size_t gx = 0; gx < global_x; gx++) {
+            int x = gx;
+            int y = gy * 2;
+            int src_index = x * 8 * 128 + (y & 127) * 8 + (y / 128) * src_stride * 128;
+            int dst_index1 = x * 8 + y * width;
+            int dst_index2 = x * 8 + (y + 1) * width;
+
+            // uchar8 pointers
+            copy_vec(output_y + (dst_index1 >> 3) * 8, input_y + (src_index >> 3) * 8, 8);
+            copy_vec(output_y + (dst_index2 >> 3) * 8, input_y + ((src_index >> 3) + 1) * 8, 8);
+            if (y < (height >> 1)) {
+                copy_vec(output_uv + (dst_index1 >> 3) * 8, input_uv + (src_index >> 3) * 8, 8);
+                copy_vec(output_uv + (dst_index2 >> 3) * 8,
+                         input_uv + ((src_index >> 3) + 1) * 8, 8);
+            }
+        }
+    }
+}
+
+void ref_g2d_yuyv_to_nv12(const uint8_t *input, uint8_t *output_y, uint8_t *output_uv,
+                          int src_width, int /*src_height*/, int /*dst_width*/, int /*dst_height*/,
+                          size_t global_x, size_t global_y) {
+    for (size_t gy = 0; gy < global_y; gy++) {
+        for (size_t gx = 0; gx < global_x; gx++) {
+            int x = gx;
+            int y = gy;
+            int index = y * src_width + x;
+            // uchar8 input, uchar4 outputs
+            const uint8_t *p = input + index * 8;
+            uint8_t *y_buf = output_y + index * 4;
+
+            y_buf[0] = p[0];
+            y_buf[1] = p[2];
+            y_buf[2] = p[4];
+            y_buf[3] = p[6];
+            if (!(y & 0x1)) {
+                uint8_t *uv_buf = output_uv + (y / 2 * src_width + x) * 4;
+                uv_buf[0] = p[1];
+                uv_buf[1] = p[3];
+                uv_buf[2] = p[5];
+                uv_buf[3] = p[7];
+            }
+        }
+    }
+}
+
+void ref_g2d_yuyv_to_i420(const uint8_t *input, uint8_t *output_y, uint8_t *output_u,
+                          uint8_t *output_v, int src_width, int /*src_height*/, int /*dst_width*/,
+                          int /*dst_height*/, size_t global_x, size_t global_y) {
+    for (size_t gy = 0; gy < global_y; gy++) {
+        for (size_t gx = 0; gx < global_x; gx++) {
+            int x = gx;
+            int y = gy;
+            int index = y * src_width + x;
+            // uchar8 input, uchar4 y, uchar2 u and v
+            const uint8_t *p = input + index * 8;
+            uint8_t *y_buf = output_y + index * 4;
+
+            y_buf[0] = p[0];
+            y_buf[1] = p[2];
+            y_buf[2] = p[4];
+            y_buf[3] = p[6];
+            if (!(y & 0x1)) {
+                int uv_index = y / 2 * src_width + x;
+                uint8_t *u_buf = output_u + uv_index * 2;
+                uint8_t *v_buf = output_v + uv_index * 2;
+                u_buf[0] = p[1];
+                u_buf[1] = p[5];
+                v_buf[0] = p[3];
+                v_buf[1] = p[7];
+            }
+        }
+    }
+}
+
+void ref_g2d_nv12_to_nv21(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                          uint8_t *output_uv, int width, int /*height*/, int src_stride,
+                          int dst_stride, size_t global_x, size_t global_y) {
+    for (size_t gy = 0; gy < global_y; gy++) {
+        for (size_t gx = 0; gx < global_x; gx++) {
+            int x = gx;
+            int y = gy;
+            if ((x + 1) * 8 > width)
+                continue;
+
+            // one row of Y and half a row of UV per work item, uchar8 Y and
+            // uchar4 UV pointers
+            int src_index = y * src_stride + x * 8;
+            int dst_index = y * dst_stride + x * 8;
+            const uint8_t *src_uv = input_uv + src_index / 8 * 4;
+            uint8_t *dst_uv = output_uv + dst_index / 8 * 4;
+
+            copy_vec(output_y + dst_index / 8 * 8, input_y + src_index / 8 * 8, 8);
+            dst_uv[0] = src_uv[1];
+            dst_uv[1] = src_uv[0];
+            dst_uv[2] = src_uv[3];
+            dst_uv[3] = src_uv[2];
+        }
+    }
+}
+
+void ref_g2d_nv12_to_i420(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                          uint8_t *output_u, uint8_t *output_v, int src_stride, int dst_stride,
+                          int leftover, size_t offset_x, size_t global_x, size_t global_y) {
+    for (size_t gy = 0; gy < global_y; gy++) {
+        for (size_t gx = offset_x; gx < offset_x + global_x; gx++) {
+            int x = gx;
+            int y = gy;
+
+            // vload16 / vstore16 at x are bytes [16 * x, 16 * x + 16)
+            copy_vec(output_y + 2 * y * dst_stride + leftover + 16 * x,
+                     input_y + 2 * y * src_stride + leftover + 16 * x, 16);
+            copy_vec(output_y + (2 * y + 1) * dst_stride + leftover + 16 * x,
+                     input_y + (2 * y + 1) * src_stride + leftover + 16 * x, 16);
+
+            const uint8_t *uv = input_uv + y * src_stride + leftover + 16 * x;
+            uint8_t *u = output_u + y * dst_stride / 2 + leftover / 2 + 8 * x;
+            uint8_t *v = output_v + y * dst_stride / 2 + leftover / 2 + 8 * x;
+            for (int i = 0; i < 8; i++) {
+                u[i] = uv[2 * i];
+                v[i] = uv[2 * i + 1];
+            }
+        }
+    }
+}
+
+void ref_g2d_nv16_to_i420(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                          uint8_t *output_u, uint8_t *output_v, int /*width*/, int src_stride,
+                          int dst_stride, size_t global_x, size_t global_y) {
+    for (size_t gy = 0; gy < global_y; gy++) {
+        for (size_t gx = 0; gx < global_x; gx++) {
+            int x = gx;
+            int y = gy;
+
+            copy_vec(output_y + 2 * y * dst_stride + 16 * x, input_y + 2 * y * src_stride + 16 * x,
+                     16);
+            copy_vec(output_y + (2 * y + 1) * dst_stride + 16 * x,
+                     input_y + (2 * y + 1) * src_stride + 16 * x, 16);
+
+            // U from the even line, V from the odd line of the pair
+            const uint8_t *uv_u = input_uv + 2 * y * src_stride + 16 * x;
+            const uint8_t *uv_v = input_uv + (2 * y + 1) * src_stride + 16 * x;
+            uint8_t *u = output_u + y * (dst_stride / 2) + 8 * x;
+            uint8_t *v = output_v + y * (dst_stride / 2) + 8 * x;
+            for (int i = 0; i < 8; i++) {
+                u[i] = uv_u[2 * i];
+                v[i] = uv_v[2 * i + 1];
+            }
+        }
+    }
+}
+
+void ref_g2d_nv16_to_nv12(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                          uint8_t *output_uv, int /*width*/, int src_stride, int dst_stride,
+                          size_t global_x, size_t global_y) {
+    for (size_t gy = 0; gy < global_y; gy++) {
+        for (size_t gx = 0; gx < global_x; gx++) {
+            int x = gx;
+            int y = gy;
+
+            copy_vec(output_y + 2 * y * dst_stride + 16 * x, input_y + 2 * y * src_stride + 16 * x,
+                     16);
+            copy_vec(output_y + (2 * y + 1) * dst_stride + 16 * x,
+                     input_y + (2 * y + 1) * src_stride + 16 * x, 16);
+            copy_vec(output_uv + y * dst_stride + 16 * x, input_uv + 2 * y * src_stride + 16 * x,
+                     16);
+        }
+    }
+}
+
+void ref_g2d_yuyv_to_yuyv(const uint8_t *input, uint8_t *output, int src_width, int /*src_height*/,
+                          int dst_width, int /*dst_height*/, size_t global_x, size_t global_y) {
+    // black in YUYV, as the uint4 the kernel stores
+    static const uint32_t fill[4] = {0x80008000, 0x80008000, 0x80008000, 0x80008000};
+
+    for (size_t gy = 0; gy < global_y; gy++) {
+        for (size_t gx = 0; gx < global_x; gx++) {
+            int x = gx;
+            int y = gy;
+            uint8_t *output_buf = output + (y * dst_width + x) * 16;
+            if (x >= src_width)
+                copy_vec(output_buf, (const uint8_t *)fill, 16);
+            else
+                copy_vec(output_buf, input + (y * src_width + x) * 16, 16);
+        }
+    }
+}
+
+void ref_g2d_mem_copy(const uint8_t *input, uint8_t *output, int /*size*/, size_t global_x) {
+    // uint16 pointers
+    for (size_t gx = 0; gx < global_x; gx++)
+        copy_vec(output + gx * 64, input + gx * 64, 64);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2023 NXP.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __CL_G2D_REF_H__
+#define __CL_G2D_REF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Host reference of the kernels in cl_g2d.cl. Each function takes the kernel
+ * arguments in the order opencl-2d.cpp sets them, followed by the NDRange the
+ * kernel is enqueued with, and runs every work item of the range on the CPU.
+ * The result is bit-exact with the kernel, including the bytes a work item
+ * writes past the visible width, so a device output can be compared byte by
+ * byte against it.
+ */
+
+void ref_nv12_10bit_tiled_to_linear(const uint8_t *input_y, const uint8_t *input_uv,
+                                    uint8_t *output_y, uint8_t *output_uv, int src_stride,
+                                    int width, int height, size_t global_x, size_t global_y);
+
+void ref_nv12_tiled_to_linear(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                              uint8_t *output_uv, int src_stride, int width, int height,
+                              size_t global_x, size_t global_y);
+
+void ref_g2d_yuyv_to_nv12(const uint8_t *input, uint8_t *output_y, uint8_t *output_uv,
+                          int src_width, int src_height, int dst_width, int dst_height,
+                          size_t global_x, size_t global_y);
+
+void ref_g2d_yuyv_to_i420(const uint8_t *input, uint8_t *output_y, uint8_t *output_u,
+                          uint8_t *output_v, int src_width, int src_height, int dst_width,
+                          int dst_height, size_t global_x, size_t global_y);
+
+void ref_g2d_nv12_to_nv21(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                          uint8_t *output_uv, int width, int height, int src_stride,
+                          int dst_stride, size_t global_x, size_t global_y);
+
+/* offset_x is the global offset of the range, used by the leftover pass. */
+void ref_g2d_nv12_to_i420(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                          uint8_t *output_u, uint8_t *output_v, int src_stride, int dst_stride,
+                          int leftover, size_t offset_x, size_t global_x, size_t global_y);
+
+void ref_g2d_nv16_to_i420(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                          uint8_t *output_u, uint8_t *output_v, int width, int src_stride,
+                          int dst_stride, size_t global_x, size_t global_y);
+
+void ref_g2d_nv16_to_nv12(const uint8_t *input_y, const uint8_t *input_uv, uint8_t *output_y,
+                          uint8_t *output_uv, int width, int src_stride, int dst_stride,
+                          size_t global_x, size_t global_y);
+
+void ref_g2d_yuyv_to_yuyv(const uint8_t *input, uint8_t *output, int src_width, int src_height,
+                          int dst_width, int dst_height, size_t global_x, size_t global_y);
+
+void ref_g2d_mem_copy(const uint8_t *input, uint8_t *output, int size, size_t global_x);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -61,6 +61,11 @@
 #define PLAT_VLOAD_BYTES 16
 #define PLAT_LOCAL_SIZE 8
 
+/* cl_mem objects of physical and device buffers kept across calls */
+#define MAX_CL_MEM_CACHE 32
+/* operations recorded in one command list */
+#define MAX_CL_CMDLIST_OPS 8
+
 using android::Mutex;
 
 typedef enum {
@@ -94,6 +99,14 @@ static const char *kernel_name_list[MAX_CL_KERNEL_COUNT + 1] = {
         NULL,
 };
 
+struct g2dMemCacheEntry {
+    long addr; // physical address, or id of a device buffer
+    int len;
+    int usage;
+    cl_mem mem;
+    unsigned int lastUse;
+};
+
 struct g2dContext {
     cl_context context;
     cl_device_id device;
@@ -103,15 +116,43 @@ struct g2dContext {
     cl_mem memInObjects[MAX_CL_KERNEL_COUNT][MAX_CL_MEM_COUNT];
     cl_mem memOutObjects[MAX_CL_KERNEL_COUNT][MAX_CL_MEM_COUNT];
     struct cl_g2d_surface *dst[MAX_CL_KERNEL_COUNT];
+    struct g2dMemCacheEntry memCache[MAX_CL_MEM_CACHE];
+    unsigned int memCacheClock;
     Mutex mLock;
 };
 
+typedef enum {
+    G2D_OP_BLIT = 0,
+    G2D_OP_COPY = 1,
+} g2d_op_type;
+
+struct g2dOp {
+    g2d_op_type type;
+    int kernel_index;
+    struct cl_g2d_surface src;
+    struct cl_g2d_surface dst;
+    struct cl_g2d_buf inBuf;
+    struct cl_g2d_buf outBuf;
+    unsigned int size;
+    cl_mem inMems[MAX_CL_MEM_COUNT];
+    cl_mem outMems[MAX_CL_MEM_COUNT];
+};
+
+struct g2dCmdList {
+    struct g2dContext *gcontext;
+    int count;
+    struct g2dOp ops[MAX_CL_CMDLIST_OPS];
+    // completion of the last submit
+    cl_event done;
+};
+
 static int g2d_get_planebpp(unsigned int format, int plane);
 static int g2d_get_planecount(unsigned int format);
 static int g2d_get_planesize(struct cl_g2d_surface *surface, int plane);
 static bool CreateMemObjects(struct g2dContext *gcontext, struct cl_g2d_surface *surface,
-                             bool isInput);
+                             bool isInput, cl_mem *memObjects);
 static bool ReadOutMemObjects(struct g2dContext *gcontext);
+static int get_kernel_index(struct cl_g2d_surface *src, struct cl_g2d_surface *dst);
 static cl_program CreateProgram(cl_context context, cl_device_id device, const char *fileName);
 static cl_command_queue CreateCommandQueue(cl_context context, cl_device_id *device);
 static cl_context CreateContext();
@@ -216,8 +257,68 @@ static int g2d_get_planesize(struct cl_g2d_surface *surface, int plane) {
     return surface->stride * surface->height * bpp / 8;
 }
 
+// Return a retained cl_mem of a physical or device buffer. The objects are
+// kept in a small cache keyed by address, so per-frame calls on the same
+// buffers skip clCreateBuffer. They are created read-write, so the output of
+// one operation is the same object when it is the input of the next.
+static cl_mem GetCachedMemObject(struct g2dContext *gcontext, long addr, int len, int usage) {
+    struct g2dMemCacheEntry *entry = NULL;
+    int oldest = 0;
+
+    gcontext->memCacheClock++;
+    for (int i = 0; i < MAX_CL_MEM_CACHE; i++) {
+        struct g2dMemCacheEntry *e = &gcontext->memCache[i];
+        if ((e->mem != NULL) && (e->addr == addr) && (e->len == len) && (e->usage == usage)) {
+            entry = e;
+            break;
+        }
+        if ((e->mem == NULL) ||
+            ((gcontext->memCache[oldest].mem != NULL) &&
+             (e->lastUse < gcontext->memCache[oldest].lastUse)))
+            oldest = i;
+    }
+
+    if (entry == NULL) {
+        cl_mem_flags d_flags = CL_MEM_READ_WRITE;
+        void *host_ptr = NULL;
+        if (usage != CL_G2D_DEVICE_MEMORY) {
+            d_flags |= CL_MEM_USE_HOST_PHYSICAL_ADDR_VIV;
+            host_ptr = (void *)addr;
+        }
+        if (usage == CL_G2D_UNCACHED_MEMORY)
+            d_flags |= CL_MEM_USE_UNCACHED_HOST_MEMORY_VIV;
+
+        cl_mem memObject = clCreateBuffer(gcontext->context, d_flags, len, host_ptr, NULL);
+        if (memObject == NULL) {
+            g2d_printf("%s: Error creating memory objects.\n", __func__);
+            return NULL;
+        }
+
+        entry = &gcontext->memCache[oldest];
+        if (entry->mem != NULL)
+            clReleaseMemObject(entry->mem);
+        entry->addr = addr;
+        entry->len = len;
+        entry->usage = usage;
+        entry->mem = memObject;
+    }
+
+    entry->lastUse = gcontext->memCacheClock;
+    clRetainMemObject(entry->mem);
+    return entry->mem;
+}
+
+static void ReleaseMemCache(struct g2dContext *gcontext) {
+    for (int i = 0; i < MAX_CL_MEM_CACHE; i++) {
+        if (gcontext->memCache[i].mem != NULL) {
+            clReleaseMemObject(gcontext->memCache[i].mem);
+            gcontext->memCache[i].mem = NULL;
+        }
+    }
+}
+
 static bool CreateMemObjects(struct g2dContext *gcontext, struct cl_g2d_surface *surface,
-                             bool isInput, int kernel_index) {
+                             bool isInput, cl_mem *memObjects) {
     cl_mem memObject;
     int plane = g2d_get_planecount(surface->format);
 
@@ -244,21 +345,35 @@ static bool CreateMemObjects(struct g2dContext *gcontext, struct cl_g2d_surface
         }
 
         // step 7: Initial input,output for the host and create memory objects for the kernel
-        memObject = clCreateBuffer(gcontext->context, d_flags, len,
-                                   (unsigned char *)surface->planes[i], NULL);
+        if (surface->usePhyAddr || (surface->usage == CL_G2D_DEVICE_MEMORY))
+            memObject = GetCachedMemObject(gcontext, surface->planes[i], len, surface->usage);
+        else
+            memObject = clCreateBuffer(gcontext->context, d_flags, len,
+                                       (unsigned char *)surface->planes[i], NULL);
         if (memObject == NULL) {
             g2d_printf("%s: Error creating memory objects.\n", __func__);
             return false;
         }
-        if (isInput) {
-            gcontext->memInObjects[kernel_index][i] = memObject;
-        } else {
-            gcontext->memOutObjects[kernel_index][i] = memObject;
-        }
+        memObjects[i] = memObject;
     }
     return true;
 }
 
+// Memory object of a cl_g2d_buf, physical and device buffers come from the cache.
+static cl_mem CreateBufMemObject(struct g2dContext *gcontext, struct cl_g2d_buf *buf,
+                                 bool isInput) {
+    cl_mem_flags d_flags;
+
+    if (buf->use_phy || (buf->usage == CL_G2D_DEVICE_MEMORY))
+        return GetCachedMemObject(gcontext, (long)buf->buf_paddr, buf->buf_size, buf->usage);
+
+    d_flags = (isInput ? CL_MEM_READ_ONLY : CL_MEM_WRITE_ONLY) | CL_MEM_USE_HOST_PTR;
+    if (buf->usage == CL_G2D_UNCACHED_MEMORY)
+        d_flags |= CL_MEM_USE_UNCACHED_HOST_MEMORY_VIV;
+
+    return clCreateBuffer(gcontext->context, d_flags, buf->buf_size, buf->buf_vaddr, NULL);
+}
+
 static bool ReadOutMemObjects(struct g2dContext *gContext) {
     cl_int errNum;
     cl_mem memObject;
@@ -268,7 +383,7 @@ static bool ReadOutMemObjects(struct g2dContext *gContext) {
         // Read the output buffer back to the Host
         // Since the memobj is created as CL_MEM_USE_UNCACHED_HOST_MEMORY_VIV
         // No need to read output buffer
-        if ((gContext->dst[i] == NULL) || (gContext->dst[i]->usage == CL_G2D_UNCACHED_MEMORY))
+        if ((gContext->dst[i] == NULL) || (gContext->dst[i]->usage != CL_G2D_CACHED_MEMORY))
             continue;
 
         int plane = g2d_get_planecount(gContext->dst[i]->format);
@@ -520,6 +635,7 @@ static void Cleanup(struct g2dContext *gContext) {
                     gContext->dst[i] = NULL;
                 }
 
+            ReleaseMemCache(gContext);
             ReleaseKernel(gContext);
             if (gContext->context != 0)
                 errNum = clReleaseContext(gContext->context);
@@ -617,16 +733,37 @@ int cl_g2d_close(void *handle) {
     return 0;
 }
 
+// Enqueue the copy kernel on whole blocks of CL_ATOMIC_COPY_SIZE bytes.
+static int EnqueueCopy(struct g2dContext *gcontext, cl_mem inMem, cl_mem outMem,
+                       unsigned int size, cl_event *event) {
+    cl_int errNum = 0;
+    cl_kernel kernel = gcontext->kernel[MEM_COPY_INDEX];
+    size_t globalWorkSize = size / CL_ATOMIC_COPY_SIZE;
+
+    errNum |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &inMem);
+    errNum |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &outMem);
+    errNum |= clSetKernelArg(kernel, 2, sizeof(cl_int), &size);
+    if (errNum != CL_SUCCESS) {
+        g2d_printf("%s: Error setting kernel arguments.\n", __func__);
+        return -1;
+    }
+
+    // Summit command
+    errNum = clEnqueueNDRangeKernel(gcontext->commandQueue, kernel, 1, NULL, &globalWorkSize, NULL,
+                                    0, NULL, event);
+    if (errNum != CL_SUCCESS) {
+        g2d_printf("%s: Error queuing kernel for execution as err = %d \n", __func__, errNum);
+        return -1;
+    }
+    return 0;
+}
+
 int cl_g2d_copy(void *handle, struct cl_g2d_buf *output_buf, struct cl_g2d_buf *input_buf,
                 unsigned int size) {
-    cl_int errNum = 0;
-    cl_kernel kernel = 0;
     int kernel_index = MEM_COPY_INDEX;
     unsigned int remain_size = 0;
     size_t globalWorkSize = 0;
     struct g2dContext *gcontext = (struct g2dContext *)handle;
-    void *inAddr = NULL;
-    void *outAddr = NULL;
 
     if ((gcontext == NULL) || (input_buf == NULL) || (output_buf == NULL) ||
         (size > input_buf->buf_size) || (size > output_buf->buf_size)) {
@@ -640,63 +777,25 @@ int cl_g2d_copy(void *handle, struct cl_g2d_buf *output_buf, struct cl_g2d_buf *
         goto error;
     }
 
-    kernel = gcontext->kernel[kernel_index];
-    cl_mem memObject;
-    cl_mem_flags d_flags;
-
-    d_flags = CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR;
-    if (input_buf->usage == CL_G2D_UNCACHED_MEMORY)
-        d_flags |= CL_MEM_USE_UNCACHED_HOST_MEMORY_VIV;
-
-    inAddr = input_buf->buf_vaddr;
-    if (input_buf->use_phy) {
-        d_flags |= CL_MEM_USE_HOST_PHYSICAL_ADDR_VIV;
-        d_flags &= ~CL_MEM_USE_HOST_PTR;
-        inAddr = (void *)input_buf->buf_paddr;
-    }
-
-    memObject = clCreateBuffer(gcontext->context, d_flags, input_buf->buf_size, inAddr, NULL);
-    if (memObject == NULL) {
+    gcontext->memInObjects[kernel_index][0] = CreateBufMemObject(gcontext, input_buf, true);
+    if (gcontext->memInObjects[kernel_index][0] == NULL) {
         g2d_printf("%s: Error creating input memory objects.\n", __func__);
         goto error;
     }
-    gcontext->memInObjects[kernel_index][0] = memObject;
-
-    d_flags = CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR;
-    if (output_buf->usage == CL_G2D_UNCACHED_MEMORY)
-        d_flags |= CL_MEM_USE_UNCACHED_HOST_MEMORY_VIV;
 
-    outAddr = output_buf->buf_vaddr;
-    if (output_buf->use_phy) {
-        d_flags |= CL_MEM_USE_HOST_PHYSICAL_ADDR_VIV;
-        d_flags &= ~CL_MEM_USE_HOST_PTR;
-        outAddr = (void *)output_buf->buf_paddr;
-    }
-
-    memObject = clCreateBuffer(gcontext->context, d_flags, output_buf->buf_size, outAddr, NULL);
-    if (memObject == NULL) {
+    gcontext->memOutObjects[kernel_index][0] = CreateBufMemObject(gcontext, output_buf, false);
+    if (gcontext->memOutObjects[kernel_index][0] == NULL) {
         g2d_printf("%s: Error creating output memory objects.\n", __func__);
         goto error;
     }
-    gcontext->memOutObjects[kernel_index][0] = memObject;
 
-    errNum |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &gcontext->memInObjects[kernel_index][0]);
-    errNum |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &gcontext->memOutObjects[kernel_index][0]);
-    errNum |= clSetKernelArg(kernel, 2, sizeof(cl_int), &size);
-    if (errNum != CL_SUCCESS) {
-        g2d_printf("%s: Error setting kernel arguments.\n", __func__);
+    if (EnqueueCopy(gcontext, gcontext->memInObjects[kernel_index][0],
+                    gcontext->memOutObjects[kernel_index][0], size, NULL) != 0) {
         ReleaseMemObjects(gcontext);
         goto error;
     }
     globalWorkSize = size / CL_ATOMIC_COPY_SIZE;
-    // Summit command
-    errNum = clEnqueueNDRangeKernel(gcontext->commandQueue, kernel, 1, NULL, &globalWorkSize, NULL,
-                                    0, NULL, NULL);
-    if (errNum != CL_SUCCESS) {
-        g2d_printf("%s: Error queuing kernel for execution as err = %d \n", __func__, errNum);
-        ReleaseMemObjects(gcontext);
-        goto error;
-    }
+
     gcontext->dst[kernel_index] = (struct cl_g2d_surface *)malloc(sizeof(struct cl_g2d_surface));
     if (gcontext->dst[kernel_index] != NULL) {
         // Create a fake surface based on YUYV format, w=size/2, h = 1
@@ -748,14 +847,203 @@ static int get_kernel_index(struct cl_g2d_surface *src, struct cl_g2d_surface *d
     return kernel_index;
 }
 
-int cl_g2d_blit(void *handle, struct cl_g2d_surface *src, struct cl_g2d_surface *dst) {
+// Set the arguments of the kernel converting src to dst and enqueue it.
+static int EnqueueBlit(struct g2dContext *gcontext, int kernel_index, struct cl_g2d_surface *src,
+                       struct cl_g2d_surface *dst, cl_mem *inMems, cl_mem *outMems,
+                       cl_event *event) {
     cl_int errNum = 0;
-    struct g2dContext *gcontext = (struct g2dContext *)handle;
-    cl_kernel kernel = 0;
-    int kernel_index = 0;
+    cl_kernel kernel = gcontext->kernel[kernel_index];
     cl_int kernel_width = 0;
     cl_int kernel_height = 0;
 
+    // step 9: Set kernel args
+    int arg_index = 0;
+    for (int i = 0; i < MAX_CL_MEM_COUNT; i++)
+        if (inMems[i] != NULL) {
+            errNum |= clSetKernelArg(kernel, arg_index, sizeof(cl_mem), &inMems[i]);
+            arg_index++;
+        }
+
+    for (int i = 0; i < MAX_CL_MEM_COUNT; i++)
+        if (outMems[i] != NULL) {
+            errNum |= clSetKernelArg(kernel, arg_index, sizeof(cl_mem), &outMems[i]);
+            arg_index++;
+        }
+
+    if (kernel_index == YUYV_TO_NV12_INDEX) {
+        // for yuyv to nv12, 4 pixels with one kernel calls
+        // and based on src width
+        int src_width = src->width / 4;
+        int dst_width = dst->width / 4;
+        kernel_width = src->width / 4;
+        kernel_height = src->height;
+
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src->height));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst->height));
+    } else if (kernel_index == YUYV_TO_YUYV_INDEX) {
+        // for yuyv to yuyv, 8 pixels with one kernel calls
+        // and based on dst width
+        int src_width = src->width / 8;
+        int dst_width = dst->stride / 8;
+        kernel_width = dst->stride / 8;
+        kernel_height = src->height;
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src->height));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst->height));
+    } else if (kernel_index == NV12_TO_NV21_INDEX) {
+        // for nv12 to nv21, 8 pixels with one kernel calls
+        // and based on src width
+        int width = src->width;
+        int height = src->height;
+        int src_stride = src->stride;
+        int dst_stride = dst->stride;
+        kernel_width = (width + 7) / 8;
+        kernel_height = height;
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(height));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_stride));
+    } else if (kernel_index == NV12_TILED_TO_LINEAR_INDEX) {
+        // for nv12 8bit tiled, 16 pixels with one kernel calls
+        int width = dst->width;
+        int height = dst->height;
+        int src_stride = src->stride;
+        kernel_width = width / 8;
+        kernel_height = height / 2;
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(height));
+    } else if (kernel_index == NV12_10BIT_TILED_TO_LINEAR_INDEX) {
+        // for nv12 10bit tiled, 16 pixels with one kernel calls
+        int width = dst->width;
+        int height = dst->height;
+        int src_stride = src->stride;
+        kernel_width = width / 8;
+        kernel_height = height / 2;
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(height));
+    } else if (kernel_index == NV12_TO_I420_INDEX) {
+        int width = src->width;
+        int src_stride = src->stride;
+        int dst_stride = dst->stride;
+        kernel_width = (width + 7) / 8;
+        kernel_height = src->height;
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_stride));
+    } else if (kernel_index == NV16_TO_I420_INDEX) {
+        int width = src->width;
+        int src_stride = src->stride;
+        int dst_stride = dst->stride;
+
+        kernel_width = width / PLAT_VLOAD_BYTES;
+        kernel_height = src->height / 2;
+
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_stride));
+    } else if (kernel_index == YUYV_TO_I420_INDEX) {
+        // for yuyv to i420, 4 pixels with one kernel calls
+        // and based on src width
+        int src_width = src->width / 4;
+        int dst_width = dst->width / 4;
+        kernel_width = src->width / 4;
+        kernel_height = src->height;
+
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src->height));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst->height));
+    } else if (kernel_index == NV16_TO_NV12_INDEX) {
+        int width = src->width;
+        int src_stride = src->stride;
+        int dst_stride = dst->stride;
+
+        kernel_width = src_stride / PLAT_VLOAD_BYTES;
+        kernel_height = src->height / 2;
+
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
+        errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_stride));
+    }
+
+    if (errNum != CL_SUCCESS) {
+        g2d_printf("%s: Error setting kernel arguments.\n", __func__);
+        return -1;
+    }
+
+    // step 10: Running the kernel
+    // Summit command
+    if (kernel_index == NV12_TO_I420_INDEX) {
+        int src_stride = src->stride;
+        unsigned int nPicHeight = dst->height;
+        int leftover = 0;
+        int leftover_index = arg_index;
+        errNum |= clSetKernelArg(kernel, leftover_index, sizeof(int), &leftover);
+        size_t global2d[2];
+        size_t local2d[2];
+
+        global2d[0] = src_stride / PLAT_VLOAD_BYTES / PLAT_LOCAL_SIZE * PLAT_LOCAL_SIZE;
+        global2d[1] = nPicHeight / 2;
+        if (global2d[0] == 0) {
+            g2d_printf("%s: NV12_TO_I420: stride %d less than %d\n", __func__, src_stride,
+                       PLAT_VLOAD_BYTES * PLAT_LOCAL_SIZE);
+            return -1;
+        }
+
+        local2d[0] = PLAT_LOCAL_SIZE;
+        local2d[1] = 1;
+        errNum = clEnqueueNDRangeKernel(gcontext->commandQueue, kernel, 2, NULL, global2d,
+                                        local2d, 0, NULL, event);
+        if (errNum != CL_SUCCESS) {
+            g2d_printf("%s: NV12_TO_I420-1: Error queuing kernel for execution as err = %d \n",
+                       __func__, errNum);
+            return -1;
+        }
+        leftover = src_stride - global2d[0] * PLAT_VLOAD_BYTES;
+        if (0 != leftover) {
+            // redo the last work group shifted right by leftover bytes, so it
+            // ends at the stride. It rewrites the same values where it overlaps.
+            size_t offset2d[2];
+            offset2d[0] = global2d[0] - PLAT_LOCAL_SIZE;
+            offset2d[1] = 0;
+            global2d[0] = PLAT_LOCAL_SIZE;
+            // the event is of the last command
+            if ((event != NULL) && (*event != NULL)) {
+                clReleaseEvent(*event);
+                *event = NULL;
+            }
+            errNum = clSetKernelArg(kernel, leftover_index, sizeof(int), &leftover);
+            errNum |= clEnqueueNDRangeKernel(gcontext->commandQueue, kernel, 2, offset2d,
+                                             global2d, local2d, 0, NULL, event);
+            if (errNum != CL_SUCCESS) {
+                g2d_printf("%s: NV12_TO_I420-2: Error queuing kernel for execution as err = %d "
+                           "\n",
+                           __func__, errNum);
+                return -1;
+            }
+        }
+    } else {
+        size_t globalWorkSize[2] = {(size_t)kernel_width, (size_t)kernel_height};
+        errNum = clEnqueueNDRangeKernel(gcontext->commandQueue, kernel, 2, NULL, globalWorkSize,
+                                        NULL, 0, NULL, event);
+        if (errNum != CL_SUCCESS) {
+            g2d_printf("%s: Error queuing kernel for execution as err = %d \n", __func__,
+                       errNum);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int cl_g2d_blit(void *handle, struct cl_g2d_surface *src, struct cl_g2d_surface *dst) {
+    struct g2dContext *gcontext = (struct g2dContext *)handle;
+    int kernel_index = 0;
+
     if (gcontext == NULL) {
         g2d_printf("%s: invalid handle\n", __func__);
         return -1;
@@ -769,194 +1057,24 @@ int cl_g2d_blit(void *handle, struct cl_g2d_surface *src, struct cl_g2d_surface
             goto error;
         }
 
-        kernel = gcontext->kernel[kernel_index];
         // Create memObjects
-        if (!CreateMemObjects(gcontext, src, true, kernel_index)) {
+        if (!CreateMemObjects(gcontext, src, true, gcontext->memInObjects[kernel_index])) {
             g2d_printf("%s: Cannot create input mem objs\n", __func__);
             ReleaseMemObjects(gcontext);
             goto error;
         }
-        if (!CreateMemObjects(gcontext, dst, false, kernel_index)) {
+        if (!CreateMemObjects(gcontext, dst, false, gcontext->memOutObjects[kernel_index])) {
             g2d_printf("%s: Cannot create output mem objs\n", __func__);
             ReleaseMemObjects(gcontext);
             goto error;
         }
-        // step 9: Set kernel args
-        int arg_index = 0;
-        for (int i = 0; i < MAX_CL_MEM_COUNT; i++)
-            if (gcontext->memInObjects[kernel_index][i] != NULL) {
-                errNum |= clSetKernelArg(kernel, arg_index, sizeof(cl_mem),
-                                         &gcontext->memInObjects[kernel_index][i]);
-                arg_index++;
-            }
 
-        for (int i = 0; i < MAX_CL_MEM_COUNT; i++)
-            if (gcontext->memOutObjects[kernel_index][i] != NULL) {
-                errNum |= clSetKernelArg(kernel, arg_index, sizeof(cl_mem),
-                                         &gcontext->memOutObjects[kernel_index][i]);
-                arg_index++;
-            }
-
-        if (kernel_index == YUYV_TO_NV12_INDEX) {
-            // for yuyv to nv12, 4 pixels with one kernel calls
-            // and based on src width
-            int src_width = src->width / 4;
-            int dst_width = dst->width / 4;
-            kernel_width = src->width / 4;
-            kernel_height = src->height;
-
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src->height));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst->height));
-        } else if (kernel_index == YUYV_TO_YUYV_INDEX) {
-            // for yuyv to yuyv, 8 pixels with one kernel calls
-            // and based on dst width
-            int src_width = src->width / 8;
-            int dst_width = dst->stride / 8;
-            kernel_width = dst->stride / 8;
-            kernel_height = src->height;
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src->height));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst->height));
-        } else if (kernel_index == NV12_TO_NV21_INDEX) {
-            // for nv12 to nv21, 8 pixels with one kernel calls
-            // and based on src width
-            int width = src->width;
-            int height = src->height;
-            int src_stride = src->stride;
-            int dst_stride = dst->stride;
-            kernel_width = (width + 7) / 8;
-            kernel_height = height;
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(height));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_stride));
-        } else if (kernel_index == NV12_TILED_TO_LINEAR_INDEX) {
-            // for nv12 8bit tiled, 16 pixels with one kernel calls
-            int width = dst->width;
-            int height = dst->height;
-            int src_stride = src->stride;
-            kernel_width = width / 8;
-            kernel_height = height / 2;
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(height));
-        } else if (kernel_index == NV12_10BIT_TILED_TO_LINEAR_INDEX) {
-            // for nv12 10bit tiled, 16 pixels with one kernel calls
-            int width = dst->width;
-            int height = dst->height;
-            int src_stride = src->stride;
-            kernel_width = width / 8;
-            kernel_height = height / 2;
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(height));
-        } else if (kernel_index == NV12_TO_I420_INDEX) {
-            int width = src->width;
-            int src_stride = src->stride;
-            int dst_stride = dst->stride;
-            kernel_width = (width + 7) / 8;
-            kernel_height = src->height;
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_stride));
-        } else if (kernel_index == NV16_TO_I420_INDEX) {
-            int width = src->width;
-            int src_stride = src->stride;
-            int dst_stride = dst->stride;
-
-            kernel_width = width / PLAT_VLOAD_BYTES;
-            kernel_height = src->height / 2;
-
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_stride));
-        } else if (kernel_index == YUYV_TO_I420_INDEX) {
-            // for yuyv to i420, 4 pixels with one kernel calls
-            // and based on src width
-            int src_width = src->width / 4;
-            int dst_width = dst->width / 4;
-            kernel_width = src->width / 4;
-            kernel_height = src->height;
-
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src->height));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst->height));
-        } else if (kernel_index == NV16_TO_NV12_INDEX) {
-            int width = src->width;
-            int src_stride = src->stride;
-            int dst_stride = dst->stride;
-
-            kernel_width = src_stride / PLAT_VLOAD_BYTES;
-            kernel_height = src->height / 2;
-
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(width));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(src_stride));
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(cl_int), &(dst_stride));
-        }
-
-        if (errNum != CL_SUCCESS) {
-            g2d_printf("%s: Error setting kernel arguments.\n", __func__);
+        if (EnqueueBlit(gcontext, kernel_index, src, dst, gcontext->memInObjects[kernel_index],
+                        gcontext->memOutObjects[kernel_index], NULL) != 0) {
             ReleaseMemObjects(gcontext);
             goto error;
         }
 
-        // step 10: Running the kernel
-        // Summit command
-        if (kernel_index == NV12_TO_I420_INDEX) {
-            int src_stride = src->stride;
-            unsigned int nPicHeight = dst->height;
-            int leftover = 0;
-            errNum |= clSetKernelArg(kernel, arg_index++, sizeof(int), &leftover);
-            size_t global2d[2];
-            size_t local2d[2];
-
-            global2d[0] = src_stride / PLAT_VLOAD_BYTES / PLAT_LOCAL_SIZE * PLAT_LOCAL_SIZE;
-            global2d[1] = nPicHeight / 2;
-
-            local2d[0] = PLAT_LOCAL_SIZE;
-            local2d[1] = 1;
-            errNum = clEnqueueNDRangeKernel(gcontext->commandQueue, kernel, 2, NULL, global2d,
-                                            local2d, 0, NULL, NULL);
-            if (errNum != CL_SUCCESS) {
-                g2d_printf("%s: NV12_TO_I420-1: Error queuing kernel for execution as err = %d \n",
-                           __func__, errNum);
-                ReleaseMemObjects(gcontext);
-                goto error;
-            }
-            leftover = src_stride - global2d[0] * PLAT_VLOAD_BYTES;
-            if (0 != leftover) {
-                leftover = leftover - PLAT_VLOAD_BYTES * PLAT_LOCAL_SIZE;
-                size_t offset2d[2];
-                offset2d[0] = global2d[0] - PLAT_LOCAL_SIZE;
-                offset2d[1] = 0;
-                local2d[0] = 1;
-                local2d[1] = 1;
-                errNum = clSetKernelArg(kernel, arg_index++, sizeof(int), &leftover);
-                errNum |= clEnqueueNDRangeKernel(gcontext->commandQueue, kernel, 2, offset2d,
-                                                 global2d, local2d, 0, NULL, NULL);
-                if (errNum != CL_SUCCESS) {
-                    g2d_printf("%s: NV12_TO_I420-2: Error queuing kernel for execution as err = %d "
-                               "\n",
-                               __func__, errNum);
-                    ReleaseMemObjects(gcontext);
-                    goto error;
-                }
-            }
-        } else {
-            size_t globalWorkSize[2] = {(size_t)kernel_width, (size_t)kernel_height};
-            errNum = clEnqueueNDRangeKernel(gcontext->commandQueue, kernel, 2, NULL, globalWorkSize,
-                                            NULL, 0, NULL, NULL);
-            if (errNum != CL_SUCCESS) {
-                g2d_printf("%s: Error queuing kernel for execution as err = %d \n", __func__,
-                           errNum);
-                ReleaseMemObjects(gcontext);
-                goto error;
-            }
-        }
-
         gcontext->dst[kernel_index] =
                 (struct cl_g2d_surface *)malloc(sizeof(struct cl_g2d_surface));
         if (gcontext->dst[kernel_index] != NULL)
@@ -1007,3 +1125,250 @@ int cl_g2d_finish(void *handle) {
 
     return 0;
 }
+
+static void ReleaseCmdListMems(struct g2dCmdList *list) {
+    for (int i = 0; i < list->count; i++) {
+        struct g2dOp *op = &list->ops[i];
+        for (int j = 0; j < MAX_CL_MEM_COUNT; j++) {
+            if (op->inMems[j] != NULL) {
+                clReleaseMemObject(op->inMems[j]);
+                op->inMems[j] = NULL;
+            }
+            if (op->outMems[j] != NULL) {
+                clReleaseMemObject(op->outMems[j]);
+                op->outMems[j] = NULL;
+            }
+        }
+    }
+}
+
+// Keep the completion event of the last enqueued command only.
+static void SetCmdListDone(struct g2dCmdList *list, cl_event event) {
+    if (event == NULL)
+        return;
+    if (list->done != NULL)
+        clReleaseEvent(list->done);
+    list->done = event;
+}
+
+static int SubmitOp(struct g2dCmdList *list, struct g2dOp *op) {
+    struct g2dContext *gcontext = list->gcontext;
+    cl_event event = NULL;
+    cl_int errNum;
+
+    if (op->type == G2D_OP_COPY) {
+        unsigned int offset = op->size & ~CL_ATOMIC_COPY_MASK;
+        unsigned int remain_size = op->size & CL_ATOMIC_COPY_MASK;
+
+        op->inMems[0] = CreateBufMemObject(gcontext, &op->inBuf, true);
+        op->outMems[0] = CreateBufMemObject(gcontext, &op->outBuf, false);
+        if ((op->inMems[0] == NULL) || (op->outMems[0] == NULL)) {
+            g2d_printf("%s: Error creating copy memory objects.\n", __func__);
+            return -1;
+        }
+
+        if (offset > 0) {
+            if (EnqueueCopy(gcontext, op->inMems[0], op->outMems[0], op->size, &event) != 0)
+                return -1;
+            SetCmdListDone(list, event);
+        }
+        // the tail is copied on the device too, a later op may read it
+        if (remain_size > 0) {
+            event = NULL;
+            errNum = clEnqueueCopyBuffer(gcontext->commandQueue, op->inMems[0], op->outMems[0],
+                                         offset, offset, remain_size, 0, NULL, &event);
+            if (errNum != CL_SUCCESS) {
+                g2d_printf("%s: Error queuing tail copy as err = %d\n", __func__, errNum);
+                return -1;
+            }
+            SetCmdListDone(list, event);
+        }
+        return 0;
+    }
+
+    if (!CreateMemObjects(gcontext, &op->src, true, op->inMems) ||
+        !CreateMemObjects(gcontext, &op->dst, false, op->outMems)) {
+        g2d_printf("%s: Cannot create mem objs\n", __func__);
+        return -1;
+    }
+    if (EnqueueBlit(gcontext, op->kernel_index, &op->src, &op->dst, op->inMems, op->outMems,
+                    &event) != 0)
+        return -1;
+    SetCmdListDone(list, event);
+    return 0;
+}
+
+// Read cached host outputs back once all ops are queued, intermediates in
+// device memory or uncached memory need no read.
+static int ReadOutCmdList(struct g2dCmdList *list) {
+    struct g2dContext *gcontext = list->gcontext;
+
+    for (int i = 0; i < list->count; i++) {
+        struct g2dOp *op = &list->ops[i];
+        for (int j = 0; j < MAX_CL_MEM_COUNT; j++) {
+            unsigned char *buf;
+            int len;
+            cl_event event = NULL;
+
+            if (op->outMems[j] == NULL)
+                continue;
+            if (op->type == G2D_OP_COPY) {
+                if (op->outBuf.usage != CL_G2D_CACHED_MEMORY)
+                    continue;
+                buf = (unsigned char *)op->outBuf.buf_vaddr;
+                len = op->size;
+            } else {
+                if (op->dst.usage != CL_G2D_CACHED_MEMORY)
+                    continue;
+                buf = (unsigned char *)op->dst.planes[j];
+                len = g2d_get_planesize(&op->dst, j);
+            }
+            if (buf == NULL)
+                continue;
+
+            cl_int errNum = clEnqueueReadBuffer(gcontext->commandQueue, op->outMems[j], CL_FALSE,
+                                                0, len, buf, 0, NULL, &event);
+            if (errNum != CL_SUCCESS) {
+                g2d_printf("%s: Error reading result buffer plane %d.\n", __func__, j);
+                return -1;
+            }
+            SetCmdListDone(list, event);
+        }
+    }
+    return 0;
+}
+
+int cl_g2d_cmdlist_create(void *handle, void **cmdlist) {
+    struct g2dContext *gcontext = (struct g2dContext *)handle;
+    struct g2dCmdList *list;
+
+    if ((gcontext == NULL) || (cmdlist == NULL)) {
+        g2d_printf("%s: invalid parameters\n", __func__);
+        return -1;
+    }
+
+    list = (struct g2dCmdList *)calloc(1, sizeof(struct g2dCmdList));
+    if (list == NULL) {
+        g2d_printf("%s: malloc memory failed for cmdlist!\n", __func__);
+        return -1;
+    }
+    list->gcontext = gcontext;
+    *cmdlist = (void *)list;
+    return 0;
+}
+
+int cl_g2d_cmdlist_blit(void *cmdlist, struct cl_g2d_surface *src, struct cl_g2d_surface *dst) {
+    struct g2dCmdList *list = (struct g2dCmdList *)cmdlist;
+    struct g2dOp *op;
+    int kernel_index;
+
+    if ((list == NULL) || (src == NULL) || (dst == NULL) || (list->done != NULL) ||
+        (list->count >= MAX_CL_CMDLIST_OPS)) {
+        g2d_printf("%s: invalid parameters\n", __func__);
+        return -1;
+    }
+
+    kernel_index = get_kernel_index(src, dst);
+    if ((kernel_index < 0) || (kernel_index >= MAX_CL_KERNEL_COUNT)) {
+        g2d_printf("%s: cannot support src format 0x%x and dst format 0x%x\n", __func__,
+                   src->format, dst->format);
+        return -1;
+    }
+
+    op = &list->ops[list->count++];
+    memset(op, 0, sizeof(struct g2dOp));
+    op->type = G2D_OP_BLIT;
+    op->kernel_index = kernel_index;
+    op->src = *src;
+    op->dst = *dst;
+    return 0;
+}
+
+int cl_g2d_cmdlist_copy(void *cmdlist, struct cl_g2d_buf *output_buf,
+                        struct cl_g2d_buf *input_buf, unsigned int size) {
+    struct g2dCmdList *list = (struct g2dCmdList *)cmdlist;
+    struct g2dOp *op;
+
+    if ((list == NULL) || (input_buf == NULL) || (output_buf == NULL) || (size == 0) ||
+        (size > input_buf->buf_size) || (size > output_buf->buf_size) || (list->done != NULL) ||
+        (list->count >= MAX_CL_CMDLIST_OPS)) {
+        g2d_printf("%s: invalid parameters\n", __func__);
+        return -1;
+    }
+
+    op = &list->ops[list->count++];
+    memset(op, 0, sizeof(struct g2dOp));
+    op->type = G2D_OP_COPY;
+    op->kernel_index = MEM_COPY_INDEX;
+    op->inBuf = *input_buf;
+    op->outBuf = *output_buf;
+    op->size = size;
+    return 0;
+}
+
+int cl_g2d_cmdlist_submit(void *cmdlist) {
+    struct g2dCmdList *list = (struct g2dCmdList *)cmdlist;
+    struct g2dContext *gcontext;
+
+    if ((list == NULL) || (list->count == 0) || (list->done != NULL)) {
+        g2d_printf("%s: invalid cmdlist\n", __func__);
+        return -1;
+    }
+    gcontext = list->gcontext;
+    Mutex::Autolock _l(gcontext->mLock);
+
+    // the queue is in order, so each op sees the output of the previous one
+    // without a round trip to the host.
+    for (int i = 0; i < list->count; i++) {
+        if (SubmitOp(list, &list->ops[i]) != 0)
+            goto error;
+    }
+    if (ReadOutCmdList(list) != 0)
+        goto error;
+
+    clFlush(gcontext->commandQueue);
+    return 0;
+
+error:
+    // ops already queued still hold their own references
+    if (list->done != NULL) {
+        clWaitForEvents(1, &list->done);
+        clReleaseEvent(list->done);
+        list->done = NULL;
+    }
+    ReleaseCmdListMems(list);
+    list->count = 0;
+    return -1;
+}
+
+int cl_g2d_cmdlist_wait(void *cmdlist) {
+    struct g2dCmdList *list = (struct g2dCmdList *)cmdlist;
+    cl_int errNum = CL_SUCCESS;
+
+    if (list == NULL) {
+        g2d_printf("%s: invalid cmdlist\n", __func__);
+        return -1;
+    }
+
+    if (list->done != NULL) {
+        errNum = clWaitForEvents(1, &list->done);
+        clReleaseEvent(list->done);
+        list->done = NULL;
+    }
+
+    // the list is empty again and can be recorded for the next frame
+    ReleaseCmdListMems(list);
+    list->count = 0;
+    return (errNum == CL_SUCCESS) ? 0 : -1;
+}
+
+int cl_g2d_cmdlist_destroy(void *cmdlist) {
+    if (cmdlist == NULL) {
+        g2d_printf("%s: invalid cmdlist\n", __func__);
+        return -1;
+    }
+
+    cl_g2d_cmdlist_wait(cmdlist);
+    free(cmdlist);
+    return 0;
+}
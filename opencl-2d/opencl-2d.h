@@ -21,7 +21,7 @@ extern "C" {
 #endif
 
 #define CL_G2D_VERSION_MAJOR 0
-#define CL_G2D_VERSION_MINOR 1
+#define CL_G2D_VERSION_MINOR 2
 #define CL_G2D_VERSION_PATCH 0
 
 enum cl_buffer_usage {
@@ -29,6 +29,10 @@ enum cl_buffer_usage {
     CL_G2D_CACHED_MEMORY = 0,
     /* uncached buffer*/
     CL_G2D_UNCACHED_MEMORY = 1,
+    /* buffer only on the device, for intermediates of a command list. The
+     * plane addresses are non-zero ids chosen by the caller, not memory.
+     */
+    CL_G2D_DEVICE_MEMORY = 2,
 };
 
 // rgb formats
@@ -108,6 +112,22 @@ int cl_g2d_blit(void *handle, struct cl_g2d_surface *src, struct cl_g2d_surface
 int cl_g2d_flush(void *handle);
 int cl_g2d_finish(void *handle);
 
+/*
+ * Command list: record a chain of blits and copies, submit it once and wait
+ * for one completion. Ops run in order on the device, so the output of one op
+ * can be the input of the next, e.g. tiled to linear, then NV12 to I420, then
+ * copy. Intermediates in CL_G2D_DEVICE_MEMORY never touch the host. Memory
+ * objects of physical and device buffers are cached by address across calls.
+ * After wait, the list is empty and can be recorded again.
+ */
+int cl_g2d_cmdlist_create(void *handle, void **cmdlist);
+int cl_g2d_cmdlist_blit(void *cmdlist, struct cl_g2d_surface *src, struct cl_g2d_surface *dst);
+int cl_g2d_cmdlist_copy(void *cmdlist, struct cl_g2d_buf *output_buf,
+                        struct cl_g2d_buf *input_buf, unsigned int size);
+int cl_g2d_cmdlist_submit(void *cmdlist);
+int cl_g2d_cmdlist_wait(void *cmdlist);
+int cl_g2d_cmdlist_destroy(void *cmdlist);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,50 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef IMX_2D_BLEND_HPP_
+#define IMX_2D_BLEND_HPP_
+
+#include <stdint.h>
+
+namespace imx {
+
+// Blend weights are fixed point, the weight of the first camera is alpha and
+// the one of the second camera SV_ALPHA_ONE - alpha.
+#define SV_ALPHA_SHIFT 8
+#define SV_ALPHA_ONE (1 << SV_ALPHA_SHIFT)
+
+// Pixel kernels of the 2D surround view on 32 bit pixels. offsets are in
+// pixels from the start of the camera image. The implementation is picked once
+// at runtime: NEON on arm64, AVX2 or SSE2 on x86, plain C elsewhere. All of
+// them give the same output bit for bit.
+struct SVBlendKernels {
+    const char *name;
+    // dst[i] = src[offsets[i]]
+    void (*copy)(const uint32_t *src, const uint32_t *offsets, uint32_t *dst, int count);
+    // every byte of dst[i] is
+    // (p0 * alpha[i] + p1 * (SV_ALPHA_ONE - alpha[i]) + SV_ALPHA_ONE / 2) >> SV_ALPHA_SHIFT
+    // with p0 the byte of src0[offsets0[i]] and p1 the one of src1[offsets1[i]].
+    void (*blend)(const uint32_t *src0, const uint32_t *offsets0, const uint32_t *src1,
+                  const uint32_t *offsets1, const uint16_t *alpha, uint32_t *dst, int count);
+};
+
+const SVBlendKernels &getSVBlendKernels();
+
+// the plain C kernels, reference of the others.
+const SVBlendKernels &getSVBlendKernelsC();
+
+} // namespace imx
+#endif
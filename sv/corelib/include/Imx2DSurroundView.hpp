@@ -20,8 +20,15 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 
+#include <string>
+
 #include "ImxSurroundViewTypes.hpp"
 
+// LUT of a calibration are kept in this directory and mapped on later starts.
+// The device init.rc creates it and its sepolicy lets the surround view client
+// write it; when it can not be written the LUT is simply built on every start.
+#define SV_LUT_CACHE_DIR "/data/vendor/sv"
+
 using namespace std;
 using namespace Eigen;
 
@@ -69,7 +76,7 @@ struct ImxSV2DParams {
 
 class Imx2DSV {
 public:
-    virtual ~Imx2DSV() = default;
+    virtual ~Imx2DSV();
     Imx2DSV();
 
     bool startSV();
@@ -78,9 +85,26 @@ public:
                     vector<Vector3d> &evsTransforms, vector<Matrix<double, 3, 3>> &Ks,
                     vector<Matrix<double, 1, 4>> &Ds);
     bool GetSVBuffer(vector<shared_ptr<char>> &distorts, void *flat_outbuf, uint32_t bpp);
+    // directory of the LUT cache, empty to always build the LUT.
+    void SetLUTCacheDir(const string &dir);
 
 private:
+    // Output pixels from [start, start + count) that take the same cameras,
+    // camera1 is -1 out of the overlap regions.
+    struct BlendRun {
+        uint32_t start;
+        uint32_t count;
+        int camera0;
+        int camera1;
+    };
+
     bool updateLUT();
+    void packLUT();
+    uint64_t getLUTKey();
+    string getLUTCachePath(uint64_t key);
+    bool loadLUTCache(uint64_t key);
+    void saveLUTCache(uint64_t key);
+    void releaseLUT();
 
     ImxSV2DParams m2DParams;
     vector<Vector3d> mEvsRotations;
@@ -88,6 +112,24 @@ private:
     vector<Matrix<double, 3, 3>> mKs;
     vector<Matrix<double, 1, 4>> mDs;
     shared_ptr<PixelMap> mLookupPtr;
+
+    // packed LUT, one entry per output pixel. The offsets are in pixels from
+    // the start of the camera image, alpha is the weight of camera0. They
+    // point to the vectors below or to the mapped cache file.
+    const BlendRun *mRuns = nullptr;
+    uint32_t mRunCount = 0;
+    const uint32_t *mOffsets0 = nullptr;
+    const uint32_t *mOffsets1 = nullptr;
+    const uint16_t *mAlpha = nullptr;
+
+    vector<BlendRun> mRunStore;
+    vector<uint32_t> mOffsets0Store;
+    vector<uint32_t> mOffsets1Store;
+    vector<uint16_t> mAlphaStore;
+
+    string mCacheDir;
+    void *mCacheMap = nullptr;
+    size_t mCacheMapSize = 0;
 };
 
 } // namespace imx
@@ -36,6 +36,7 @@
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <memory>
 #include <vector>
 
 #include "ImxSurroundViewTypes.hpp"
@@ -54,6 +55,17 @@ struct GridParam { /* Parameters of grid */
                     * Step in z axis: step_z[i] = (i * step_x)^2, i = 1, 2, ... - number of point */
 };
 
+/* One ring of the grid: the points at the same distance from the bowl center and at the same
+ * height, one per circular sector, with their mapping on the cameras. The points only depend on
+ * these values, so rings are kept between createGrid() calls and only new ones are projected. */
+struct GridRing {
+    double distance;
+    double height;
+    uint angles;
+    vector<Vector3d> points;
+    vector<PixelMap> maps;
+};
+
 /*******************************************************************************************
  * Classes
  *******************************************************************************************/
@@ -101,11 +113,17 @@ public:
      **************************************************************************************************************/
     bool createGrid(float radius);
 
+    /* Copy of the triangles of a camera, malloc'ed and freed by the caller. */
     int getMashes(float **points, int camara);
+    /* Triangles of a camera: SV_ATTRIBUTE_NUM interleaved floats per vertex (position,
+     * texture coordinate, alpha), ready to be uploaded as is. Valid until the next createGrid(). */
+    const vector<float> &getMesh(int camera);
     int getGrids(float **points);
 
 private:
     bool valid3DPoint(uint32_t index);
+    void projectRing(GridRing &ring);
+    void buildMesh(int camera, vector<float> &mesh);
 
     int mNoP;                    // Number of grid points for one grid sector (angle)
     int mMinNoP;                 // Number of grid points for valid camra mapping
@@ -121,7 +139,11 @@ private:
     vector<Vector3d> mEvsTransforms;
     vector<Matrix<double, 3, 3>> mKs;
     vector<Matrix<double, 1, 4>> mDs;
-    shared_ptr<PixelMap> mLookupPtr;
+    vector<Matrix3d> mRotationMatrices;
+    vector<PixelMap> mLookup; // camera mapping of mGlobalP3d
+
+    vector<shared_ptr<GridRing>> mRings; // rings of the current grid, from the center
+    vector<vector<float>> mMeshes;       // per camera, see getMesh()
 };
 
 } // namespace imx
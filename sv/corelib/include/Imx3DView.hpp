@@ -113,8 +113,11 @@ public:
     void renderBuffer(int buf_num, int type, int vert_num);
     void updateBuffer(int buf_num, GLfloat* buf, int num);
     void renderView(shared_ptr<unsigned char> distort, uint32_t w, uint32_t h, int mesh);
-    int addMesh(float* data, int data_num);
+    int addMesh(const float* data, int data_num);
     bool prepareGL(uint32_t output_w, uint32_t output_h);
+    // Rebuild the bowl for a new radius and upload the camera meshes again, only the
+    // grid rings whose shape changed are computed.
+    bool updateBowl(float radius);
     bool renderSV(vector<shared_ptr<unsigned char>> images, char* outbuf, uint32_t input_w,
                   uint32_t input_h, uint32_t output_w, uint32_t output_h);
 
@@ -126,7 +129,7 @@ private:
     vector<int> mAshes;
     imx::CurvilinearGrid* mGrid;
     void vLoad(GLfloat** vert, int* num, string filename);
-    void bufferObjectInit(GLuint* text_vao, GLuint* text_vbo, GLfloat* vert, int num);
+    void bufferObjectInit(GLuint* text_vao, GLuint* text_vbo, const GLfloat* vert, int num);
     void texture2dInit(GLuint* texture);
     bool mInitial;
     vector<Vector3d> mEvsRotations;
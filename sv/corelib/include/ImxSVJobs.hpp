@@ -0,0 +1,35 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef IMX_SV_JOBS_HPP_
+#define IMX_SV_JOBS_HPP_
+
+#include <stdint.h>
+
+#include <functional>
+
+namespace imx {
+
+// upper limit of threads running the jobs, caller included.
+#define SV_MAX_JOB_THREADS 8
+
+// Split [0, count) into contiguous bands, run job(begin, end) for each of them
+// on its own thread and wait for all of them. The caller thread takes the
+// first band.
+void runSVJobs(uint32_t count, const std::function<void(uint32_t, uint32_t)> &job);
+
+} // namespace imx
+#endif
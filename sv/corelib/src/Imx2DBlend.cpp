@@ -0,0 +1,239 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "Imx2DBlend.hpp"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace imx {
+
+/*======== generic C ======== */
+static void copyC(const uint32_t *src, const uint32_t *offsets, uint32_t *dst, int count) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = src[offsets[i]];
+    }
+}
+
+// blend the pixels [begin, end), the SIMD versions finish their tail with it.
+static void blendRangeC(const uint32_t *src0, const uint32_t *offsets0, const uint32_t *src1,
+                        const uint32_t *offsets1, const uint16_t *alpha, uint32_t *dst, int begin,
+                        int end) {
+    for (int i = begin; i < end; i++) {
+        uint32_t p0 = src0[offsets0[i]];
+        uint32_t p1 = src1[offsets1[i]];
+        uint32_t a0 = alpha[i];
+        uint32_t a1 = SV_ALPHA_ONE - a0;
+        uint32_t out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            uint32_t c = ((p0 >> shift) & 0xff) * a0 + ((p1 >> shift) & 0xff) * a1;
+            out |= ((c + SV_ALPHA_ONE / 2) >> SV_ALPHA_SHIFT) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+static void blendC(const uint32_t *src0, const uint32_t *offsets0, const uint32_t *src1,
+                   const uint32_t *offsets1, const uint16_t *alpha, uint32_t *dst, int count) {
+    blendRangeC(src0, offsets0, src1, offsets1, alpha, dst, 0, count);
+}
+
+static const SVBlendKernels sKernelsC = {
+        "c",
+        copyC,
+        blendC,
+};
+
+// With weights summing to 256 the sum of 8 bit channels fits 16 bit lanes:
+// 255 * 256 + 128 < 65536.
+
+#if defined(__aarch64__)
+/*======== NEON ======== */
+// NEON has no gather, the pixels are loaded lane by lane and blended together.
+static inline uint32x4_t gatherNeon(const uint32_t *src, const uint32_t *offsets) {
+    uint32x4_t v = vdupq_n_u32(0);
+    v = vld1q_lane_u32(src + offsets[0], v, 0);
+    v = vld1q_lane_u32(src + offsets[1], v, 1);
+    v = vld1q_lane_u32(src + offsets[2], v, 2);
+    v = vld1q_lane_u32(src + offsets[3], v, 3);
+    return v;
+}
+
+static void blendNeon(const uint32_t *src0, const uint32_t *offsets0, const uint32_t *src1,
+                      const uint32_t *offsets1, const uint16_t *alpha, uint32_t *dst, int count) {
+    const uint16x8_t one = vdupq_n_u16(SV_ALPHA_ONE);
+    const uint16x8_t round = vdupq_n_u16(SV_ALPHA_ONE / 2);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t p0 = vreinterpretq_u8_u32(gatherNeon(src0, offsets0 + i));
+        uint8x16_t p1 = vreinterpretq_u8_u32(gatherNeon(src1, offsets1 + i));
+
+        // the alpha of a pixel for each of its 4 channels
+        uint16x4_t a = vld1_u16(alpha + i);
+        uint16x4x2_t a2 = vzip_u16(a, a);
+        uint16x4x2_t lo4 = vzip_u16(a2.val[0], a2.val[0]);
+        uint16x4x2_t hi4 = vzip_u16(a2.val[1], a2.val[1]);
+        uint16x8_t alo = vcombine_u16(lo4.val[0], lo4.val[1]);
+        uint16x8_t ahi = vcombine_u16(hi4.val[0], hi4.val[1]);
+
+        uint16x8_t lo = vmlaq_u16(round, vmovl_u8(vget_low_u8(p0)), alo);
+        lo = vmlaq_u16(lo, vmovl_u8(vget_low_u8(p1)), vsubq_u16(one, alo));
+        uint16x8_t hi = vmlaq_u16(round, vmovl_u8(vget_high_u8(p0)), ahi);
+        hi = vmlaq_u16(hi, vmovl_u8(vget_high_u8(p1)), vsubq_u16(one, ahi));
+
+        uint8x16_t v = vcombine_u8(vshrn_n_u16(lo, SV_ALPHA_SHIFT), vshrn_n_u16(hi, SV_ALPHA_SHIFT));
+        vst1q_u32(dst + i, vreinterpretq_u32_u8(v));
+    }
+    blendRangeC(src0, offsets0, src1, offsets1, alpha, dst, i, count);
+}
+
+static const SVBlendKernels sKernelsNeon = {
+        "neon",
+        copyC,
+        blendNeon,
+};
+
+#elif defined(__x86_64__) || defined(__i386__)
+/*======== SSE2 ======== */
+// SSE2 has no gather, the pixels are loaded one by one and blended together.
+static inline __m128i gatherSse2(const uint32_t *src, const uint32_t *offsets) {
+    return _mm_set_epi32(src[offsets[3]], src[offsets[2]], src[offsets[1]], src[offsets[0]]);
+}
+
+// lo and hi hold the 8 bit channels of two pixels widened to 16 bit, a their
+// alpha spread over the channels.
+static inline __m128i blendLanesSse2(__m128i p0, __m128i p1, __m128i a) {
+    const __m128i one = _mm_set1_epi16(SV_ALPHA_ONE);
+    const __m128i round = _mm_set1_epi16(SV_ALPHA_ONE / 2);
+    __m128i v = _mm_add_epi16(round, _mm_mullo_epi16(p0, a));
+    v = _mm_add_epi16(v, _mm_mullo_epi16(p1, _mm_sub_epi16(one, a)));
+    return _mm_srli_epi16(v, SV_ALPHA_SHIFT);
+}
+
+static void blendSse2(const uint32_t *src0, const uint32_t *offsets0, const uint32_t *src1,
+                      const uint32_t *offsets1, const uint16_t *alpha, uint32_t *dst, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i p0 = gatherSse2(src0, offsets0 + i);
+        __m128i p1 = gatherSse2(src1, offsets1 + i);
+
+        // the alpha of a pixel in both halves of a 32 bit lane, then twice
+        // per pixel: 4 channels
+        __m128i a = _mm_loadl_epi64((const __m128i *)(alpha + i));
+        a = _mm_unpacklo_epi16(a, a);
+        __m128i alo = _mm_unpacklo_epi32(a, a);
+        __m128i ahi = _mm_unpackhi_epi32(a, a);
+
+        __m128i lo = blendLanesSse2(_mm_unpacklo_epi8(p0, zero), _mm_unpacklo_epi8(p1, zero), alo);
+        __m128i hi = blendLanesSse2(_mm_unpackhi_epi8(p0, zero), _mm_unpackhi_epi8(p1, zero), ahi);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    blendRangeC(src0, offsets0, src1, offsets1, alpha, dst, i, count);
+}
+
+static const SVBlendKernels sKernelsSse2 = {
+        "sse2",
+        copyC,
+        blendSse2,
+};
+
+/*======== AVX2 ======== */
+// unpack and pack work inside 128 bit lanes, so pixels 0-1 and 4-5 share the
+// low half and the alpha is spread the same way.
+__attribute__((target("avx2"))) static void copyAvx2(const uint32_t *src, const uint32_t *offsets,
+                                                     uint32_t *dst, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i idx = _mm256_loadu_si256((const __m256i *)(offsets + i));
+        __m256i v = _mm256_i32gather_epi32((const int *)src, idx, 4);
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    copyC(src, offsets + i, dst + i, count - i);
+}
+
+__attribute__((target("avx2"))) static void blendAvx2(const uint32_t *src0,
+                                                      const uint32_t *offsets0,
+                                                      const uint32_t *src1,
+                                                      const uint32_t *offsets1,
+                                                      const uint16_t *alpha, uint32_t *dst,
+                                                      int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(SV_ALPHA_ONE);
+    const __m256i round = _mm256_set1_epi16(SV_ALPHA_ONE / 2);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i idx0 = _mm256_loadu_si256((const __m256i *)(offsets0 + i));
+        __m256i idx1 = _mm256_loadu_si256((const __m256i *)(offsets1 + i));
+        __m256i p0 = _mm256_i32gather_epi32((const int *)src0, idx0, 4);
+        __m256i p1 = _mm256_i32gather_epi32((const int *)src1, idx1, 4);
+
+        __m256i a = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(alpha + i)));
+        a = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+        __m256i alo = _mm256_unpacklo_epi32(a, a);
+        __m256i ahi = _mm256_unpackhi_epi32(a, a);
+
+        __m256i lo = _mm256_add_epi16(round,
+                                      _mm256_mullo_epi16(_mm256_unpacklo_epi8(p0, zero), alo));
+        lo = _mm256_add_epi16(lo, _mm256_mullo_epi16(_mm256_unpacklo_epi8(p1, zero),
+                                                     _mm256_sub_epi16(one, alo)));
+        __m256i hi = _mm256_add_epi16(round,
+                                      _mm256_mullo_epi16(_mm256_unpackhi_epi8(p0, zero), ahi));
+        hi = _mm256_add_epi16(hi, _mm256_mullo_epi16(_mm256_unpackhi_epi8(p1, zero),
+                                                     _mm256_sub_epi16(one, ahi)));
+
+        __m256i v = _mm256_packus_epi16(_mm256_srli_epi16(lo, SV_ALPHA_SHIFT),
+                                        _mm256_srli_epi16(hi, SV_ALPHA_SHIFT));
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+    blendSse2(src0, offsets0 + i, src1, offsets1 + i, alpha + i, dst + i, count - i);
+}
+
+static const SVBlendKernels sKernelsAvx2 = {
+        "avx2",
+        copyAvx2,
+        blendAvx2,
+};
+#endif
+
+static const SVBlendKernels *selectSVBlendKernels() {
+    const SVBlendKernels *kernels = &sKernelsC;
+#if defined(__aarch64__)
+    // NEON is mandatory on arm64.
+    kernels = &sKernelsNeon;
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        kernels = &sKernelsAvx2;
+    else if (__builtin_cpu_supports("sse2"))
+        kernels = &sKernelsSse2;
+#endif
+    return kernels;
+}
+
+const SVBlendKernels &getSVBlendKernels() {
+    static const SVBlendKernels *kernels = selectSVBlendKernels();
+    return *kernels;
+}
+
+const SVBlendKernels &getSVBlendKernelsC() {
+    return sKernelsC;
+}
+
+} // namespace imx
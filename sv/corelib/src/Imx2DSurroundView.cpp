@@ -17,18 +17,81 @@
 #include "Imx2DSurroundView.hpp"
 
 #include <cutils/log.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <vector>
 
+#include "Imx2DBlend.hpp"
+#include "ImxSVJobs.hpp"
+
 using namespace std;
 using namespace Eigen;
 
 namespace imx {
 
-Imx2DSV::Imx2DSV() : mLookupPtr(nullptr) {}
+// Bump when the LUT math or the cache layout changes, old files are then ignored.
+#define SV_LUT_MAGIC 0x544c5653 // "SVLT"
+#define SV_LUT_VERSION 1
+
+// The cache file is this header followed by the runs, offsets0, offsets1 and
+// alpha arrays of the packed LUT.
+struct LUTCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t pixels;
+    uint32_t runs;
+    uint32_t reserved[2];
+};
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool writeAll(int fd, const void *data, size_t size) {
+    const char *p = (const char *)data;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += written;
+        size -= written;
+    }
+    return true;
+}
+
+Imx2DSV::Imx2DSV() : mLookupPtr(nullptr), mCacheDir(SV_LUT_CACHE_DIR) {}
+
+Imx2DSV::~Imx2DSV() {
+    releaseLUT();
+}
+
+void Imx2DSV::SetLUTCacheDir(const string &dir) {
+    mCacheDir = dir;
+}
 
 bool Imx2DSV::startSV() {
+    releaseLUT();
+    uint64_t key = getLUTKey();
+    if (loadLUTCache(key))
+        return true;
+
     int flatw = m2DParams.resolution.width;
     int flath = m2DParams.resolution.height;
     shared_ptr<PixelMap> LUT_ptr(new PixelMap[flath * flatw], std::default_delete<PixelMap[]>());
@@ -40,14 +103,39 @@ bool Imx2DSV::startSV() {
         ALOGE("Cannot allocate Lookup mapping buffer!");
         return false;
     }
-    return updateLUT();
+    if (!updateLUT())
+        return false;
+
+    // only the packed LUT is used from now on
+    packLUT();
+    mLookupPtr = nullptr;
+    saveLUTCache(key);
+    return true;
 }
 
 bool Imx2DSV::stopSV() {
     mLookupPtr = nullptr;
+    releaseLUT();
     return true;
 }
 
+void Imx2DSV::releaseLUT() {
+    if (mCacheMap != nullptr) {
+        munmap(mCacheMap, mCacheMapSize);
+        mCacheMap = nullptr;
+        mCacheMapSize = 0;
+    }
+    mRunStore.clear();
+    mOffsets0Store.clear();
+    mOffsets1Store.clear();
+    mAlphaStore.clear();
+    mRuns = nullptr;
+    mRunCount = 0;
+    mOffsets0 = nullptr;
+    mOffsets1 = nullptr;
+    mAlpha = nullptr;
+}
+
 bool Imx2DSV::SetConfigs(ImxSV2DParams &sv2DParams, vector<Vector3d> &evsRotations,
                          vector<Vector3d> &evsTransforms, vector<Matrix<double, 3, 3>> &Ks,
                          vector<Matrix<double, 1, 4>> &Ds) {
@@ -63,48 +151,226 @@ bool Imx2DSV::SetConfigs(ImxSV2DParams &sv2DParams, vector<Vector3d> &evsRotatio
 
 // Assume the input and out buffer share the same format/bpp
 bool Imx2DSV::GetSVBuffer(vector<shared_ptr<char>> &distorts, void *flat_outbuf, uint32_t bpp) {
-    uint32_t flatw = m2DParams.resolution.width;
-    uint32_t flath = m2DParams.resolution.height;
-    uint32_t stride = m2DParams.cam_resolution.width * bpp;
-    uint32_t fstride = flatw * bpp;
     if (flat_outbuf == nullptr || distorts.size() != 4) {
         ALOGE("Error!Not valid input for SV process!");
         return false;
     }
+    if (mOffsets0 == nullptr) {
+        ALOGE("Error!Surround view is not started!");
+        return false;
+    }
+
+    const SVBlendKernels &kernels = getSVBlendKernels();
+    for (uint32_t r = 0; r < mRunCount; r++) {
+        const BlendRun &run = mRuns[r];
+        const char *distort0 = distorts[run.camera0].get();
+        const char *distort1 = run.camera1 >= 0 ? distorts[run.camera1].get() : nullptr;
+        if (bpp == 4) {
+            uint32_t *dst = (uint32_t *)flat_outbuf + run.start;
+            if (distort1 == nullptr)
+                kernels.copy((const uint32_t *)distort0, &mOffsets0[run.start], dst, run.count);
+            else
+                kernels.blend((const uint32_t *)distort0, &mOffsets0[run.start],
+                              (const uint32_t *)distort1, &mOffsets1[run.start],
+                              &mAlpha[run.start], dst, run.count);
+            continue;
+        }
+
+        // other pixel sizes, byte by byte with the math of the kernels
+        for (uint32_t i = run.start; i < run.start + run.count; i++) {
+            unsigned char *out = (unsigned char *)flat_outbuf + (size_t)i * bpp;
+            const unsigned char *in0 = (const unsigned char *)distort0 + (size_t)mOffsets0[i] * bpp;
+            if (distort1 == nullptr) {
+                memcpy(out, in0, bpp);
+                continue;
+            }
+            const unsigned char *in1 = (const unsigned char *)distort1 + (size_t)mOffsets1[i] * bpp;
+            uint32_t alpha = mAlpha[i];
+            for (uint32_t b = 0; b < bpp; b++) {
+                out[b] = (in0[b] * alpha + in1[b] * (SV_ALPHA_ONE - alpha) + SV_ALPHA_ONE / 2) >>
+                        SV_ALPHA_SHIFT;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Turn the PixelMap into per pixel offsets and fixed point alpha, grouped in
+// runs of pixels taking the same cameras so GetSVBuffer can hand whole runs
+// to the blend kernels.
+void Imx2DSV::packLUT() {
+    uint32_t flatw = m2DParams.resolution.width;
+    uint32_t flath = m2DParams.resolution.height;
+    uint32_t width = m2DParams.cam_resolution.width;
+    uint32_t pixels = flatw * flath;
     PixelMap *LUT = mLookupPtr.get();
-    for (uint32_t v = 0; v < flath; v++) {
-        for (uint32_t u = 0; u < flatw; u++) {
-            PixelMap *pMap = LUT + v * flatw + u;
-            if ((pMap->index0 >= 0) && (pMap->index1 >= 0)) {
-                // alpha blending on overlap region
-                auto distort0 = distorts[pMap->index0].get();
-                auto distort1 = distorts[pMap->index1].get();
-                unsigned int color0 =
-                        *(int *)((char *)distort0 + stride * pMap->v0 + pMap->u0 * bpp);
-                unsigned int color1 =
-                        *(int *)((char *)distort1 + stride * pMap->v1 + pMap->u1 * bpp);
-                float alpha = pMap->alpha0;
-                unsigned char R = alpha * (color0 & 0xff0000 >> 16) +
-                        (1 - alpha) * ((color1 & 0xff0000) >> 16);
-                unsigned char G =
-                        alpha * (color0 & 0xff00 >> 8) + (1 - alpha) * ((color1 & 0xff00) >> 8);
-                unsigned char B = alpha * (color0 & 0xff) + (1 - alpha) * (color1 & 0xff);
-                color0 = (R << 16) | (G << 8) | B;
-                *(int *)((char *)flat_outbuf + fstride * ((int)v) + ((int)u) * bpp) = color0;
-            } else if (pMap->index0 >= 0) {
-                int index = pMap->index0;
-
-                auto distort0 = distorts[index].get();
-                unsigned int color0 =
-                        *(int *)((char *)distort0 + stride * pMap->v0 + pMap->u0 * bpp);
-                *(int *)((char *)flat_outbuf + fstride * v + u * bpp) = color0;
+
+    mRunStore.clear();
+    mOffsets0Store.assign(pixels, 0);
+    mOffsets1Store.assign(pixels, 0);
+    mAlphaStore.assign(pixels, 0);
+    for (uint32_t i = 0; i < pixels; i++) {
+        PixelMap *pMap = LUT + i;
+        if (pMap->index0 < 0)
+            continue;
+
+        int camera1 = -1;
+        mOffsets0Store[i] = pMap->v0 * width + pMap->u0;
+        if (pMap->index1 >= 0) {
+            camera1 = pMap->index1;
+            mOffsets1Store[i] = pMap->v1 * width + pMap->u1;
+            float alpha = pMap->alpha0 * SV_ALPHA_ONE + 0.5f;
+            mAlphaStore[i] = alpha < 0 ? 0 : (alpha > SV_ALPHA_ONE ? SV_ALPHA_ONE : alpha);
+        }
+
+        if (!mRunStore.empty()) {
+            BlendRun &last = mRunStore.back();
+            if (last.start + last.count == i && last.camera0 == pMap->index0 &&
+                last.camera1 == camera1) {
+                last.count++;
+                continue;
             }
         }
+        mRunStore.push_back({i, 1, pMap->index0, camera1});
+    }
+
+    mRuns = mRunStore.data();
+    mRunCount = mRunStore.size();
+    mOffsets0 = mOffsets0Store.data();
+    mOffsets1 = mOffsets1Store.data();
+    mAlpha = mAlphaStore.data();
+    ALOGI("%s: %u runs, %s kernels", __func__, mRunCount, getSVBlendKernels().name);
+}
+
+// The key covers everything the LUT is computed from.
+uint64_t Imx2DSV::getLUTKey() {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint32_t version = SV_LUT_VERSION;
+    hash = hashBytes(hash, &version, sizeof(version));
+    int32_t sizes[4] = {m2DParams.cam_resolution.width, m2DParams.cam_resolution.height,
+                        m2DParams.resolution.width, m2DParams.resolution.height};
+    hash = hashBytes(hash, sizes, sizeof(sizes));
+    float physical[2] = {m2DParams.physical_size.width, m2DParams.physical_size.height};
+    hash = hashBytes(hash, physical, sizeof(physical));
+    for (size_t index = 0; index < mEvsRotations.size(); index++) {
+        hash = hashBytes(hash, mEvsRotations[index].data(), sizeof(double) * 3);
+        hash = hashBytes(hash, mEvsTransforms[index].data(), sizeof(double) * 3);
+        hash = hashBytes(hash, mKs[index].data(), sizeof(double) * 9);
+        hash = hashBytes(hash, mDs[index].data(), sizeof(double) * 4);
+    }
+    return hash;
+}
+
+string Imx2DSV::getLUTCachePath(uint64_t key) {
+    char name[64];
+    snprintf(name, sizeof(name), "/sv2d_lut_%016" PRIx64 ".bin", key);
+    return mCacheDir + name;
+}
+
+// Map the LUT cached for this calibration, if any. The file is checked
+// against the current sizes so a bad file can not make GetSVBuffer read out
+// of the camera images.
+bool Imx2DSV::loadLUTCache(uint64_t key) {
+    if (mCacheDir.empty())
+        return false;
+
+    string path = getLUTCachePath(key);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(LUTCacheHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t fileSize = st.st_size;
+    void *map = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        ALOGW("%s: mmap %s failed: %s", __func__, path.c_str(), strerror(errno));
+        return false;
+    }
+
+    uint64_t pixels = (uint64_t)m2DParams.resolution.width * m2DParams.resolution.height;
+    uint64_t camPixels =
+            (uint64_t)m2DParams.cam_resolution.width * m2DParams.cam_resolution.height;
+    const LUTCacheHeader *header = (const LUTCacheHeader *)map;
+    bool valid = header->magic == SV_LUT_MAGIC && header->version == SV_LUT_VERSION &&
+            header->key == key && header->pixels == pixels && header->runs <= pixels &&
+            fileSize ==
+                    sizeof(LUTCacheHeader) + header->runs * sizeof(BlendRun) +
+                            pixels * (2 * sizeof(uint32_t) + sizeof(uint16_t));
+
+    const char *data = (const char *)map + sizeof(LUTCacheHeader);
+    const BlendRun *runs = (const BlendRun *)data;
+    const uint32_t *offsets0 = (const uint32_t *)(runs + (valid ? header->runs : 0));
+    const uint32_t *offsets1 = offsets0 + pixels;
+    const uint16_t *alpha = (const uint16_t *)(offsets1 + pixels);
+    for (uint32_t r = 0; valid && r < header->runs; r++) {
+        const BlendRun &run = runs[r];
+        valid = run.camera0 >= 0 && run.camera0 < (int)mEvsRotations.size() &&
+                run.camera1 >= -1 && run.camera1 < (int)mEvsRotations.size() &&
+                (uint64_t)run.start + run.count <= pixels;
+        for (uint32_t i = run.start; valid && i < run.start + run.count; i++) {
+            valid = offsets0[i] < camPixels &&
+                    (run.camera1 < 0 || (offsets1[i] < camPixels && alpha[i] <= SV_ALPHA_ONE));
+        }
+    }
+    if (!valid) {
+        ALOGW("%s: drop invalid LUT cache %s", __func__, path.c_str());
+        munmap(map, fileSize);
+        unlink(path.c_str());
+        return false;
     }
 
+    mCacheMap = map;
+    mCacheMapSize = fileSize;
+    mRuns = runs;
+    mRunCount = header->runs;
+    mOffsets0 = offsets0;
+    mOffsets1 = offsets1;
+    mAlpha = alpha;
+    ALOGI("%s: LUT mapped from %s, %u runs", __func__, path.c_str(), mRunCount);
     return true;
 }
 
+// Write the packed LUT to a temporary file renamed into place, so a reader
+// never sees a partial file.
+void Imx2DSV::saveLUTCache(uint64_t key) {
+    if (mCacheDir.empty())
+        return;
+
+    if (mkdir(mCacheDir.c_str(), 0770) != 0 && errno != EEXIST) {
+        ALOGW("%s: cannot create %s: %s", __func__, mCacheDir.c_str(), strerror(errno));
+        return;
+    }
+
+    string path = getLUTCachePath(key);
+    string tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        ALOGW("%s: cannot create %s: %s", __func__, tmpPath.c_str(), strerror(errno));
+        return;
+    }
+
+    uint32_t pixels = m2DParams.resolution.width * m2DParams.resolution.height;
+    LUTCacheHeader header = {SV_LUT_MAGIC, SV_LUT_VERSION, key, pixels, mRunCount, {0, 0}};
+    bool ok = writeAll(fd, &header, sizeof(header)) &&
+            writeAll(fd, mRuns, mRunCount * sizeof(BlendRun)) &&
+            writeAll(fd, mOffsets0, pixels * sizeof(uint32_t)) &&
+            writeAll(fd, mOffsets1, pixels * sizeof(uint32_t)) &&
+            writeAll(fd, mAlpha, pixels * sizeof(uint16_t)) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        ALOGW("%s: cannot write %s: %s", __func__, path.c_str(), strerror(errno));
+        unlink(tmpPath.c_str());
+        return;
+    }
+    ALOGI("%s: LUT saved to %s", __func__, path.c_str());
+}
+
 bool Imx2DSV::updateLUT() {
     uint32_t flatw = m2DParams.resolution.width;
     uint32_t flath = m2DParams.resolution.height;
@@ -129,66 +395,71 @@ bool Imx2DSV::updateLUT() {
         double normal = R.norm();
         AngleAxisd rotation_vector(normal, R / normal);
         auto rotation_matrix = rotation_vector.toRotationMatrix();
-        for (uint32_t v = 0; v < flath; v++) {
-            for (uint32_t u = 0; u < flatw; u++) {
-                float x = -pw / 2 + u * pw / flatw;
-                float y = ph / 2 - v * ph / flath;
-                Vector3d worldPoint{x, y, 0};
-
-                Vector3d cameraPoint = rotation_matrix * worldPoint + T;
-                Vector3d normalizedCamera = cameraPoint / cameraPoint[2];
-                Vector3d cameraZ{0, 0, 1};
-                auto dot = cameraZ.dot(cameraPoint);
-                auto fov = acos(dot / cameraPoint.norm());
-                auto threshhold = M_PI / 3;
-                // if the worldPoint beyond the camera FOV, ignore it.
-                // assume we only care FOV < threshold point
-                // a dot b = a.norm()*b.norm*cos(angle)
-                // here angle should be less than 90 degree.
-                if (dot / cameraPoint.norm() < cos(threshhold)) {
-                    continue;
-                }
-                Vector3d undistortPoint = K * normalizedCamera;
-                auto xc = (undistortPoint[0] / undistortPoint[2] - cx) / fx;
-                auto yc = (undistortPoint[1] / undistortPoint[2] - cy) / fy;
-
-                auto r = sqrt(xc * xc + yc * yc);
-                double theta = atan(r);
-                double theta_4 = k4 * pow(theta, 9);
-                double theta_3 = k3 * pow(theta, 7);
-                double theta_2 = k2 * pow(theta, 5);
-                double theta_1 = k1 * pow(theta, 3);
-                double theta_d = theta + theta_1 + theta_2 + theta_3 + theta_4;
-                double x_distorted = xc * (theta_d / r);
-                double y_distorted = yc * (theta_d / r);
-
-                double u_distorted = fx * x_distorted + cx;
-                double v_distorted = fy * y_distorted + cy;
-                if (u_distorted >= 0 && v_distorted >= 0 && u_distorted < width &&
-                    v_distorted < height) {
-                    PixelMap *pMap = LUT + v * flatw + u;
-                    if (pMap->index0 == -1) {
-                        pMap->index0 = index;
-                        pMap->u0 = u_distorted;
-                        pMap->v0 = v_distorted;
-                        pMap->fov0 = fov;
-                    } else if ((index != pMap->index0) && (pMap->index1 == -1)) {
-                        pMap->index1 = index;
-                        pMap->u1 = u_distorted;
-                        pMap->v1 = v_distorted;
-                        pMap->fov1 = fov;
-                        auto fov0 = pMap->fov0;
-                        // alpha value is set based the ratio of distance the border
-                        // of two camera FOV
-                        auto alpha0 = (threshhold - fov0) / (threshhold - fov0 + threshhold - fov);
-                        pMap->alpha1 = 1 - alpha0;
-                        pMap->alpha0 = alpha0;
-                    } else if ((index != pMap->index0) && (index != pMap->index1)) {
-                        ALOGW("Warning! Region overlapped with 3 cameras");
+        // bands of rows are independent, cameras still go in order so the
+        // first camera seeing a pixel stays camera0.
+        runSVJobs(flath, [&](uint32_t start, uint32_t end) {
+            for (uint32_t v = start; v < end; v++) {
+                for (uint32_t u = 0; u < flatw; u++) {
+                    float x = -pw / 2 + u * pw / flatw;
+                    float y = ph / 2 - v * ph / flath;
+                    Vector3d worldPoint{x, y, 0};
+
+                    Vector3d cameraPoint = rotation_matrix * worldPoint + T;
+                    Vector3d normalizedCamera = cameraPoint / cameraPoint[2];
+                    Vector3d cameraZ{0, 0, 1};
+                    auto dot = cameraZ.dot(cameraPoint);
+                    auto fov = acos(dot / cameraPoint.norm());
+                    auto threshhold = M_PI / 3;
+                    // if the worldPoint beyond the camera FOV, ignore it.
+                    // assume we only care FOV < threshold point
+                    // a dot b = a.norm()*b.norm*cos(angle)
+                    // here angle should be less than 90 degree.
+                    if (dot / cameraPoint.norm() < cos(threshhold)) {
+                        continue;
+                    }
+                    Vector3d undistortPoint = K * normalizedCamera;
+                    auto xc = (undistortPoint[0] / undistortPoint[2] - cx) / fx;
+                    auto yc = (undistortPoint[1] / undistortPoint[2] - cy) / fy;
+
+                    auto r = sqrt(xc * xc + yc * yc);
+                    double theta = atan(r);
+                    double theta_4 = k4 * pow(theta, 9);
+                    double theta_3 = k3 * pow(theta, 7);
+                    double theta_2 = k2 * pow(theta, 5);
+                    double theta_1 = k1 * pow(theta, 3);
+                    double theta_d = theta + theta_1 + theta_2 + theta_3 + theta_4;
+                    double x_distorted = xc * (theta_d / r);
+                    double y_distorted = yc * (theta_d / r);
+
+                    double u_distorted = fx * x_distorted + cx;
+                    double v_distorted = fy * y_distorted + cy;
+                    if (u_distorted >= 0 && v_distorted >= 0 && u_distorted < width &&
+                        v_distorted < height) {
+                        PixelMap *pMap = LUT + v * flatw + u;
+                        if (pMap->index0 == -1) {
+                            pMap->index0 = index;
+                            pMap->u0 = u_distorted;
+                            pMap->v0 = v_distorted;
+                            pMap->fov0 = fov;
+                        } else if ((index != pMap->index0) && (pMap->index1 == -1)) {
+                            pMap->index1 = index;
+                            pMap->u1 = u_distorted;
+                            pMap->v1 = v_distorted;
+                            pMap->fov1 = fov;
+                            auto fov0 = pMap->fov0;
+                            // alpha value is set based the ratio of distance the border
+                            // of two camera FOV
+                            auto alpha0 =
+                                    (threshhold - fov0) / (threshhold - fov0 + threshhold - fov);
+                            pMap->alpha1 = 1 - alpha0;
+                            pMap->alpha0 = alpha0;
+                        } else if ((index != pMap->index0) && (index != pMap->index1)) {
+                            ALOGW("Warning! Region overlapped with 3 cameras");
+                        }
                     }
                 }
             }
-        }
+        });
     }
 
     return true;
@@ -27,6 +27,7 @@
 #include <math.h>
 
 #include "Imx3DView.hpp"
+#include "ImxSVJobs.hpp"
 
 #define SV_INVALID_INDEX (-1)
 
@@ -62,6 +63,11 @@ CurvilinearGrid::CurvilinearGrid(uint angles, uint nop_z, double step_x, uint32_
     mEvsTransforms = evsTransforms;
     mKs = Ks;
     mDs = Ds;
+    for (auto &R : mEvsRotations) {
+        double normal = R.norm();
+        AngleAxisd rotation_vector(normal, R / normal);
+        mRotationMatrices.push_back(rotation_vector.toRotationMatrix());
+    }
 }
 
 /**************************************************************************************************************
@@ -79,58 +85,105 @@ CurvilinearGrid::CurvilinearGrid(uint angles, uint nop_z, double step_x, uint32_
  *
  **************************************************************************************************************/
 bool CurvilinearGrid::createGrid(float radius) {
-    mGlobalP3d.clear();
     mRadius = radius;
     int pnum = radius / mParameters.step_x; // Number of grid rows of flat bowl bottom
     int startpnum = 2;                      // The first row of grid
-    mNoP = (pnum - startpnum) +
-            mParameters.nop_z; // Number of grid points for one grid sector (angle)
 
-    for (uint angle = 0; angle < mParameters.angles * 2; angle++) {
-        double angle_start =
-                angle * (M_PI / mParameters.angles); // Start angle of the current circular sector
+    // Rings from the center: flat bottom points, then points on bowl side. Rings of the previous
+    // grid with the same shape are reused, the others are projected in parallel.
+    vector<pair<double, double>> shape;
+    for (int i = startpnum; i < pnum; i++) {
+        shape.push_back({i * mParameters.step_x, 0});
+    }
+    for (uint i = 1; i <= mParameters.nop_z; i++) {
+        shape.push_back({radius + i * mParameters.step_x, pow(i * mParameters.step_x, 2)});
+    }
 
-        // Flat bottom points
-        for (int i = startpnum; i < pnum; i++) {
-            double hptn = i * mParameters.step_x;
-            mGlobalP3d.push_back(Vector3d(hptn * cos(angle_start), hptn * sin(angle_start), 0));
+    vector<shared_ptr<GridRing>> rings;
+    vector<GridRing *> newRings;
+    bool changed = mMeshes.empty() || shape.size() != mRings.size();
+    for (size_t r = 0; r < shape.size(); r++) {
+        shared_ptr<GridRing> ring;
+        for (auto &old : mRings) {
+            if (old->distance == shape[r].first && old->height == shape[r].second &&
+                old->angles == mParameters.angles) {
+                ring = old;
+                break;
+            }
         }
-
-        // Points on bowl side
-        for (uint i = 1; i <= mParameters.nop_z; i++) {
-            double hptn = radius + i * mParameters.step_x;
-            mGlobalP3d.push_back(Vector3d(hptn * cos(angle_start), hptn * sin(angle_start),
-                                          pow(i * mParameters.step_x, 2)));
+        if (ring == nullptr) {
+            ring = make_shared<GridRing>();
+            ring->distance = shape[r].first;
+            ring->height = shape[r].second;
+            ring->angles = mParameters.angles;
+            newRings.push_back(ring.get());
         }
+        if (r >= mRings.size() || mRings[r] != ring)
+            changed = true;
+        rings.push_back(ring);
     }
-    ALOGI("3D point size=%u", mGlobalP3d.size());
-    shared_ptr<PixelMap> LUT_ptr(new PixelMap[mGlobalP3d.size()],
-                                 std::default_delete<PixelMap[]>());
-    if (LUT_ptr != nullptr) {
-        PixelMap *LUT = LUT_ptr.get();
-        memset((void *)LUT, SV_INVALID_INDEX, sizeof(PixelMap) * mGlobalP3d.size());
-        mLookupPtr = LUT_ptr;
-    } else {
-        ALOGE("Cannot allocate Lookup mapping buffer!");
-        return false;
+    runSVJobs(newRings.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t r = begin; r < end; r++) {
+            projectRing(*newRings[r]);
+        }
+    });
+    mRings = rings;
+    ALOGI("Grid rings %zu, %zu projected", mRings.size(), newRings.size());
+    if (!changed)
+        return true;
+
+    // Points are stored sector by sector, from the center
+    uint sectors = mParameters.angles * 2;
+    mNoP = mRings.size(); // Number of grid points for one grid sector (angle)
+    mGlobalP3d.resize(sectors * mNoP);
+    mLookup.resize(sectors * mNoP);
+    for (uint angle = 0; angle < sectors; angle++) {
+        for (int n = 0; n < mNoP; n++) {
+            mGlobalP3d[angle * mNoP + n] = mRings[n]->points[angle];
+            mLookup[angle * mNoP + n] = mRings[n]->maps[angle];
+        }
     }
+    ALOGI("3D point size=%zu", mGlobalP3d.size());
 
-    PixelMap *LUT = mLookupPtr.get();
-    int iMaxNoP = 0;
+    // Triangles stop at the shortest line of mapped points, the last point of a line excluded.
     int iMinNoP = mNoP;
-    for (uint32_t pointIndex = 0; pointIndex < mGlobalP3d.size(); pointIndex++) {
-        auto &worldPoint = mGlobalP3d[pointIndex];
-        PixelMap *pMap = LUT + pointIndex;
+    for (uint angle = 0; angle < sectors; angle++) {
+        int iMaxNoP = 0;
+        for (int n = 0; n < mNoP - 1; n++) {
+            if (mLookup[angle * mNoP + n].index0 != SV_INVALID_INDEX)
+                iMaxNoP = n;
+        }
+        if (iMaxNoP < iMinNoP)
+            iMinNoP = iMaxNoP;
+    }
+    ALOGI("Grids %d of points on one line, minmum %d points with valid mapping on one line", mNoP,
+          iMinNoP);
+    mMinNoP = iMinNoP;
+
+    mMeshes.resize(mEvsRotations.size());
+    runSVJobs(mMeshes.size(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t camera = begin; camera < end; camera++) {
+            buildMesh(camera, mMeshes[camera]);
+        }
+    });
+    return true;
+}
+
+// Map every point of the ring on the cameras.
+void CurvilinearGrid::projectRing(GridRing &ring) {
+    uint sectors = ring.angles * 2;
+    ring.points.resize(sectors);
+    ring.maps.resize(sectors);
+    memset((void *)ring.maps.data(), SV_INVALID_INDEX, sizeof(PixelMap) * sectors);
 
-        int iNoP = pointIndex % mNoP;
-        if (iNoP == 0)
-            iMaxNoP = 0;
-        if (iNoP == mNoP - 1)
-            if (iMaxNoP < iMinNoP)
-                iMinNoP = iMaxNoP;
+    for (uint angle = 0; angle < sectors; angle++) {
+        double angle_start = angle * (M_PI / ring.angles); // Start angle of the circular sector
+        Vector3d &worldPoint = ring.points[angle];
+        worldPoint = Vector3d(ring.distance * cos(angle_start), ring.distance * sin(angle_start),
+                              ring.height);
+        PixelMap *pMap = &ring.maps[angle];
 
         for (int index = 0; index < mEvsRotations.size(); index++) {
-            auto &R = mEvsRotations[index];
             auto &T = mEvsTransforms[index];
             auto &K = mKs[index];
             auto &D = mDs[index];
@@ -142,9 +195,7 @@ bool CurvilinearGrid::createGrid(float radius) {
             double fy = K(1, 1);
             double cx = K(0, 2);
             double cy = K(1, 2);
-            double normal = R.norm();
-            AngleAxisd rotation_vector(normal, R / normal);
-            auto rotation_matrix = rotation_vector.toRotationMatrix();
+            auto &rotation_matrix = mRotationMatrices[index];
 
             Vector3d cameraPoint = rotation_matrix * worldPoint + T;
             Vector3d normalizedCamera = cameraPoint / cameraPoint[2];
@@ -180,8 +231,6 @@ bool CurvilinearGrid::createGrid(float radius) {
             double v_distorted = fy * y_distorted + cy;
             if (u_distorted >= 0 && v_distorted >= 0 && u_distorted < mWidth &&
                 v_distorted < mHeight) {
-                if (iMaxNoP < iNoP)
-                    iMaxNoP = iNoP;
                 // Get fisyeye image 2d pixel based on p3d point
                 if (pMap->index0 == -1) {
                     pMap->index0 = index;
@@ -201,17 +250,14 @@ bool CurvilinearGrid::createGrid(float radius) {
                     pMap->alpha1 = 1 - alpha0;
                     pMap->alpha0 = alpha0;
                 } else if ((index != pMap->index0) && (index != pMap->index1)) {
-                    ALOGW("********Point %d overlapped with 3 cameras!!!", pointIndex);
+                    ALOGW("********Point %u of ring %f overlapped with 3 cameras!!!", angle,
+                          ring.distance);
                 }
             } else {
                 // No valid mapping
             }
         }
     }
-    ALOGI("Grids %d of points on one line, minmum %d points with valid mapping on one line", mNoP,
-          iMinNoP);
-    mMinNoP = iMinNoP;
-    return true;
 }
 
 bool CurvilinearGrid::valid3DPoint(uint32_t index) {
@@ -334,25 +380,37 @@ static bool IsCommonIndex(int camera, PixelMap *LUT0, PixelMap *LUT1, PixelMap *
 }
 
 int CurvilinearGrid::getMashes(float **points, int camera) {
-    int size = 0;
-
     if (camera == SV_INVALID_INDEX) {
         ALOGE("Error! Not a valid camera index %d", camera);
         return 0;
     }
 
-    if (mGlobalP3d.size() == 0)
+    const vector<float> &mesh = getMesh(camera);
+    if (mesh.empty())
         return (0);
-    float x_norm = 1.0 / mWidth;
-    float y_norm = 1.0 / mHeight;
 
-    //(*points) = (float*)malloc(6 * SV_ATTRIBUTE_NUM * mP2d.size() * sizeof(float));
-    (*points) = (float *)malloc(6 * SV_ATTRIBUTE_NUM * mGlobalP3d.size() * sizeof(float));
+    (*points) = (float *)malloc(mesh.size() * sizeof(float));
     if ((*points) == NULL) {
         ALOGE("Memory allocation did not complete successfully");
         return (0);
     }
-    memset(*points, 0, 6 * SV_ATTRIBUTE_NUM * mGlobalP3d.size() * sizeof(float));
+    memcpy(*points, mesh.data(), mesh.size() * sizeof(float));
+    return mesh.size();
+}
+
+const vector<float> &CurvilinearGrid::getMesh(int camera) {
+    static const vector<float> empty;
+    if (camera < 0 || camera >= (int)mMeshes.size())
+        return empty;
+    return mMeshes[camera];
+}
+
+void CurvilinearGrid::buildMesh(int camera, vector<float> &mesh) {
+    mesh.clear();
+    if (mGlobalP3d.size() == 0)
+        return;
+    float x_norm = 1.0 / mWidth;
+    float y_norm = 1.0 / mHeight;
 
     /**************************** Get triangles for I quadrant of template
      *********************************** p  _  p+2 Triangles orientation: 		| /|
@@ -362,7 +420,10 @@ int CurvilinearGrid::getMashes(float **points, int camera) {
      *******************************************************************************************************/
     auto total = mParameters.angles * 2 * mNoP;
     auto norXY = mRadius + mParameters.nop_z * mParameters.step_x;
-    PixelMap *LUT = mLookupPtr.get();
+    PixelMap *LUT = mLookup.data();
+
+    // Find the grids seen by the camera first, so the mesh is allocated once at its final size.
+    vector<int> grids;
     for (uint angle = 0; angle < mParameters.angles * 2; angle++) {
         for (int n = 0; n < mMinNoP; n++) {
             int i = angle * mNoP + n;
@@ -375,42 +436,47 @@ int CurvilinearGrid::getMashes(float **points, int camera) {
                     IsCommonIndex(camera, LUT + i, LUT + i + 1, LUT + inext, LUT + inext + 1);
             if (!validGrid)
                 continue;
-
-            auto fn = [&](unsigned int point) {
-                (*points)[size++] = mGlobalP3d[point][0] / norXY;
-                (*points)[size++] = mGlobalP3d[point][1] / norXY;
-                (*points)[size++] = mGlobalP3d[point][2] / norXY;
-                // texture corridnate should be top - x*normal?
-                if (camera == (LUT + point)->index0) {
-                    (*points)[size++] = (LUT + point)->u0 * x_norm;
-                    (*points)[size++] = (LUT + point)->v0 * y_norm;
-                    (*points)[size++] = (LUT + point)->alpha0;
-                } else {
-                    (*points)[size++] = (LUT + point)->u1 * x_norm;
-                    (*points)[size++] = (LUT + point)->v1 * y_norm;
-                    (*points)[size++] = (LUT + point)->alpha1;
-                }
-            };
-
-            // first triangle
-            // P
-            fn(i);
-            // P1
-            fn(i + 1);
-            // P2
-            fn(inext);
-
-            // second triangle
-            // P3
-            fn(inext + 1);
-            // P2
-            fn(inext);
-            // P1
-            fn(i + 1);
+            grids.push_back(i);
         }
     }
 
-    return (size);
+    mesh.resize(grids.size() * 6 * SV_ATTRIBUTE_NUM);
+    float *points = mesh.data();
+    int size = 0;
+    for (int i : grids) {
+        int inext = (i + mNoP) % total;
+        auto fn = [&](unsigned int point) {
+            points[size++] = mGlobalP3d[point][0] / norXY;
+            points[size++] = mGlobalP3d[point][1] / norXY;
+            points[size++] = mGlobalP3d[point][2] / norXY;
+            // texture corridnate should be top - x*normal?
+            if (camera == (LUT + point)->index0) {
+                points[size++] = (LUT + point)->u0 * x_norm;
+                points[size++] = (LUT + point)->v0 * y_norm;
+                points[size++] = (LUT + point)->alpha0;
+            } else {
+                points[size++] = (LUT + point)->u1 * x_norm;
+                points[size++] = (LUT + point)->v1 * y_norm;
+                points[size++] = (LUT + point)->alpha1;
+            }
+        };
+
+        // first triangle
+        // P
+        fn(i);
+        // P1
+        fn(i + 1);
+        // P2
+        fn(inext);
+
+        // second triangle
+        // P3
+        fn(inext + 1);
+        // P2
+        fn(inext);
+        // P1
+        fn(i + 1);
+    }
 }
 
 } // namespace imx
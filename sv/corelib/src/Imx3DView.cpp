@@ -80,6 +80,7 @@ string Imx3DView::getEGLError(void) {
 
 Imx3DView::Imx3DView() {
     current_prog = 0;
+    mGrid = nullptr;
     // glBlendFunc(GL_ONE_MINUS_DST_ALPHA, GL_DST_ALPHA);
     // glBlendFunc(GL_DST_ALPHA, GL_ONE_MINUS_DST_ALPHA);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -92,6 +93,7 @@ Imx3DView::Imx3DView() {
 Imx3DView::Imx3DView(vector<Vector3d>& evsRotations, vector<Vector3d>& evsTransforms,
                      vector<Matrix<double, 3, 3>>& Ks, vector<Matrix<double, 1, 4>>& Ds) {
     current_prog = 0;
+    mGrid = nullptr;
     // glBlendFunc(GL_ONE_MINUS_DST_ALPHA, GL_DST_ALPHA);
     // glBlendFunc(GL_DST_ALPHA, GL_ONE_MINUS_DST_ALPHA);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -174,10 +176,10 @@ int Imx3DView::addMesh(string filename) {
     return (v_obj.size() - 1);
 }
 
-int Imx3DView::addMesh(float* data, int data_num) {
+int Imx3DView::addMesh(const float* data, int data_num) {
     ///////////////////////////////// Load vertices arrays ///////////////////////////////
     vertices_obj vo_tmp;
-    GLfloat* vert = data;
+    const GLfloat* vert = data;
     vo_tmp.num = data_num;
 
     //////////////////////// Camera textures initialization /////////////////////////////
@@ -208,7 +210,8 @@ void Imx3DView::texture2dInit(GLuint* texture) {
 
 /***************************************************************************************
 ***************************************************************************************/
-void Imx3DView::bufferObjectInit(GLuint* text_vao, GLuint* text_vbo, GLfloat* vert, int num) {
+void Imx3DView::bufferObjectInit(GLuint* text_vao, GLuint* text_vbo, const GLfloat* vert,
+                                 int num) {
     // rectangle
     glBindBuffer(GL_ARRAY_BUFFER, *text_vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * SV_ATTRIBUTE_NUM * num, &vert[0],
@@ -441,13 +444,8 @@ bool Imx3DView::prepareGL(uint32_t output_w, uint32_t output_h) {
 
     if (setProgram(2) == 0) {
         for (uint32_t index = 0; index < 4; index++) {
-            float* data = nullptr;
-            int data_num = mGrid->getMashes(&data, index);
-            int grid_buf = addMesh(data, data_num / SV_ATTRIBUTE_NUM);
-            if (data != nullptr) {
-                free(data);
-                data = nullptr;
-            }
+            const vector<float>& mesh = mGrid->getMesh(index);
+            int grid_buf = addMesh(mesh.data(), mesh.size() / SV_ATTRIBUTE_NUM);
             mAshes.push_back(grid_buf);
         }
 
@@ -467,6 +465,24 @@ bool Imx3DView::prepareGL(uint32_t output_w, uint32_t output_h) {
     return true;
 }
 
+bool Imx3DView::updateBowl(float radius) {
+    if (mGrid == nullptr || mAshes.empty())
+        return false;
+
+    if (!mGrid->createGrid(radius))
+        return false;
+
+    for (uint32_t index = 0; index < mAshes.size(); index++) {
+        const vector<float>& mesh = mGrid->getMesh(index);
+        vertices_obj& obj = v_obj[mAshes[index]];
+        obj.num = mesh.size() / SV_ATTRIBUTE_NUM;
+        glBindBuffer(GL_ARRAY_BUFFER, obj.vbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * mesh.size(), mesh.data(), GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
 bool Imx3DView::renderSV(vector<shared_ptr<unsigned char>> images, char* outbuf, uint32_t input_w,
                          uint32_t input_h, uint32_t output_w, uint32_t output_h) {
     if (!mInitial) {
@@ -0,0 +1,47 @@
+/*
+ *  Copyright 2023 NXP.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "ImxSVJobs.hpp"
+
+#include <thread>
+#include <vector>
+
+namespace imx {
+
+void runSVJobs(uint32_t count, const std::function<void(uint32_t, uint32_t)> &job) {
+    uint32_t bands = std::thread::hardware_concurrency();
+    if (bands > SV_MAX_JOB_THREADS)
+        bands = SV_MAX_JOB_THREADS;
+    if (bands > count)
+        bands = count;
+    if (bands <= 1) {
+        if (count > 0)
+            job(0, count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; i < bands; i++) {
+        workers.emplace_back(job, (uint64_t)count * i / bands,
+                             (uint64_t)count * (i + 1) / bands);
+    }
+    job(0, count / bands);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+} // namespace imx